@@ -46,6 +46,9 @@ struct _EAddressbookModelPrivate {
 	/* Query Results */
 	GPtrArray *contacts;
 
+	/* Contact UID -> index in contacts */
+	GHashTable *contact_index;
+
 	/* Signal Handler IDs */
 	gulong create_contact_id;
 	gulong remove_contact_id;
@@ -93,6 +96,42 @@ free_data (EAddressbookModel *model)
 	array = model->priv->contacts;
 	g_ptr_array_foreach (array, (GFunc) g_object_unref, NULL);
 	g_ptr_array_set_size (array, 0);
+
+	g_hash_table_remove_all (model->priv->contact_index);
+}
+
+/* Records the position of the contact at the given index */
+static void
+index_contact (EAddressbookModel *model,
+               guint index)
+{
+	EContact *contact;
+	const gchar *uid;
+
+	contact = model->priv->contacts->pdata[index];
+	uid = e_contact_get_const (contact, E_CONTACT_UID);
+
+	if (uid != NULL)
+		g_hash_table_insert (
+			model->priv->contact_index,
+			g_strdup (uid), GUINT_TO_POINTER (index));
+}
+
+/* Returns the index of the contact with the given UID, or -1 */
+static gint
+lookup_contact_index (EAddressbookModel *model,
+                      const gchar *uid)
+{
+	gpointer value;
+
+	if (uid == NULL)
+		return -1;
+
+	if (!g_hash_table_lookup_extended (
+		model->priv->contact_index, uid, NULL, &value))
+		return -1;
+
+	return GPOINTER_TO_UINT (value);
 }
 
 static void
@@ -189,6 +228,7 @@ view_create_contact_cb (EBookClientView *client_view,
 		EContact *contact = contact_list->data;
 
 		g_ptr_array_add (array, g_object_ref (contact));
+		index_contact (model, array->len - 1);
 		contact_list = contact_list->next;
 	}
 
@@ -211,53 +251,55 @@ view_remove_contact_cb (EBookClientView *client_view,
                         const GSList *ids,
                         EAddressbookModel *model)
 {
-	/* XXX we should keep a hash around instead of this O(n*m) loop */
 	const GSList *iter;
 	GArray *indices;
 	GPtrArray *array;
-	gint ii;
+	guint src, dest;
 
 	array = model->priv->contacts;
 	indices = g_array_new (FALSE, FALSE, sizeof (gint));
 
 	for (iter = ids; iter != NULL; iter = iter->next) {
 		const gchar *target_uid = iter->data;
+		gint ii;
 
-		for (ii = 0; ii < array->len; ii++) {
-			EContact *contact;
-			const gchar *uid;
-
-			contact = array->pdata[ii];
-			/* check if already removed */
-			if (!contact)
-				continue;
+		ii = lookup_contact_index (model, target_uid);
+		if (ii < 0)
+			continue;
 
-			uid = e_contact_get_const (contact, E_CONTACT_UID);
-			g_return_if_fail (uid != NULL);
+		g_hash_table_remove (model->priv->contact_index, target_uid);
 
-			if (strcmp (uid, target_uid) == 0) {
-				g_object_unref (contact);
-				g_array_append_val (indices, ii);
-				array->pdata[ii] = NULL;
-				break;
-			}
-		}
+		g_object_unref (array->pdata[ii]);
+		g_array_append_val (indices, ii);
+		array->pdata[ii] = NULL;
 	}
 
-	/* Sort the 'indices' array in descending order, since
-	 * g_ptr_array_remove_index() shifts subsequent elements
-	 * down one position to fill the gap. */
+	/* Sort the 'indices' array in descending order, which is
+	 * the order the CONTACTS_REMOVED listeners expect. */
 	g_array_sort (indices, sort_descending);
 
-	for (ii = 0; ii < indices->len; ii++) {
-		gint index;
+	/* Close the gaps in one pass, from the first removed
+	 * contact on, updating the index of each moved contact. */
+	if (indices->len > 0) {
+		dest = g_array_index (indices, gint, indices->len - 1);
+
+		for (src = dest; src < array->len; src++) {
+			if (array->pdata[src] == NULL)
+				continue;
+
+			if (src != dest) {
+				array->pdata[dest] = array->pdata[src];
+				index_contact (model, dest);
+			}
+
+			dest++;
+		}
 
-		index = g_array_index (indices, gint, ii);
-		g_ptr_array_remove_index (array, index);
+		g_ptr_array_set_size (array, dest);
 	}
 
 	g_signal_emit (model, signals[CONTACTS_REMOVED], 0, indices);
-	g_array_free (indices, FALSE);
+	g_array_free (indices, TRUE);
 
 	update_folder_bar_message (model);
 }
@@ -279,31 +321,15 @@ view_modify_contact_cb (EBookClientView *client_view,
 		target_uid = e_contact_get_const (new_contact, E_CONTACT_UID);
 		g_warn_if_fail (target_uid != NULL);
 
-		/* skip contacts without UID */
-		if (!target_uid) {
-			contact_list = contact_list->next;
-			continue;
-		}
-
-		for (ii = 0; ii < array->len; ii++) {
-			EContact *old_contact;
-			const gchar *uid;
-
-			old_contact = array->pdata[ii];
-			g_return_if_fail (old_contact != NULL);
-
-			uid = e_contact_get_const (old_contact, E_CONTACT_UID);
-			g_return_if_fail (uid != NULL);
+		ii = lookup_contact_index (model, target_uid);
 
-			if (strcmp (uid, target_uid) != 0)
-				continue;
-
-			g_object_unref (old_contact);
+		/* skip contacts without UID or not in the model */
+		if (ii >= 0) {
+			g_object_unref (array->pdata[ii]);
 			array->pdata[ii] = e_contact_duplicate (new_contact);
 
 			g_signal_emit (
 				model, signals[CONTACT_CHANGED], 0, ii);
-			break;
 		}
 
 		contact_list = contact_list->next;
@@ -579,6 +605,7 @@ addressbook_model_finalize (GObject *object)
 	priv = E_ADDRESSBOOK_MODEL_GET_PRIVATE (object);
 
 	g_ptr_array_free (priv->contacts, TRUE);
+	g_hash_table_destroy (priv->contact_index);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_addressbook_model_parent_class)->finalize (object);
@@ -770,6 +797,8 @@ e_addressbook_model_init (EAddressbookModel *model)
 {
 	model->priv = E_ADDRESSBOOK_MODEL_GET_PRIVATE (model);
 	model->priv->contacts = g_ptr_array_new ();
+	model->priv->contact_index = g_hash_table_new_full (
+		g_str_hash, g_str_equal, g_free, NULL);
 	model->priv->first_get_view = TRUE;
 }
 
@@ -876,6 +905,13 @@ e_addressbook_model_find (EAddressbookModel *model,
 	g_return_val_if_fail (E_IS_CONTACT (contact), -1);
 
 	array = model->priv->contacts;
+
+	ii = lookup_contact_index (
+		model, e_contact_get_const (contact, E_CONTACT_UID));
+	if (ii >= 0 && array->pdata[ii] == contact)
+		return ii;
+
+	/* Not indexed, e.g. a duplicate UID; search the array. */
 	for (ii = 0; ii < array->len; ii++) {
 		EContact *candidate = array->pdata[ii];
 
@@ -18,6 +18,7 @@
  */
 
 #include <gtk/gtk.h>
+#include <libebook/libebook.h>
 
 struct _EImportImporter *evolution_ldif_importer_peek (void);
 struct _EImportImporter *evolution_vcard_importer_peek (void);
@@ -27,3 +28,23 @@ struct _EImportImporter *evolution_csv_evolution_importer_peek (void);
 
 /* private utility function for importers only */
 GtkWidget *evolution_contact_importer_get_preview_widget (const GSList *contacts);
+
+/* threaded, batched import shared by the contact importers */
+typedef struct _EvolutionContactImportJob EvolutionContactImportJob;
+
+typedef void (*EvolutionContactImportFunc) (EvolutionContactImportJob *job,
+					    gpointer user_data,
+					    GCancellable *cancellable);
+
+void evolution_contact_importer_run (struct _EImport *import,
+				     struct _EImportTarget *target,
+				     ESource *source,
+				     EvolutionContactImportFunc func,
+				     gpointer user_data,
+				     GDestroyNotify destroy_user_data);
+void evolution_contact_importer_cancel (struct _EImportTarget *target);
+void evolution_contact_import_job_submit (EvolutionContactImportJob *job,
+					  EContact *contact);
+void evolution_contact_import_job_flush (EvolutionContactImportJob *job);
+void evolution_contact_import_job_set_progress (EvolutionContactImportJob *job,
+						gint percent);
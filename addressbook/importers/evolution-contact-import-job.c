@@ -0,0 +1,332 @@
+/*
+ * Evolution addressbook - Threaded, batched contact import
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib/gi18n.h>
+
+#include <libebook/libebook.h>
+
+#include <e-util/e-util.h>
+
+#include "evolution-addressbook-importers.h"
+
+#define IMPORT_JOB_KEY "contact-import-job"
+
+/* How often the main loop picks up progress from the worker thread. */
+#define PROGRESS_INTERVAL 250 /* milliseconds */
+
+struct _EvolutionContactImportJob {
+	EImport *import;
+	EImportTarget *target;
+	EBookClient *book_client;
+	GCancellable *cancellable;
+
+	EvolutionContactImportFunc func;
+	gpointer user_data;
+	GDestroyNotify destroy_user_data;
+
+	/* Pending contacts, most recently submitted first. */
+	GSList *batch;
+	guint batch_length;
+	guint batch_size;
+
+	volatile gint percent;
+	guint progress_id;
+};
+
+static void
+import_job_free (EvolutionContactImportJob *job)
+{
+	if (job->progress_id)
+		g_source_remove (job->progress_id);
+
+	if (job->destroy_user_data)
+		job->destroy_user_data (job->user_data);
+
+	g_slist_free_full (job->batch, (GDestroyNotify) g_object_unref);
+
+	g_clear_object (&job->book_client);
+	g_clear_object (&job->cancellable);
+	g_object_unref (job->import);
+
+	g_free (job);
+}
+
+static void
+import_job_complete (EvolutionContactImportJob *job)
+{
+	EImport *import = g_object_ref (job->import);
+	EImportTarget *target = job->target;
+
+	g_datalist_remove_data (&target->data, IMPORT_JOB_KEY);
+	import_job_free (job);
+
+	e_import_complete (import, target);
+	g_object_unref (import);
+}
+
+static gboolean
+import_job_progress_cb (gpointer user_data)
+{
+	EvolutionContactImportJob *job = user_data;
+
+	e_import_status (
+		job->import, job->target, _("Importing..."),
+		g_atomic_int_get (&job->percent));
+
+	return TRUE;
+}
+
+static void
+import_job_thread (GTask *task,
+                   gpointer source_object,
+                   gpointer task_data,
+                   GCancellable *cancellable)
+{
+	EvolutionContactImportJob *job = task_data;
+
+	job->func (job, job->user_data, cancellable);
+	evolution_contact_import_job_flush (job);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+import_job_done_cb (GObject *source_object,
+                    GAsyncResult *result,
+                    gpointer user_data)
+{
+	import_job_complete (user_data);
+}
+
+static void
+import_job_connect_cb (GObject *source_object,
+                       GAsyncResult *result,
+                       gpointer user_data)
+{
+	EvolutionContactImportJob *job = user_data;
+	EClient *client;
+	GTask *task;
+	GError *error = NULL;
+
+	client = e_book_client_connect_finish (result, &error);
+
+	if (client == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("%s: %s", G_STRFUNC, error->message);
+		g_error_free (error);
+		import_job_complete (job);
+		return;
+	}
+
+	job->book_client = E_BOOK_CLIENT (client);
+
+	/* Backends without bulk adds only take one contact at a time. */
+	if (!e_client_check_capability (client, "bulk-adds"))
+		job->batch_size = 1;
+
+	job->progress_id = g_timeout_add (
+		PROGRESS_INTERVAL, import_job_progress_cb, job);
+
+	task = g_task_new (NULL, job->cancellable, import_job_done_cb, job);
+	g_task_set_task_data (task, job, NULL);
+	g_task_run_in_thread (task, import_job_thread);
+	g_object_unref (task);
+}
+
+/* Adds contacts one at a time; used when the backend
+ * rejects a batch, so one bad contact does not lose the rest. */
+static void
+import_job_add_each (EvolutionContactImportJob *job,
+                     GSList *contacts)
+{
+	GSList *link;
+
+	for (link = contacts; link; link = g_slist_next (link)) {
+		EContact *contact = link->data;
+		gchar *uid = NULL;
+
+		if (g_cancellable_is_cancelled (job->cancellable))
+			break;
+
+		e_book_client_add_contact_sync (
+			job->book_client, contact, &uid,
+			job->cancellable, NULL);
+		if (uid != NULL) {
+			e_contact_set (contact, E_CONTACT_UID, uid);
+			g_free (uid);
+		}
+	}
+}
+
+/**
+ * evolution_contact_importer_run:
+ * @import: an #EImport
+ * @target: the #EImportTarget being imported
+ * @source: the address book #ESource to import into
+ * @func: function reading contacts, called in a worker thread
+ * @user_data: data to pass to @func
+ * @destroy_user_data: function to free @user_data, called in the main thread
+ *
+ * Connects to @source and runs @func in a worker thread.  @func passes
+ * each parsed contact to evolution_contact_import_job_submit(), which
+ * adds them to the address book in batches.  Progress reported through
+ * evolution_contact_import_job_set_progress() is forwarded to @import
+ * from the main loop, and e_import_complete() is called once done.
+ **/
+void
+evolution_contact_importer_run (EImport *import,
+                                EImportTarget *target,
+                                ESource *source,
+                                EvolutionContactImportFunc func,
+                                gpointer user_data,
+                                GDestroyNotify destroy_user_data)
+{
+	EvolutionContactImportJob *job;
+	GSettings *settings;
+
+	g_return_if_fail (E_IS_IMPORT (import));
+	g_return_if_fail (target != NULL);
+	g_return_if_fail (func != NULL);
+
+	settings = g_settings_new ("org.gnome.evolution.addressbook");
+
+	job = g_new0 (EvolutionContactImportJob, 1);
+	job->import = g_object_ref (import);
+	job->target = target;
+	job->cancellable = g_cancellable_new ();
+	job->func = func;
+	job->user_data = user_data;
+	job->destroy_user_data = destroy_user_data;
+	job->batch_size = MAX (1, g_settings_get_int (settings, "import-batch-size"));
+
+	g_object_unref (settings);
+
+	g_datalist_set_data (&target->data, IMPORT_JOB_KEY, job);
+
+	if (source == NULL) {
+		import_job_complete (job);
+		return;
+	}
+
+	e_book_client_connect (
+		source, job->cancellable, import_job_connect_cb, job);
+}
+
+/**
+ * evolution_contact_importer_cancel:
+ * @target: the #EImportTarget being imported
+ *
+ * Cancels the import running for @target, if any.  Contacts already
+ * submitted stay in the address book.
+ **/
+void
+evolution_contact_importer_cancel (EImportTarget *target)
+{
+	EvolutionContactImportJob *job;
+
+	g_return_if_fail (target != NULL);
+
+	job = g_datalist_get_data (&target->data, IMPORT_JOB_KEY);
+	if (job)
+		g_cancellable_cancel (job->cancellable);
+}
+
+/**
+ * evolution_contact_import_job_submit:
+ * @job: an #EvolutionContactImportJob
+ * @contact: an #EContact to import
+ *
+ * Queues @contact for import, sending the batch to the address book once
+ * it is full.  The contact's UID is set after it has been added.  Only
+ * call this from the import function.
+ **/
+void
+evolution_contact_import_job_submit (EvolutionContactImportJob *job,
+                                     EContact *contact)
+{
+	g_return_if_fail (job != NULL);
+	g_return_if_fail (E_IS_CONTACT (contact));
+
+	job->batch = g_slist_prepend (job->batch, g_object_ref (contact));
+	job->batch_length++;
+
+	if (job->batch_length >= job->batch_size)
+		evolution_contact_import_job_flush (job);
+}
+
+/**
+ * evolution_contact_import_job_flush:
+ * @job: an #EvolutionContactImportJob
+ *
+ * Adds all queued contacts to the address book now, e.g. because later
+ * contacts refer to their UIDs.  Only call this from the import function.
+ **/
+void
+evolution_contact_import_job_flush (EvolutionContactImportJob *job)
+{
+	GSList *contacts, *uids = NULL;
+	GError *error = NULL;
+
+	g_return_if_fail (job != NULL);
+
+	if (job->batch == NULL)
+		return;
+
+	contacts = g_slist_reverse (job->batch);
+	job->batch = NULL;
+	job->batch_length = 0;
+
+	if (job->batch_size == 1) {
+		import_job_add_each (job, contacts);
+
+	} else if (e_book_client_add_contacts_sync (
+		job->book_client, contacts, &uids, job->cancellable, &error)) {
+		GSList *link, *uid_link;
+
+		for (link = contacts, uid_link = uids; link && uid_link;
+		     link = g_slist_next (link), uid_link = g_slist_next (uid_link))
+			e_contact_set (link->data, E_CONTACT_UID, uid_link->data);
+
+	} else if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_warning ("%s: %s", G_STRFUNC, error->message);
+		import_job_add_each (job, contacts);
+	}
+
+	g_clear_error (&error);
+	g_slist_free_full (uids, g_free);
+	g_slist_free_full (contacts, (GDestroyNotify) g_object_unref);
+}
+
+/**
+ * evolution_contact_import_job_set_progress:
+ * @job: an #EvolutionContactImportJob
+ * @percent: progress of the import, 0 to 100
+ *
+ * Records the import progress.  Safe to call from the worker thread.
+ **/
+void
+evolution_contact_import_job_set_progress (EvolutionContactImportJob *job,
+                                           gint percent)
+{
+	g_return_if_fail (job != NULL);
+
+	g_atomic_int_set (&job->percent, CLAMP (percent, 0, 100));
+}
@@ -47,12 +47,6 @@
 #define TAB_FILE_DELIMITER '\t'
 
 typedef struct {
-	EImport *import;
-	EImportTarget *target;
-
-	guint idle_id;
-
-	gint state;
 	FILE *file;
 	gulong size;
 	gint count;
@@ -60,16 +54,11 @@ typedef struct {
 	/* gint -> gint -- Column index in the CSV
 	 * file to an index in the known fields array. */
 	GHashTable *fields_map;
-
-	EBookClient *book_client;
-	GSList *contacts;
 } CSVImporter;
 
 static gint importer;
 static gchar delimiter;
 
-static void csv_import_done (CSVImporter *gci);
-
 typedef struct {
 	const gchar *csv_attribute;
 	EContactField contact_field;
@@ -717,35 +706,23 @@ getNextCSVEntry (CSVImporter *gci,
 	return contact;
 }
 
-static gboolean
-csv_import_contacts (gpointer d)
+/* Runs in a worker thread. */
+static void
+csv_import_contacts (EvolutionContactImportJob *job,
+                     gpointer user_data,
+                     GCancellable *cancellable)
 {
-	CSVImporter *gci = d;
-	EContact *contact = NULL;
+	CSVImporter *gci = user_data;
+	EContact *contact;
 
-	while ((contact = getNextCSVEntry (gci, gci->file))) {
-		gchar *uid = NULL;
+	while (!g_cancellable_is_cancelled (cancellable) &&
+	       (contact = getNextCSVEntry (gci, gci->file)) != NULL) {
+		evolution_contact_import_job_submit (job, contact);
+		g_object_unref (contact);
 
-		e_book_client_add_contact_sync (
-			gci->book_client, contact, &uid, NULL, NULL);
-		if (uid != NULL) {
-			e_contact_set (contact, E_CONTACT_UID, uid);
-			g_free (uid);
-		}
-		gci->contacts = g_slist_prepend (gci->contacts, contact);
-	}
-	if (contact == NULL) {
-		gci->state = 1;
-	}
-	if (gci->state == 1) {
-		csv_import_done (gci);
-		return FALSE;
-	}
-	else {
-		e_import_status (
-			gci->import, gci->target, _("Importing..."),
-			ftell (gci->file) * 100 / gci->size);
-		return TRUE;
+		if (gci->size > 0)
+			evolution_contact_import_job_set_progress (
+				job, ftell (gci->file) * 100 / gci->size);
 	}
 }
 
@@ -853,44 +830,16 @@ csv_supported (EImport *ei,
 }
 
 static void
-csv_import_done (CSVImporter *gci)
+csv_importer_free (CSVImporter *gci)
 {
-	if (gci->idle_id)
-		g_source_remove (gci->idle_id);
-
 	fclose (gci->file);
-	g_object_unref (gci->book_client);
-	g_slist_foreach (gci->contacts, (GFunc) g_object_unref, NULL);
-	g_slist_free (gci->contacts);
 
 	if (gci->fields_map)
 		g_hash_table_destroy (gci->fields_map);
 
-	e_import_complete (gci->import, gci->target);
-	g_object_unref (gci->import);
-
 	g_free (gci);
 }
 
-static void
-book_client_connect_cb (GObject *source_object,
-                        GAsyncResult *result,
-                        gpointer user_data)
-{
-	CSVImporter *gci = user_data;
-	EClient *client;
-
-	client = e_book_client_connect_finish (result, NULL);
-
-	if (client == NULL) {
-		csv_import_done (gci);
-		return;
-	}
-
-	gci->book_client = E_BOOK_CLIENT (client);
-	gci->idle_id = g_idle_add (csv_import_contacts, gci);
-}
-
 static void
 csv_import (EImport *ei,
             EImportTarget *target,
@@ -917,9 +866,6 @@ csv_import (EImport *ei,
 	}
 
 	gci = g_malloc0 (sizeof (*gci));
-	g_datalist_set_data (&target->data, "csv-data", gci);
-	gci->import = g_object_ref (ei);
-	gci->target = target;
 	gci->file = file;
 	gci->fields_map = NULL;
 	gci->count = 0;
@@ -929,7 +875,9 @@ csv_import (EImport *ei,
 
 	source = g_datalist_get_data (&target->data, "csv-source");
 
-	e_book_client_connect (source, NULL, book_client_connect_cb, gci);
+	evolution_contact_importer_run (
+		ei, target, source, csv_import_contacts,
+		gci, (GDestroyNotify) csv_importer_free);
 }
 
 static void
@@ -964,10 +912,7 @@ csv_cancel (EImport *ei,
             EImportTarget *target,
             EImportImporter *im)
 {
-	CSVImporter *gci = g_datalist_get_data (&target->data, "csv-data");
-
-	if (gci)
-		gci->state = 1;
+	evolution_contact_importer_cancel (target);
 }
 
 static GtkWidget *
@@ -47,26 +47,15 @@
 #include "evolution-addressbook-importers.h"
 
 typedef struct {
-	EImport *import;
-	EImportTarget *target;
-
-	guint idle_id;
-
 	GHashTable *dn_contact_hash;
 
-	gint state;		/* 0 - initial scan, 1 - list cards, 2 - cancelled/complete */
 	FILE *file;
 	gulong size;
 
-	EBookClient *book_client;
-
 	GSList *contacts;
 	GSList *list_contacts;
-	GSList *list_iterator;
 } LDIFImporter;
 
-static void ldif_import_done (LDIFImporter *gci);
-
 static struct {
 	const gchar *ldif_attribute;
 	EContactField contact_field;
@@ -482,72 +471,48 @@ add_to_notes (EContact *contact,
 	g_free (new_text);
 }
 
-static gboolean
-ldif_import_contacts (gpointer d)
+/* Runs in a worker thread. */
+static void
+ldif_import_contacts (EvolutionContactImportJob *job,
+                      gpointer user_data,
+                      GCancellable *cancellable)
 {
-	LDIFImporter *gci = d;
+	LDIFImporter *gci = user_data;
 	EContact *contact;
 	GSList *iter;
-	gint count = 0;
 
 	/* We process all normal cards immediately and keep the list
 	 * ones till the end */
 
-	if (gci->state == 0) {
-		while (count < 50 && (contact = getNextLDIFEntry (
-			gci->dn_contact_hash, gci->file))) {
-			if (e_contact_get (contact, E_CONTACT_IS_LIST)) {
-				gci->list_contacts = g_slist_prepend (
-					gci->list_contacts, contact);
-			} else {
-				gchar *uid = NULL;
-
-				add_to_notes (contact, E_CONTACT_OFFICE);
-				add_to_notes (contact, E_CONTACT_SPOUSE);
-				add_to_notes (contact, E_CONTACT_BLOG_URL);
-
-				e_book_client_add_contact_sync (
-					gci->book_client,
-					contact, &uid, NULL, NULL);
-				if (uid != NULL) {
-					e_contact_set (contact, E_CONTACT_UID, uid);
-					g_free (uid);
-				}
-				gci->contacts = g_slist_prepend (gci->contacts, contact);
-			}
-			count++;
-		}
-		if (contact == NULL) {
-			gci->state = 1;
-			gci->list_iterator = gci->list_contacts;
-		}
-	}
-	if (gci->state == 1) {
-		for (iter = gci->list_iterator; count < 50 && iter; iter = iter->next) {
-			gchar *uid = NULL;
-
-			contact = iter->data;
-			resolve_list_card (gci, contact);
-			e_book_client_add_contact_sync (
-				gci->book_client, contact, &uid, NULL, NULL);
-			if (uid != NULL) {
-				e_contact_set (contact, E_CONTACT_UID, uid);
-				g_free (uid);
-			}
-			count++;
+	while (!g_cancellable_is_cancelled (cancellable) &&
+	       (contact = getNextLDIFEntry (gci->dn_contact_hash, gci->file))) {
+		if (e_contact_get (contact, E_CONTACT_IS_LIST)) {
+			gci->list_contacts = g_slist_prepend (
+				gci->list_contacts, contact);
+		} else {
+			add_to_notes (contact, E_CONTACT_OFFICE);
+			add_to_notes (contact, E_CONTACT_SPOUSE);
+			add_to_notes (contact, E_CONTACT_BLOG_URL);
+
+			evolution_contact_import_job_submit (job, contact);
+			gci->contacts = g_slist_prepend (gci->contacts, contact);
 		}
-		gci->list_iterator = iter;
-		if (iter == NULL)
-			gci->state = 2;
+
+		if (gci->size > 0)
+			evolution_contact_import_job_set_progress (
+				job, ftell (gci->file) * 100 / gci->size);
 	}
-	if (gci->state == 2) {
-		ldif_import_done (gci);
-		return FALSE;
-	} else {
-		e_import_status (
-			gci->import, gci->target, _("Importing..."),
-			ftell (gci->file) * 100 / gci->size);
-		return TRUE;
+
+	/* List cards refer to the UIDs of the contacts above. */
+	evolution_contact_import_job_flush (job);
+
+	for (iter = gci->list_contacts; iter; iter = iter->next) {
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+
+		contact = iter->data;
+		resolve_list_card (gci, contact);
+		evolution_contact_import_job_submit (job, contact);
 	}
 }
 
@@ -648,44 +613,18 @@ ldif_supported (EImport *ei,
 }
 
 static void
-ldif_import_done (LDIFImporter *gci)
+ldif_importer_free (LDIFImporter *gci)
 {
-	if (gci->idle_id)
-		g_source_remove (gci->idle_id);
-
 	fclose (gci->file);
-	g_object_unref (gci->book_client);
 	g_slist_foreach (gci->contacts, (GFunc) g_object_unref, NULL);
 	g_slist_foreach (gci->list_contacts, (GFunc) g_object_unref, NULL);
 	g_slist_free (gci->contacts);
 	g_slist_free (gci->list_contacts);
 	g_hash_table_destroy (gci->dn_contact_hash);
 
-	e_import_complete (gci->import, gci->target);
-	g_object_unref (gci->import);
-
 	g_free (gci);
 }
 
-static void
-book_client_connect_cb (GObject *source_object,
-                        GAsyncResult *result,
-                        gpointer user_data)
-{
-	LDIFImporter *gci = user_data;
-	EClient *client;
-
-	client = e_book_client_connect_finish (result, NULL);
-
-	if (client == NULL) {
-		ldif_import_done (gci);
-		return;
-	}
-
-	gci->book_client = E_BOOK_CLIENT (client);
-	gci->idle_id = g_idle_add (ldif_import_contacts, gci);
-}
-
 static void
 ldif_import (EImport *ei,
              EImportTarget *target,
@@ -709,9 +648,6 @@ ldif_import (EImport *ei,
 	}
 
 	gci = g_malloc0 (sizeof (*gci));
-	g_datalist_set_data (&target->data, "ldif-data", gci);
-	gci->import = g_object_ref (ei);
-	gci->target = target;
 	gci->file = file;
 	fseek (file, 0, SEEK_END);
 	gci->size = ftell (file);
@@ -723,7 +659,9 @@ ldif_import (EImport *ei,
 
 	source = g_datalist_get_data (&target->data, "ldif-source");
 
-	e_book_client_connect (source, NULL, book_client_connect_cb, gci);
+	evolution_contact_importer_run (
+		ei, target, source, ldif_import_contacts,
+		gci, (GDestroyNotify) ldif_importer_free);
 }
 
 static void
@@ -731,10 +669,7 @@ ldif_cancel (EImport *ei,
              EImportTarget *target,
              EImportImporter *im)
 {
-	LDIFImporter *gci = g_datalist_get_data (&target->data, "ldif-data");
-
-	if (gci)
-		gci->state = 2;
+	evolution_contact_importer_cancel (target);
 }
 
 static GtkWidget *
@@ -52,35 +52,15 @@ enum _VCardEncoding {
 typedef enum _VCardEncoding VCardEncoding;
 
 typedef struct {
-	EImport *import;
-	EImportTarget *target;
-
-	guint idle_id;
-
-	gint state;		/* 0 - importing, 1 - cancelled/complete */
-	gint total;
-	gint count;
-
-	ESource *primary;
-
-	GSList *contactlist;
-	GSList *iterator;
-	EBookClient *book_client;
-
-	/* when opening book */
-	gchar *contents;
+	GFile *file;
 	VCardEncoding encoding;
 } VCardImporter;
 
-static void vcard_import_done (VCardImporter *gci);
-
 static void
-vcard_import_contact (VCardImporter *gci,
-                      EContact *contact)
+vcard_prepare_contact (EContact *contact)
 {
 	EContactPhoto *photo;
 	GList *attrs, *attr;
-	gchar *uid = NULL;
 
 	/* Apple's addressbook.app exports PHOTO's without a TYPE
 	 * param, so let's figure out the format here if there's a
@@ -214,42 +194,128 @@ vcard_import_contact (VCardImporter *gci,
 		}
 	}
 
-	/* FIXME Error checking */
-	e_book_client_add_contact_sync (
-		gci->book_client, contact, &uid, NULL, NULL);
-	if (uid != NULL) {
-		e_contact_set (contact, E_CONTACT_UID, uid);
-		g_free (uid);
+}
+
+static GInputStream *
+vcard_open_stream (VCardImporter *gci,
+                   GFileInputStream *file_stream)
+{
+	GCharsetConverter *converter = NULL;
+	GInputStream *stream;
+	const gchar *charset = NULL;
+	GError *error = NULL;
+
+	if (gci->encoding == VCARD_ENCODING_UTF16)
+		charset = "UTF-16";
+	else if (gci->encoding == VCARD_ENCODING_LOCALE)
+		g_get_charset (&charset);
+
+	if (charset != NULL)
+		converter = g_charset_converter_new ("UTF-8", charset, &error);
+
+	if (error != NULL) {
+		g_warning ("%s: %s", G_STRFUNC, error->message);
+		g_error_free (error);
 	}
+
+	if (converter == NULL)
+		return g_object_ref (file_stream);
+
+	stream = g_converter_input_stream_new (
+		G_INPUT_STREAM (file_stream), G_CONVERTER (converter));
+	g_object_unref (converter);
+
+	return stream;
 }
 
-static gboolean
-vcard_import_contacts (gpointer data)
+/* Runs in a worker thread.  Reads the file line by line and submits
+ * each card as soon as its END:VCARD is seen, so the whole file is
+ * never held in memory. */
+static void
+vcard_import_contacts (EvolutionContactImportJob *job,
+                       gpointer user_data,
+                       GCancellable *cancellable)
 {
-	VCardImporter *gci = data;
-	gint count = 0;
-	GSList *iterator = gci->iterator;
-
-	if (gci->state == 0) {
-		while (count < 50 && iterator) {
-			vcard_import_contact (gci, iterator->data);
-			count++;
-			iterator = iterator->next;
+	VCardImporter *gci = user_data;
+	GFileInputStream *file_stream;
+	GInputStream *stream;
+	GDataInputStream *data_stream;
+	GFileInfo *info;
+	GString *card;
+	goffset size = 0;
+	gchar *line;
+	gint depth = 0;
+	GError *error = NULL;
+
+	file_stream = g_file_read (gci->file, cancellable, &error);
+	if (file_stream == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("%s: %s", G_STRFUNC, error->message);
+		g_error_free (error);
+		return;
+	}
+
+	info = g_file_input_stream_query_info (
+		file_stream, G_FILE_ATTRIBUTE_STANDARD_SIZE, cancellable, NULL);
+	if (info != NULL) {
+		size = g_file_info_get_size (info);
+		g_object_unref (info);
+	}
+
+	stream = vcard_open_stream (gci, file_stream);
+	data_stream = g_data_input_stream_new (stream);
+	g_data_input_stream_set_newline_type (
+		data_stream, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+	g_object_unref (stream);
+
+	card = g_string_new (NULL);
+
+	while ((line = g_data_input_stream_read_line (
+		data_stream, NULL, cancellable, &error)) != NULL) {
+
+		if (g_ascii_strncasecmp (line, "BEGIN:VCARD", 11) == 0)
+			depth++;
+
+		if (depth > 0) {
+			g_string_append (card, line);
+			g_string_append_c (card, '\n');
+		}
+
+		if (depth > 0 && g_ascii_strncasecmp (line, "END:VCARD", 9) == 0 && --depth == 0) {
+			EContact *contact;
+
+			contact = e_contact_new_from_vcard (card->str);
+			vcard_prepare_contact (contact);
+			evolution_contact_import_job_submit (job, contact);
+			g_object_unref (contact);
+
+			g_string_truncate (card, 0);
+
+			if (size > 0)
+				evolution_contact_import_job_set_progress (
+					job, g_seekable_tell (
+					G_SEEKABLE (file_stream)) * 100 / size);
 		}
-		gci->count += count;
-		gci->iterator = iterator;
-		if (iterator == NULL)
-			gci->state = 1;
+
+		g_free (line);
 	}
-	if (gci->state == 1) {
-		vcard_import_done (gci);
-		return FALSE;
-	} else {
-		e_import_status (
-			gci->import, gci->target, _("Importing..."),
-			gci->count * 100 / gci->total);
-		return TRUE;
+
+	if (error != NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("%s: %s", G_STRFUNC, error->message);
+		g_error_free (error);
 	}
+
+	g_string_free (card, TRUE);
+	g_object_unref (data_stream);
+	g_object_unref (file_stream);
+}
+
+static void
+vcard_importer_free (VCardImporter *gci)
+{
+	g_object_unref (gci->file);
+	g_free (gci);
 }
 
 #define BOM (gunichar2)0xFEFF
@@ -445,65 +511,6 @@ vcard_supported (EImport *ei,
 	return retval;
 }
 
-static void
-vcard_import_done (VCardImporter *gci)
-{
-	if (gci->idle_id)
-		g_source_remove (gci->idle_id);
-
-	g_free (gci->contents);
-	g_object_unref (gci->book_client);
-	g_slist_free_full (gci->contactlist, (GDestroyNotify) g_object_unref);
-
-	e_import_complete (gci->import, gci->target);
-	g_object_unref (gci->import);
-	g_free (gci);
-}
-
-static void
-book_client_connect_cb (GObject *source_object,
-                        GAsyncResult *result,
-                        gpointer user_data)
-{
-	VCardImporter *gci = user_data;
-	EClient *client;
-
-	client = e_book_client_connect_finish (result, NULL);
-
-	if (client == NULL) {
-		vcard_import_done (gci);
-		return;
-	}
-
-	gci->book_client = E_BOOK_CLIENT (client);
-
-	if (gci->encoding == VCARD_ENCODING_UTF16) {
-		gchar *tmp;
-
-		gunichar2 *contents_utf16 = (gunichar2 *) gci->contents;
-		tmp = utf16_to_utf8 (contents_utf16);
-		g_free (gci->contents);
-		gci->contents = tmp;
-
-	} else if (gci->encoding == VCARD_ENCODING_LOCALE) {
-		gchar *tmp;
-		tmp = g_locale_to_utf8 (gci->contents, -1, NULL, NULL, NULL);
-		g_free (gci->contents);
-		gci->contents = tmp;
-	}
-
-	gci->contactlist = eab_contact_list_from_string (gci->contents);
-	g_free (gci->contents);
-	gci->contents = NULL;
-	gci->iterator = gci->contactlist;
-	gci->total = g_slist_length (gci->contactlist);
-
-	if (gci->iterator)
-		gci->idle_id = g_idle_add (vcard_import_contacts, gci);
-	else
-		vcard_import_done (gci);
-}
-
 static void
 vcard_import (EImport *ei,
               EImportTarget *target,
@@ -513,7 +520,6 @@ vcard_import (EImport *ei,
 	ESource *source;
 	EImportTargetURI *s = (EImportTargetURI *) target;
 	gchar *filename;
-	gchar *contents;
 	VCardEncoding encoding;
 
 	filename = g_filename_from_uri (s->uri_src, NULL, NULL);
@@ -531,24 +537,17 @@ vcard_import (EImport *ei,
 		return;
 	}
 
-	if (!g_file_get_contents (filename, &contents, NULL, NULL)) {
-		g_message (G_STRLOC ":Couldn't read file.");
-		g_free (filename);
-		e_import_complete (ei, target);
-		return;
-	}
-
-	g_free (filename);
 	gci = g_malloc0 (sizeof (*gci));
-	g_datalist_set_data (&target->data, "vcard-data", gci);
-	gci->import = g_object_ref (ei);
-	gci->target = target;
+	gci->file = g_file_new_for_path (filename);
 	gci->encoding = encoding;
-	gci->contents = contents;
+
+	g_free (filename);
 
 	source = g_datalist_get_data (&target->data, "vcard-source");
 
-	e_book_client_connect (source, NULL, book_client_connect_cb, gci);
+	evolution_contact_importer_run (
+		ei, target, source, vcard_import_contacts,
+		gci, (GDestroyNotify) vcard_importer_free);
 }
 
 static void
@@ -556,10 +555,7 @@ vcard_cancel (EImport *ei,
               EImportTarget *target,
               EImportImporter *im)
 {
-	VCardImporter *gci = g_datalist_get_data (&target->data, "vcard-data");
-
-	if (gci)
-		gci->state = 1;
+	evolution_contact_importer_cancel (target);
 }
 
 static GtkWidget *
@@ -72,6 +72,9 @@ typedef struct {
 	/* The live view to the calendar */
 	ECalClientView *view;
 
+	/* Cancels a pending view request */
+	GCancellable *cancellable;
+
 	/* Hash table of component UID -> CompQueuedAlarms.  If an element is
 	 * present here, then it means its cqa->queued_alarms contains at least
 	 * one queued alarm.  When all the alarms for a component have been
@@ -227,8 +230,24 @@ e_ctime (const time_t *timep)
 	return ret;
 }
 
-/* Queues an alarm trigger for midnight so that we can load the next
- * day's worth of alarms. */
+/* Returns the end of the time range for which alarms are loaded; the
+ * range covers the configured number of days, starting with today. */
+static time_t
+alarm_window_end (time_t now)
+{
+	icaltimezone *zone;
+	time_t day_end;
+
+	zone = config_data_get_timezone ();
+	day_end = time_day_end_with_zone (now, zone);
+
+	return time_add_day_with_zone (
+		day_end, config_data_get_notify_lookahead_days () - 1, zone);
+}
+
+/* Queues an alarm trigger for the midnight when half of the lookahead
+ * window has passed, so that we can load the next days' worth of alarms.
+ * With the default one-day window this is the coming midnight. */
 static void
 queue_midnight_refresh (void)
 {
@@ -240,7 +259,9 @@ queue_midnight_refresh (void)
 	}
 
 	zone = config_data_get_timezone ();
-	midnight = time_day_end_with_zone (time (NULL), zone);
+	midnight = time_add_day_with_zone (
+		time_day_end_with_zone (time (NULL), zone),
+		(config_data_get_notify_lookahead_days () - 1) / 2, zone);
 
 	debug (("Refresh at %s", e_ctime (&midnight)));
 
@@ -574,14 +595,90 @@ add_component_alarms (ClientAlarms *ca,
 	g_hash_table_insert (ca->uid_alarms_hash, cqa->id, cqa);
 }
 
-/* Loads the alarms of a client for a given range of time */
+struct _load_alarms_data {
+	ClientAlarms *ca;
+	GCancellable *cancellable;
+};
+
+static void
+load_alarms_got_view_cb (GObject *source_object,
+                         GAsyncResult *result,
+                         gpointer user_data)
+{
+	struct _load_alarms_data *lad = user_data;
+	ECalClientView *view = NULL;
+	ClientAlarms *ca;
+	GError *error = NULL;
+
+	e_cal_client_get_view_finish (
+		E_CAL_CLIENT (source_object), result, &view, &error);
+
+	/* The client may be gone already when cancelled. */
+	if (g_cancellable_is_cancelled (lad->cancellable)) {
+		if (view != NULL)
+			g_object_unref (view);
+		g_clear_error (&error);
+		goto exit;
+	}
+
+	ca = lad->ca;
+
+	if (error != NULL) {
+		g_warning (
+			"%s: Could not get query for client: %s",
+			G_STRFUNC, error->message);
+		g_error_free (error);
+		goto exit;
+	}
+
+	debug (("Setting Call backs"));
+
+	ca->view = view;
+
+	g_signal_connect (
+		ca->view, "objects-added",
+		G_CALLBACK (query_objects_modified_cb), ca);
+	g_signal_connect (
+		ca->view, "objects-modified",
+		G_CALLBACK (query_objects_modified_cb), ca);
+	g_signal_connect (
+		ca->view, "objects-removed",
+		G_CALLBACK (query_objects_removed_cb), ca);
+
+	e_cal_client_view_start (ca->view, &error);
+
+	if (error != NULL) {
+		g_warning (
+			"%s: Failed to start view: %s",
+			G_STRFUNC, error->message);
+		g_error_free (error);
+	}
+
+exit:
+	g_object_unref (lad->cancellable);
+	g_slice_free (struct _load_alarms_data, lad);
+}
+
+/* Cancels a pending view request of a client, if any */
+static void
+cancel_load_alarms (ClientAlarms *ca)
+{
+	if (ca->cancellable != NULL) {
+		g_cancellable_cancel (ca->cancellable);
+		g_object_unref (ca->cancellable);
+		ca->cancellable = NULL;
+	}
+}
+
+/* Loads the alarms of a client for a given range of time.  The view is
+ * requested asynchronously, so that several clients load in parallel. */
 static void
 load_alarms (ClientAlarms *ca,
              time_t start,
              time_t end)
 {
+	struct _load_alarms_data *lad;
 	gchar *str_query, *iso_start, *iso_end;
-	GError *error = NULL;
 
 	debug (("..."));
 
@@ -610,45 +707,25 @@ load_alarms (ClientAlarms *ca,
 		ca->view = NULL;
 	}
 
-	e_cal_client_get_view_sync (
-		ca->cal_client, str_query, &ca->view, NULL, &error);
+	cancel_load_alarms (ca);
+	ca->cancellable = g_cancellable_new ();
 
-	if (error != NULL) {
-		g_warning (
-			"%s: Could not get query for client: %s",
-			G_STRFUNC, error->message);
-		g_error_free (error);
-	} else {
-		debug (("Setting Call backs"));
-
-		g_signal_connect (
-			ca->view, "objects-added",
-			G_CALLBACK (query_objects_modified_cb), ca);
-		g_signal_connect (
-			ca->view, "objects-modified",
-			G_CALLBACK (query_objects_modified_cb), ca);
-		g_signal_connect (
-			ca->view, "objects-removed",
-			G_CALLBACK (query_objects_removed_cb), ca);
-
-		e_cal_client_view_start (ca->view, &error);
+	lad = g_slice_new0 (struct _load_alarms_data);
+	lad->ca = ca;
+	lad->cancellable = g_object_ref (ca->cancellable);
 
-		if (error != NULL) {
-			g_warning (
-				"%s: Failed to start view: %s",
-				G_STRFUNC, error->message);
-			g_error_free (error);
-		}
-	}
+	e_cal_client_get_view (
+		ca->cal_client, str_query, ca->cancellable,
+		load_alarms_got_view_cb, lad);
 
 	g_free (str_query);
 }
 
-/* Loads today's remaining alarms for a client */
+/* Loads the remaining alarms of the lookahead window for a client */
 static void
 load_alarms_for_today (ClientAlarms *ca)
 {
-	time_t now, from, day_end, day_start;
+	time_t now, from, window_end, day_start;
 	icaltimezone *zone;
 
 	now = time (NULL);
@@ -666,9 +743,9 @@ load_alarms_for_today (ClientAlarms *ca)
 
 	/* Add one hour after midnight, just to cover the delay in 30 minutes
 	 * midnight checking. */
-	day_end = time_day_end_with_zone (now, zone) + (60 * 60);
-	debug (("From %s to %s", e_ctime (&from), e_ctime (&day_end)));
-	load_alarms (ca, from, day_end);
+	window_end = alarm_window_end (now) + (60 * 60);
+	debug (("From %s to %s", e_ctime (&from), e_ctime (&window_end)));
+	load_alarms (ca, from, window_end);
 }
 
 /* Looks up a component's queued alarm structure in a client alarms structure */
@@ -771,52 +848,123 @@ duplicate_ecal (const GSList *in_list)
 	return g_slist_reverse (out_list);
 }
 
-static gboolean
-get_alarms_for_object (ECalClient *cal_client,
-                       const ECalComponentId *id,
-                       time_t start,
-                       time_t end,
-                       ECalComponentAlarms **alarms)
+/* Queues the alarm instances of cqa->alarms which are not in the
+ * skip set, prepending them to cqa->queued_alarms */
+static void
+queue_comp_alarms (CompQueuedAlarms *cqa,
+                   GHashTable *skip)
 {
-	icalcomponent *icalcomp = NULL;
-	ECalComponent *comp;
-	ECalComponentAlarmAction omit[] = {-1};
+	GSList *sl;
+
+	for (sl = cqa->alarms->alarms; sl; sl = sl->next) {
+		ECalComponentAlarmInstance *instance;
+		gpointer alarm_id;
+		QueuedAlarm *qa;
 
-	g_return_val_if_fail (cal_client != NULL, FALSE);
-	g_return_val_if_fail (id != NULL, FALSE);
-	g_return_val_if_fail (alarms != NULL, FALSE);
-	g_return_val_if_fail (start >= 0 && end >= 0, FALSE);
-	g_return_val_if_fail (start <= end, FALSE);
+		instance = sl->data;
 
-	e_cal_client_get_object_sync (
-		cal_client, id->uid, id->rid, &icalcomp, NULL, NULL);
+		if (skip != NULL && g_hash_table_contains (skip, instance))
+			continue;
 
-	if (icalcomp == NULL)
-		return FALSE;
+		if (!has_known_notification (cqa->alarms->comp, instance->auid))
+			continue;
 
-	comp = e_cal_component_new ();
-	if (!e_cal_component_set_icalcomponent (comp, icalcomp)) {
-		icalcomponent_free (icalcomp);
-		g_object_unref (comp);
-		return FALSE;
+		alarm_id = alarm_add (instance->trigger, alarm_trigger_cb, cqa, NULL);
+		if (!alarm_id)
+			continue;
+
+		qa = g_new (QueuedAlarm, 1);
+		qa->alarm_id = alarm_id;
+		qa->instance = instance;
+		qa->snooze = FALSE;
+		qa->orig_trigger = instance->trigger;
+		cqa->queued_alarms = g_slist_prepend (cqa->queued_alarms, qa);
+		debug (("Adding %p to queue", qa));
 	}
+}
 
-	*alarms = e_cal_util_generate_alarms_for_comp (
-		comp, start, end, omit, e_cal_client_resolve_tzid_cb,
-		cal_client, config_data_get_timezone ());
+/* Finds the alarm instance a queued alarm still stands for, if any */
+static ECalComponentAlarmInstance *
+find_same_instance (ECalComponentAlarms *alarms,
+                    QueuedAlarm *qa,
+                    GHashTable *used)
+{
+	GSList *sl;
 
-	g_object_unref (comp);
+	for (sl = alarms->alarms; sl; sl = sl->next) {
+		ECalComponentAlarmInstance *instance = sl->data;
 
-	return TRUE;
+		if (instance->trigger == qa->orig_trigger &&
+		    g_strcmp0 (instance->auid, qa->instance->auid) == 0 &&
+		    !g_hash_table_contains (used, instance))
+			return instance;
+	}
+
+	return NULL;
+}
+
+/* Replaces the alarms of a component with newly generated ones.  Queued
+ * alarms whose instance did not change stay in the alarm queue, so a
+ * refresh of the view costs nothing for unchanged components. */
+static void
+update_comp_alarms (CompQueuedAlarms *cqa,
+                    ECalComponentAlarms *alarms)
+{
+	GHashTable *used;
+	GSList *kept = NULL, *dropped = NULL, *l;
+
+	used = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (l = cqa->queued_alarms; l; l = l->next) {
+		QueuedAlarm *qa = l->data;
+		ECalComponentAlarmInstance *instance;
+
+		instance = find_same_instance (alarms, qa, used);
+		if (instance != NULL &&
+		    has_known_notification (alarms->comp, instance->auid)) {
+			/* A snoozed alarm keeps its snooze time. */
+			if (qa->snooze)
+				instance->trigger = qa->instance->trigger;
+			qa->instance = instance;
+			g_hash_table_add (used, instance);
+			kept = g_slist_prepend (kept, qa);
+		} else {
+			dropped = g_slist_prepend (dropped, qa);
+		}
+	}
+
+	if (dropped != NULL)
+		tray_list_remove_cqa (cqa);
+
+	for (l = dropped; l; l = l->next) {
+		QueuedAlarm *qa = l->data;
+
+		alarm_remove (qa->alarm_id);
+		g_free (qa);
+	}
+
+	g_slist_free (dropped);
+	g_slist_free (cqa->queued_alarms);
+
+	e_cal_component_alarms_free (cqa->alarms);
+	cqa->alarms = alarms;
+	cqa->queued_alarms = kept;
+
+	/* add the new alarms */
+	queue_comp_alarms (cqa, used);
+
+	cqa->queued_alarms = g_slist_reverse (cqa->queued_alarms);
+
+	g_hash_table_destroy (used);
 }
 
 static void
 query_objects_changed_async (struct _query_msg *msg)
 {
 	ClientAlarms *ca;
-	time_t from, day_end;
+	time_t from, window_end;
 	ECalComponentAlarms *alarms;
-	gboolean found;
+	ECalComponentAlarmAction omit[] = {-1};
 	icaltimezone *zone;
 	CompQueuedAlarms *cqa;
 	GSList *l;
@@ -833,39 +981,39 @@ query_objects_changed_async (struct _query_msg *msg)
 
 	zone = config_data_get_timezone ();
 
-	day_end = time_day_end_with_zone (time (NULL), zone);
+	window_end = alarm_window_end (time (NULL));
 
 	for (l = objects; l != NULL; l = l->next) {
 		ECalComponentId *id;
-		GSList *sl;
 		ECalComponent *comp = e_cal_component_new ();
 
-		e_cal_component_set_icalcomponent (comp, l->data);
-
-		id = e_cal_component_get_id (comp);
-		found = get_alarms_for_object (ca->cal_client, id, from, day_end, &alarms);
-
-		if (!found) {
-			debug (("No Alarm found for client %p", ca->cal_client));
-			tray_list_remove_cqa (lookup_comp_queued_alarms (ca, id));
-			remove_comp (ca, id);
-			g_hash_table_remove (ca->uid_alarms_hash, id);
-			e_cal_component_free_id (id);
+		/* The view passes the whole component, so the alarms are
+		 * generated from it instead of fetching it again. */
+		if (!e_cal_component_set_icalcomponent (comp, l->data)) {
+			icalcomponent_free (l->data);
 			g_object_unref (comp);
-			comp = NULL;
 			continue;
 		}
 
+		id = e_cal_component_get_id (comp);
+
+		alarms = e_cal_util_generate_alarms_for_comp (
+			comp, from, window_end, omit,
+			e_cal_client_resolve_tzid_cb, ca->cal_client, zone);
+
 		cqa = lookup_comp_queued_alarms (ca, id);
 		if (!cqa) {
 			debug (("No currently queued alarms for %s", id->uid));
 			add_component_alarms (ca, alarms);
+			e_cal_component_free_id (id);
 			g_object_unref (comp);
 			comp = NULL;
 			continue;
 		}
 
 		debug (("Alarm Already Exist for %s", id->uid));
+		e_cal_component_free_id (id);
+
 		/* If the alarms or the alarms list is empty,
 		 * remove it after updating the cqa structure. */
 		if (alarms == NULL || alarms->alarms == NULL) {
@@ -880,35 +1028,8 @@ query_objects_changed_async (struct _query_msg *msg)
 		}
 
 		/* if already in the list, just update it */
-		remove_alarms (cqa, FALSE);
-		cqa->alarms = alarms;
-		cqa->queued_alarms = NULL;
-
-		/* add the new alarms */
-		for (sl = cqa->alarms->alarms; sl; sl = sl->next) {
-			ECalComponentAlarmInstance *instance;
-			gpointer alarm_id;
-			QueuedAlarm *qa;
-
-			instance = sl->data;
-
-			if (!has_known_notification (cqa->alarms->comp, instance->auid))
-				continue;
-
-			alarm_id = alarm_add (instance->trigger, alarm_trigger_cb, cqa, NULL);
-			if (!alarm_id)
-				continue;
-
-			qa = g_new (QueuedAlarm, 1);
-			qa->alarm_id = alarm_id;
-			qa->instance = instance;
-			qa->snooze = FALSE;
-			qa->orig_trigger = instance->trigger;
-			cqa->queued_alarms = g_slist_prepend (cqa->queued_alarms, qa);
-			debug (("Adding %p to queue", qa));
-		}
+		update_comp_alarms (cqa, alarms);
 
-		cqa->queued_alarms = g_slist_reverse (cqa->queued_alarms);
 		g_object_unref (comp);
 		comp = NULL;
 	}
@@ -2160,6 +2281,7 @@ free_client_alarms_cb (gpointer key,
 	debug (("ca=%p", ca));
 
 	if (ca) {
+		cancel_load_alarms (ca);
 		remove_client_alarms (ca);
 		if (ca->cal_client) {
 			debug (("Disconnecting Client"));
@@ -2274,6 +2396,7 @@ alarm_queue_add_async (struct _alarm_client_msg *msg)
 
 	ca->cal_client = cal_client;
 	ca->view = NULL;
+	ca->cancellable = NULL;
 
 	g_hash_table_insert (client_alarms_hash, cal_client, ca);
 
@@ -2378,6 +2501,7 @@ alarm_queue_remove_async (struct _alarm_client_msg *msg)
 	g_return_if_fail (ca != NULL);
 
 	debug (("..."));
+	cancel_load_alarms (ca);
 	remove_client_alarms (ca);
 
 	/* Clean up */
@@ -2451,7 +2575,7 @@ update_cqa (CompQueuedAlarms *cqa,
 
 	zone = config_data_get_timezone ();
 	from = time_day_begin_with_zone (time (NULL), zone);
-	to = time_day_end_with_zone (time (NULL), zone);
+	to = alarm_window_end (time (NULL));
 
 	debug (("Generating alarms between %s and %s", e_ctime (&from), e_ctime (&to)));
 	alarms = e_cal_util_generate_alarms_for_comp (
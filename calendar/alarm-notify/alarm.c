@@ -35,11 +35,17 @@
 #include "alarm.h"
 #include "config-data.h"
 
-/* Our glib timeout */
-static guint timeout_id;
-
-/* The list of pending alarms */
-static GList *alarms = NULL;
+/* Pending alarms are kept in a hierarchical timer wheel: level N has
+ * WHEEL_SLOTS slots of WHEEL_SLOTS^N seconds each, relative to wheel_time.
+ * An alarm sits in the lowest level whose span still covers its trigger,
+ * and is moved down a level as wheel_time catches up with it.  Alarms too
+ * far ahead for the top level wait in the overflow queue, and alarms whose
+ * trigger time has been reached wait in the due queue, in trigger order.
+ * Adding and removing an alarm takes constant time. */
+#define WHEEL_BITS   6
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
 
 /* A queued alarm structure */
 typedef struct {
@@ -47,26 +53,194 @@ typedef struct {
 	AlarmFunction      alarm_fn;
 	gpointer           data;
 	AlarmDestroyNotify destroy_notify_fn;
+
+	/* Order of the alarms with the same trigger */
+	guint64            seq;
+
+	/* The queue holding the alarm and its link in there */
+	GQueue            *queue;
+	GList             *link;
 } AlarmRecord;
 
+/* Our glib timeout, and the time it is set for */
+static guint timeout_id;
+static time_t timeout_trigger;
+
+static GQueue wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static GQueue overflow = G_QUEUE_INIT;
+static GQueue due = G_QUEUE_INIT;
+static time_t wheel_time;
+static guint64 next_seq;
+
+/* Set of the AlarmRecord-s in the queues */
+static GHashTable *alarms = NULL;
+
 static void setup_timeout (void);
 
-/* Removes the head alarm from the queue.  Does not touch the timeout_id. */
+/* Compares the trigger times of two AlarmRecord structures. */
+static gint
+compare_alarm_by_time (gconstpointer a,
+                       gconstpointer b)
+{
+	const AlarmRecord *ara = a;
+	const AlarmRecord *arb = b;
+	time_t diff;
+
+	diff = ara->trigger - arb->trigger;
+	if (diff == 0)
+		return (ara->seq < arb->seq) ? -1 : (ara->seq > arb->seq) ? 1 : 0;
+
+	return (diff < 0) ? -1 : 1;
+}
+
+static guint64
+wheel_block (time_t t,
+             gint level)
+{
+	return ((guint64) t) >> (WHEEL_BITS * level);
+}
+
 static void
-pop_alarm (void)
+unlink_alarm (AlarmRecord *ar)
 {
-	AlarmRecord *ar;
-	GList *l;
+	g_queue_delete_link (ar->queue, ar->link);
+	ar->queue = NULL;
+	ar->link = NULL;
+}
+
+/* Puts the alarm in the due queue, keeping it sorted */
+static void
+insert_due (AlarmRecord *ar)
+{
+	GList *link;
+
+	/* The due queue is short, and new alarms usually go last. */
+	for (link = due.tail; link; link = link->prev) {
+		if (compare_alarm_by_time (link->data, ar) <= 0)
+			break;
+	}
+
+	if (link) {
+		g_queue_insert_after (&due, link, ar);
+		ar->link = link->next;
+	} else {
+		g_queue_push_head (&due, ar);
+		ar->link = due.head;
+	}
+
+	ar->queue = &due;
+}
 
-	if (!alarms) {
-		g_warning ("Nothing to pop from the alarm queue");
+/* Puts the alarm in the wheel slot covering its trigger */
+static void
+insert_alarm (AlarmRecord *ar)
+{
+	gint level;
+
+	if (ar->trigger <= wheel_time) {
+		insert_due (ar);
 		return;
 	}
 
-	ar = alarms->data;
+	ar->queue = &overflow;
 
-	l = alarms;
-	alarms = g_list_delete_link (alarms, l);
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		if (wheel_block (ar->trigger, level + 1) ==
+		    wheel_block (wheel_time, level + 1)) {
+			ar->queue = &wheel[level]
+				[wheel_block (ar->trigger, level) & WHEEL_MASK];
+			break;
+		}
+	}
+
+	g_queue_push_tail (ar->queue, ar);
+	ar->link = ar->queue->tail;
+}
+
+/* Moves the wheel forward to the given time, moving alarms which
+ * triggered by then into the due queue. */
+static void
+advance_wheel (time_t now)
+{
+	GQueue moved = G_QUEUE_INIT;
+	gint level, slot, first, last;
+
+	if (now <= wheel_time)
+		return;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		if (wheel_block (now, level + 1) !=
+		    wheel_block (wheel_time, level + 1)) {
+			/* The whole level has been passed. */
+			first = 0;
+			last = WHEEL_MASK;
+		} else {
+			first = (wheel_block (wheel_time, level) & WHEEL_MASK) + 1;
+			last = wheel_block (now, level) & WHEEL_MASK;
+		}
+
+		for (slot = first; slot <= last; slot++) {
+			GQueue *queue = &wheel[level][slot];
+
+			while (!g_queue_is_empty (queue))
+				g_queue_push_tail (&moved, g_queue_pop_head (queue));
+		}
+	}
+
+	if (wheel_block (now, WHEEL_LEVELS) != wheel_block (wheel_time, WHEEL_LEVELS)) {
+		while (!g_queue_is_empty (&overflow))
+			g_queue_push_tail (&moved, g_queue_pop_head (&overflow));
+	}
+
+	wheel_time = now;
+
+	while (!g_queue_is_empty (&moved))
+		insert_alarm (g_queue_pop_head (&moved));
+}
+
+static AlarmRecord *
+find_min_in_queue (GQueue *queue)
+{
+	AlarmRecord *min = NULL;
+	GList *link;
+
+	for (link = queue->head; link; link = link->next) {
+		if (!min || compare_alarm_by_time (link->data, min) < 0)
+			min = link->data;
+	}
+
+	return min;
+}
+
+/* Returns the alarm which triggers first */
+static AlarmRecord *
+peek_alarm (void)
+{
+	gint level, slot;
+
+	if (!g_queue_is_empty (&due))
+		return g_queue_peek_head (&due);
+
+	/* Every alarm at a level triggers before those at the levels above
+	 * it, and the slots after the current one are in trigger order. */
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		for (slot = (wheel_block (wheel_time, level) & WHEEL_MASK) + 1;
+		     slot < WHEEL_SLOTS; slot++) {
+			if (!g_queue_is_empty (&wheel[level][slot]))
+				return find_min_in_queue (&wheel[level][slot]);
+		}
+	}
+
+	return find_min_in_queue (&overflow);
+}
+
+/* Removes an alarm from the queues and frees it.  Does not touch the
+ * timeout_id. */
+static void
+pop_alarm (AlarmRecord *ar)
+{
+	unlink_alarm (ar);
+	g_hash_table_remove (alarms, ar);
 
 	g_free (ar);
 }
@@ -77,21 +251,22 @@ alarm_ready_cb (gpointer data)
 {
 	time_t now;
 
-	if (!alarms) {
+	timeout_id = 0;
+
+	if (!alarms || g_hash_table_size (alarms) == 0) {
 		g_warning ("Alarm triggered, but no alarm present\n");
 		return FALSE;
 	}
 
-	timeout_id = 0;
-
 	now = time (NULL);
+	advance_wheel (now);
 
 	debug (("Alarm callback!"));
-	while (alarms) {
+	while (!g_queue_is_empty (&due)) {
 		AlarmRecord *notify_id, *ar;
 		AlarmRecord ar_copy;
 
-		ar = alarms->data;
+		ar = g_queue_peek_head (&due);
 
 		if (ar->trigger > now)
 			break;
@@ -104,7 +279,7 @@ alarm_ready_cb (gpointer data)
 
 		/* This will free the original AlarmRecord;
 		 * that's why we copy it. */
-		pop_alarm ();
+		pop_alarm (notify_id);
 
 		(* ar->alarm_fn) (notify_id, ar->trigger, ar->data);
 
@@ -112,17 +287,16 @@ alarm_ready_cb (gpointer data)
 			(* ar->destroy_notify_fn) (notify_id, ar->data);
 	}
 
-	/* We need this check because one of the alarm_fn above may have
-	 * re-entered and added an alarm of its own, so the timer will
-	 * already be set up.
+	/* One of the alarm_fn above may have re-entered and added an
+	 * alarm of its own, so the timer may already be set up.
 	 */
-	if (alarms)
+	if (timeout_id == 0 && g_hash_table_size (alarms) > 0)
 		setup_timeout ();
 
 	return FALSE;
 }
 
-/* Sets up a timeout for the next minute.  We do not need to be concerned with
+/* Sets up a timeout for the next alarm.  We do not need to be concerned with
  * timezones here, as this is just a periodic check on the alarm queue.
  */
 static void
@@ -132,13 +306,12 @@ setup_timeout (void)
 	guint diff;
 	time_t now;
 
-	if (!alarms) {
+	ar = alarms ? peek_alarm () : NULL;
+	if (!ar) {
 		g_warning ("No alarm to setup\n");
 		return;
 	}
 
-	ar = alarms->data;
-
 	/* Remove the existing time out */
 	if (timeout_id != 0) {
 		g_source_remove (timeout_id);
@@ -147,8 +320,8 @@ setup_timeout (void)
 
 	/* Ensure that if the trigger managed to get behind the
 	 * current time we timeout immediately */
-	diff = MAX (0, ar->trigger - time (NULL));
 	now = time (NULL);
+	diff = MAX (0, ar->trigger - now);
 
 	/* Add the time out */
 	debug (
@@ -156,38 +329,27 @@ setup_timeout (void)
 		diff / 60, diff % 60, (gint64) ar->trigger, (gint64) now));
 	debug ((" %s", ctime (&ar->trigger)));
 	debug ((" %s", ctime (&now)));
+	timeout_trigger = ar->trigger;
 	timeout_id = e_named_timeout_add_seconds (diff, alarm_ready_cb, NULL);
 }
 
-/* Used from g_list_insert_sorted(); compares the
- * trigger times of two AlarmRecord structures. */
-static gint
-compare_alarm_by_time (gconstpointer a,
-                       gconstpointer b)
-{
-	const AlarmRecord *ara = a;
-	const AlarmRecord *arb = b;
-	time_t diff;
-
-	diff = ara->trigger - arb->trigger;
-	return (diff < 0) ? -1 : (diff > 0) ? 1 : 0;
-}
-
 /* Adds an alarm to the queue and sets up the timer */
 static void
 queue_alarm (AlarmRecord *ar)
 {
-	GList *old_head;
+	if (!alarms)
+		alarms = g_hash_table_new (g_direct_hash, g_direct_equal);
 
-	/* Track the current head of the list in case there are changes */
-	old_head = alarms;
+	/* Start the wheel at the current time when it is empty */
+	if (g_hash_table_size (alarms) == 0)
+		wheel_time = MAX (wheel_time, time (NULL));
 
-	/* Insert the new alarm in order if the alarm's trigger time is
-	 * after the current time */
-	alarms = g_list_insert_sorted (alarms, ar, compare_alarm_by_time);
+	ar->seq = next_seq++;
+	insert_alarm (ar);
+	g_hash_table_add (alarms, ar);
 
-	/* If there first item on the list didn't change, the time out is fine */
-	if (old_head == alarms)
+	/* If the alarm does not trigger before the time out, it is fine */
+	if (timeout_id != 0 && timeout_trigger <= ar->trigger)
 		return;
 
 	/* Set the timer for removal upon activation */
@@ -241,36 +403,27 @@ alarm_remove (gpointer alarm)
 {
 	AlarmRecord *notify_id, *ar;
 	AlarmRecord ar_copy;
-	AlarmRecord *old_head;
-	GList *l;
 
 	g_return_if_fail (alarm != NULL);
 
 	ar = alarm;
 
-	l = g_list_find (alarms, ar);
-	if (!l) {
+	if (!alarms || !g_hash_table_contains (alarms, ar)) {
 		g_warning (G_STRLOC ": Requested removal of nonexistent alarm!");
 		return;
 	}
 
-	old_head = alarms->data;
-
 	notify_id = ar;
 
-	if (old_head == ar) {
-		ar_copy = *ar;
-		ar = &ar_copy;
+	ar_copy = *ar;
+	ar = &ar_copy;
 
-		/* This will free the original AlarmRecord;
-		 * that's why we copy it. */
-		pop_alarm ();
-	} else {
-		alarms = g_list_delete_link (alarms, l);
-	}
+	/* This will free the original AlarmRecord;
+	 * that's why we copy it. */
+	pop_alarm (notify_id);
 
 	/* Reset the timeout */
-	if (!alarms) {
+	if (g_hash_table_size (alarms) == 0 && timeout_id != 0) {
 		g_source_remove (timeout_id);
 		timeout_id = 0;
 	}
@@ -291,10 +444,11 @@ alarm_remove (gpointer alarm)
 void
 alarm_done (void)
 {
-	GList *l;
+	GHashTableIter iter;
+	gpointer key;
 
 	if (timeout_id == 0) {
-		if (alarms)
+		if (alarms && g_hash_table_size (alarms) > 0)
 			g_warning ("No timeout, but queue is not NULL\n");
 		return;
 	}
@@ -302,15 +456,18 @@ alarm_done (void)
 	g_source_remove (timeout_id);
 	timeout_id = 0;
 
-	if (!alarms) {
+	if (!alarms || g_hash_table_size (alarms) == 0) {
 		g_warning ("timeout present, freed, but no alarms active\n");
 		return;
 	}
 
-	for (l = alarms; l; l = l->next) {
+	g_hash_table_iter_init (&iter, alarms);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
 		AlarmRecord *ar;
 
-		ar = l->data;
+		ar = key;
+
+		unlink_alarm (ar);
 
 		if (ar->destroy_notify_fn)
 			(* ar->destroy_notify_fn) (ar, ar->data);
@@ -318,7 +475,7 @@ alarm_done (void)
 		g_free (ar);
 	}
 
-	g_list_free (alarms);
+	g_hash_table_destroy (alarms);
 	alarms = NULL;
 }
 
@@ -330,6 +487,6 @@ alarm_done (void)
 void
 alarm_reschedule_timeout (void)
 {
-	if (alarms)
+	if (alarms && g_hash_table_size (alarms) > 0)
 		setup_timeout ();
 }
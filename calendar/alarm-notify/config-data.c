@@ -107,6 +107,14 @@ config_data_get_notify_with_tray (void)
 	return g_settings_get_boolean (calendar_settings, "notify-with-tray");
 }
 
+gint
+config_data_get_notify_lookahead_days (void)
+{
+	ensure_inited ();
+
+	return MAX (1, g_settings_get_int (calendar_settings, "notify-lookahead-days"));
+}
+
 static void
 source_written_cb (GObject *source_object,
                    GAsyncResult *result,
@@ -34,6 +34,8 @@ icaltimezone *	config_data_get_timezone	(void);
 gboolean	config_data_get_24_hour_format	(void);
 gboolean	config_data_get_notify_with_tray
 						(void);
+gint		config_data_get_notify_lookahead_days
+						(void);
 void		config_data_set_last_notification_time
 						(ECalClient *cal,
 						 time_t t);
@@ -0,0 +1,668 @@
+/*
+ *
+ * Evolution calendar - Cache of expanded recurrence instances
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Recurring components are expanded by the calendar model, the date
+ * navigator, printing and purging, often for the same time range.  The
+ * functions here wrap e_cal_client_generate_instances_for_object() and
+ * remember the instances of recurring series, keyed by the client, the
+ * UID and revision of the master component, the revisions of the detached
+ * instances the caller passes along and the client's default timezone, so
+ * a series is only expanded once per time range.  A cached range also
+ * answers requests for any range inside of it.  Callers which see detached
+ * instances change later on must call e_cal_instance_cache_invalidate(). */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "e-cal-instance-cache.h"
+
+/* Upper bound on the number of instances kept, over all series. */
+#define CACHE_MAX_INSTANCES 20000
+
+typedef struct _CachedInstance CachedInstance;
+typedef struct _CacheEntry CacheEntry;
+typedef struct _GenerateData GenerateData;
+
+struct _CachedInstance {
+	icalcomponent *icalcomp;
+	time_t start;
+	time_t end;
+};
+
+struct _CacheEntry {
+	ECalClient *client;	/* not referenced */
+	gchar *key;
+	gchar *uid;
+	time_t start;
+	time_t end;
+	GArray *instances;
+	GList *lru_link;
+};
+
+struct _GenerateData {
+	ECalClient *client;
+	icalcomponent *icalcomp;
+	gchar *key;
+	gchar *uid;
+	time_t start;
+	time_t end;
+	GArray *instances;
+	GArray *replay;
+	gboolean complete;
+	GCancellable *cancellable;
+
+	ECalRecurInstanceFn cb;
+	gpointer cb_data;
+	GDestroyNotify destroy_cb_data;
+};
+
+static GMutex cache_lock;
+/* Cache key -> GQueue of CacheEntry, one per cached time range */
+static GHashTable *cache_entries;
+/* CacheEntry, most recently used first */
+static GQueue cache_lru = G_QUEUE_INIT;
+/* ECalClient instances we hold a weak reference on */
+static GHashTable *cache_clients;
+static guint cache_n_instances;
+
+static void
+cached_instance_clear (CachedInstance *ci)
+{
+	if (ci->icalcomp != NULL)
+		icalcomponent_free (ci->icalcomp);
+	ci->icalcomp = NULL;
+}
+
+static GArray *
+cached_instances_new (void)
+{
+	GArray *instances;
+
+	instances = g_array_new (FALSE, TRUE, sizeof (CachedInstance));
+	g_array_set_clear_func (
+		instances, (GDestroyNotify) cached_instance_clear);
+
+	return instances;
+}
+
+static gchar *
+instance_cache_dup_revision (icalcomponent *icalcomp)
+{
+	icalproperty *prop;
+	gchar *revision;
+
+	prop = icalcomponent_get_first_property (
+		icalcomp, ICAL_LASTMODIFIED_PROPERTY);
+
+	if (prop != NULL) {
+		struct icaltimetype itt;
+
+		itt = icalproperty_get_lastmodified (prop);
+		revision = g_strdup_printf (
+			"%d/%s", icalcomponent_get_sequence (icalcomp),
+			icaltime_as_ical_string (itt));
+	} else {
+		gchar *str;
+
+		/* No LAST-MODIFIED, use the content itself. */
+		str = icalcomponent_as_ical_string_r (icalcomp);
+		revision = g_compute_checksum_for_string (
+			G_CHECKSUM_SHA1, str, -1);
+		g_free (str);
+	}
+
+	return revision;
+}
+
+static gint
+instance_cache_compare_strings (gconstpointer a,
+                                gconstpointer b)
+{
+	return g_strcmp0 (*((const gchar **) a), *((const gchar **) b));
+}
+
+/* Detached instances replace generated ones, so the expansion of a
+ * series depends on their revisions too. */
+static void
+instance_cache_append_detached (GString *key,
+                                const gchar *uid,
+                                GSList *detached)
+{
+	GPtrArray *revisions;
+	GSList *link;
+	guint ii;
+
+	revisions = g_ptr_array_new_with_free_func (g_free);
+
+	for (link = detached; link != NULL; link = g_slist_next (link)) {
+		icalcomponent *icalcomp = link->data;
+		struct icaltimetype icalrid;
+		gchar *rid, *revision;
+
+		if (g_strcmp0 (icalcomponent_get_uid (icalcomp), uid) != 0)
+			continue;
+
+		icalrid = icalcomponent_get_recurrenceid (icalcomp);
+		if (icaltime_is_null_time (icalrid))
+			continue;
+
+		rid = icaltime_as_ical_string_r (icalrid);
+		revision = instance_cache_dup_revision (icalcomp);
+		g_ptr_array_add (revisions, g_strconcat (rid, "=", revision, NULL));
+		g_free (revision);
+		g_free (rid);
+	}
+
+	/* Independent of the order the caller lists them in. */
+	g_ptr_array_sort (revisions, instance_cache_compare_strings);
+
+	for (ii = 0; ii < revisions->len; ii++)
+		g_string_append_printf (key, "\n%s", (gchar *) revisions->pdata[ii]);
+
+	g_ptr_array_unref (revisions);
+}
+
+/* Returns NULL for components which are not cached, which is
+ * everything but the masters of recurring series. */
+static gchar *
+instance_cache_dup_key (ECalClient *client,
+                        icalcomponent *icalcomp,
+                        GSList *detached)
+{
+	icaltimezone *zone;
+	const gchar *uid;
+	const gchar *tzid = NULL;
+	gchar *revision;
+	GString *key;
+
+	/* Anything else expands to one instance at most. */
+	if (e_cal_util_component_is_instance (icalcomp) ||
+	    !e_cal_util_component_has_recurrences (icalcomp))
+		return NULL;
+
+	uid = icalcomponent_get_uid (icalcomp);
+	if (uid == NULL || *uid == '\0')
+		return NULL;
+
+	/* Floating times are expanded in the client's default timezone. */
+	zone = e_cal_client_get_default_timezone (client);
+	if (zone != NULL)
+		tzid = icaltimezone_get_tzid (zone);
+
+	revision = instance_cache_dup_revision (icalcomp);
+
+	key = g_string_new (NULL);
+	g_string_printf (
+		key, "%p\n%s\n%s\n%s", (gpointer) client, uid,
+		revision, tzid ? tzid : "");
+
+	g_free (revision);
+
+	instance_cache_append_detached (key, uid, detached);
+
+	return g_string_free (key, FALSE);
+}
+
+/* Must be called with the cache_lock held. */
+static void
+instance_cache_entry_remove (CacheEntry *entry)
+{
+	GQueue *bucket;
+
+	bucket = g_hash_table_lookup (cache_entries, entry->key);
+	if (bucket != NULL) {
+		g_queue_remove (bucket, entry);
+		if (g_queue_is_empty (bucket))
+			g_hash_table_remove (cache_entries, entry->key);
+	}
+
+	g_queue_delete_link (&cache_lru, entry->lru_link);
+	cache_n_instances -= entry->instances->len;
+
+	g_array_unref (entry->instances);
+	g_free (entry->key);
+	g_free (entry->uid);
+	g_slice_free (CacheEntry, entry);
+}
+
+/* Must be called with the cache_lock held. */
+static void
+instance_cache_remove_matching (gpointer client,
+                                const gchar *uid)
+{
+	GList *link;
+
+	link = g_queue_peek_head_link (&cache_lru);
+	while (link != NULL) {
+		CacheEntry *entry = link->data;
+
+		/* The entry frees its link. */
+		link = g_list_next (link);
+
+		if (entry->client != client)
+			continue;
+
+		if (uid != NULL && g_strcmp0 (entry->uid, uid) != 0)
+			continue;
+
+		instance_cache_entry_remove (entry);
+	}
+}
+
+static void
+instance_cache_client_gone_cb (gpointer user_data,
+                               GObject *where_the_object_was)
+{
+	g_mutex_lock (&cache_lock);
+
+	instance_cache_remove_matching (where_the_object_was, NULL);
+	g_hash_table_remove (cache_clients, where_the_object_was);
+
+	g_mutex_unlock (&cache_lock);
+}
+
+static gboolean
+instance_in_range (const CachedInstance *ci,
+                   time_t start,
+                   time_t end)
+{
+	if (ci->start == ci->end)
+		return ci->start >= start && ci->start < end;
+
+	return ci->start < end && ci->end > start;
+}
+
+/* Returns copies of the cached instances for the given time range,
+ * or NULL if there are none. */
+static GArray *
+instance_cache_lookup (const gchar *key,
+                       time_t start,
+                       time_t end)
+{
+	GQueue *bucket;
+	GList *link;
+	GArray *replay = NULL;
+	guint ii;
+
+	if (key == NULL)
+		return NULL;
+
+	g_mutex_lock (&cache_lock);
+
+	bucket = cache_entries ? g_hash_table_lookup (cache_entries, key) : NULL;
+
+	for (link = bucket ? g_queue_peek_head_link (bucket) : NULL; link; link = g_list_next (link)) {
+		CacheEntry *entry = link->data;
+		gboolean exact;
+
+		if (entry->start > start || entry->end < end)
+			continue;
+
+		exact = entry->start == start && entry->end == end;
+
+		/* Copy the instances, the callbacks run unlocked. */
+		replay = cached_instances_new ();
+		for (ii = 0; ii < entry->instances->len; ii++) {
+			CachedInstance *ci;
+			CachedInstance copy;
+
+			ci = &g_array_index (entry->instances, CachedInstance, ii);
+			if (!exact && !instance_in_range (ci, start, end))
+				continue;
+
+			copy.icalcomp = icalcomponent_new_clone (ci->icalcomp);
+			copy.start = ci->start;
+			copy.end = ci->end;
+			g_array_append_val (replay, copy);
+		}
+
+		g_queue_unlink (&cache_lru, entry->lru_link);
+		g_queue_push_head_link (&cache_lru, entry->lru_link);
+
+		break;
+	}
+
+	g_mutex_unlock (&cache_lock);
+
+	return replay;
+}
+
+/* Calls cb for the instances returned by instance_cache_lookup(). */
+static void
+instance_cache_replay (GArray *replay,
+                       ECalRecurInstanceFn cb,
+                       gpointer cb_data)
+{
+	guint ii;
+
+	for (ii = 0; ii < replay->len; ii++) {
+		CachedInstance *ci;
+		ECalComponent *comp;
+		gboolean keep_going;
+
+		ci = &g_array_index (replay, CachedInstance, ii);
+
+		/* The component takes the icalcomponent. */
+		comp = e_cal_component_new_from_icalcomponent (ci->icalcomp);
+		ci->icalcomp = NULL;
+
+		if (comp == NULL)
+			continue;
+
+		keep_going = cb (comp, ci->start, ci->end, cb_data);
+
+		g_object_unref (comp);
+
+		if (!keep_going)
+			break;
+	}
+}
+
+static void
+instance_cache_store (GenerateData *gd)
+{
+	CacheEntry *entry;
+	GQueue *bucket;
+	GList *link;
+
+	/* Do not let one huge series push everything else out. */
+	if (gd->instances->len > CACHE_MAX_INSTANCES / 4)
+		return;
+
+	g_mutex_lock (&cache_lock);
+
+	if (cache_entries == NULL) {
+		cache_entries = g_hash_table_new_full (
+			g_str_hash, g_str_equal,
+			(GDestroyNotify) g_free,
+			(GDestroyNotify) g_queue_free);
+		cache_clients = g_hash_table_new (
+			g_direct_hash, g_direct_equal);
+	}
+
+	if (!g_hash_table_contains (cache_clients, gd->client)) {
+		g_object_weak_ref (
+			G_OBJECT (gd->client),
+			instance_cache_client_gone_cb, NULL);
+		g_hash_table_add (cache_clients, gd->client);
+	}
+
+	/* Replace an entry for the same range, if any. */
+	bucket = g_hash_table_lookup (cache_entries, gd->key);
+	for (link = bucket ? g_queue_peek_head_link (bucket) : NULL; link; link = g_list_next (link)) {
+		CacheEntry *old_entry = link->data;
+
+		if (old_entry->start == gd->start && old_entry->end == gd->end) {
+			instance_cache_entry_remove (old_entry);
+			break;
+		}
+	}
+
+	entry = g_slice_new0 (CacheEntry);
+	entry->client = gd->client;
+	entry->key = g_strdup (gd->key);
+	entry->uid = g_strdup (gd->uid);
+	entry->start = gd->start;
+	entry->end = gd->end;
+	entry->instances = g_array_ref (gd->instances);
+
+	bucket = g_hash_table_lookup (cache_entries, entry->key);
+	if (bucket == NULL) {
+		bucket = g_queue_new ();
+		g_hash_table_insert (
+			cache_entries, g_strdup (entry->key), bucket);
+	}
+	g_queue_push_tail (bucket, entry);
+
+	g_queue_push_head (&cache_lru, entry);
+	entry->lru_link = g_queue_peek_head_link (&cache_lru);
+	cache_n_instances += entry->instances->len;
+
+	while (cache_n_instances > CACHE_MAX_INSTANCES &&
+	       g_queue_get_length (&cache_lru) > 1)
+		instance_cache_entry_remove (g_queue_peek_tail (&cache_lru));
+
+	g_mutex_unlock (&cache_lock);
+}
+
+static gboolean
+instance_cache_record_cb (ECalComponent *comp,
+                          time_t instance_start,
+                          time_t instance_end,
+                          gpointer user_data)
+{
+	GenerateData *gd = user_data;
+	CachedInstance ci;
+
+	/* Copy before the callback, it may change the component. */
+	ci.icalcomp = icalcomponent_new_clone (
+		e_cal_component_get_icalcomponent (comp));
+	ci.start = instance_start;
+	ci.end = instance_end;
+	g_array_append_val (gd->instances, ci);
+
+	if (!gd->cb (comp, instance_start, instance_end, gd->cb_data)) {
+		/* Only part of the range was expanded. */
+		gd->complete = FALSE;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static GenerateData *
+generate_data_new (ECalClient *client,
+                   icalcomponent *icalcomp,
+                   time_t start,
+                   time_t end,
+                   GCancellable *cancellable,
+                   ECalRecurInstanceFn cb,
+                   gpointer cb_data,
+                   GDestroyNotify destroy_cb_data)
+{
+	GenerateData *gd;
+
+	gd = g_slice_new0 (GenerateData);
+	gd->client = g_object_ref (client);
+	gd->icalcomp = icalcomponent_new_clone (icalcomp);
+	gd->uid = g_strdup (icalcomponent_get_uid (icalcomp));
+	gd->start = start;
+	gd->end = end;
+	gd->instances = cached_instances_new ();
+	gd->complete = TRUE;
+	gd->cb = cb;
+	gd->cb_data = cb_data;
+	gd->destroy_cb_data = destroy_cb_data;
+
+	if (cancellable != NULL)
+		gd->cancellable = g_object_ref (cancellable);
+
+	return gd;
+}
+
+static void
+generate_data_finish (GenerateData *gd)
+{
+	if (gd->key != NULL && gd->complete &&
+	    !g_cancellable_is_cancelled (gd->cancellable))
+		instance_cache_store (gd);
+
+	if (gd->destroy_cb_data != NULL)
+		gd->destroy_cb_data (gd->cb_data);
+
+	g_clear_object (&gd->client);
+	g_clear_object (&gd->cancellable);
+	icalcomponent_free (gd->icalcomp);
+	g_array_unref (gd->instances);
+	if (gd->replay != NULL)
+		g_array_unref (gd->replay);
+	g_free (gd->key);
+	g_free (gd->uid);
+	g_slice_free (GenerateData, gd);
+}
+
+/**
+ * e_cal_instance_cache_generate_sync:
+ * @client: an #ECalClient
+ * @icalcomp: an #icalcomponent of @client
+ * @detached: (element-type icalcomponent): the detached instances of
+ *            @icalcomp known to the caller, or %NULL
+ * @start: start of the time range
+ * @end: end of the time range
+ * @cb: callback for each instance
+ * @cb_data: data for @cb
+ *
+ * Cached counterpart of e_cal_client_generate_instances_for_object_sync().
+ * Only the instances of recurring series are cached, for anything else
+ * this is the same as calling that function.
+ **/
+void
+e_cal_instance_cache_generate_sync (ECalClient *client,
+                                    icalcomponent *icalcomp,
+                                    GSList *detached,
+                                    time_t start,
+                                    time_t end,
+                                    ECalRecurInstanceFn cb,
+                                    gpointer cb_data)
+{
+	GenerateData *gd;
+
+	g_return_if_fail (E_IS_CAL_CLIENT (client));
+	g_return_if_fail (icalcomp != NULL);
+	g_return_if_fail (cb != NULL);
+
+	gd = generate_data_new (
+		client, icalcomp, start, end,
+		NULL, cb, cb_data, NULL);
+
+	gd->key = instance_cache_dup_key (client, icalcomp, detached);
+	gd->replay = instance_cache_lookup (gd->key, start, end);
+
+	if (gd->replay != NULL) {
+		instance_cache_replay (gd->replay, cb, cb_data);
+		gd->complete = FALSE;
+		generate_data_finish (gd);
+		return;
+	}
+
+	e_cal_client_generate_instances_for_object_sync (
+		client, icalcomp, start, end,
+		instance_cache_record_cb, gd);
+
+	generate_data_finish (gd);
+}
+
+static void
+instance_cache_replay_done_cb (GObject *source_object,
+                               GAsyncResult *result,
+                               gpointer user_data)
+{
+	GenerateData *gd = user_data;
+
+	if (!g_cancellable_is_cancelled (gd->cancellable))
+		instance_cache_replay (gd->replay, gd->cb, gd->cb_data);
+
+	/* Nothing new to store. */
+	gd->complete = FALSE;
+	generate_data_finish (gd);
+}
+
+/**
+ * e_cal_instance_cache_generate:
+ * @client: an #ECalClient
+ * @icalcomp: an #icalcomponent of @client
+ * @detached: (element-type icalcomponent): the detached instances of
+ *            @icalcomp known to the caller, or %NULL
+ * @start: start of the time range
+ * @end: end of the time range
+ * @cancellable: a #GCancellable; can be %NULL
+ * @cb: callback for each instance
+ * @cb_data: data for @cb
+ * @destroy_cb_data: function to free @cb_data; can be %NULL
+ *
+ * Cached counterpart of e_cal_client_generate_instances_for_object().
+ * Like there, @cb is only called after this function returned, also
+ * for cached instances.
+ **/
+void
+e_cal_instance_cache_generate (ECalClient *client,
+                               icalcomponent *icalcomp,
+                               GSList *detached,
+                               time_t start,
+                               time_t end,
+                               GCancellable *cancellable,
+                               ECalRecurInstanceFn cb,
+                               gpointer cb_data,
+                               GDestroyNotify destroy_cb_data)
+{
+	GSimpleAsyncResult *simple;
+	GenerateData *gd;
+
+	g_return_if_fail (E_IS_CAL_CLIENT (client));
+	g_return_if_fail (icalcomp != NULL);
+	g_return_if_fail (cb != NULL);
+
+	gd = generate_data_new (
+		client, icalcomp, start, end,
+		cancellable, cb, cb_data, destroy_cb_data);
+
+	gd->key = instance_cache_dup_key (client, icalcomp, detached);
+	gd->replay = instance_cache_lookup (gd->key, start, end);
+
+	if (gd->replay == NULL) {
+		e_cal_client_generate_instances_for_object (
+			client, gd->icalcomp, start, end, cancellable,
+			instance_cache_record_cb, gd,
+			(GDestroyNotify) generate_data_finish);
+		return;
+	}
+
+	/* Replay from an idle callback, as promised above. */
+	simple = g_simple_async_result_new (
+		G_OBJECT (client), instance_cache_replay_done_cb,
+		gd, e_cal_instance_cache_generate);
+
+	g_simple_async_result_complete_in_idle (simple);
+
+	g_object_unref (simple);
+}
+
+/**
+ * e_cal_instance_cache_invalidate:
+ * @client: an #ECalClient
+ * @uid: a component UID, or %NULL for all components of @client
+ *
+ * Forgets the cached instances of @uid, after it was changed or
+ * removed in @client.
+ **/
+void
+e_cal_instance_cache_invalidate (ECalClient *client,
+                                 const gchar *uid)
+{
+	g_return_if_fail (E_IS_CAL_CLIENT (client));
+
+	g_mutex_lock (&cache_lock);
+
+	if (cache_entries != NULL)
+		instance_cache_remove_matching (client, uid);
+
+	g_mutex_unlock (&cache_lock);
+}
@@ -0,0 +1,48 @@
+/*
+ *
+ * Evolution calendar - Cache of expanded recurrence instances
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef E_CAL_INSTANCE_CACHE_H
+#define E_CAL_INSTANCE_CACHE_H
+
+#include <libecal/libecal.h>
+
+G_BEGIN_DECLS
+
+void		e_cal_instance_cache_generate_sync
+						(ECalClient *client,
+						 icalcomponent *icalcomp,
+						 GSList *detached,
+						 time_t start,
+						 time_t end,
+						 ECalRecurInstanceFn cb,
+						 gpointer cb_data);
+void		e_cal_instance_cache_generate	(ECalClient *client,
+						 icalcomponent *icalcomp,
+						 GSList *detached,
+						 time_t start,
+						 time_t end,
+						 GCancellable *cancellable,
+						 ECalRecurInstanceFn cb,
+						 gpointer cb_data,
+						 GDestroyNotify destroy_cb_data);
+void		e_cal_instance_cache_invalidate	(ECalClient *client,
+						 const gchar *uid);
+
+G_END_DECLS
+
+#endif /* E_CAL_INSTANCE_CACHE_H */
@@ -34,6 +34,7 @@
 #include <e-util/e-util-enumtypes.h>
 
 #include "comp-util.h"
+#include "e-cal-instance-cache.h"
 #include "e-cal-model.h"
 #include "itip-utils.h"
 #include "misc.h"
@@ -42,6 +43,10 @@ typedef struct _ClientData ClientData;
 
 struct _ECalModelComponentPrivate {
 	GString *categories_str;
+
+	/* Row in the owning model's 'objects' array, or -1.
+	 * Only a hint, see cal_model_get_row(). */
+	gint row;
 };
 
 #define E_CAL_MODEL_GET_PRIVATE(obj) \
@@ -83,6 +88,13 @@ struct _ECalModelPrivate {
 	/* Array for storing the objects. Each element is of type ECalModelComponent */
 	GPtrArray *objects;
 
+	/* Index of 'objects' by component UID, so views with many
+	 * components do not need a linear scan per notification.
+	 * 'objects_by_uid' maps a UID to a GQueue of IndexEntry,
+	 * 'objects_index' maps an ECalModelComponent to its IndexEntry. */
+	GHashTable *objects_by_uid;
+	GHashTable *objects_index;
+
 	icalcomponent_kind kind;
 	ECalModelFlags flags;
 	icaltimezone *zone;
@@ -91,6 +103,14 @@ struct _ECalModelPrivate {
 	time_t start;
 	time_t end;
 
+	/* The time range the client views query.  When expanding
+	 * recurrences this is wider than the displayed range, and the
+	 * components outside of it are kept in 'window_objects', so
+	 * moving to an adjacent range needs no new query. */
+	time_t window_start;
+	time_t window_end;
+	GHashTable *window_objects;
+
 	/* The search regular expression */
 	gchar *search_sexp;
 
@@ -144,6 +164,15 @@ struct _ECalModelPrivate {
 	GCancellable *loading_clients;
 };
 
+typedef struct {
+	ECalModelComponent *comp_data;
+	ECalClient *client;
+	gchar *uid;
+	gchar *rid;
+	gboolean in_window;
+	gboolean stale;
+} IndexEntry;
+
 typedef struct {
 	const gchar *color;
 	GList *uids;
@@ -417,6 +446,130 @@ cal_model_clients_remove (ECalModel *model,
 	return removed;
 }
 
+static void
+index_entry_free (IndexEntry *entry)
+{
+	g_free (entry->uid);
+	g_free (entry->rid);
+	g_slice_free (IndexEntry, entry);
+}
+
+static void
+cal_model_index_remove (ECalModelPrivate *priv,
+                        ECalModelComponent *comp_data)
+{
+	IndexEntry *entry;
+	GQueue *bucket;
+
+	entry = g_hash_table_lookup (priv->objects_index, comp_data);
+	if (entry == NULL)
+		return;
+
+	bucket = g_hash_table_lookup (priv->objects_by_uid, entry->uid);
+	if (bucket != NULL) {
+		g_queue_remove (bucket, entry);
+		if (g_queue_is_empty (bucket))
+			g_hash_table_remove (priv->objects_by_uid, entry->uid);
+	}
+
+	/* This frees the entry. */
+	g_hash_table_remove (priv->objects_index, comp_data);
+}
+
+static void
+cal_model_index_add (ECalModelPrivate *priv,
+                     ECalModelComponent *comp_data,
+                     gboolean in_window)
+{
+	IndexEntry *entry;
+	GQueue *bucket;
+	const gchar *uid;
+	struct icaltimetype icalrid;
+
+	cal_model_index_remove (priv, comp_data);
+
+	if (comp_data->icalcomp == NULL)
+		return;
+
+	/* Components without a UID can never be looked up. */
+	uid = icalcomponent_get_uid (comp_data->icalcomp);
+	if (uid == NULL || *uid == '\0')
+		return;
+
+	entry = g_slice_new0 (IndexEntry);
+	entry->comp_data = comp_data;
+	entry->client = comp_data->client;
+	entry->uid = g_strdup (uid);
+	entry->in_window = in_window;
+
+	icalrid = icalcomponent_get_recurrenceid (comp_data->icalcomp);
+	if (!icaltime_is_null_time (icalrid))
+		entry->rid = icaltime_as_ical_string_r (icalrid);
+
+	bucket = g_hash_table_lookup (priv->objects_by_uid, uid);
+	if (bucket == NULL) {
+		bucket = g_queue_new ();
+		g_hash_table_insert (
+			priv->objects_by_uid, g_strdup (uid), bucket);
+	}
+
+	g_queue_push_tail (bucket, entry);
+
+	g_hash_table_insert (priv->objects_index, comp_data, entry);
+}
+
+/* Unlike re-adding, this keeps the index entry and its flags. */
+static void
+cal_model_index_set_in_window (ECalModelPrivate *priv,
+                               ECalModelComponent *comp_data,
+                               gboolean in_window)
+{
+	IndexEntry *entry;
+
+	entry = g_hash_table_lookup (priv->objects_index, comp_data);
+	if (entry != NULL)
+		entry->in_window = in_window;
+}
+
+static void
+cal_model_index_clear (ECalModelPrivate *priv)
+{
+	g_hash_table_remove_all (priv->objects_by_uid);
+	g_hash_table_remove_all (priv->objects_index);
+}
+
+/* Updates the row hints of 'objects' from index 'from' on. */
+static void
+cal_model_renumber_rows (ECalModelPrivate *priv,
+                         guint from)
+{
+	guint ii;
+
+	for (ii = from; ii < priv->objects->len; ii++) {
+		ECalModelComponent *comp_data;
+
+		comp_data = g_ptr_array_index (priv->objects, ii);
+		comp_data->priv->row = ii;
+	}
+}
+
+static gint
+cal_model_get_row (ECalModelPrivate *priv,
+                   ECalModelComponent *comp_data)
+{
+	gint row = comp_data->priv->row;
+
+	if (row >= 0 && row < priv->objects->len &&
+	    g_ptr_array_index (priv->objects, row) == comp_data)
+		return row;
+
+	/* Stale hint, the array was changed behind our back. */
+	row = get_position_in_array (priv->objects, comp_data);
+	comp_data->priv->row = row;
+
+	return row;
+}
+
 static gpointer
 get_categories (ECalModelComponent *comp_data)
 {
@@ -1135,6 +1288,11 @@ cal_model_finalize (GObject *object)
 	}
 	g_ptr_array_free (priv->objects, FALSE);
 
+	g_hash_table_foreach (priv->window_objects, (GHFunc) g_object_unref, NULL);
+	g_hash_table_destroy (priv->window_objects);
+	g_hash_table_destroy (priv->objects_by_uid);
+	g_hash_table_destroy (priv->objects_index);
+
 	g_mutex_clear (&priv->notify_lock);
 
 	g_hash_table_destroy (priv->notify_added);
@@ -2035,10 +2193,21 @@ e_cal_model_init (ECalModel *model)
 	/* match none by default */
 	model->priv->start = -1;
 	model->priv->end = -1;
+	model->priv->window_start = -1;
+	model->priv->window_end = -1;
+	model->priv->window_objects = g_hash_table_new (g_direct_hash, g_direct_equal);
 	model->priv->search_sexp = NULL;
 	model->priv->full_sexp = g_strdup ("#f");
 
 	model->priv->objects = g_ptr_array_new ();
+	model->priv->objects_by_uid = g_hash_table_new_full (
+		g_str_hash, g_str_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) g_queue_free);
+	model->priv->objects_index = g_hash_table_new_full (
+		g_direct_hash, g_direct_equal,
+		(GDestroyNotify) NULL,
+		(GDestroyNotify) index_entry_free);
 	model->priv->kind = ICAL_NO_COMPONENT;
 	model->priv->flags = 0;
 
@@ -2691,45 +2860,169 @@ e_cal_model_list_clients (ECalModel *model)
 	return g_queue_peek_head_link (&results);
 }
 
+static IndexEntry *
+cal_model_index_lookup (ECalModelPrivate *priv,
+                        ECalClient *client,
+                        const ECalComponentId *id,
+                        gboolean in_window)
+{
+	GQueue *bucket;
+	GList *link;
+	gboolean has_rid;
+
+	if (id == NULL || id->uid == NULL || *id->uid == '\0')
+		return NULL;
+
+	bucket = g_hash_table_lookup (priv->objects_by_uid, id->uid);
+	if (bucket == NULL)
+		return NULL;
+
+	has_rid = (id->rid && *id->rid);
+
+	for (link = g_queue_peek_head_link (bucket); link; link = g_list_next (link)) {
+		IndexEntry *entry = link->data;
+
+		if (entry->in_window != in_window)
+			continue;
+
+		if (client && entry->client != client)
+			continue;
+
+		if (has_rid && g_strcmp0 (entry->rid, id->rid) != 0)
+			continue;
+
+		return entry;
+	}
+
+	return NULL;
+}
+
+/* Lists the icalcomponents of the rows which are detached instances
+ * of the series 'comp_data' is the master of, if it is one.  Free the
+ * list with g_slist_free(). */
+static GSList *
+cal_model_list_detached (ECalModelPrivate *priv,
+                        ECalModelComponent *comp_data)
+{
+	GQueue *bucket;
+	GList *link;
+	GSList *detached = NULL;
+	const gchar *uid;
+
+	if (e_cal_util_component_is_instance (comp_data->icalcomp) ||
+	    !e_cal_util_component_has_recurrences (comp_data->icalcomp))
+		return NULL;
+
+	uid = icalcomponent_get_uid (comp_data->icalcomp);
+	bucket = uid ? g_hash_table_lookup (priv->objects_by_uid, uid) : NULL;
+
+	for (link = bucket ? g_queue_peek_head_link (bucket) : NULL; link; link = g_list_next (link)) {
+		IndexEntry *entry = link->data;
+
+		if (entry->client == comp_data->client && entry->rid != NULL)
+			detached = g_slist_prepend (
+				detached, entry->comp_data->icalcomp);
+	}
+
+	return detached;
+}
+
 static ECalModelComponent *
 search_by_id_and_client (ECalModelPrivate *priv,
                          ECalClient *client,
                          const ECalComponentId *id)
 {
-	gint i;
+	IndexEntry *entry;
 
-	for (i = 0; i < priv->objects->len; i++) {
-		ECalModelComponent *comp_data = g_ptr_array_index (priv->objects, i);
-
-		if (comp_data) {
-			const gchar *uid;
-			gchar *rid = NULL;
-			struct icaltimetype icalrid;
-			gboolean has_rid = (id->rid && *id->rid);
-
-			uid = icalcomponent_get_uid (comp_data->icalcomp);
-			icalrid = icalcomponent_get_recurrenceid (comp_data->icalcomp);
-			if (!icaltime_is_null_time (icalrid))
-				rid = icaltime_as_ical_string_r (icalrid);
-
-			if (uid && *uid) {
-				if ((!client || comp_data->client == client) && !strcmp (id->uid, uid)) {
-					if (has_rid) {
-						if (!(rid && *rid && !strcmp (rid, id->rid))) {
-							g_free (rid);
-							continue;
-						}
-					}
-					g_free (rid);
-					return comp_data;
-				}
-			}
+	entry = cal_model_index_lookup (priv, client, id, FALSE);
 
-			g_free (rid);
-		}
+	return entry ? entry->comp_data : NULL;
+}
+
+static gboolean
+cal_model_component_in_range (ECalModelComponent *comp_data,
+                              time_t start,
+                              time_t end)
+{
+	time_t instance_end;
+
+	/* Same test as the backends' occur-in-time-range. */
+	instance_end = MAX (comp_data->instance_start, comp_data->instance_end);
+	if (comp_data->instance_start == instance_end)
+		return comp_data->instance_start >= start &&
+			comp_data->instance_start < end;
+
+	return comp_data->instance_start < end && instance_end > start;
+}
+
+/* Whether the component belongs to the displayed rows, as opposed to
+ * the part of the query window outside of the displayed time range. */
+static gboolean
+cal_model_is_displayed (ECalModelPrivate *priv,
+                        ECalModelComponent *comp_data)
+{
+	/* Only expanded instances have reliable instance times. */
+	if (!(priv->flags & E_CAL_MODEL_FLAGS_EXPAND_RECURRENCES))
+		return TRUE;
+
+	if (priv->start == -1 || priv->end == -1)
+		return TRUE;
+
+	return cal_model_component_in_range (comp_data, priv->start, priv->end);
+}
+
+/* Takes ownership of comp_data. */
+static void
+cal_model_window_add (ECalModelPrivate *priv,
+                      ECalModelComponent *comp_data)
+{
+	g_hash_table_add (priv->window_objects, comp_data);
+	cal_model_index_add (priv, comp_data, TRUE);
+}
+
+/* Passes ownership of comp_data to the caller. */
+static gboolean
+cal_model_window_remove (ECalModelPrivate *priv,
+                         ECalModelComponent *comp_data)
+{
+	if (!g_hash_table_remove (priv->window_objects, comp_data))
+		return FALSE;
+
+	cal_model_index_remove (priv, comp_data);
+
+	return TRUE;
+}
+
+static void
+cal_model_window_clear (ECalModelPrivate *priv)
+{
+	GHashTableIter iter;
+	gpointer key;
+
+	g_hash_table_iter_init (&iter, priv->window_objects);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		cal_model_index_remove (priv, key);
+		g_object_unref (key);
 	}
 
-	return NULL;
+	g_hash_table_remove_all (priv->window_objects);
+}
+
+/* Appends comp_data to the rows when it is displayed, otherwise keeps
+ * it in the window.  Takes ownership of comp_data and returns whether
+ * it was appended to the rows. */
+static gboolean
+cal_model_take_component (ECalModel *model,
+                          ECalModelComponent *comp_data)
+{
+	if (cal_model_is_displayed (model->priv, comp_data)) {
+		e_cal_model_append_component (model, comp_data);
+		return TRUE;
+	}
+
+	cal_model_window_add (model->priv, comp_data);
+
+	return FALSE;
 }
 
 static void
@@ -2738,14 +3031,21 @@ remove_all_for_id_and_client (ECalModel *model,
                               const ECalComponentId *id)
 {
 	ECalModelComponent *comp_data;
+	IndexEntry *entry;
+
+	while ((entry = cal_model_index_lookup (model->priv, client, id, TRUE))) {
+		comp_data = entry->comp_data;
+
+		if (cal_model_window_remove (model->priv, comp_data))
+			g_object_unref (comp_data);
+	}
 
 	while ((comp_data = search_by_id_and_client (model->priv, client, id))) {
 		gint pos;
 		GSList *list = NULL;
 
-		pos = get_position_in_array (model->priv->objects, comp_data);
-
-		if (!g_ptr_array_remove (model->priv->objects, comp_data))
+		pos = e_cal_model_remove_component (model, comp_data);
+		if (pos < 0)
 			continue;
 
 		list = g_slist_append (list, comp_data);
@@ -2759,6 +3059,154 @@ remove_all_for_id_and_client (ECalModel *model,
 	}
 }
 
+/* Moves components between the rows and the window after the displayed
+ * time range changed, dropping those which are outside of the window.
+ * The rows are announced as removed and added again, the same as after
+ * new queries, because the views lay them out by the new time range. */
+static void
+cal_model_sort_into_range (ECalModel *model)
+{
+	ECalModelPrivate *priv = model->priv;
+	GHashTableIter iter;
+	gpointer key;
+	GSList *shown = NULL, *kept = NULL, *dropped = NULL, *entering = NULL, *link;
+	guint ii, len;
+
+	e_table_model_pre_change (E_TABLE_MODEL (model));
+
+	g_hash_table_iter_init (&iter, priv->window_objects);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		ECalModelComponent *comp_data = key;
+
+		if (cal_model_is_displayed (priv, comp_data)) {
+			g_hash_table_iter_remove (&iter);
+			entering = g_slist_prepend (entering, comp_data);
+		} else if (!cal_model_component_in_range (comp_data, priv->window_start, priv->window_end)) {
+			g_hash_table_iter_remove (&iter);
+			cal_model_index_remove (priv, comp_data);
+			g_object_unref (comp_data);
+		}
+	}
+
+	len = priv->objects->len;
+
+	for (ii = 0; ii < len; ii++) {
+		ECalModelComponent *comp_data;
+
+		comp_data = g_ptr_array_index (priv->objects, ii);
+		shown = g_slist_prepend (shown, comp_data);
+
+		if (cal_model_is_displayed (priv, comp_data)) {
+			kept = g_slist_prepend (kept, comp_data);
+		} else if (cal_model_component_in_range (comp_data, priv->window_start, priv->window_end)) {
+			g_hash_table_add (priv->window_objects, comp_data);
+			cal_model_index_set_in_window (priv, comp_data, TRUE);
+		} else {
+			cal_model_index_remove (priv, comp_data);
+			dropped = g_slist_prepend (dropped, comp_data);
+		}
+	}
+
+	g_ptr_array_set_size (priv->objects, 0);
+
+	if (shown != NULL) {
+		g_signal_emit (model, signals[COMPS_DELETED], 0, shown);
+		e_table_model_rows_deleted (E_TABLE_MODEL (model), 0, len);
+	} else {
+		e_table_model_no_change (E_TABLE_MODEL (model));
+	}
+
+	kept = g_slist_reverse (kept);
+
+	for (link = kept; link != NULL; link = g_slist_next (link))
+		g_ptr_array_add (priv->objects, link->data);
+
+	for (link = entering; link != NULL; link = g_slist_next (link)) {
+		g_ptr_array_add (priv->objects, link->data);
+		cal_model_index_set_in_window (priv, link->data, FALSE);
+	}
+
+	cal_model_renumber_rows (priv, 0);
+
+	if (priv->objects->len > 0) {
+		e_table_model_pre_change (E_TABLE_MODEL (model));
+		e_table_model_rows_inserted (
+			E_TABLE_MODEL (model), 0, priv->objects->len);
+	}
+
+	g_slist_free_full (dropped, (GDestroyNotify) g_object_unref);
+	g_slist_free (shown);
+	g_slist_free (kept);
+	g_slist_free (entering);
+}
+
+/* Marks everything currently held as needing confirmation from the
+ * client views; see cal_model_remove_stale(). */
+static void
+cal_model_mark_stale (ECalModelPrivate *priv)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init (&iter, priv->objects_index);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		IndexEntry *entry = value;
+
+		entry->stale = TRUE;
+	}
+}
+
+/* Removes components of the client which its new view did not report. */
+static void
+cal_model_remove_stale (ECalModel *model,
+                        ECalClient *client)
+{
+	ECalModelPrivate *priv = model->priv;
+	GHashTableIter iter;
+	gpointer value;
+	GSList *stale = NULL, *link;
+	gboolean changed = FALSE;
+
+	g_hash_table_iter_init (&iter, priv->objects_index);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		IndexEntry *entry = value;
+
+		if (entry->stale && entry->client == client)
+			stale = g_slist_prepend (stale, entry->comp_data);
+	}
+
+	for (link = stale; link != NULL; link = g_slist_next (link)) {
+		ECalModelComponent *comp_data = link->data;
+		GSList *list;
+		gint pos;
+
+		if (cal_model_window_remove (priv, comp_data)) {
+			g_object_unref (comp_data);
+			continue;
+		}
+
+		pos = e_cal_model_remove_component (model, comp_data);
+		if (pos < 0)
+			continue;
+
+		list = g_slist_append (NULL, comp_data);
+		g_signal_emit (model, signals[COMPS_DELETED], 0, list);
+
+		g_slist_free (list);
+		g_object_unref (comp_data);
+
+		e_table_model_pre_change (E_TABLE_MODEL (model));
+		e_table_model_row_deleted (E_TABLE_MODEL (model), pos);
+		changed = TRUE;
+	}
+
+	g_slist_free (stale);
+
+	/* to notify about changes, because in call of row_deleted there are still all events */
+	if (changed)
+		e_table_model_changed (E_TABLE_MODEL (model));
+}
+
 typedef struct {
 	ECalClient *client;
 	ECalClientView *view;
@@ -2802,8 +3250,6 @@ add_instance_cb (ECalComponent *comp,
 	remove_all_for_id_and_client (rdata->model, rdata->client, id);
 	e_cal_component_free_id (id);
 
-	e_table_model_pre_change (E_TABLE_MODEL (rdata->model));
-
 	/* set the right instance start date to component */
 	e_cal_component_get_dtstart (comp, &datetime);
 	if (datetime.tzid)
@@ -2831,8 +3277,11 @@ add_instance_cb (ECalComponent *comp,
 	comp_data->instance_start = instance_start;
 	comp_data->instance_end = instance_end;
 
-	g_ptr_array_add (priv->objects, comp_data);
-	e_table_model_row_inserted (E_TABLE_MODEL (rdata->model), priv->objects->len - 1);
+	e_table_model_pre_change (E_TABLE_MODEL (rdata->model));
+	if (cal_model_take_component (rdata->model, comp_data))
+		e_table_model_row_inserted (E_TABLE_MODEL (rdata->model), priv->objects->len - 1);
+	else
+		e_table_model_no_change (E_TABLE_MODEL (rdata->model));
 
 	return TRUE;
 }
@@ -2974,6 +3423,104 @@ process_event (ECalClientView *view,
 	g_mutex_unlock (&model->priv->notify_lock);
 }
 
+static void
+cal_model_component_set_icalcomponent (ECalModelComponent *comp_data,
+                                       icalcomponent *icalcomp,
+                                       const icaltimezone *zone)
+{
+	if (comp_data->icalcomp)
+		icalcomponent_free (comp_data->icalcomp);
+	if (comp_data->dtstart) {
+		g_free (comp_data->dtstart);
+		comp_data->dtstart = NULL;
+	}
+	if (comp_data->dtend) {
+		g_free (comp_data->dtend);
+		comp_data->dtend = NULL;
+	}
+	if (comp_data->due) {
+		g_free (comp_data->due);
+		comp_data->due = NULL;
+	}
+	if (comp_data->completed) {
+		g_free (comp_data->completed);
+		comp_data->completed = NULL;
+	}
+	if (comp_data->created) {
+		g_free (comp_data->created);
+		comp_data->created = NULL;
+	}
+	if (comp_data->lastmodified) {
+		g_free (comp_data->lastmodified);
+		comp_data->lastmodified = NULL;
+	}
+	if (comp_data->color) {
+		g_free (comp_data->color);
+		comp_data->color = NULL;
+	}
+
+	comp_data->icalcomp = icalcomp;
+	e_cal_model_set_instance_times (comp_data, zone);
+}
+
+/* Updates a component kept from a previous query window in place,
+ * instead of replacing it, when its new view reports it again. */
+static gboolean
+cal_model_refresh_stale (ECalModel *model,
+                         ECalClient *client,
+                         const ECalComponentId *id,
+                         icalcomponent *icalcomp,
+                         GSList **refreshed)
+{
+	ECalModelPrivate *priv = model->priv;
+	ECalModelComponent *comp_data;
+	IndexEntry *entry;
+	const gchar *rid;
+	gboolean in_window;
+
+	entry = cal_model_index_lookup (priv, client, id, FALSE);
+	if (entry == NULL)
+		entry = cal_model_index_lookup (priv, client, id, TRUE);
+
+	rid = (id->rid && *id->rid) ? id->rid : NULL;
+	if (entry == NULL || !entry->stale || g_strcmp0 (entry->rid, rid) != 0)
+		return FALSE;
+
+	comp_data = entry->comp_data;
+	in_window = entry->in_window;
+
+	cal_model_component_set_icalcomponent (
+		comp_data, icalcomponent_new_clone (icalcomp), priv->zone);
+	cal_model_index_add (priv, comp_data, in_window);
+
+	/* Let the caller replace it if it moved in or out of the
+	 * displayed time range meanwhile. */
+	if (in_window == cal_model_is_displayed (priv, comp_data))
+		return FALSE;
+
+	if (!in_window)
+		*refreshed = g_slist_prepend (*refreshed, comp_data);
+
+	return TRUE;
+}
+
+/* Announces rows appended since 'first_new' with a single
+ * rows_inserted emission, so sorters merge them in one step. */
+static void
+cal_model_flush_inserted (ECalModel *model,
+                          gint *first_new)
+{
+	gint len = model->priv->objects->len;
+
+	if (*first_new >= 0 && *first_new < len) {
+		e_table_model_pre_change (E_TABLE_MODEL (model));
+		e_table_model_rows_inserted (
+			E_TABLE_MODEL (model), *first_new, len - *first_new);
+	}
+
+	*first_new = -1;
+}
+
 static void
 process_added (ECalClientView *view,
                const GSList *objects,
@@ -2981,7 +3528,8 @@ process_added (ECalClientView *view,
 {
 	ECalModelPrivate *priv;
 	const GSList *l;
-	GSList *copy;
+	GSList *copy, *refreshed = NULL, *link;
+	gint first_new = -1;
 
 	priv = model->priv;
 
@@ -2994,6 +3542,11 @@ process_added (ECalClientView *view,
 		ECalComponent *comp = e_cal_component_new ();
 		ECalClient *client = e_cal_client_view_get_client (view);
 
+		/* a new detached instance changes its series' expansion */
+		if (e_cal_util_component_is_instance (l->data))
+			e_cal_instance_cache_invalidate (
+				client, icalcomponent_get_uid (l->data));
+
 		/* This will fail for alarm or VCalendar component */
 		if (!e_cal_component_set_icalcomponent (comp, icalcomponent_new_clone (l->data))) {
 			g_object_unref (comp);
@@ -3001,13 +3554,22 @@ process_added (ECalClientView *view,
 		}
 
 		id = e_cal_component_get_id (comp);
+		g_object_unref (comp);
+		ensure_dates_are_in_default_zone (model, l->data);
 
-		/* remove the components if they are already present and re-add them */
+		if (!(e_cal_util_component_has_recurrences (l->data) && (priv->flags & E_CAL_MODEL_FLAGS_EXPAND_RECURRENCES)) &&
+		    cal_model_refresh_stale (model, client, id, l->data, &refreshed)) {
+			e_cal_component_free_id (id);
+			continue;
+		}
+
+		/* remove the components if they are already present and re-add
+		 * them; announce pending rows first so row numbers stay valid */
+		if (search_by_id_and_client (priv, client, id) != NULL)
+			cal_model_flush_inserted (model, &first_new);
 		remove_all_for_id_and_client (model, client, id);
 
 		e_cal_component_free_id (id);
-		g_object_unref (comp);
-		ensure_dates_are_in_default_zone (model, l->data);
 
 		if (e_cal_util_component_has_recurrences (l->data) && (priv->flags & E_CAL_MODEL_FLAGS_EXPAND_RECURRENCES)) {
 			ClientData *client_data;
@@ -3015,29 +3577,50 @@ process_added (ECalClientView *view,
 			client_data = cal_model_clients_lookup (model, client);
 
 			if (client_data != NULL) {
-				RecurrenceExpansionData *rdata = g_new0 (RecurrenceExpansionData, 1);
+				RecurrenceExpansionData *rdata;
+
+				/* instances are announced one by one */
+				cal_model_flush_inserted (model, &first_new);
+
+				rdata = g_new0 (RecurrenceExpansionData, 1);
 				rdata->client = g_object_ref (client);
 				rdata->view = g_object_ref (view);
 				rdata->model = g_object_ref (model);
 
-				e_cal_client_generate_instances_for_object (rdata->client, l->data, priv->start, priv->end, client_data->cancellable,
-									    (ECalRecurInstanceFn) add_instance_cb, rdata, free_rdata);
+				/* The detached instances arriving with the series key its
+				 * cached expansion, later ones invalidate it (see above). */
+				e_cal_instance_cache_generate (rdata->client, l->data, copy, priv->window_start, priv->window_end, client_data->cancellable,
+							       (ECalRecurInstanceFn) add_instance_cb, rdata, free_rdata);
 
 				client_data_unref (client_data);
 			}
 		} else {
-			e_table_model_pre_change (E_TABLE_MODEL (model));
-
 			comp_data = g_object_new (E_TYPE_CAL_MODEL_COMPONENT, NULL);
 			comp_data->client = g_object_ref (client);
 			comp_data->icalcomp = icalcomponent_new_clone (l->data);
 			e_cal_model_set_instance_times (comp_data, priv->zone);
 
-			g_ptr_array_add (priv->objects, comp_data);
-			e_table_model_row_inserted (E_TABLE_MODEL (model), priv->objects->len - 1);
+			if (first_new < 0)
+				first_new = priv->objects->len;
+
+			cal_model_take_component (model, comp_data);
 		}
 	}
 
+	cal_model_flush_inserted (model, &first_new);
+
+	for (link = refreshed; link != NULL; link = g_slist_next (link)) {
+		gint pos;
+
+		pos = cal_model_get_row (priv, link->data);
+		if (pos < 0)
+			continue;
+
+		e_table_model_pre_change (E_TABLE_MODEL (model));
+		e_table_model_row_changed (E_TABLE_MODEL (model), pos);
+	}
+
+	g_slist_free (refreshed);
 	g_slist_free (copy);
 }
 
@@ -3054,6 +3637,10 @@ process_modified (ECalClientView *view,
 
 	/*  re-add only the recurrence objects */
 	for (l = objects; l != NULL; l = g_slist_next (l)) {
+		e_cal_instance_cache_invalidate (
+			e_cal_client_view_get_client (view),
+			icalcomponent_get_uid (l->data));
+
 		if (!e_cal_util_component_is_instance (l->data) && e_cal_util_component_has_recurrences (l->data) && (priv->flags & E_CAL_MODEL_FLAGS_EXPAND_RECURRENCES))
 			list = g_slist_prepend (list, l->data);
 		else {
@@ -3062,6 +3649,7 @@ process_modified (ECalClientView *view,
 			ECalComponentId *id;
 			ECalComponent *comp = e_cal_component_new ();
 			ECalClient *client = e_cal_client_view_get_client (view);
+			gboolean in_window = FALSE;
 
 			if (!e_cal_component_set_icalcomponent (comp, icalcomponent_new_clone (l->data))) {
 				g_object_unref (comp);
@@ -3073,6 +3661,15 @@ process_modified (ECalClientView *view,
 			id = e_cal_component_get_id (comp);
 
 			comp_data = search_by_id_and_client (priv, client, id);
+			if (comp_data == NULL) {
+				IndexEntry *entry;
+
+				entry = cal_model_index_lookup (priv, client, id, TRUE);
+				if (entry != NULL) {
+					comp_data = entry->comp_data;
+					in_window = TRUE;
+				}
+			}
 
 			e_cal_component_free_id (id);
 			g_object_unref (comp);
@@ -3082,41 +3679,44 @@ process_modified (ECalClientView *view,
 				continue;
 			}
 
-			if (comp_data->icalcomp)
-				icalcomponent_free (comp_data->icalcomp);
-			if (comp_data->dtstart) {
-				g_free (comp_data->dtstart);
-				comp_data->dtstart = NULL;
-			}
-			if (comp_data->dtend) {
-				g_free (comp_data->dtend);
-				comp_data->dtend = NULL;
-			}
-			if (comp_data->due) {
-				g_free (comp_data->due);
-				comp_data->due = NULL;
-			}
-			if (comp_data->completed) {
-				g_free (comp_data->completed);
-				comp_data->completed = NULL;
-			}
-			if (comp_data->created) {
-				g_free (comp_data->created);
-				comp_data->created = NULL;
-			}
-			if (comp_data->lastmodified) {
-				g_free (comp_data->lastmodified);
-				comp_data->lastmodified = NULL;
+			cal_model_component_set_icalcomponent (
+				comp_data, icalcomponent_new_clone (l->data), priv->zone);
+			cal_model_index_add (priv, comp_data, in_window);
+
+			if (in_window && !cal_model_is_displayed (priv, comp_data)) {
+				e_table_model_no_change (E_TABLE_MODEL (model));
+				continue;
 			}
-			if (comp_data->color) {
-				g_free (comp_data->color);
-				comp_data->color = NULL;
+
+			if (in_window) {
+				/* moved into the displayed time range */
+				cal_model_window_remove (priv, comp_data);
+				e_cal_model_append_component (model, comp_data);
+				e_table_model_row_inserted (E_TABLE_MODEL (model), priv->objects->len - 1);
+				continue;
 			}
 
-			comp_data->icalcomp = icalcomponent_new_clone (l->data);
-			e_cal_model_set_instance_times (comp_data, priv->zone);
+			if (!cal_model_is_displayed (priv, comp_data)) {
+				/* moved out of the displayed time range */
+				GSList *deleted;
+
+				pos = e_cal_model_remove_component (model, comp_data);
+				if (pos < 0) {
+					e_table_model_no_change (E_TABLE_MODEL (model));
+					continue;
+				}
+
+				deleted = g_slist_append (NULL, comp_data);
+				g_signal_emit (model, signals[COMPS_DELETED], 0, deleted);
+				g_slist_free (deleted);
 
-			pos = get_position_in_array (priv->objects, comp_data);
+				cal_model_window_add (priv, comp_data);
+
+				e_table_model_row_deleted (E_TABLE_MODEL (model), pos);
+				continue;
+			}
+
+			pos = cal_model_get_row (priv, comp_data);
 
 			e_table_model_row_changed (E_TABLE_MODEL (model), pos);
 		}
@@ -3145,15 +3745,25 @@ process_removed (ECalClientView *view,
 	for (l = ids; l; l = l->next) {
 		ECalModelComponent *comp_data = NULL;
 		ECalComponentId *id = l->data;
+		IndexEntry *entry;
 		gint pos;
 
+		e_cal_instance_cache_invalidate (
+			e_cal_client_view_get_client (view), id->uid);
+
+		while ((entry = cal_model_index_lookup (priv, e_cal_client_view_get_client (view), id, TRUE))) {
+			comp_data = entry->comp_data;
+
+			if (cal_model_window_remove (priv, comp_data))
+				g_object_unref (comp_data);
+		}
+
 		/* make sure we remove all objects with this UID */
 		while ((comp_data = search_by_id_and_client (priv, e_cal_client_view_get_client (view), id))) {
 			GSList *l = NULL;
 
-			pos = get_position_in_array (priv->objects, comp_data);
-
-			if (!g_ptr_array_remove (priv->objects, comp_data))
+			pos = e_cal_model_remove_component (model, comp_data);
+			if (pos < 0)
 				continue;
 
 			l = g_slist_append (l, comp_data);
@@ -3297,6 +3907,11 @@ client_view_complete_cb (ECalClientView *view,
 		client = e_cal_client_view_get_client (view);
 		source_type = e_cal_client_get_source_type (client);
 
+		/* Drop what a previous query window held but the new
+		 * one does not contain any longer. */
+		if (error == NULL)
+			cal_model_remove_stale (model, client);
+
 		g_signal_emit (
 			model, signals[CAL_VIEW_COMPLETE], 0,
 			error, source_type);
@@ -3515,8 +4130,21 @@ static void
 remove_client_objects (ECalModel *model,
                        ClientData *client_data)
 {
+	GHashTableIter iter;
+	gpointer key;
 	gint i;
 
+	g_hash_table_iter_init (&iter, model->priv->window_objects);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		ECalModelComponent *comp_data = key;
+
+		if (comp_data->client == client_data->client) {
+			g_hash_table_iter_remove (&iter);
+			cal_model_index_remove (model->priv, comp_data);
+			g_object_unref (comp_data);
+		}
+	}
+
 	/* remove all objects belonging to this client */
 	for (i = model->priv->objects->len; i > 0; i--) {
 		ECalModelComponent *comp_data = (ECalModelComponent *) g_ptr_array_index (model->priv->objects, i - 1);
@@ -3526,7 +4154,8 @@ remove_client_objects (ECalModel *model,
 		if (comp_data->client == client_data->client) {
 			GSList *l = NULL;
 
-			g_ptr_array_remove (model->priv->objects, comp_data);
+			g_ptr_array_remove_index (model->priv->objects, i - 1);
+			cal_model_index_remove (model->priv, comp_data);
 
 			l = g_slist_append (l, comp_data);
 			g_signal_emit (model, signals[COMPS_DELETED], 0, l);
@@ -3539,6 +4168,8 @@ remove_client_objects (ECalModel *model,
 		}
 	}
 
+	cal_model_renumber_rows (model->priv, 0);
+
 	/* to notify about changes, because in call of row_deleted there are still all events */
 	e_table_model_changed (E_TABLE_MODEL (model));
 }
@@ -3667,6 +4298,8 @@ cleanup_content_cb (gpointer user_data)
 
 	slist = get_objects_as_list (model);
 	g_ptr_array_set_size (priv->objects, 0);
+	cal_model_window_clear (priv);
+	cal_model_index_clear (priv);
 	g_signal_emit (model, signals[COMPS_DELETED], 0, slist);
 
 	e_table_model_rows_deleted (E_TABLE_MODEL (model), 0, len);
@@ -3680,23 +4313,34 @@ cleanup_content_cb (gpointer user_data)
 }
 
 static void
-redo_queries (ECalModel *model)
+cal_model_update_window (ECalModelPrivate *priv)
 {
-	ECalModelPrivate *priv;
-	GList *list, *link;
-	struct cc_data data;
+	priv->window_start = priv->start;
+	priv->window_end = priv->end;
 
-	priv = model->priv;
+	/* Also query one displayed range worth of components on each
+	 * side, so paging to an adjacent range is served locally. */
+	if ((priv->flags & E_CAL_MODEL_FLAGS_EXPAND_RECURRENCES) != 0 &&
+	    priv->start != -1 && priv->end != -1) {
+		time_t span = priv->end - priv->start;
+
+		priv->window_start = MAX (0, priv->start - span);
+		priv->window_end = priv->end + span;
+	}
+}
 
+static void
+cal_model_update_full_sexp (ECalModelPrivate *priv)
+{
 	if (priv->full_sexp)
 		g_free (priv->full_sexp);
 
-	if (priv->start != -1 && priv->end != -1) {
+	if (priv->window_start != -1 && priv->window_end != -1) {
 		gchar *iso_start, *iso_end;
 		const gchar *default_tzloc = NULL;
 
-		iso_start = isodate_from_time_t (priv->start);
-		iso_end = isodate_from_time_t (priv->end);
+		iso_start = isodate_from_time_t (priv->window_start);
+		iso_end = isodate_from_time_t (priv->window_end);
 
 		if (priv->zone && priv->zone != icaltimezone_get_utc_timezone ())
 			default_tzloc = icaltimezone_get_location (priv->zone);
@@ -3721,6 +4365,34 @@ redo_queries (ECalModel *model)
 	} else {
 		priv->full_sexp = g_strdup ("#f");
 	}
+}
+
+static void
+cal_model_update_client_views (ECalModel *model)
+{
+	GList *list, *link;
+
+	list = cal_model_clients_list (model);
+
+	for (link = list; link != NULL; link = g_list_next (link)) {
+		ClientData *client_data = link->data;
+
+		update_e_cal_view_for_client (model, client_data);
+	}
+
+	g_list_free_full (list, (GDestroyNotify) client_data_unref);
+}
+
+static void
+redo_queries (ECalModel *model)
+{
+	ECalModelPrivate *priv;
+	struct cc_data data;
+
+	priv = model->priv;
+
+	cal_model_update_window (priv);
+	cal_model_update_full_sexp (priv);
 
 	/* clean up the current contents, which should be done
 	 * always from the main thread, because of gtk calls during removal */
@@ -3738,16 +4410,43 @@ redo_queries (ECalModel *model)
 	e_flag_free (data.eflag);
 
 	/* update the view for all clients */
+	cal_model_update_client_views (model);
+}
 
-	list = cal_model_clients_list (model);
+/* Follows a change of the displayed time range without dropping the
+ * model content.  Returns FALSE if the caller should redo the queries. */
+static gboolean
+cal_model_slide_window (ECalModel *model)
+{
+	ECalModelPrivate *priv = model->priv;
 
-	for (link = list; link != NULL; link = g_list_next (link)) {
-		ClientData *client_data = link->data;
+	if (!(priv->flags & E_CAL_MODEL_FLAGS_EXPAND_RECURRENCES))
+		return FALSE;
 
-		update_e_cal_view_for_client (model, client_data);
+	if (priv->start == -1 || priv->end == -1 ||
+	    priv->window_start == -1 || priv->window_end == -1)
+		return FALSE;
+
+	/* Row changes need to be done from the main thread. */
+	if (!g_main_context_is_owner (g_main_context_default ()))
+		return FALSE;
+
+	if (priv->start >= priv->window_start && priv->end <= priv->window_end) {
+		cal_model_sort_into_range (model);
+		return TRUE;
 	}
 
-	g_list_free_full (list, (GDestroyNotify) client_data_unref);
+	/* Query a window around the new range.  What is already known
+	 * of it stays in place until the new views either report it
+	 * again or complete without it. */
+	cal_model_update_window (priv);
+	cal_model_update_full_sexp (priv);
+	cal_model_sort_into_range (model);
+	cal_model_mark_stale (priv);
+
+	cal_model_update_client_views (model);
+
+	return TRUE;
 }
 
 void
@@ -3789,8 +4488,12 @@ e_cal_model_set_time_range (ECalModel *model,
 	priv->start = start;
 	priv->end = end;
 
+	/* Views lay out the rows by the time range they got with this
+	 * signal, thus it is emitted before any of the rows change. */
 	g_signal_emit (model, signals[TIME_RANGE_CHANGED], 0, start, end);
-	redo_queries (model);
+
+	if (!cal_model_slide_window (model))
+		redo_queries (model);
 }
 
 const gchar *
@@ -3863,9 +4566,12 @@ e_cal_model_set_search_query_with_time_range (ECalModel *model,
 	if (!(priv->start == start && priv->end == end)) {
 		priv->start = start;
 		priv->end = end;
-		do_query = TRUE;
 
 		g_signal_emit (model, signals[TIME_RANGE_CHANGED], 0, start, end);
+
+		/* A new search needs new queries anyway. */
+		if (!do_query && !cal_model_slide_window (model))
+			do_query = TRUE;
 	}
 
 	if (do_query)
@@ -4224,6 +4930,7 @@ static void
 e_cal_model_component_init (ECalModelComponent *comp)
 {
 	comp->priv = E_CAL_MODEL_COMPONENT_GET_PRIVATE (comp);
+	comp->priv->row = -1;
 }
 
 /**
@@ -4248,13 +4955,22 @@ e_cal_model_generate_instances_sync (ECalModel *model,
 		mdata.comp_data = comp_data;
 		mdata.cb_data = cb_data;
 
-		if (comp_data->instance_start < end && comp_data->instance_end > start)
-			e_cal_client_generate_instances_for_object_sync (comp_data->client, comp_data->icalcomp, start, end, cb, &mdata);
+		if (comp_data->instance_start < end && comp_data->instance_end > start) {
+			GSList *detached;
+
+			detached = cal_model_list_detached (model->priv, comp_data);
+			e_cal_instance_cache_generate_sync (comp_data->client, comp_data->icalcomp, detached, start, end, cb, &mdata);
+			g_slist_free (detached);
+		}
 	}
 }
 
 /**
  * e_cal_model_get_object_array
+ *
+ * The returned array must not be modified directly; use
+ * e_cal_model_append_component() and e_cal_model_remove_component()
+ * so the UID index stays in sync.
  */
 GPtrArray *
 e_cal_model_get_object_array (ECalModel *model)
@@ -4266,6 +4982,60 @@ e_cal_model_get_object_array (ECalModel *model)
 	return model->priv->objects;
 }
 
+/**
+ * e_cal_model_append_component:
+ * @model: an #ECalModel
+ * @comp_data: an #ECalModelComponent
+ *
+ * Appends @comp_data to the object array of @model and indexes it for
+ * e_cal_model_get_component_for_uid().  The model takes ownership of
+ * the @comp_data reference.  Callers are responsible for emitting the
+ * appropriate #ETableModel signals.
+ **/
+void
+e_cal_model_append_component (ECalModel *model,
+                              ECalModelComponent *comp_data)
+{
+	g_return_if_fail (E_IS_CAL_MODEL (model));
+	g_return_if_fail (E_IS_CAL_MODEL_COMPONENT (comp_data));
+
+	comp_data->priv->row = model->priv->objects->len;
+	g_ptr_array_add (model->priv->objects, comp_data);
+	cal_model_index_add (model->priv, comp_data, FALSE);
+}
+
+/**
+ * e_cal_model_remove_component:
+ * @model: an #ECalModel
+ * @comp_data: an #ECalModelComponent
+ *
+ * Removes @comp_data from the object array of @model and from its index.
+ * The reference held by the model is passed to the caller.  Callers are
+ * responsible for emitting the appropriate #ETableModel signals.
+ *
+ * Returns: the row @comp_data occupied, or -1 if @model did not have it
+ **/
+gint
+e_cal_model_remove_component (ECalModel *model,
+                              ECalModelComponent *comp_data)
+{
+	gint pos;
+
+	g_return_val_if_fail (E_IS_CAL_MODEL (model), -1);
+	g_return_val_if_fail (E_IS_CAL_MODEL_COMPONENT (comp_data), -1);
+
+	cal_model_index_remove (model->priv, comp_data);
+
+	pos = cal_model_get_row (model->priv, comp_data);
+	if (pos >= 0) {
+		g_ptr_array_remove_index (model->priv->objects, pos);
+		cal_model_renumber_rows (model->priv, pos);
+		comp_data->priv->row = -1;
+	}
+
+	return pos;
+}
+
 void
 e_cal_model_set_instance_times (ECalModelComponent *comp_data,
                                 const icaltimezone *zone)
@@ -299,6 +299,10 @@ void		e_cal_model_generate_instances_sync
 						 ECalRecurInstanceFn cb,
 						 gpointer cb_data);
 GPtrArray *	e_cal_model_get_object_array	(ECalModel *model);
+void		e_cal_model_append_component	(ECalModel *model,
+						 ECalModelComponent *comp_data);
+gint		e_cal_model_remove_component	(ECalModel *model,
+						 ECalModelComponent *comp_data);
 void		e_cal_model_set_instance_times	(ECalModelComponent *comp_data,
 						 const icaltimezone *zone);
 void		e_cal_model_set_search_query_with_time_range
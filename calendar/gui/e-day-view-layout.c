@@ -31,27 +31,59 @@
 
 #include "e-day-view-layout.h"
 
+/* Columns of the main canvas are kept in guint8 fields. */
+#define MAX_DAY_COLUMNS G_MAXUINT8
+
+/* The expansion pass keeps one bit per row and column, in rows of
+ * guint32 words. */
+#define GRID_WORD_BITS 32
+
+#define GRID_WORDS(cols) (((cols) + GRID_WORD_BITS - 1) / GRID_WORD_BITS)
+
+#define GRID_TEST(grid, words, row, col) \
+	(((grid)[(row) * (words) + (col) / GRID_WORD_BITS] >> \
+	  ((col) % GRID_WORD_BITS)) & 1)
+
+#define GRID_SET(grid, words, row, col) \
+	((grid)[(row) * (words) + (col) / GRID_WORD_BITS] |= \
+	 (1u << ((col) % GRID_WORD_BITS)))
+
 static void e_day_view_layout_long_event (EDayViewEvent	  *event,
-					  guint8	  *grid,
+					  gint		  *row_ends,
 					  gint		   days_shown,
 					  time_t	  *day_starts,
 					  gint		  *rows_in_top_display);
 
-static void e_day_view_layout_day_event (EDayViewEvent    *event,
-					 EBitArray       **grid,
+static gboolean e_day_view_get_event_rows (EDayViewEvent  *event,
+					   gint		   rows,
+					   gint		   mins_per_row,
+					   gint		  *start_row,
+					   gint		  *end_row);
+static gint e_day_view_layout_day_event (EDayViewEvent    *event,
+					 gint		  *col_ends,
+					 gint		  *n_cols,
 					 guint16	  *group_starts,
 					 guint8		  *cols_per_row,
 					 gint		   rows,
 					 gint		   mins_per_row,
 					 gint              max_cols);
 static void e_day_view_expand_day_event (EDayViewEvent    *event,
-					 EBitArray       **grid,
+					 const guint32	  *grid,
+					 gint		   words,
 					 guint8		  *cols_per_row,
+					 gint		   rows,
 					 gint		   mins_per_row);
 static void e_day_view_recalc_cols_per_row (gint           rows,
 					    guint8	  *cols_per_row,
 					    guint16       *group_starts);
 
+/* Both layouts below sweep over the events in the order of their start
+ * time, which is how EDayView and printing sort them.  A row (or column)
+ * is free for an event if everything placed in it so far ends before the
+ * event starts, so only the end of each row (or column) is tracked.  For
+ * unsorted events this still gives a valid, though not as compact,
+ * layout. */
+
 void
 e_day_view_layout_long_events (GArray *events,
                                gint days_shown,
@@ -60,13 +92,14 @@ e_day_view_layout_long_events (GArray *events,
 {
 	EDayViewEvent *event;
 	gint event_num;
-	guint8 *grid;
+	gint *row_ends;
 
-	/* This is a temporary 2-d grid which is used to place events.
-	 * Each element is 0 if the position is empty, or 1 if occupied.
+	/* The last day occupied in each row, or -1 if the row is empty.
 	 * We allocate the maximum size possible here, assuming that each
 	 * event will need its own row. */
-	grid = g_new0 (guint8, events->len * E_DAY_VIEW_MAX_DAYS);
+	row_ends = g_new (gint, events->len + 1);
+	for (event_num = 0; event_num <= events->len; event_num++)
+		row_ends[event_num] = -1;
 
 	/* Reset the number of rows in the top display to 0. It will be
 	 * updated as events are layed out below. */
@@ -77,23 +110,22 @@ e_day_view_layout_long_events (GArray *events,
 	for (event_num = 0; event_num < events->len; event_num++) {
 		event = &g_array_index (events, EDayViewEvent, event_num);
 		e_day_view_layout_long_event (
-			event, grid,
+			event, row_ends,
 			days_shown, day_starts,
 			rows_in_top_display);
 	}
 
-	/* Free the grid. */
-	g_free (grid);
+	g_free (row_ends);
 }
 
 static void
 e_day_view_layout_long_event (EDayViewEvent *event,
-                              guint8 *grid,
+                              gint *row_ends,
                               gint days_shown,
                               time_t *day_starts,
                               gint *rows_in_top_display)
 {
-	gint start_day, end_day, free_row, day, row;
+	gint start_day, end_day, free_row;
 
 	event->num_columns = 0;
 
@@ -102,26 +134,17 @@ e_day_view_layout_long_event (EDayViewEvent *event,
 					      &start_day, &end_day))
 		return;
 
-	/* Try each row until we find a free one. */
-	row = 0;
-	do {
-		free_row = row;
-		for (day = start_day; day <= end_day; day++) {
-			if (grid[row * E_DAY_VIEW_MAX_DAYS + day]) {
-				free_row = -1;
-				break;
-			}
-		}
-		row++;
-	} while (free_row == -1);
+	/* Use the first row which is free from the start day on; rows past
+	 * rows_in_top_display are always empty. */
+	for (free_row = 0; free_row < *rows_in_top_display; free_row++) {
+		if (row_ends[free_row] < start_day)
+			break;
+	}
 
 	event->start_row_or_col = free_row;
 	event->num_columns = 1;
 
-	/* Mark the cells as full. */
-	for (day = start_day; day <= end_day; day++) {
-		grid[free_row * E_DAY_VIEW_MAX_DAYS + day] = 1;
-	}
+	row_ends[free_row] = MAX (row_ends[free_row], end_day);
 
 	/* Update the number of rows in the top canvas if necessary. */
 	*rows_in_top_display = MAX (*rows_in_top_display, free_row + 1);
@@ -136,8 +159,9 @@ e_day_view_layout_day_events (GArray *events,
                               gint max_cols)
 {
 	EDayViewEvent *event;
-	gint row, event_num, res;
-	EBitArray **grid;
+	gint row, event_num, res, words, n_cols;
+	gint *col_ends;
+	guint32 *grid = NULL;
 
 	/* This is a temporary array which keeps track of rows which are
 	 * connected. When an appointment spans multiple rows then the number
@@ -147,9 +171,12 @@ e_day_view_layout_day_events (GArray *events,
 	 * rows. */
 	guint16 group_starts[12 * 24];
 
-	/* This is a temporary 2-d grid which is used to place events.
-	 * Each element is 0 if the position is empty, or 1 if occupied. */
-	grid = g_new0 (EBitArray *, rows);
+	if (max_cols <= 0 || max_cols > MAX_DAY_COLUMNS)
+		max_cols = MAX_DAY_COLUMNS;
+
+	/* The last row occupied in each column used so far. */
+	col_ends = g_new (gint, max_cols);
+	n_cols = 0;
 
 	/* Reset the cols_per_row array, and initialize the connected rows so
 	 * that all rows are not connected - each row is the start of a new
@@ -157,93 +184,125 @@ e_day_view_layout_day_events (GArray *events,
 	for (row = 0; row < rows; row++) {
 		cols_per_row[row] = 0;
 		group_starts[row] = row;
-
-		/* row doesn't contain any event at the moment */
-		grid[row] = e_bit_array_new (0);
 	}
 
 	/* Iterate over the events, finding which rows they cover, and putting
 	 * them in the first free column available. Increment the number of
 	 * events in each of the rows it covers, and make sure they are all
 	 * in one group. */
+	res = 0;
 	for (event_num = 0; event_num < events->len; event_num++) {
+		gint col;
+
 		event = &g_array_index (events, EDayViewEvent, event_num);
 
-		e_day_view_layout_day_event (
-			event, grid, group_starts,
+		col = e_day_view_layout_day_event (
+			event, col_ends, &n_cols, group_starts,
 			cols_per_row, rows, mins_per_row, max_cols);
+
+		res = MAX (res, col + 1);
 	}
 
+	g_free (col_ends);
+
 	/* Recalculate the number of columns needed in each row. */
 	e_day_view_recalc_cols_per_row (rows, cols_per_row, group_starts);
 
-	/* Iterate over the events again, trying to expand events horizontally
-	 * if there is enough space. */
+	/* Fill a grid of the occupied cells, then iterate over the events
+	 * again, trying to expand events horizontally if there is enough
+	 * space. */
+	words = GRID_WORDS (res);
+	if (words > 0)
+		grid = g_new0 (guint32, rows * words);
+
 	for (event_num = 0; event_num < events->len; event_num++) {
+		gint start_row, end_row;
+
 		event = &g_array_index (events, EDayViewEvent, event_num);
-		e_day_view_expand_day_event (
-			event, grid, cols_per_row,
-			mins_per_row);
+
+		if (event->num_columns == 0 || !e_day_view_get_event_rows (
+		    event, rows, mins_per_row, &start_row, &end_row))
+			continue;
+
+		for (row = start_row; row <= end_row; row++)
+			GRID_SET (grid, words, row, event->start_row_or_col);
 	}
 
-	/* Free the grid and compute maximum number of columns used. */
-	res = 0;
-	for (row = 0; row < rows; row++) {
-		res = MAX (res, e_bit_array_bit_count (grid[row]));
-		g_object_unref (grid[row]);
+	for (event_num = 0; event_num < events->len; event_num++) {
+		event = &g_array_index (events, EDayViewEvent, event_num);
+		e_day_view_expand_day_event (
+			event, grid, words, cols_per_row,
+			rows, mins_per_row);
 	}
+
 	g_free (grid);
 
 	return res;
 }
 
-/* Finds the first free position to place the event in.
+/* Returns the rows covered by the event, clamped to the visible ones,
+ * or FALSE if the event can't currently be seen. */
+static gboolean
+e_day_view_get_event_rows (EDayViewEvent *event,
+                           gint rows,
+                           gint mins_per_row,
+                           gint *start_row,
+                           gint *end_row)
+{
+	*start_row = event->start_minute / mins_per_row;
+	*end_row = (event->end_minute - 1) / mins_per_row;
+	if (*end_row < *start_row)
+		*end_row = *start_row;
+
+	if (*start_row >= rows || *end_row < 0)
+		return FALSE;
+
+	/* Make sure we don't go outside the visible times. */
+	*start_row = CLAMP (*start_row, 0, rows - 1);
+	*end_row = CLAMP (*end_row, 0, rows - 1);
+
+	return TRUE;
+}
+
+/* Finds the first free position to place the event in, and returns it,
+ * or -1 if the event is not placed.
  * Increments the number of events in each of the rows it covers, and makes
  * sure they are all in one group. */
-static void
+static gint
 e_day_view_layout_day_event (EDayViewEvent *event,
-                             EBitArray **grid,
+                             gint *col_ends,
+                             gint *n_cols,
                              guint16 *group_starts,
                              guint8 *cols_per_row,
                              gint rows,
                              gint mins_per_row,
                              gint max_cols)
 {
-	gint start_row, end_row, free_col, col, row, group_start;
-
-	start_row = event->start_minute / mins_per_row;
-	end_row = (event->end_minute - 1) / mins_per_row;
-	if (end_row < start_row)
-		end_row = start_row;
+	gint start_row, end_row, free_col, row, group_start;
 
 	event->num_columns = 0;
 
 	/* If the event can't currently be seen, just return. */
-	if (start_row >= rows || end_row < 0)
-		return;
+	if (!e_day_view_get_event_rows (
+		event, rows, mins_per_row, &start_row, &end_row))
+		return -1;
 
-	/* Make sure we don't go outside the visible times. */
-	start_row = CLAMP (start_row, 0, rows - 1);
-	end_row = CLAMP (end_row, 0, rows - 1);
+	/* Use the first column which is free from the start row on. */
+	for (free_col = 0; free_col < *n_cols; free_col++) {
+		if (col_ends[free_col] < start_row)
+			break;
+	}
 
-	/* Try each column until we find a free one. */
-	for (col = 0; max_cols <= 0 || col < max_cols; col++) {
-		free_col = col;
-		for (row = start_row; row <= end_row; row++) {
-			if (e_bit_array_bit_count (grid[row]) > col &&
-			    e_bit_array_value_at (grid[row], col)) {
-				free_col = -1;
-				break;
-			}
-		}
+	if (free_col == *n_cols) {
+		/* If we can't find space for the event, just return. */
+		if (*n_cols >= max_cols)
+			return -1;
 
-		if (free_col != -1)
-			break;
+		col_ends[free_col] = -1;
+		(*n_cols)++;
 	}
 
-	/* If we can't find space for the event, just return. */
-	if (free_col == -1)
-		return;
+	col_ends[free_col] = MAX (col_ends[free_col], end_row);
 
 	/* The event is assigned 1 col initially, but may be expanded later. */
 	event->start_row_or_col = free_col;
@@ -257,13 +316,6 @@ e_day_view_layout_day_event (EDayViewEvent *event,
 	 * all the events have been layed out. Also make sure all the rows that
 	 * the event covers are in one group. */
 	for (row = start_row; row <= end_row; row++) {
-		/* resize the array if necessary */
-		if (e_bit_array_bit_count (grid[row]) <= free_col)
-			e_bit_array_insert (
-				grid[row], e_bit_array_bit_count (grid[row]),
-				free_col - e_bit_array_bit_count (grid[row]) + 1);
-
-		e_bit_array_change_one_row (grid[row], free_col, TRUE);
 		cols_per_row[row]++;
 		group_starts[row] = group_start;
 	}
@@ -274,6 +326,8 @@ e_day_view_layout_day_event (EDayViewEvent *event,
 			break;
 		group_starts[row] = group_start;
 	}
+
+	return free_col;
 }
 
 /* For each group of rows, find the max number of events in all the
@@ -302,24 +356,27 @@ e_day_view_recalc_cols_per_row (gint rows,
 /* Expands the event horizontally to fill any free space. */
 static void
 e_day_view_expand_day_event (EDayViewEvent *event,
-                             EBitArray **grid,
+                             const guint32 *grid,
+                             gint words,
                              guint8 *cols_per_row,
+                             gint rows,
                              gint mins_per_row)
 {
-	gint start_row, end_row, col, row;
+	gint start_row, end_row, col, row, n_cols;
 	gboolean clashed;
 
-	start_row = event->start_minute / mins_per_row;
-	end_row = (event->end_minute - 1) / mins_per_row;
-	if (end_row < start_row)
-		end_row = start_row;
+	if (event->num_columns == 0 || !e_day_view_get_event_rows (
+	    event, rows, mins_per_row, &start_row, &end_row))
+		return;
+
+	/* Columns past the grid are empty. */
+	n_cols = MIN (cols_per_row[start_row], words * GRID_WORD_BITS);
 
 	/* Try each column until we find a free one. */
 	clashed = FALSE;
-	for (col = event->start_row_or_col + 1; col < cols_per_row[start_row]; col++) {
+	for (col = event->start_row_or_col + 1; col < n_cols; col++) {
 		for (row = start_row; row <= end_row; row++) {
-			if (e_bit_array_bit_count (grid[row]) > col &&
-			    e_bit_array_value_at (grid[row], col)) {
+			if (GRID_TEST (grid, words, row, col)) {
 				clashed = TRUE;
 				break;
 			}
@@ -1927,6 +1927,7 @@ e_day_view_init (EDayView *day_view)
 		day_view->events_sorted[day] = TRUE;
 		day_view->need_layout[day] = FALSE;
 		day_view->need_reshape[day] = FALSE;
+		day_view->day_max_cols[day] = 0;
 	}
 
 	/* These indicate that the times haven't been set. */
@@ -5332,8 +5333,10 @@ e_day_view_free_events (EDayView *day_view)
 
 	e_day_view_free_event_array (day_view, day_view->long_events);
 
-	for (day = 0; day < E_DAY_VIEW_MAX_DAYS; day++)
+	for (day = 0; day < E_DAY_VIEW_MAX_DAYS; day++) {
 		e_day_view_free_event_array (day_view, day_view->events[day]);
+		day_view->need_layout[day] = TRUE;
+	}
 
 	if (did_editing)
 		g_object_notify (G_OBJECT (day_view), "is-editing");
@@ -5487,6 +5490,7 @@ e_day_view_check_layout (EDayView *day_view)
 	gint day, rows_in_top_display;
 	gint days_shown;
 	gint max_cols = -1;
+	gboolean relayout = FALSE;
 
 	days_shown = e_day_view_get_days_shown (day_view);
 
@@ -5503,19 +5507,17 @@ e_day_view_check_layout (EDayView *day_view)
 	/* Make sure the events are sorted (by start and size). */
 	e_day_view_ensure_events_sorted (day_view);
 
+	/* Only the days whose events changed are layed out again. */
 	for (day = 0; day < days_shown; day++) {
 		if (day_view->need_layout[day]) {
-			gint cols;
-
-			cols = e_day_view_layout_day_events (
+			day_view->day_max_cols[day] = e_day_view_layout_day_events (
 				day_view->events[day],
 				day_view->rows,
 				time_divisions,
 				day_view->cols_per_row[day],
 				days_shown == 1 ? -1 :
 				E_DAY_VIEW_MULTI_DAY_MAX_COLUMNS);
-
-			max_cols = MAX (cols, max_cols);
+			relayout = TRUE;
 		}
 
 		if (day_view->need_layout[day]
@@ -5551,6 +5553,11 @@ e_day_view_check_layout (EDayView *day_view)
 	day_view->long_events_need_layout = FALSE;
 	day_view->long_events_need_reshape = FALSE;
 
+	if (relayout) {
+		for (day = 0; day < days_shown; day++)
+			max_cols = MAX (max_cols, day_view->day_max_cols[day]);
+	}
+
 	if (max_cols != -1 && max_cols != day_view->max_cols) {
 		day_view->max_cols = max_cols;
 		e_day_view_recalc_main_canvas_size (day_view);
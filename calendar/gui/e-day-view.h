@@ -283,7 +283,9 @@ struct _EDayView {
 	 * Note that there are a maximum of 12 * 24 rows (when a row is 5 mins)
 	 * but we don't always have that many rows. */
 	guint8 cols_per_row[E_DAY_VIEW_MAX_DAYS][12 * 24];
-	/* The maximum number of columns from all rows in cols_per_row */
+	/* The maximum number of columns from all rows in cols_per_row,
+	 * for each day and over all days shown */
+	gint day_max_cols[E_DAY_VIEW_MAX_DAYS];
 	gint max_cols;
 
 	/* Sizes of the various time strings. */
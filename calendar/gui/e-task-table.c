@@ -1741,14 +1741,13 @@ hide_completed_rows_ready (GObject *source_object,
 		comp_data = e_cal_model_get_component_for_uid (model, id);
 		if (comp_data != NULL) {
 			e_table_model_pre_change (E_TABLE_MODEL (model));
-			pos = get_position_in_array (
-				comp_objects, comp_data);
-			e_table_model_row_deleted (
-				E_TABLE_MODEL (model), pos);
-			changed = TRUE;
-
-			if (g_ptr_array_remove (comp_objects, comp_data))
+			pos = e_cal_model_remove_component (model, comp_data);
+			if (pos >= 0) {
+				e_table_model_row_deleted (
+					E_TABLE_MODEL (model), pos);
+				changed = TRUE;
 				g_object_unref (comp_data);
+			}
 		}
 		e_cal_component_free_id (id);
 		g_object_unref (comp);
@@ -1827,7 +1826,7 @@ show_completed_rows_ready (GObject *source_object,
 			comp_data->completed = NULL;
 			comp_data->color = NULL;
 
-			g_ptr_array_add (comp_objects, comp_data);
+			e_cal_model_append_component (model, comp_data);
 			e_table_model_row_inserted (
 				E_TABLE_MODEL (model),
 				comp_objects->len - 1);
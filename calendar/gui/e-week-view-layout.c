@@ -27,8 +27,13 @@
 #include "e-week-view-layout.h"
 #include "calendar-config.h"
 
+/* Each day of the grid has one bit per row, in guint32 words. */
+#define GRID_WORD_BITS 32
+#define GRID_DAY_WORDS \
+	((E_WEEK_VIEW_MAX_ROWS_PER_CELL + GRID_WORD_BITS - 1) / GRID_WORD_BITS)
+
 static void e_week_view_layout_event	(EWeekViewEvent	*event,
-					 guint8		*grid,
+					 guint32	*grid,
 					 GArray		*spans,
 					 GArray		*old_spans,
 					 gboolean	 multi_week_view,
@@ -59,15 +64,14 @@ e_week_view_layout_events (GArray *events,
 	EWeekViewEvent *event;
 	EWeekViewEventSpan *span;
 	gint num_days, day, event_num, span_num;
-	guint8 *grid;
+	guint32 *grid;
 	GArray *spans;
 
 	/* This is a temporary 2-d grid which is used to place events.
-	 * Each element is 0 if the position is empty, or 1 if occupied.
+	 * Each bit is 0 if the position is empty, or 1 if occupied.
 	 * We allocate the maximum size possible here, assuming that each
 	 * event will need its own row. */
-	grid = g_new0 (guint8, E_WEEK_VIEW_MAX_ROWS_PER_CELL * 7
-		       * E_WEEK_VIEW_MAX_WEEKS);
+	grid = g_new0 (guint32, GRID_DAY_WORDS * 7 * E_WEEK_VIEW_MAX_WEEKS);
 
 	/* We create a new array of spans, which will replace the old one. */
 	spans = g_array_new (FALSE, FALSE, sizeof (EWeekViewEventSpan));
@@ -111,7 +115,7 @@ e_week_view_layout_events (GArray *events,
 
 static void
 e_week_view_layout_event (EWeekViewEvent *event,
-                                 guint8 *grid,
+                                 guint32 *grid,
                                  GArray *spans,
                                  GArray *old_spans,
                                  gboolean multi_week_view,
@@ -122,7 +126,7 @@ e_week_view_layout_event (EWeekViewEvent *event,
                                  gint *rows_per_day)
 {
 	gint start_day, end_day, span_start_day, span_end_day, rows_per_cell;
-	gint free_row, row, day, span_num, spans_index, num_spans, days_shown;
+	gint free_row, word, day, span_num, spans_index, num_spans, days_shown;
 	EWeekViewEventSpan span, *old_span;
 
 	days_shown = multi_week_view ? weeks_shown * 7 : 7;
@@ -160,27 +164,31 @@ e_week_view_layout_event (EWeekViewEvent *event,
 			"  Span start:%i end:%i\n", span_start_day,
 			span_end_day);
 #endif
-		/* Try each row until we find a free one or we fall off the
-		 * bottom of the available rows. */
-		row = 0;
+		/* Find the first row free in all days of the span, 32 rows
+		 * at a time, or fall off the bottom of the available rows. */
 		free_row = -1;
-		while (free_row == -1 && row < rows_per_cell) {
-			free_row = row;
-			for (day = span_start_day; day <= span_end_day;
-			     day++) {
-				if (grid[day * rows_per_cell + row]) {
-					free_row = -1;
-					break;
-				}
+		for (word = 0; word < GRID_DAY_WORDS; word++) {
+			guint32 used = 0;
+
+			for (day = span_start_day; day <= span_end_day; day++)
+				used |= grid[day * GRID_DAY_WORDS + word];
+
+			if (used != G_MAXUINT32) {
+				free_row = word * GRID_WORD_BITS +
+					g_bit_nth_lsf ((gulong) (guint32) ~used, -1);
+				break;
 			}
-			row++;
-		};
+		}
+
+		if (free_row >= rows_per_cell)
+			free_row = -1;
 
 		if (free_row != -1) {
 			/* Mark the cells as full. */
 			for (day = span_start_day; day <= span_end_day;
 			     day++) {
-				grid[day * rows_per_cell + free_row] = 1;
+				grid[day * GRID_DAY_WORDS + free_row / GRID_WORD_BITS] |=
+					1u << (free_row % GRID_WORD_BITS);
 				rows_per_day[day] = MAX (
 					rows_per_day[day],
 					free_row + 1);
@@ -230,23 +238,31 @@ e_week_view_find_day (time_t time_to_find,
                       gint days_shown,
                       time_t *day_starts)
 {
-	gint day;
+	gint low, high, day;
 
 	if (time_to_find < day_starts[0])
 		return -1;
 	if (time_to_find > day_starts[days_shown])
 		return days_shown;
 
-	for (day = 1; day <= days_shown; day++) {
-		if (time_to_find <= day_starts[day]) {
-			if (time_to_find == day_starts[day]
-			    && !include_midnight_in_prev_day)
-				return day;
-			return day - 1;
-		}
+	/* Binary search for the first day start not before the time;
+	 * it exists since the time is at most day_starts[days_shown]. */
+	low = 1;
+	high = days_shown;
+	while (low < high) {
+		day = (low + high) / 2;
+		if (day_starts[day] < time_to_find)
+			low = day + 1;
+		else
+			high = day;
 	}
 
-	g_return_val_if_reached (days_shown);
+	/* A time before day_starts[1] also ends up here, in day 0. */
+	day = low;
+	if (time_to_find == day_starts[day] && !include_midnight_in_prev_day)
+		return day;
+
+	return day - 1;
 }
 
 /* This returns the last possible day in the same span as the given day.
@@ -29,10 +29,14 @@
 
 #include "shell/e-shell.h"
 #include "calendar-config.h"
+#include "e-cal-instance-cache.h"
 #include "tag-calendar.h"
 
 struct calendar_tag_closure {
+	volatile gint ref_count;
+
 	ECalendarItem *calitem;
+	GCancellable *cancellable;
 	icaltimezone *zone;
 	time_t start_time;
 	time_t end_time;
@@ -41,6 +45,24 @@ struct calendar_tag_closure {
 	gboolean recur_events_italic;
 };
 
+static struct calendar_tag_closure *
+calendar_tag_closure_ref (struct calendar_tag_closure *closure)
+{
+	g_atomic_int_inc (&closure->ref_count);
+
+	return closure;
+}
+
+static void
+calendar_tag_closure_unref (struct calendar_tag_closure *closure)
+{
+	if (g_atomic_int_dec_and_test (&closure->ref_count)) {
+		if (closure->cancellable != NULL)
+			g_object_unref (closure->cancellable);
+		g_free (closure);
+	}
+}
+
 /* Clears all the tags in a calendar and fills a closure structure with the
  * necessary information for iterating over occurrences.  Returns FALSE if
  * the calendar has no dates shown.  */
@@ -127,6 +149,110 @@ tag_calendar_cb (ECalComponent *comp,
 	return TRUE;
 }
 
+/* Tags the one occurrence of a component which does not recur. */
+static void
+tag_calendar_single (ECalClient *client,
+                     icalcomponent *icalcomp,
+                     struct calendar_tag_closure *closure)
+{
+	ECalComponent *comp;
+
+	comp = e_cal_component_new_from_icalcomponent (
+		icalcomponent_new_clone (icalcomp));
+	if (comp == NULL)
+		return;
+
+	e_cal_recur_generate_instances (
+		comp, closure->start_time, closure->end_time,
+		(ECalRecurInstanceFn) tag_calendar_cb, closure,
+		e_cal_client_resolve_tzid_cb, client, closure->zone);
+
+	g_object_unref (comp);
+}
+
+static void
+tag_calendar_got_objects_cb (GObject *source_object,
+                             GAsyncResult *result,
+                             gpointer user_data)
+{
+	ECalClient *client = E_CAL_CLIENT (source_object);
+	struct calendar_tag_closure *closure = user_data;
+	GHashTable *masters;
+	GHashTable *detached;
+	GSList *icalcomps = NULL, *link;
+	GError *error = NULL;
+
+	e_cal_client_get_object_list_finish (
+		client, result, &icalcomps, &error);
+
+	if (error != NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning (
+				"%s: Failed to get objects: %s",
+				G_STRFUNC, error->message);
+		g_error_free (error);
+		calendar_tag_closure_unref (closure);
+		return;
+	}
+
+	/* UIDs of the recurring series in the list */
+	masters = g_hash_table_new (g_str_hash, g_str_equal);
+	/* UID -> GSList of the detached instances in the list */
+	detached = g_hash_table_new_full (
+		g_str_hash, g_str_equal,
+		(GDestroyNotify) NULL,
+		(GDestroyNotify) g_slist_free);
+
+	for (link = icalcomps; link != NULL; link = g_slist_next (link)) {
+		icalcomponent *icalcomp = link->data;
+		const gchar *uid = icalcomponent_get_uid (icalcomp);
+
+		if (uid == NULL)
+			continue;
+
+		if (e_cal_util_component_is_instance (icalcomp)) {
+			GSList *list;
+
+			list = g_hash_table_lookup (detached, uid);
+			g_hash_table_steal (detached, uid);
+			g_hash_table_insert (
+				detached, (gpointer) uid,
+				g_slist_prepend (list, icalcomp));
+		} else if (e_cal_util_component_has_recurrences (icalcomp)) {
+			g_hash_table_add (masters, (gpointer) uid);
+		}
+	}
+
+	for (link = icalcomps; link != NULL; link = g_slist_next (link)) {
+		icalcomponent *icalcomp = link->data;
+		const gchar *uid = icalcomponent_get_uid (icalcomp);
+
+		if (uid == NULL || !g_hash_table_contains (masters, uid)) {
+			tag_calendar_single (client, icalcomp, closure);
+			continue;
+		}
+
+		/* Detached instances are expanded with their series. */
+		if (e_cal_util_component_is_instance (icalcomp))
+			continue;
+
+		e_cal_instance_cache_generate (
+			client, icalcomp,
+			g_hash_table_lookup (detached, uid),
+			closure->start_time, closure->end_time,
+			closure->cancellable,
+			(ECalRecurInstanceFn) tag_calendar_cb,
+			calendar_tag_closure_ref (closure),
+			(GDestroyNotify) calendar_tag_closure_unref);
+	}
+
+	g_hash_table_destroy (detached);
+	g_hash_table_destroy (masters);
+	e_cal_client_free_icalcomp_slist (icalcomps);
+
+	calendar_tag_closure_unref (closure);
+}
+
 /**
  * tag_calendar_by_client:
  * @ecal: Calendar widget to tag.
@@ -143,6 +269,8 @@ tag_calendar_by_client (ECalendar *ecal,
 {
 	GSettings *settings;
 	struct calendar_tag_closure *closure;
+	gchar *iso_start, *iso_end;
+	gchar *sexp;
 
 	g_return_if_fail (E_IS_CALENDAR (ecal));
 	g_return_if_fail (E_IS_CAL_CLIENT (client));
@@ -166,10 +294,26 @@ tag_calendar_by_client (ECalendar *ecal,
 
 	g_object_unref (settings);
 
-	e_cal_client_generate_instances (
-		client, closure->start_time, closure->end_time, cancellable,
-		(ECalRecurInstanceFn) tag_calendar_cb,
-		closure, (GDestroyNotify) g_free);
+	closure->ref_count = 1;
+	if (cancellable != NULL)
+		closure->cancellable = g_object_ref (cancellable);
+
+	iso_start = isodate_from_time_t (closure->start_time);
+	iso_end = isodate_from_time_t (closure->end_time);
+
+	sexp = g_strdup_printf (
+		"(occur-in-time-range? (make-time \"%s\") (make-time \"%s\"))",
+		iso_start, iso_end);
+
+	/* Expand the matching objects one by one, so that the
+	 * instances of unchanged series come from the cache. */
+	e_cal_client_get_object_list (
+		client, sexp, cancellable,
+		tag_calendar_got_objects_cb, closure);
+
+	g_free (sexp);
+	g_free (iso_start);
+	g_free (iso_end);
 }
 
 /* Resolves TZIDs for the recurrence generator, for when the comp is not on
@@ -254,12 +398,14 @@ tag_calendar_by_comp (ECalendar *ecal,
 		alloced_closure = g_new0 (struct calendar_tag_closure, 1);
 
 		*alloced_closure = closure;
+		alloced_closure->ref_count = 1;
+		alloced_closure->cancellable = NULL;
 
 		e_cal_client_generate_instances_for_object (
 			client, e_cal_component_get_icalcomponent (comp),
 			closure.start_time, closure.end_time, cancellable,
-			(ECalRecurInstanceFn) tag_calendar_cb,
-			alloced_closure, (GDestroyNotify) g_free);
+			(ECalRecurInstanceFn) tag_calendar_cb, alloced_closure,
+			(GDestroyNotify) calendar_tag_closure_unref);
 	} else
 		e_cal_recur_generate_instances (
 			comp, closure.start_time, closure.end_time,
@@ -0,0 +1,586 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * test-event-layout - compares the day and week view layouts with the
+ * straightforward grid search they replaced, on random dense days.
+ * Run with --benchmark to also time both day view layouts.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "e-day-view-layout.h"
+#include "e-week-view-layout.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+#define FIRST_DAY ((time_t) 1400000000 - 1400000000 % DAY_SECONDS)
+
+/* Columns of the reference grid, more than any test day needs. */
+#define REF_MAX_COLS 256
+
+static gint n_failures;
+
+static void
+check (gboolean condition,
+       const gchar *what,
+       guint32 seed)
+{
+	if (!condition) {
+		g_printerr ("FAIL: %s (seed %u)\n", what, seed);
+		n_failures++;
+	}
+}
+
+static gint
+event_sort_func (gconstpointer arg1,
+                 gconstpointer arg2)
+{
+	const ECalendarViewEvent *event1 = arg1;
+	const ECalendarViewEvent *event2 = arg2;
+
+	/* The same order as EDayView and EWeekView sort events in. */
+	if (event1->start < event2->start)
+		return -1;
+	if (event1->start > event2->start)
+		return 1;
+
+	if (event1->end > event2->end)
+		return -1;
+	if (event1->end < event2->end)
+		return 1;
+
+	return 0;
+}
+
+/* The day view layout before the sweep, with one byte per cell. */
+static gint
+ref_layout_day_events (GArray *events,
+                       gint rows,
+                       gint mins_per_row,
+                       guint8 *cols_per_row,
+                       gint max_cols)
+{
+	guint16 group_starts[12 * 24];
+	guint8 *grid;
+	gint row, col, event_num, res = 0;
+
+	grid = g_new0 (guint8, rows * REF_MAX_COLS);
+
+	for (row = 0; row < rows; row++) {
+		cols_per_row[row] = 0;
+		group_starts[row] = row;
+	}
+
+	for (event_num = 0; event_num < events->len; event_num++) {
+		EDayViewEvent *event;
+		gint start_row, end_row, free_col = -1, group_start;
+
+		event = &g_array_index (events, EDayViewEvent, event_num);
+
+		start_row = event->start_minute / mins_per_row;
+		end_row = (event->end_minute - 1) / mins_per_row;
+		if (end_row < start_row)
+			end_row = start_row;
+
+		event->num_columns = 0;
+
+		if (start_row >= rows || end_row < 0)
+			continue;
+
+		start_row = CLAMP (start_row, 0, rows - 1);
+		end_row = CLAMP (end_row, 0, rows - 1);
+
+		for (col = 0; (max_cols <= 0 || col < max_cols) && col < REF_MAX_COLS; col++) {
+			free_col = col;
+			for (row = start_row; row <= end_row; row++) {
+				if (grid[row * REF_MAX_COLS + col]) {
+					free_col = -1;
+					break;
+				}
+			}
+
+			if (free_col != -1)
+				break;
+		}
+
+		if (free_col == -1)
+			continue;
+
+		event->start_row_or_col = free_col;
+		event->num_columns = 1;
+		res = MAX (res, free_col + 1);
+
+		group_start = group_starts[start_row];
+		for (row = start_row; row <= end_row; row++) {
+			grid[row * REF_MAX_COLS + free_col] = 1;
+			cols_per_row[row]++;
+			group_starts[row] = group_start;
+		}
+
+		for (row = end_row + 1; row < rows; row++) {
+			if (group_starts[row] > end_row)
+				break;
+			group_starts[row] = group_start;
+		}
+	}
+
+	/* Every row of a group gets the column count of its fullest row. */
+	row = 0;
+	while (row < rows) {
+		gint start_row = row, max_events = 0;
+
+		for (; row < rows && group_starts[row] == start_row; row++)
+			max_events = MAX (max_events, cols_per_row[row]);
+
+		for (col = start_row; col < row; col++)
+			cols_per_row[col] = max_events;
+	}
+
+	/* Expand the events over the free columns to their right.  Events
+	 * which did not fit are skipped; the original expanded them from
+	 * whatever column they had before, which the sweep fixed. */
+	for (event_num = 0; event_num < events->len; event_num++) {
+		EDayViewEvent *event;
+		gint start_row, end_row;
+		gboolean clashed = FALSE;
+
+		event = &g_array_index (events, EDayViewEvent, event_num);
+		if (event->num_columns == 0)
+			continue;
+
+		start_row = event->start_minute / mins_per_row;
+		end_row = (event->end_minute - 1) / mins_per_row;
+		if (end_row < start_row)
+			end_row = start_row;
+		start_row = CLAMP (start_row, 0, rows - 1);
+		end_row = CLAMP (end_row, 0, rows - 1);
+
+		for (col = event->start_row_or_col + 1; col < cols_per_row[start_row]; col++) {
+			for (row = start_row; row <= end_row; row++) {
+				if (grid[row * REF_MAX_COLS + col]) {
+					clashed = TRUE;
+					break;
+				}
+			}
+
+			if (clashed)
+				break;
+
+			event->num_columns++;
+		}
+	}
+
+	g_free (grid);
+
+	return res;
+}
+
+/* The long event layout before the sweep. */
+static void
+ref_layout_long_events (GArray *events,
+                        gint days_shown,
+                        time_t *day_starts,
+                        gint *rows_in_top_display)
+{
+	guint8 *grid;
+	gint event_num;
+
+	grid = g_new0 (guint8, (events->len + 1) * E_DAY_VIEW_MAX_DAYS);
+
+	*rows_in_top_display = 0;
+
+	for (event_num = 0; event_num < events->len; event_num++) {
+		EDayViewEvent *event;
+		gint start_day, end_day, free_row, row, day;
+
+		event = &g_array_index (events, EDayViewEvent, event_num);
+		event->num_columns = 0;
+
+		if (!e_day_view_find_long_event_days (
+			event, days_shown, day_starts, &start_day, &end_day))
+			continue;
+
+		row = 0;
+		do {
+			free_row = row;
+			for (day = start_day; day <= end_day; day++) {
+				if (grid[row * E_DAY_VIEW_MAX_DAYS + day]) {
+					free_row = -1;
+					break;
+				}
+			}
+			row++;
+		} while (free_row == -1);
+
+		event->start_row_or_col = free_row;
+		event->num_columns = 1;
+
+		for (day = start_day; day <= end_day; day++)
+			grid[free_row * E_DAY_VIEW_MAX_DAYS + day] = 1;
+
+		*rows_in_top_display = MAX (*rows_in_top_display, free_row + 1);
+	}
+
+	g_free (grid);
+}
+
+/* A day with n_events events, many of them overlapping. */
+static GArray *
+new_dense_day (GRand *rand,
+               gint n_events)
+{
+	GArray *events;
+	gint ii;
+
+	events = g_array_new (FALSE, TRUE, sizeof (EDayViewEvent));
+
+	for (ii = 0; ii < n_events; ii++) {
+		EDayViewEvent event;
+		gint start, length;
+
+		memset (&event, 0, sizeof (event));
+
+		/* Crowd the events into the working hours. */
+		start = g_rand_int_range (rand, 8 * 60, 18 * 60);
+		if (g_rand_boolean (rand))
+			length = 5 * g_rand_int_range (rand, 0, 13);
+		else
+			length = 5 * g_rand_int_range (rand, 6, 73);
+
+		event.start_minute = start;
+		event.end_minute = MIN (start + length, 24 * 60);
+		event.start = FIRST_DAY + event.start_minute * 60;
+		event.end = FIRST_DAY + event.end_minute * 60;
+
+		g_array_append_val (events, event);
+	}
+
+	g_array_sort (events, event_sort_func);
+
+	return events;
+}
+
+static void
+test_day_events (guint32 seed)
+{
+	static const gint mins_per_row[] = { 5, 10, 15, 30, 60 };
+	static const gint max_cols[] = { -1, E_DAY_VIEW_MULTI_DAY_MAX_COLUMNS };
+	GRand *rand;
+	GArray *events, *ref_events;
+	guint8 cols_per_row[12 * 24], ref_cols_per_row[12 * 24];
+	gint ii, jj, rows, res, ref_res, n_events;
+	guint kk;
+
+	rand = g_rand_new_with_seed (seed);
+	n_events = g_rand_int_range (rand, 1, 200);
+	events = new_dense_day (rand, n_events);
+	g_rand_free (rand);
+
+	for (ii = 0; ii < G_N_ELEMENTS (mins_per_row); ii++) {
+		for (jj = 0; jj < G_N_ELEMENTS (max_cols); jj++) {
+			rows = 24 * 60 / mins_per_row[ii];
+
+			ref_events = g_array_sized_new (FALSE, FALSE, sizeof (EDayViewEvent), events->len);
+			g_array_append_vals (ref_events, events->data, events->len);
+
+			res = e_day_view_layout_day_events (
+				events, rows, mins_per_row[ii],
+				cols_per_row, max_cols[jj]);
+			ref_res = ref_layout_day_events (
+				ref_events, rows, mins_per_row[ii],
+				ref_cols_per_row, max_cols[jj]);
+
+			check (res == ref_res, "day events: column count", seed);
+			check (
+				memcmp (cols_per_row, ref_cols_per_row, rows) == 0,
+				"day events: columns per row", seed);
+
+			for (kk = 0; kk < events->len; kk++) {
+				EDayViewEvent *event, *ref_event;
+
+				event = &g_array_index (events, EDayViewEvent, kk);
+				ref_event = &g_array_index (ref_events, EDayViewEvent, kk);
+
+				check (
+					event->num_columns == ref_event->num_columns,
+					"day events: event width", seed);
+				check (
+					event->num_columns == 0 ||
+					event->start_row_or_col == ref_event->start_row_or_col,
+					"day events: event column", seed);
+			}
+
+			g_array_free (ref_events, TRUE);
+		}
+	}
+
+	g_array_free (events, TRUE);
+}
+
+static void
+test_long_events (guint32 seed)
+{
+	GRand *rand;
+	GArray *events, *ref_events;
+	time_t day_starts[E_DAY_VIEW_MAX_DAYS + 1];
+	gint ii, n_events, rows, ref_rows;
+	guint kk;
+
+	for (ii = 0; ii <= E_DAY_VIEW_MAX_DAYS; ii++)
+		day_starts[ii] = FIRST_DAY + ii * DAY_SECONDS;
+
+	rand = g_rand_new_with_seed (seed);
+	n_events = g_rand_int_range (rand, 1, 100);
+
+	events = g_array_new (FALSE, TRUE, sizeof (EDayViewEvent));
+	for (ii = 0; ii < n_events; ii++) {
+		EDayViewEvent event;
+		gint start_day, n_days;
+
+		memset (&event, 0, sizeof (event));
+
+		start_day = g_rand_int_range (rand, 0, E_DAY_VIEW_MAX_DAYS);
+		n_days = g_rand_int_range (rand, 1, E_DAY_VIEW_MAX_DAYS - start_day + 1);
+
+		event.start = day_starts[start_day];
+		event.end = day_starts[start_day + n_days];
+
+		g_array_append_val (events, event);
+	}
+	g_rand_free (rand);
+
+	g_array_sort (events, event_sort_func);
+
+	ref_events = g_array_sized_new (FALSE, FALSE, sizeof (EDayViewEvent), events->len);
+	g_array_append_vals (ref_events, events->data, events->len);
+
+	e_day_view_layout_long_events (
+		events, E_DAY_VIEW_MAX_DAYS, day_starts, &rows);
+	ref_layout_long_events (
+		ref_events, E_DAY_VIEW_MAX_DAYS, day_starts, &ref_rows);
+
+	check (rows == ref_rows, "long events: row count", seed);
+
+	for (kk = 0; kk < events->len; kk++) {
+		EDayViewEvent *event, *ref_event;
+
+		event = &g_array_index (events, EDayViewEvent, kk);
+		ref_event = &g_array_index (ref_events, EDayViewEvent, kk);
+
+		check (
+			event->num_columns == ref_event->num_columns &&
+			event->start_row_or_col == ref_event->start_row_or_col,
+			"long events: event row", seed);
+	}
+
+	g_array_free (ref_events, TRUE);
+	g_array_free (events, TRUE);
+}
+
+/* The day lookup before the binary search. */
+static gint
+ref_find_day (time_t time_to_find,
+              gboolean include_midnight_in_prev_day,
+              gint days_shown,
+              time_t *day_starts)
+{
+	gint day;
+
+	if (time_to_find < day_starts[0])
+		return -1;
+	if (time_to_find > day_starts[days_shown])
+		return days_shown;
+
+	for (day = 1; day <= days_shown; day++) {
+		if (time_to_find <= day_starts[day]) {
+			if (time_to_find == day_starts[day]
+			    && !include_midnight_in_prev_day)
+				return day;
+			return day - 1;
+		}
+	}
+
+	return days_shown;
+}
+
+static void
+test_week_events (guint32 seed)
+{
+	const gint weeks_shown = 5;
+	const gint days_shown = 7 * 5;
+	GRand *rand;
+	GArray *events, *spans;
+	time_t day_starts[E_WEEK_VIEW_MAX_WEEKS * 7 + 1];
+	gint rows_per_day[E_WEEK_VIEW_MAX_WEEKS * 7];
+	gint ref_rows_per_day[E_WEEK_VIEW_MAX_WEEKS * 7];
+	guint8 *grid;
+	gint ii, n_events;
+	guint kk, span_num;
+
+	for (ii = 0; ii <= days_shown; ii++)
+		day_starts[ii] = FIRST_DAY + ii * DAY_SECONDS;
+
+	rand = g_rand_new_with_seed (seed);
+	n_events = g_rand_int_range (rand, 1, 120);
+
+	/* Mostly short events in the first week, to fill its rows. */
+	events = g_array_new (FALSE, TRUE, sizeof (EWeekViewEvent));
+	for (ii = 0; ii < n_events; ii++) {
+		EWeekViewEvent event;
+		gint start_day;
+
+		memset (&event, 0, sizeof (event));
+
+		if (g_rand_int_range (rand, 0, 4) == 0) {
+			start_day = g_rand_int_range (rand, 0, days_shown);
+			event.start = day_starts[start_day];
+			event.end = event.start + g_rand_int_range (
+				rand, 1, 10 * DAY_SECONDS);
+		} else {
+			start_day = g_rand_int_range (rand, 0, 7);
+			event.start = day_starts[start_day] +
+				60 * g_rand_int_range (rand, 0, 24 * 60);
+			event.end = event.start + 60 * g_rand_int_range (rand, 0, 4 * 60);
+		}
+
+		event.end = MIN (event.end, day_starts[days_shown]);
+		event.start = MIN (event.start, event.end);
+
+		g_array_append_val (events, event);
+	}
+	g_rand_free (rand);
+
+	g_array_sort (events, event_sort_func);
+
+	spans = e_week_view_layout_events (
+		events, NULL, TRUE, weeks_shown, FALSE,
+		G_DATE_MONDAY, day_starts, rows_per_day);
+
+	/* Placing the spans in order, each has to get the first row
+	 * which is free on all of its days. */
+	grid = g_new0 (guint8, days_shown * E_WEEK_VIEW_MAX_ROWS_PER_CELL);
+	memset (ref_rows_per_day, 0, sizeof (ref_rows_per_day));
+
+	for (kk = 0; kk < events->len; kk++) {
+		EWeekViewEvent *event;
+		gint start_day, end_day, last_day = -1;
+
+		event = &g_array_index (events, EWeekViewEvent, kk);
+
+		start_day = CLAMP (ref_find_day (event->start, FALSE, days_shown, day_starts), 0, days_shown - 1);
+		end_day = CLAMP (ref_find_day (event->end, TRUE, days_shown, day_starts), 0, days_shown - 1);
+
+		for (span_num = 0; span_num < event->num_spans; span_num++) {
+			EWeekViewEventSpan *span;
+			gint row, free_row = -1, day;
+
+			span = &g_array_index (spans, EWeekViewEventSpan, event->spans_index + span_num);
+
+			if (span_num == 0)
+				check (span->start_day == start_day, "week events: start day", seed);
+
+			for (row = 0; row < E_WEEK_VIEW_MAX_ROWS_PER_CELL && free_row == -1; row++) {
+				free_row = row;
+				for (day = span->start_day; day < span->start_day + span->num_days; day++) {
+					if (grid[day * E_WEEK_VIEW_MAX_ROWS_PER_CELL + row]) {
+						free_row = -1;
+						break;
+					}
+				}
+			}
+
+			check (span->row == free_row, "week events: span row", seed);
+
+			for (day = span->start_day; day < span->start_day + span->num_days; day++) {
+				grid[day * E_WEEK_VIEW_MAX_ROWS_PER_CELL + span->row] = 1;
+				ref_rows_per_day[day] = MAX (ref_rows_per_day[day], span->row + 1);
+			}
+
+			last_day = span->start_day + span->num_days - 1;
+		}
+
+		check (last_day == -1 || last_day == end_day, "week events: end day", seed);
+	}
+
+	check (
+		memcmp (rows_per_day, ref_rows_per_day, days_shown * sizeof (gint)) == 0,
+		"week events: rows per day", seed);
+
+	g_free (grid);
+	g_array_free (spans, TRUE);
+	g_array_free (events, TRUE);
+}
+
+static void
+benchmark_day_events (void)
+{
+	GRand *rand;
+	GArray *events;
+	GTimer *timer;
+	guint8 cols_per_row[12 * 24];
+	gdouble elapsed, ref_elapsed;
+	gint ii;
+
+	rand = g_rand_new_with_seed (1);
+	events = new_dense_day (rand, 250);
+	g_rand_free (rand);
+
+	timer = g_timer_new ();
+
+	for (ii = 0; ii < 1000; ii++)
+		e_day_view_layout_day_events (events, 12 * 24, 5, cols_per_row, -1);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	for (ii = 0; ii < 1000; ii++)
+		ref_layout_day_events (events, 12 * 24, 5, cols_per_row, -1);
+	ref_elapsed = g_timer_elapsed (timer, NULL);
+
+	g_print (
+		"1000 layouts of 250 events: %.3f s, grid search %.3f s\n",
+		elapsed, ref_elapsed);
+
+	g_timer_destroy (timer);
+	g_array_free (events, TRUE);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	guint32 seed;
+
+	for (seed = 1; seed <= 500; seed++) {
+		test_day_events (seed);
+		test_long_events (seed);
+		test_week_events (seed);
+	}
+
+	if (argc > 1 && g_strcmp0 (argv[1], "--benchmark") == 0)
+		benchmark_day_events ();
+
+	if (n_failures > 0) {
+		g_printerr ("%d checks failed\n", n_failures);
+		return 1;
+	}
+
+	g_print ("PASS\n");
+
+	return 0;
+}
@@ -20,6 +20,8 @@
 #include <config.h>
 #include <glib/gi18n-lib.h>
 
+#include "e-misc-utils.h"
+
 #define E_BOOK_SOURCE_CONFIG_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), E_TYPE_BOOK_SOURCE_CONFIG, EBookSourceConfigPrivate))
@@ -225,6 +227,9 @@ e_book_source_config_class_init (EBookSourceConfigClass *class)
 
 	g_type_class_add_private (class, sizeof (EBookSourceConfigPrivate));
 
+	/* Load the modules extending us before anything looks for them. */
+	e_util_prepare_extension_point (G_TYPE_FROM_CLASS (class));
+
 	object_class = G_OBJECT_CLASS (class);
 	object_class->dispose = book_source_config_dispose;
 	object_class->constructed = book_source_config_constructed;
@@ -327,6 +327,9 @@ e_cal_source_config_class_init (ECalSourceConfigClass *class)
 
 	g_type_class_add_private (class, sizeof (ECalSourceConfigPrivate));
 
+	/* Load the modules extending us before anything looks for them. */
+	e_util_prepare_extension_point (G_TYPE_FROM_CLASS (class));
+
 	object_class = G_OBJECT_CLASS (class);
 	object_class->set_property = cal_source_config_set_property;
 	object_class->get_property = cal_source_config_get_property;
@@ -54,6 +54,7 @@
 #include "e-text-event-processor-emacs-like.h"
 #include "e-text-event-processor.h"
 #include "e-text.h"
+#include "e-trace.h"
 #include "e-unicode.h"
 
 #define d(x)
@@ -108,6 +109,16 @@ G_DEFINE_TYPE (ECellText, e_cell_text, E_TYPE_CELL)
 
 #define TEXT_PAD 4
 
+/* Number of laid out cells kept per view. */
+#define LAYOUT_CACHE_SIZE 512
+
+/* How many lookups pass between samples of the hit and miss counters. */
+#define LAYOUT_CACHE_SAMPLE_INTERVAL 1024
+
+#define ATTR_BOLD      (1 << 0)
+#define ATTR_STRIKEOUT (1 << 1)
+#define ATTR_UNDERLINE (1 << 2)
+
 typedef struct {
 	gpointer lines;			/* Text split into lines (private field) */
 	gint num_lines;			/* Number of lines of text */
@@ -131,8 +142,27 @@ typedef struct {
 	gint xofs, yofs;                 /* This gets added to the x
                                            and y for the cell text. */
 	gdouble ellipsis_width[2];      /* The width of the ellipsis. */
+
+	/*
+	 * Layouts of cells not being edited, keyed by text, width,
+	 * font and attributes; most recently used at the head.
+	 */
+	GHashTable *layout_cache;
+	GQueue layout_lru;
+	guint layout_hits, layout_misses;
+
+	/* The widget font with ECellText:font_name applied, and
+	 * what it was built from. */
+	PangoFontDescription *font_desc;
+	guint font_desc_hash;
+	gchar *font_desc_name;
 } ECellTextView;
 
+typedef struct {
+	gchar *key;
+	PangoLayout *layout;
+} CachedLayout;
+
 struct _CellEdit {
 
 	ECellTextView *text_view;
@@ -205,6 +235,8 @@ static void _insert (ECellTextView *text_view, const gchar *string, gint value);
 static void _delete_selection (ECellTextView *text_view);
 static PangoAttrList * build_attr_list (ECellTextView *text_view, gint row, gint text_length);
 static void update_im_cursor_location (ECellTextView *tv);
+static void layout_cache_clear (ECellTextView *text_view);
+static void layout_cache_sample (ECellTextView *text_view);
 
 static gchar *
 ect_real_get_text (ECellText *cell,
@@ -346,6 +378,16 @@ ect_new_view (ECell *ecell,
 	text_view->xofs = 0.0;
 	text_view->yofs = 0.0;
 
+	text_view->layout_cache = g_hash_table_new (g_str_hash, g_str_equal);
+	g_queue_init (&text_view->layout_lru);
+
+	/* Cached layouts are keyed by content and do not go stale
+	 * on row or cell changes; drop them when the whole model
+	 * changes so they do not outlive the data. */
+	g_signal_connect_swapped (
+		table_model, "model_changed",
+		G_CALLBACK (layout_cache_clear), text_view);
+
 	return (ECellView *) text_view;
 }
 
@@ -363,6 +405,22 @@ ect_kill_view (ECellView *ecv)
 	if (text_view->cell_view.kill_view_cb_data)
 	    g_list_free (text_view->cell_view.kill_view_cb_data);
 
+	g_signal_handlers_disconnect_matched (
+		text_view->cell_view.e_table_model, G_SIGNAL_MATCH_DATA,
+		0, 0, NULL, NULL, text_view);
+
+	d (g_print (
+		"%s: layout cache %u hits, %u misses\n", G_STRFUNC,
+		text_view->layout_hits, text_view->layout_misses));
+	layout_cache_sample (text_view);
+
+	layout_cache_clear (text_view);
+	g_hash_table_destroy (text_view->layout_cache);
+
+	if (text_view->font_desc)
+		pango_font_description_free (text_view->font_desc);
+	g_free (text_view->font_desc_name);
+
 	g_free (text_view);
 }
 
@@ -392,6 +450,9 @@ ect_unrealize (ECellView *ecv)
 		ect_cancel_edit (text_view);
 	}
 
+	/* The layouts belong to the canvas' Pango context. */
+	layout_cache_clear (text_view);
+
 	g_object_unref (text_view->i_cursor);
 
 	if (E_CELL_CLASS (e_cell_text_parent_class)->unrealize)
@@ -399,26 +460,40 @@ ect_unrealize (ECellView *ecv)
 
 }
 
-static PangoAttrList *
-build_attr_list (ECellTextView *text_view,
-                 gint row,
-                 gint text_length)
+static guint
+get_attr_flags (ECellTextView *text_view,
+                gint row)
 {
-
 	ECellView *ecell_view = (ECellView *) text_view;
 	ECellText *ect = E_CELL_TEXT (ecell_view->ecell);
+	guint flags = 0;
+
+	if (row < 0)
+		return 0;
+
+	if (ect->bold_column >= 0 &&
+	    e_table_model_value_at (ecell_view->e_table_model, ect->bold_column, row))
+		flags |= ATTR_BOLD;
+	if (ect->strikeout_column >= 0 &&
+	    e_table_model_value_at (ecell_view->e_table_model, ect->strikeout_column, row))
+		flags |= ATTR_STRIKEOUT;
+	if (ect->underline_column >= 0 &&
+	    e_table_model_value_at (ecell_view->e_table_model, ect->underline_column, row))
+		flags |= ATTR_UNDERLINE;
+
+	return flags;
+}
+
+static PangoAttrList *
+build_attr_list_with_flags (guint flags,
+                            gint text_length)
+{
 	PangoAttrList *attrs = pango_attr_list_new ();
 	gboolean bold, strikeout, underline;
 
-	bold = ect->bold_column >= 0 &&
-		row >= 0 &&
-		e_table_model_value_at (ecell_view->e_table_model, ect->bold_column, row);
-	strikeout = ect->strikeout_column >= 0 &&
-		row >= 0 &&
-		e_table_model_value_at (ecell_view->e_table_model, ect->strikeout_column, row);
-	underline = ect->underline_column >= 0 &&
-		row >= 0 &&
-		e_table_model_value_at (ecell_view->e_table_model, ect->underline_column, row);
+	bold = (flags & ATTR_BOLD) != 0;
+	strikeout = (flags & ATTR_STRIKEOUT) != 0;
+	underline = (flags & ATTR_UNDERLINE) != 0;
 
 	if (bold || strikeout || underline) {
 		if (bold) {
@@ -446,6 +521,15 @@ build_attr_list (ECellTextView *text_view,
 	return attrs;
 }
 
+static PangoAttrList *
+build_attr_list (ECellTextView *text_view,
+                 gint row,
+                 gint text_length)
+{
+	return build_attr_list_with_flags (
+		get_attr_flags (text_view, row), text_length);
+}
+
 static PangoLayout *
 layout_with_preedit (ECellTextView *text_view,
                      gint row,
@@ -511,11 +595,65 @@ layout_with_preedit (ECellTextView *text_view,
 	return layout;
 }
 
+/* Returns the widget font with ECellText:font_name applied, parsing
+ * the font name again only when it or the widget font has changed. */
+static const PangoFontDescription *
+get_font_desc (ECellTextView *text_view,
+               guint widget_font_hash)
+{
+	ECellView *ecell_view = (ECellView *) text_view;
+	ECellText *ect = E_CELL_TEXT (ecell_view->ecell);
+	PangoFontDescription *desc = NULL, *fixed_desc = NULL;
+	gchar *fixed_family = NULL;
+	gint fixed_size = 0;
+	gboolean fixed_points = TRUE;
+
+	if (text_view->font_desc && text_view->font_desc_hash == widget_font_hash &&
+	    g_strcmp0 (text_view->font_desc_name, ect->font_name) == 0)
+		return text_view->font_desc;
+
+	fixed_desc = pango_font_description_from_string (ect->font_name);
+	if (fixed_desc) {
+		fixed_family = (gchar *) pango_font_description_get_family (fixed_desc);
+		fixed_size = pango_font_description_get_size (fixed_desc);
+		fixed_points = !pango_font_description_get_size_is_absolute (fixed_desc);
+	}
+
+	desc = pango_font_description_copy (gtk_widget_get_style (GTK_WIDGET (((GnomeCanvasItem *) ecell_view->e_table_item_view)->canvas))->font_desc);
+	pango_font_description_set_family (desc, fixed_family);
+	if (fixed_points)
+		pango_font_description_set_size (desc, fixed_size);
+	else
+		pango_font_description_set_absolute_size (desc, fixed_size);
+/*	pango_font_description_set_style (desc, PANGO_STYLE_OBLIQUE); */
+	pango_font_description_free (fixed_desc);
+
+	if (text_view->font_desc)
+		pango_font_description_free (text_view->font_desc);
+	text_view->font_desc = desc;
+	text_view->font_desc_hash = widget_font_hash;
+	g_free (text_view->font_desc_name);
+	text_view->font_desc_name = g_strdup (ect->font_name);
+
+	return desc;
+}
+
+static guint
+get_widget_font_hash (ECellTextView *text_view)
+{
+	GtkStyle *style;
+
+	style = gtk_widget_get_style (GTK_WIDGET (text_view->canvas));
+
+	return pango_font_description_hash (style->font_desc);
+}
+
 static PangoLayout *
-build_layout (ECellTextView *text_view,
-              gint row,
-              const gchar *text,
-              gint width)
+build_layout_with_flags (ECellTextView *text_view,
+                         guint attr_flags,
+                         guint widget_font_hash,
+                         const gchar *text,
+                         gint width)
 {
 	ECellView *ecell_view = (ECellView *) text_view;
 	ECellText *ect = E_CELL_TEXT (ecell_view->ecell);
@@ -524,7 +662,7 @@ build_layout (ECellTextView *text_view,
 
 	layout = gtk_widget_create_pango_layout (GTK_WIDGET (((GnomeCanvasItem *) ecell_view->e_table_item_view)->canvas), text);
 
-	attrs = (PangoAttrList *) build_attr_list (text_view, row, text ? strlen (text) : 0);
+	attrs = build_attr_list_with_flags (attr_flags, text ? strlen (text) : 0);
 
 	pango_layout_set_attributes (layout, attrs);
 	pango_attr_list_unref (attrs);
@@ -533,30 +671,8 @@ build_layout (ECellTextView *text_view,
 		return layout;
 
 	if (ect->font_name)
-	{
-		PangoFontDescription *desc = NULL, *fixed_desc = NULL;
-		gchar *fixed_family = NULL;
-		gint fixed_size = 0;
-		gboolean fixed_points = TRUE;
-
-		fixed_desc = pango_font_description_from_string (ect->font_name);
-		if (fixed_desc) {
-			fixed_family = (gchar *) pango_font_description_get_family (fixed_desc);
-			fixed_size = pango_font_description_get_size (fixed_desc);
-			fixed_points = !pango_font_description_get_size_is_absolute (fixed_desc);
-		}
-
-		desc = pango_font_description_copy (gtk_widget_get_style (GTK_WIDGET (((GnomeCanvasItem *) ecell_view->e_table_item_view)->canvas))->font_desc);
-		pango_font_description_set_family (desc, fixed_family);
-		if (fixed_points)
-			pango_font_description_set_size (desc, fixed_size);
-		else
-			pango_font_description_set_absolute_size (desc, fixed_size);
-/*		pango_font_description_set_style (desc, PANGO_STYLE_OBLIQUE); */
-		pango_layout_set_font_description (layout, desc);
-		pango_font_description_free (desc);
-		pango_font_description_free (fixed_desc);
-	}
+		pango_layout_set_font_description (
+			layout, get_font_desc (text_view, widget_font_hash));
 
 	pango_layout_set_width (layout, width * PANGO_SCALE);
 	pango_layout_set_wrap (layout, PANGO_WRAP_WORD_CHAR);
@@ -579,6 +695,120 @@ build_layout (ECellTextView *text_view,
 	return layout;
 }
 
+static PangoLayout *
+build_layout (ECellTextView *text_view,
+              gint row,
+              const gchar *text,
+              gint width)
+{
+	return build_layout_with_flags (
+		text_view, get_attr_flags (text_view, row),
+		get_widget_font_hash (text_view), text, width);
+}
+
+static void
+cached_layout_free (CachedLayout *cached)
+{
+	g_object_unref (cached->layout);
+	g_free (cached->key);
+	g_slice_free (CachedLayout, cached);
+}
+
+static void
+layout_cache_clear (ECellTextView *text_view)
+{
+	CachedLayout *cached;
+
+	g_hash_table_remove_all (text_view->layout_cache);
+
+	while ((cached = g_queue_pop_head (&text_view->layout_lru)) != NULL)
+		cached_layout_free (cached);
+}
+
+/* Records the hit and miss counts of the layout cache, so its size
+ * can be checked against real use with EVOLUTION_TRACE. */
+static void
+layout_cache_sample (ECellTextView *text_view)
+{
+	if (!e_trace_is_enabled ())
+		return;
+
+	e_trace_counter (
+		"e-cell-text", "layout-cache-hits",
+		text_view->layout_hits);
+	e_trace_counter (
+		"e-cell-text", "layout-cache-misses",
+		text_view->layout_misses);
+}
+
+/* Returns a new reference to a layout of @text, reusing one built
+ * earlier for the same text, width, font and attributes. */
+static PangoLayout *
+lookup_layout (ECellTextView *text_view,
+               gint row,
+               const gchar *text,
+               gint width)
+{
+	ECellText *ect = E_CELL_TEXT (((ECellView *) text_view)->ecell);
+	CachedLayout *cached;
+	GList *link;
+	guint attr_flags, font_hash;
+	gchar *key;
+
+	attr_flags = get_attr_flags (text_view, row);
+	font_hash = get_widget_font_hash (text_view);
+
+	/* Editing layouts are built differently and get modified. */
+	if (text_view->edit)
+		return build_layout_with_flags (
+			text_view, attr_flags, font_hash, text, width);
+
+	/* ECellText:font_name can be changed at any time, so it is part
+	 * of the key; font names have no newlines. */
+	key = g_strdup_printf (
+		"%d %x %u %s\n%s", MAX (width, 0), attr_flags, font_hash,
+		ect->font_name ? ect->font_name : "", text);
+
+	if ((text_view->layout_hits + text_view->layout_misses) %
+	    LAYOUT_CACHE_SAMPLE_INTERVAL == 0)
+		layout_cache_sample (text_view);
+
+	link = g_hash_table_lookup (text_view->layout_cache, key);
+	if (link != NULL) {
+		text_view->layout_hits++;
+		g_free (key);
+
+		g_queue_unlink (&text_view->layout_lru, link);
+		g_queue_push_head_link (&text_view->layout_lru, link);
+
+		cached = link->data;
+
+		return g_object_ref (cached->layout);
+	}
+
+	text_view->layout_misses++;
+
+	cached = g_slice_new (CachedLayout);
+	cached->key = key;
+	cached->layout = build_layout_with_flags (
+		text_view, attr_flags, font_hash, text, width);
+
+	g_queue_push_head (&text_view->layout_lru, cached);
+	g_hash_table_insert (
+		text_view->layout_cache, key,
+		g_queue_peek_head_link (&text_view->layout_lru));
+
+	if (g_queue_get_length (&text_view->layout_lru) > LAYOUT_CACHE_SIZE) {
+		CachedLayout *oldest;
+
+		oldest = g_queue_pop_tail (&text_view->layout_lru);
+		g_hash_table_remove (text_view->layout_cache, oldest->key);
+		cached_layout_free (oldest);
+	}
+
+	return g_object_ref (cached->layout);
+}
+
 static PangoLayout *
 generate_layout (ECellTextView *text_view,
                  gint model_col,
@@ -598,10 +828,10 @@ generate_layout (ECellTextView *text_view,
 
 	if (row >= 0) {
 		gchar *temp = e_cell_text_get_text (ect, ecell_view->e_table_model, model_col, row);
-		layout = build_layout (text_view, row, temp ? temp : "?", width);
+		layout = lookup_layout (text_view, row, temp ? temp : "?", width);
 		e_cell_text_free_text (ect, temp);
 	} else
-		layout = build_layout (text_view, row, "Mumbo Jumbo", width);
+		layout = lookup_layout (text_view, row, "Mumbo Jumbo", width);
 
 	return layout;
 }
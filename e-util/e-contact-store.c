@@ -103,6 +103,11 @@ typedef struct
 
 	EBookClientView *client_view_pending;
 	GPtrArray *contacts_pending;
+
+	/* Views requested but not received yet, and whether the
+	 * view of the latest query reported all its matches. */
+	guint n_views_requested;
+	gboolean complete;
 }
 ContactSource;
 
@@ -657,6 +662,9 @@ view_complete (EContactStore *contact_store,
 
 	/* If current view finished, do nothing */
 	if (client_view == source->client_view) {
+		source->complete =
+			error == NULL && source->n_views_requested == 0 &&
+			source->client_view_pending == NULL;
 		stop_view (contact_store, source->client_view);
 		return;
 	}
@@ -710,6 +718,9 @@ view_complete (EContactStore *contact_store,
 	/* Free array of pending contacts (members have been either moved or unreffed) */
 	g_ptr_array_free (source->contacts_pending, TRUE);
 	source->contacts_pending = NULL;
+
+	/* Views stop at a result limit with an error. */
+	source->complete = error == NULL && source->n_views_requested == 0;
 }
 
 /* --------------------- *
@@ -839,6 +850,8 @@ clear_contact_source (EContactStore *contact_store,
 		source->client_view_pending = NULL;
 		source->contacts_pending = NULL;
 	}
+
+	source->complete = FALSE;
 }
 
 static void
@@ -866,6 +879,9 @@ client_view_ready_cb (GObject *source_object,
 
 		source = &g_array_index (contact_store->priv->contact_sources, ContactSource, source_idx);
 
+		if (source->n_views_requested > 0)
+			source->n_views_requested--;
+
 		if (source->client_view) {
 			if (source->client_view_pending) {
 				stop_view (contact_store, source->client_view_pending);
@@ -916,6 +932,9 @@ query_contact_source (EContactStore *contact_store,
 		}
 	}
 
+	source->n_views_requested++;
+	source->complete = FALSE;
+
 	query_str = e_book_query_to_string (contact_store->priv->query);
 	e_book_client_get_view (source->book_client, query_str, NULL, client_view_ready_cb, g_object_ref (contact_store));
 	g_free (query_str);
@@ -1164,6 +1183,41 @@ e_contact_store_peek_query (EContactStore *contact_store)
 	return contact_store->priv->query;
 }
 
+/**
+ * e_contact_store_is_complete:
+ * @contact_store: an #EContactStore
+ *
+ * Checks whether the books assigned to @contact_store have reported
+ * every contact matching the current query.  This is not the case while
+ * their views are still running, nor when a view stopped with an error,
+ * like books do which limit the number of results.
+ *
+ * Returns: Whether @contact_store holds all the matching contacts.
+ **/
+gboolean
+e_contact_store_is_complete (EContactStore *contact_store)
+{
+	GArray *array;
+	gint i;
+
+	g_return_val_if_fail (E_IS_CONTACT_STORE (contact_store), FALSE);
+
+	if (!contact_store->priv->query)
+		return FALSE;
+
+	array = contact_store->priv->contact_sources;
+
+	for (i = 0; i < array->len; i++) {
+		ContactSource *source;
+
+		source = &g_array_index (array, ContactSource, i);
+		if (!source->complete)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 /* ---------------- *
  * GtkTreeModel API *
  * ---------------- */
@@ -89,6 +89,7 @@ gboolean	e_contact_store_remove_client	(EContactStore *contact_store,
 void		e_contact_store_set_query	(EContactStore *contact_store,
 						 EBookQuery *book_query);
 EBookQuery *	e_contact_store_peek_query	(EContactStore *contact_store);
+gboolean	e_contact_store_is_complete	(EContactStore *contact_store);
 
 G_END_DECLS
 
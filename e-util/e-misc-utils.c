@@ -1957,6 +1957,41 @@ e_util_get_searchable_categories (void)
 	return g_list_reverse (res);
 }
 
+static EExtensionPointFunc extension_point_func;
+static gpointer extension_point_data;
+
+/**
+ * e_util_set_extension_point_func:
+ * @func: an #EExtensionPointFunc, or %NULL
+ * @user_data: data to pass to @func
+ *
+ * Sets the function called by e_util_prepare_extension_point().  The
+ * shell uses it to load the modules it has deferred which extend the
+ * given type.  Pass %NULL to unset it.
+ **/
+void
+e_util_set_extension_point_func (EExtensionPointFunc func,
+                                 gpointer user_data)
+{
+	extension_point_func = func;
+	extension_point_data = user_data;
+}
+
+/**
+ * e_util_prepare_extension_point:
+ * @extensible_type: a #GType
+ *
+ * Makes sure the extensions of @extensible_type are available.  Classes
+ * which may be extended by modules should call this from their class or
+ * base initialization function, before they look for any extensions.
+ **/
+void
+e_util_prepare_extension_point (GType extensible_type)
+{
+	if (extension_point_func != NULL)
+		extension_point_func (extensible_type, extension_point_data);
+}
+
 /**
  * e_binding_transform_color_to_string:
  * @binding: a #GBinding
@@ -52,6 +52,9 @@ typedef enum {
 typedef void	(*EForeachFunc)			(gint model_row,
 						 gpointer closure);
 
+typedef void	(*EExtensionPointFunc)		(GType extensible_type,
+						 gpointer user_data);
+
 const gchar *	e_get_accels_filename		(void);
 void		e_show_uri			(GtkWindow *parent,
 						 const gchar *uri);
@@ -161,6 +164,9 @@ gchar *		e_util_guess_mime_type		(const gchar *filename,
 GSList *	e_util_get_category_filter_options
 						(void);
 GList *		e_util_get_searchable_categories (void);
+void		e_util_set_extension_point_func	(EExtensionPointFunc func,
+						 gpointer user_data);
+void		e_util_prepare_extension_point	(GType extensible_type);
 
 /* Useful GBinding transform functions */
 gboolean	e_binding_transform_color_to_string
@@ -61,6 +61,13 @@ struct _ENameSelectorEntryPrivate {
 	gboolean is_completing;
 	GSList *user_query_fields;
 
+	/* Cue of the query currently set on the contact store, and the
+	 * casefolded cue its results are being narrowed to locally, with
+	 * its comma form for multi-word cues (see name_style_query()). */
+	gchar *query_cue;
+	gchar *filter_cue;
+	gchar *filter_comma_cue;
+
 	/* For asynchronous operations. */
 	GQueue cancellables;
 };
@@ -211,6 +218,15 @@ name_selector_entry_dispose (GObject *object)
 	g_slist_free (priv->user_query_fields);
 	priv->user_query_fields = NULL;
 
+	g_free (priv->query_cue);
+	priv->query_cue = NULL;
+
+	g_free (priv->filter_cue);
+	priv->filter_cue = NULL;
+
+	g_free (priv->filter_comma_cue);
+	priv->filter_comma_cue = NULL;
+
 	/* Cancel any stuck book loading operations. */
 	while (!g_queue_is_empty (&priv->cancellables)) {
 		GCancellable *cancellable;
@@ -743,6 +759,244 @@ ens_util_populate_user_query_fields (GSList *user_query_fields,
 	return g_string_free (user_fields, !user_fields->str || !*user_fields->str);
 }
 
+static gchar *
+casefold_cue (const gchar *cue_str)
+{
+	gchar *sane;
+	gchar *folded;
+
+	sane = sanitize_string (cue_str);
+	g_strstrip (sane);
+	folded = g_utf8_casefold (sane, -1);
+	g_free (sane);
+
+	return folded;
+}
+
+/* Returns the "a, b" form name_style_query() also queries for a
+ * multi-word cue, or NULL for a single word. */
+static gchar *
+comma_cue (const gchar *folded_cue)
+{
+	gchar  **strv;
+	gchar   *comma_str = NULL;
+
+	strv = g_strsplit (folded_cue, " ", 0);
+
+	if (strv[0] && strv[1]) {
+		comma_str = g_strjoinv (", ", strv);
+		g_strstrip (comma_str);
+	}
+
+	g_strfreev (strv);
+
+	return comma_str;
+}
+
+/* Returns whether the casefolded @folded_cue is a prefix of @value,
+ * or of any word in @value when @word_starts is set.  This errs on
+ * the side of matching, since it only narrows what the backend query
+ * for a shorter cue already returned. */
+static gboolean
+value_has_cue_prefix (const gchar *value,
+                      const gchar *folded_cue,
+                      gboolean word_starts)
+{
+	gchar       *sane;
+	gchar       *folded;
+	const gchar *p;
+	gboolean     found = FALSE;
+
+	if (!value || !*value)
+		return FALSE;
+
+	sane = sanitize_string (value);
+	folded = g_utf8_casefold (sane, -1);
+	g_free (sane);
+
+	p = folded;
+	while (p && *p) {
+		while (*p == ' ')
+			p++;
+
+		if (g_str_has_prefix (p, folded_cue)) {
+			found = TRUE;
+			break;
+		}
+
+		if (!word_starts)
+			break;
+
+		p = strchr (p, ' ');
+	}
+
+	g_free (folded);
+
+	return found;
+}
+
+/* Whether the unmodified @value begins with @folded_prefix, ignoring
+ * case, as the "beginswith" of a backend query does. */
+static gboolean
+value_has_prefix (const gchar *value,
+                  const gchar *folded_prefix)
+{
+	gchar    *folded;
+	gboolean  found;
+
+	if (!value || !*value)
+		return FALSE;
+
+	folded = g_utf8_casefold (value, -1);
+	found = g_str_has_prefix (folded, folded_prefix);
+	g_free (folded);
+
+	return found;
+}
+
+static gboolean
+contact_matches_cue (EContact *contact,
+                     const gchar *folded_cue,
+                     const gchar *folded_comma_cue)
+{
+	EContactField  name_fields[] = { E_CONTACT_FULL_NAME, E_CONTACT_GIVEN_NAME,
+					 E_CONTACT_FAMILY_NAME, E_CONTACT_NICKNAME,
+					 E_CONTACT_FILE_AS };
+	GList         *email_list, *link;
+	gboolean       matches = FALSE;
+	gint           i;
+
+	for (i = 0; i < G_N_ELEMENTS (name_fields) && !matches; i++)
+		matches = value_has_cue_prefix (
+			e_contact_get_const (contact, name_fields[i]),
+			folded_cue, name_fields[i] != E_CONTACT_NICKNAME);
+
+	/* The query also has "a, b" for the full_name and file_as. */
+	if (!matches && folded_comma_cue)
+		matches = value_has_prefix (
+			e_contact_get_const (contact, E_CONTACT_FULL_NAME),
+			folded_comma_cue) || value_has_prefix (
+			e_contact_get_const (contact, E_CONTACT_FILE_AS),
+			folded_comma_cue);
+
+	if (matches)
+		return TRUE;
+
+	email_list = e_contact_get (contact, E_CONTACT_EMAIL);
+	for (link = email_list; link && !matches; link = g_list_next (link))
+		matches = value_has_cue_prefix (link->data, folded_cue, FALSE);
+	deep_free_list (email_list);
+
+	return matches;
+}
+
+static gboolean
+contact_matches_filter_cue (ENameSelectorEntry *name_selector_entry,
+                            EContact *contact)
+{
+	ENameSelectorEntryPrivate *priv = name_selector_entry->priv;
+
+	if (!priv->filter_cue)
+		return TRUE;
+
+	return contact_matches_cue (
+		contact, priv->filter_cue, priv->filter_comma_cue);
+}
+
+static void
+reset_completion_cue (ENameSelectorEntry *name_selector_entry)
+{
+	ENameSelectorEntryPrivate *priv = name_selector_entry->priv;
+
+	/* Only called when the store's rows are about to be replaced,
+	 * so there is nothing to refilter. */
+	g_free (priv->query_cue);
+	priv->query_cue = NULL;
+
+	g_free (priv->filter_cue);
+	priv->filter_cue = NULL;
+
+	g_free (priv->filter_comma_cue);
+	priv->filter_comma_cue = NULL;
+}
+
+/* Whether all books of @contact_store are on this machine.  Their
+ * backend never limits the number of results. */
+static gboolean
+completion_books_are_local (EContactStore *contact_store)
+{
+	GSList *clients, *link;
+	gboolean local = TRUE;
+
+	clients = e_contact_store_get_clients (contact_store);
+
+	for (link = clients; link != NULL && local; link = g_slist_next (link)) {
+		ESource *source;
+		ESourceBackend *extension;
+
+		source = e_client_get_source (E_CLIENT (link->data));
+
+		if (!e_source_has_extension (source, E_SOURCE_EXTENSION_ADDRESS_BOOK)) {
+			local = FALSE;
+			continue;
+		}
+
+		extension = e_source_get_extension (
+			source, E_SOURCE_EXTENSION_ADDRESS_BOOK);
+		local = g_strcmp0 (
+			e_source_backend_get_backend_name (extension),
+			"local") == 0;
+	}
+
+	g_slist_free (clients);
+
+	return local;
+}
+
+/* When @cue_str only extends the cue of the query already running on
+ * the contact store, every new match is among its results; filter those
+ * locally rather than replacing the book views with a new query.  That
+ * does not hold for books which cut the results off at a limit, like
+ * LDAP ones do, unless they reported all matches. */
+static gboolean
+narrow_completion_query (ENameSelectorEntry *name_selector_entry,
+                         const gchar *cue_str)
+{
+	ENameSelectorEntryPrivate *priv = name_selector_entry->priv;
+	gchar *folded_cue;
+
+	/* User query fields may use exact matches, which do not narrow. */
+	if (!priv->query_cue || priv->user_query_fields)
+		return FALSE;
+
+	if (!e_contact_store_is_complete (priv->contact_store) &&
+	    !completion_books_are_local (priv->contact_store))
+		return FALSE;
+
+	folded_cue = casefold_cue (cue_str);
+
+	if (!*folded_cue || !g_str_has_prefix (folded_cue, priv->query_cue)) {
+		g_free (folded_cue);
+		return FALSE;
+	}
+
+	if (g_strcmp0 (folded_cue, priv->filter_cue) == 0) {
+		g_free (folded_cue);
+		return TRUE;
+	}
+
+	g_free (priv->filter_cue);
+	priv->filter_cue = folded_cue;
+
+	g_free (priv->filter_comma_cue);
+	priv->filter_comma_cue = comma_cue (folded_cue);
+
+	if (priv->email_generator)
+		e_tree_model_generator_refilter (priv->email_generator);
+
+	return TRUE;
+}
+
 static void
 set_completion_query (ENameSelectorEntry *name_selector_entry,
                       const gchar *cue_str)
@@ -762,10 +1016,14 @@ set_completion_query (ENameSelectorEntry *name_selector_entry,
 
 	if (!cue_str) {
 		/* Clear the store */
+		reset_completion_cue (name_selector_entry);
 		e_contact_store_set_query (name_selector_entry->priv->contact_store, NULL);
 		return;
 	}
 
+	if (narrow_completion_query (name_selector_entry, cue_str))
+		return;
+
 	encoded_cue_str = escape_sexp_string (cue_str);
 	full_name_query_str = name_style_query ("full_name", cue_str);
 	file_as_query_str = name_style_query ("file_as",   cue_str);
@@ -790,6 +1048,9 @@ set_completion_query (ENameSelectorEntry *name_selector_entry,
 
 	ENS_DEBUG (g_print ("%s\n", query_str));
 
+	reset_completion_cue (name_selector_entry);
+	priv->query_cue = casefold_cue (cue_str);
+
 	book_query = e_book_query_from_string (query_str);
 	e_contact_store_set_query (name_selector_entry->priv->contact_store, book_query);
 	e_book_query_unref (book_query);
@@ -1161,6 +1422,7 @@ clear_completion_model (ENameSelectorEntry *name_selector_entry)
 	if (!name_selector_entry->priv->contact_store)
 		return;
 
+	reset_completion_cue (name_selector_entry);
 	e_contact_store_set_query (name_selector_entry->priv->contact_store, NULL);
 	priv->is_completing = FALSE;
 }
@@ -2171,6 +2433,9 @@ generate_contact_rows (EContactStore *contact_store,
 	if (!contact_uid)
 		return 0;  /* Can happen with broken databases */
 
+	if (!contact_matches_filter_cue (name_selector_entry, contact))
+		return 0;
+
 	if (e_contact_get (contact, E_CONTACT_IS_LIST))
 		return 1;
 
@@ -2198,6 +2463,8 @@ ensure_type_ahead_complete_on_timeout (ENameSelectorEntry *name_selector_entry)
 static void
 setup_contact_store (ENameSelectorEntry *name_selector_entry)
 {
+	reset_completion_cue (name_selector_entry);
+
 	if (name_selector_entry->priv->email_generator) {
 		g_object_unref (name_selector_entry->priv->email_generator);
 		name_selector_entry->priv->email_generator = NULL;
@@ -3598,3 +3865,65 @@ e_name_selector_entry_set_contact_list_editor_func (ENameSelectorEntry *name_sel
 {
 	name_selector_entry->priv->contact_list_editor_func = func;
 }
+
+#ifdef E_NAME_SELECTOR_ENTRY_TEST
+
+/* Checks that narrowing the completion locally accepts what a new
+ * backend query for the longer cue would return. */
+struct {
+	const gchar *full_name;
+	const gchar *file_as;
+	const gchar *cue;
+	gboolean matches;
+} cue_tests[] = {
+	{ "John Smith", "Smith, John", "john", TRUE },
+	{ "John Smith", "Smith, John", "smi", TRUE },
+	{ "John Smith", "Smith, John", "john smi", TRUE },
+	{ "John Smith", "Smith, John", "smith john", TRUE },
+	{ "John Smith", "Smith, John", "smith, jo", TRUE },
+	{ "John Smith", "Smith, John", "SMITH JOHN", TRUE },
+	{ "John Smith", "\"Smith, John\"", "smith john", FALSE },
+	{ "Smith,John", NULL, "smith john", FALSE },
+	{ "Smith, John Paul", NULL, "smith john paul", TRUE },
+	{ "John Smith", "Smith, John", "john x", FALSE },
+	{ "John Smith", "Smith, John", "ohn", FALSE }
+};
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	gint i, errors = 0;
+
+	for (i = 0; i < G_N_ELEMENTS (cue_tests); i++) {
+		EContact *contact;
+		gchar *folded_cue, *folded_comma_cue;
+		gboolean matches;
+
+		contact = e_contact_new ();
+		e_contact_set (contact, E_CONTACT_FULL_NAME, cue_tests[i].full_name);
+		if (cue_tests[i].file_as)
+			e_contact_set (contact, E_CONTACT_FILE_AS, cue_tests[i].file_as);
+
+		folded_cue = casefold_cue (cue_tests[i].cue);
+		folded_comma_cue = comma_cue (folded_cue);
+
+		matches = contact_matches_cue (contact, folded_cue, folded_comma_cue);
+		if (matches != cue_tests[i].matches) {
+			g_print (
+				"FAILED on \"%s\" for \"%s\" / \"%s\"\n",
+				cue_tests[i].cue, cue_tests[i].full_name,
+				cue_tests[i].file_as ? cue_tests[i].file_as : "");
+			errors++;
+		}
+
+		g_free (folded_comma_cue);
+		g_free (folded_cue);
+		g_object_unref (contact);
+	}
+
+	g_print ("\n%d errors\n", errors);
+
+	return errors;
+}
+#endif
@@ -20,13 +20,16 @@
 #endif
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <string.h>
 
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #include <libebackend/libebackend.h>
 
 #include "e-plugin.h"
+#include "e-trace.h"
 #include "e-util-private.h"
 
 /* plugin debug */
@@ -72,13 +75,26 @@ static GSList *ep_disabled;
 /* All classes which implement EPluginHooks, by class.id */
 static GHashTable *eph_types;
 
-struct _plugin_doc {
-	struct _plugin_doc *next;
-	struct _plugin_doc *prev;
+/* plugins created from the manifest whose hooks are not constructed
+ * yet, mapped to whether the rest of the plugin has been constructed */
+static GHashTable *ep_deferred;
 
-	gchar *filename;
-	xmlDocPtr doc;
-};
+/* The manifest caches what e_plugin_load_plugins() needs to know
+ * about every .eplug file, so plugins can be sorted into load levels
+ * without parsing their XML and disabled plugins are never parsed.
+ * It is a serialized GVariant of the following form:
+ *
+ *   version, plugin directory, directory mtime,
+ *   [(file name, file mtime,
+ *     [(id, type, load level, system plugin, domain, localedir,
+ *       name, description, [(author name, author email)])])]
+ *
+ * Missing strings are stored empty and a missing load level as -1.
+ */
+#define EP_MANIFEST_VERSION 1
+#define EP_MANIFEST_ENTRY_TYPE "(ssibssssa(ss))"
+#define EP_MANIFEST_FILE_TYPE "(sta" EP_MANIFEST_ENTRY_TYPE ")"
+#define EP_MANIFEST_TYPE "(usta" EP_MANIFEST_FILE_TYPE ")"
 
 enum {
 	EP_PROP_0,
@@ -133,67 +149,92 @@ ep_set_enabled (const gchar *id,
 	g_object_unref (settings);
 }
 
+static void
+ep_bind_textdomain (const gchar *domain,
+                    const gchar *localedir)
+{
+#ifdef G_OS_WIN32
+	gchar *mapped_localedir =
+		e_util_replace_prefix (
+			EVOLUTION_PREFIX,
+			e_util_get_prefix (),
+			localedir);
+	bindtextdomain (domain, mapped_localedir);
+	g_free (mapped_localedir);
+#else
+	bindtextdomain (domain, localedir);
+#endif
+}
+
+static gint
+ep_construct_hooks (EPlugin *ep,
+                    xmlNodePtr root)
+{
+	xmlNodePtr node;
+
+	for (node = root->children; node; node = node->next) {
+		EPluginHook *hook;
+		EPluginHookClass *type;
+		gchar *class;
+
+		if (strcmp ((gchar *) node->name, "hook") != 0)
+			continue;
+
+		class = e_plugin_xml_prop (node, "class");
+
+		if (class == NULL) {
+			g_warning (
+				"Plugin '%s' load failed in '%s', "
+				"missing class property for hook",
+				ep->id, ep->path);
+			return -1;
+		}
+
+		if (ep->enabled
+		    && eph_types != NULL
+			&& (type = g_hash_table_lookup (
+				eph_types, class)) != NULL) {
+			g_free (class);
+			hook = g_object_new (G_OBJECT_CLASS_TYPE (type), NULL);
+			if (type->construct (hook, ep, node) == -1) {
+				g_warning (
+					"Plugin '%s' failed to "
+					"load hook", ep->name);
+				g_object_unref (hook);
+				return -1;
+			} else {
+				ep->hooks = g_slist_append (ep->hooks, hook);
+			}
+		} else {
+			g_free (class);
+		}
+	}
+
+	return 0;
+}
+
 static gint
 ep_construct (EPlugin *ep,
               xmlNodePtr root)
 {
 	xmlNodePtr node;
-	gint res = -1;
 	gchar *localedir;
 
 	ep->domain = e_plugin_xml_prop (root, "domain");
 	if (ep->domain
 	    && (localedir = e_plugin_xml_prop (root, "localedir"))) {
-#ifdef G_OS_WIN32
-		gchar *mapped_localedir =
-			e_util_replace_prefix (
-				EVOLUTION_PREFIX,
-				e_util_get_prefix (),
-				localedir);
-		g_free (localedir);
-		localedir = mapped_localedir;
-#endif
-		bindtextdomain (ep->domain, localedir);
+		ep_bind_textdomain (ep->domain, localedir);
 		g_free (localedir);
 	}
 
 	ep->name = e_plugin_xml_prop_domain (root, "name", ep->domain);
 
+	if (ep_construct_hooks (ep, root) == -1)
+		return -1;
+
 	node = root->children;
 	while (node) {
-		if (strcmp ((gchar *) node->name, "hook") == 0) {
-			EPluginHook *hook;
-			EPluginHookClass *type;
-			gchar *class = e_plugin_xml_prop (node, "class");
-
-			if (class == NULL) {
-				g_warning (
-					"Plugin '%s' load failed in '%s', "
-					"missing class property for hook",
-					ep->id, ep->path);
-				goto fail;
-			}
-
-			if (ep->enabled
-			    && eph_types != NULL
-				&& (type = g_hash_table_lookup (
-					eph_types, class)) != NULL) {
-				g_free (class);
-				hook = g_object_new (G_OBJECT_CLASS_TYPE (type), NULL);
-				res = type->construct (hook, ep, node);
-				if (res == -1) {
-					g_warning (
-						"Plugin '%s' failed to "
-						"load hook", ep->name);
-					g_object_unref (hook);
-					goto fail;
-				} else {
-					ep->hooks = g_slist_append (ep->hooks, hook);
-				}
-			} else {
-				g_free (class);
-			}
-		} else if (strcmp ((gchar *) node->name, "description") == 0) {
+		if (strcmp ((gchar *) node->name, "description") == 0) {
 			ep->description =
 				e_plugin_xml_content_domain (node, ep->domain);
 		} else if (strcmp ((gchar *) node->name, "author") == 0) {
@@ -210,9 +251,8 @@ ep_construct (EPlugin *ep,
 		}
 		node = node->next;
 	}
-	res = 0;
-fail:
-	return res;
+
+	return 0;
 }
 
 static void
@@ -313,7 +353,7 @@ e_plugin_init (EPlugin *ep)
 
 static EPlugin *
 ep_load_plugin (xmlNodePtr root,
-                struct _plugin_doc *pdoc)
+                const gchar *filename)
 {
 	gchar *prop, *id;
 	EPluginClass *class;
@@ -321,7 +361,7 @@ ep_load_plugin (xmlNodePtr root,
 
 	id = e_plugin_xml_prop (root, "id");
 	if (id == NULL) {
-		g_warning ("Invalid e-plugin entry in '%s': no id", pdoc->filename);
+		g_warning ("Invalid e-plugin entry in '%s': no id", filename);
 		return NULL;
 	}
 
@@ -334,7 +374,7 @@ ep_load_plugin (xmlNodePtr root,
 	prop = (gchar *) xmlGetProp (root, (const guchar *)"type");
 	if (prop == NULL) {
 		g_free (id);
-		g_warning ("Invalid e-plugin entry in '%s': no type", pdoc->filename);
+		g_warning ("Invalid e-plugin entry in '%s': no type", filename);
 		return NULL;
 	}
 
@@ -350,7 +390,7 @@ ep_load_plugin (xmlNodePtr root,
 
 	ep = g_object_new (G_TYPE_FROM_CLASS (class), NULL);
 	ep->id = id;
-	ep->path = g_strdup (pdoc->filename);
+	ep->path = g_strdup (filename);
 	ep->enabled = ep_check_enabled (id);
 	if (e_plugin_construct (ep, root) == -1)
 		e_plugin_enable (ep, FALSE);
@@ -359,71 +399,510 @@ ep_load_plugin (xmlNodePtr root,
 	return ep;
 }
 
+static const gchar *
+ep_manifest_string (const gchar *value)
+{
+	return (value != NULL && *value != '\0') ? value : NULL;
+}
+
+/* Creates a disabled plugin from its manifest entry, without hooks.
+ * It is constructed from its XML file once it gets enabled. */
+static EPlugin *
+ep_load_deferred (GVariant *entry,
+                  const gchar *filename)
+{
+	const gchar *id, *type, *domain, *localedir, *name, *description;
+	const gchar *author_name, *author_email;
+	gboolean system_plugin;
+	gint load_level;
+	GVariantIter *authors;
+	EPluginClass *class;
+	EPlugin *ep;
+
+	g_variant_get (
+		entry, "(&s&sib&s&s&s&sa(ss))",
+		&id, &type, &load_level, &system_plugin,
+		&domain, &localedir, &name, &description, &authors);
+
+	if (g_hash_table_lookup (ep_plugins, id)) {
+		g_warning ("Plugin '%s' already defined", id);
+		g_variant_iter_free (authors);
+		return NULL;
+	}
+
+	class = g_hash_table_lookup (ep_types, type);
+
+	ep = g_object_new (G_TYPE_FROM_CLASS (class), NULL);
+	ep->id = g_strdup (id);
+	ep->path = g_strdup (filename);
+	ep->enabled = FALSE;
+
+	ep->domain = g_strdup (ep_manifest_string (domain));
+	if (ep->domain && ep_manifest_string (localedir))
+		ep_bind_textdomain (ep->domain, localedir);
+
+	if (ep_manifest_string (name))
+		ep->name = g_strdup (dgettext (ep->domain, name));
+	if (ep_manifest_string (description))
+		ep->description = g_strdup (dgettext (ep->domain, description));
+
+	while (g_variant_iter_next (authors, "(&s&s)", &author_name, &author_email)) {
+		EPluginAuthor *epa = g_malloc0 (sizeof (*epa));
+
+		epa->name = g_strdup (ep_manifest_string (author_name));
+		epa->email = g_strdup (ep_manifest_string (author_email));
+		ep->authors = g_slist_append (ep->authors, epa);
+	}
+	g_variant_iter_free (authors);
+
+	g_hash_table_insert (ep_plugins, ep->id, ep);
+	g_hash_table_insert (ep_deferred, ep, NULL);
+
+	return ep;
+}
+
+static xmlNodePtr
+ep_find_plugin_node (xmlDocPtr doc,
+                     const gchar *id)
+{
+	xmlNodePtr root;
+
+	root = xmlDocGetRootElement (doc);
+	if (root == NULL || strcmp ((gchar *) root->name, "e-plugin-list") != 0)
+		return NULL;
+
+	for (root = root->children; root; root = root->next) {
+		if (strcmp ((gchar *) root->name, "e-plugin") == 0) {
+			xmlChar *prop;
+			gboolean found;
+
+			prop = xmlGetProp (root, (const guchar *) "id");
+			found = g_strcmp0 ((gchar *) prop, id) == 0;
+			xmlFree (prop);
+
+			if (found)
+				return root;
+		}
+	}
+
+	return NULL;
+}
+
+/* Constructs a plugin created by ep_load_deferred().  The hooks are
+ * only constructed when @with_hooks is set, which it is when enabling
+ * the plugin; until then it is kept in ep_deferred for doing so. */
 static gint
-ep_load (const gchar *filename,
-         gint load_level)
+ep_construct_deferred (EPlugin *ep,
+                       gboolean with_hooks)
 {
 	xmlDocPtr doc;
 	xmlNodePtr root;
-	EPlugin *ep = NULL;
-	struct _plugin_doc *pdoc;
+	gpointer constructed;
+	gboolean enabled;
+	gint res = -1;
+
+	if (ep_deferred == NULL || !g_hash_table_lookup_extended (
+		ep_deferred, ep, NULL, &constructed))
+		return 0;
 
-	doc = e_xml_parse_file (filename);
+	if (constructed && !with_hooks)
+		return 0;
+
+	doc = e_xml_parse_file (ep->path);
 	if (doc == NULL)
 		return -1;
 
-	root = xmlDocGetRootElement (doc);
-	if (strcmp ((gchar *) root->name, "e-plugin-list") != 0) {
-		g_warning ("No <e-plugin-list> root element: %s", filename);
+	root = ep_find_plugin_node (doc, ep->id);
+	if (root == NULL) {
 		xmlFreeDoc (doc);
 		return -1;
 	}
 
-	pdoc = g_malloc0 (sizeof (*pdoc));
-	pdoc->doc = doc;
-	pdoc->filename = g_strdup (filename);
+	/* Hooks are only constructed for enabled plugins. */
+	enabled = ep->enabled;
+	ep->enabled = with_hooks;
 
-	for (root = root->children; root; root = root->next) {
-		if (strcmp ((gchar *) root->name, "e-plugin") == 0) {
-			gchar *plugin_load_level, *is_system_plugin;
+	if (constructed) {
+		res = ep_construct_hooks (ep, root);
+	} else {
+		GSList *link;
+
+		/* The construct() method fills these in again. */
+		for (link = ep->authors; link != NULL; link = link->next) {
+			EPluginAuthor *epa = link->data;
+
+			g_free (epa->name);
+			g_free (epa->email);
+			g_free (epa);
+		}
+		g_slist_free (ep->authors);
+		ep->authors = NULL;
+
+		g_free (ep->domain);
+		ep->domain = NULL;
+		g_free (ep->name);
+		ep->name = NULL;
+		g_free (ep->description);
+		ep->description = NULL;
+
+		res = e_plugin_construct (ep, root);
+	}
+
+	ep->enabled = enabled;
+
+	if (res == -1 || with_hooks)
+		g_hash_table_remove (ep_deferred, ep);
+	else
+		g_hash_table_insert (ep_deferred, ep, GINT_TO_POINTER (TRUE));
+
+	xmlFreeDoc (doc);
+
+	return res;
+}
+
+static guint64
+ep_file_mtime (const gchar *filename)
+{
+	struct stat st;
+
+	if (g_stat (filename, &st) == -1)
+		return 0;
+
+	return (guint64) st.st_mtime;
+}
+
+static gchar *
+ep_manifest_filename (void)
+{
+	return g_build_filename (
+		e_get_user_cache_dir (), "plugin-manifest", NULL);
+}
+
+/* Returns the cached manifest for @path, or %NULL if it
+ * is missing or the plugin directory has changed since. */
+static GVariant *
+ep_manifest_load (const gchar *path)
+{
+	GVariant *manifest, *files;
+	GVariantIter iter;
+	const gchar *manifest_path;
+	const gchar *basename;
+	gchar *filename;
+	gchar *contents = NULL;
+	gsize length = 0;
+	guint32 version;
+	guint64 mtime;
+	gboolean valid;
+
+	filename = ep_manifest_filename ();
+	g_file_get_contents (filename, &contents, &length, NULL);
+	g_free (filename);
+
+	if (contents == NULL)
+		return NULL;
+
+	manifest = g_variant_new_from_data (
+		G_VARIANT_TYPE (EP_MANIFEST_TYPE),
+		contents, length, FALSE,
+		(GDestroyNotify) g_free, contents);
+	g_variant_ref_sink (manifest);
+
+	g_variant_get_child (manifest, 0, "u", &version);
+	g_variant_get_child (manifest, 1, "&s", &manifest_path);
+	g_variant_get_child (manifest, 2, "t", &mtime);
+
+	valid = version == EP_MANIFEST_VERSION &&
+		g_strcmp0 (manifest_path, path) == 0 &&
+		mtime == ep_file_mtime (path);
+
+	/* The directory mtime covers added and removed
+	 * files, but not files which were replaced in place. */
+	files = g_variant_get_child_value (manifest, 3);
+	g_variant_iter_init (&iter, files);
+	while (valid && g_variant_iter_next (
+		&iter, "(&sta" EP_MANIFEST_ENTRY_TYPE ")",
+		&basename, &mtime, NULL)) {
+		filename = g_build_filename (path, basename, NULL);
+		valid = mtime == ep_file_mtime (filename);
+		g_free (filename);
+	}
+	g_variant_unref (files);
+
+	if (!valid) {
+		pd (printf ("plugin manifest is out of date\n"));
+		g_variant_unref (manifest);
+		return NULL;
+	}
+
+	return manifest;
+}
+
+static void
+ep_manifest_save (GVariant *manifest)
+{
+	gchar *filename;
+	GError *error = NULL;
+
+	g_mkdir_with_parents (e_get_user_cache_dir (), 0700);
+
+	filename = ep_manifest_filename ();
+
+	g_file_set_contents (
+		filename,
+		g_variant_get_data (manifest),
+		g_variant_get_size (manifest), &error);
+
+	if (error != NULL) {
+		g_warning ("%s: %s", G_STRFUNC, error->message);
+		g_error_free (error);
+	}
+
+	g_free (filename);
+}
+
+static void
+ep_manifest_add_plugin (GVariantBuilder *builder,
+                        xmlNodePtr root,
+                        const gchar *filename)
+{
+	GVariantBuilder authors;
+	xmlNodePtr node;
+	gchar *id, *type, *load_level, *system_plugin;
+	gchar *domain, *localedir, *name, *description = NULL;
+
+	id = e_plugin_xml_prop (root, "id");
+	if (id == NULL) {
+		g_warning ("Invalid e-plugin entry in '%s': no id", filename);
+		return;
+	}
+
+	type = e_plugin_xml_prop (root, "type");
+	if (type == NULL) {
+		g_warning ("Invalid e-plugin entry in '%s': no type", filename);
+		g_free (id);
+		return;
+	}
+
+	load_level = e_plugin_xml_prop (root, "load_level");
+	system_plugin = e_plugin_xml_prop (root, "system_plugin");
+	domain = e_plugin_xml_prop (root, "domain");
+	localedir = e_plugin_xml_prop (root, "localedir");
+	name = e_plugin_xml_prop (root, "name");
+
+	g_variant_builder_init (&authors, G_VARIANT_TYPE ("a(ss)"));
+
+	for (node = root->children; node; node = node->next) {
+		if (strcmp ((gchar *) node->name, "description") == 0) {
+			xmlChar *content = xmlNodeGetContent (node);
+
+			g_free (description);
+			description = g_strdup ((gchar *) content);
+			xmlFree (content);
+		} else if (strcmp ((gchar *) node->name, "author") == 0) {
+			gchar *author_name = e_plugin_xml_prop (node, "name");
+			gchar *author_email = e_plugin_xml_prop (node, "email");
+
+			if (author_name || author_email)
+				g_variant_builder_add (
+					&authors, "(ss)",
+					author_name ? author_name : "",
+					author_email ? author_email : "");
+
+			g_free (author_name);
+			g_free (author_email);
+		}
+	}
+
+	g_variant_builder_add (
+		builder, EP_MANIFEST_ENTRY_TYPE,
+		id, type,
+		load_level ? atoi (load_level) : -1,
+		g_strcmp0 (system_plugin, "true") == 0,
+		domain ? domain : "",
+		localedir ? localedir : "",
+		name ? name : "",
+		description ? description : "",
+		&authors);
+
+	g_free (id);
+	g_free (type);
+	g_free (load_level);
+	g_free (system_plugin);
+	g_free (domain);
+	g_free (localedir);
+	g_free (name);
+	g_free (description);
+}
+
+/* Scans @path and builds a new manifest from it.  The parsed
+ * documents are kept in @docs, by file name, for loading. */
+static GVariant *
+ep_manifest_build (const gchar *path,
+                   GHashTable *docs)
+{
+	GVariantBuilder builder;
+	GDir *dir;
+	const gchar *d;
+	guint64 dir_mtime;
+
+	pd (printf ("scanning plugin dir '%s'\n", path));
+
+	/* Take the mtime first, so changes made
+	 * while scanning invalidate the manifest. */
+	dir_mtime = ep_file_mtime (path);
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir == NULL) {
+		/*g_warning("Could not find plugin path: %s", path);*/
+		return NULL;
+	}
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE (EP_MANIFEST_TYPE));
+	g_variant_builder_add (&builder, "u", EP_MANIFEST_VERSION);
+	g_variant_builder_add (&builder, "s", path);
+	g_variant_builder_add (&builder, "t", dir_mtime);
+	g_variant_builder_open (&builder, G_VARIANT_TYPE ("a" EP_MANIFEST_FILE_TYPE));
+
+	while ((d = g_dir_read_name (dir))) {
+		xmlDocPtr doc;
+		xmlNodePtr root;
+		gchar *name;
+
+		if (!g_str_has_suffix (d, ".eplug"))
+			continue;
+
+		name = g_build_filename (path, d, NULL);
+
+		g_variant_builder_open (&builder, G_VARIANT_TYPE (EP_MANIFEST_FILE_TYPE));
+		g_variant_builder_add (&builder, "s", d);
+		g_variant_builder_add (&builder, "t", ep_file_mtime (name));
+		g_variant_builder_open (&builder, G_VARIANT_TYPE ("a" EP_MANIFEST_ENTRY_TYPE));
+
+		doc = e_xml_parse_file (name);
+		root = doc ? xmlDocGetRootElement (doc) : NULL;
+
+		if (root && strcmp ((gchar *) root->name, "e-plugin-list") != 0) {
+			g_warning ("No <e-plugin-list> root element: %s", name);
+			root = NULL;
+		}
 
-			plugin_load_level = NULL;
-			plugin_load_level = e_plugin_xml_prop (root, "load_level");
-			if (plugin_load_level) {
-				if ((atoi (plugin_load_level) == load_level)) {
-					ep = ep_load_plugin (root, pdoc);
+		if (root != NULL) {
+			for (root = root->children; root; root = root->next) {
+				if (strcmp ((gchar *) root->name, "e-plugin") == 0)
+					ep_manifest_add_plugin (&builder, root, name);
+			}
+		}
+
+		if (doc != NULL)
+			g_hash_table_insert (docs, g_strdup (name), doc);
+
+		g_variant_builder_close (&builder);
+		g_variant_builder_close (&builder);
+
+		g_free (name);
+	}
+
+	g_dir_close (dir);
+
+	g_variant_builder_close (&builder);
+
+	return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+static void
+ep_load_level (GVariant *manifest,
+               GHashTable *docs,
+               gint load_level)
+{
+	GVariant *files;
+	GVariantIter iter;
+	GVariantIter *entries;
+	const gchar *path;
+	const gchar *basename;
+
+	g_variant_get_child (manifest, 1, "&s", &path);
+
+	files = g_variant_get_child_value (manifest, 3);
+	g_variant_iter_init (&iter, files);
+
+	while (g_variant_iter_next (
+		&iter, "(&sta" EP_MANIFEST_ENTRY_TYPE ")",
+		&basename, NULL, &entries)) {
+		GVariant *entry;
+		gchar *filename;
+
+		filename = g_build_filename (path, basename, NULL);
+
+		while ((entry = g_variant_iter_next_value (entries)) != NULL) {
+			const gchar *id, *type;
+			gboolean system_plugin;
+			gint plugin_load_level;
+			EPlugin *ep = NULL;
+			ETraceSpan span;
+
+			g_variant_get_child (entry, 0, "&s", &id);
+			g_variant_get_child (entry, 1, "&s", &type);
+			g_variant_get_child (entry, 2, "i", &plugin_load_level);
+			g_variant_get_child (entry, 3, "b", &system_plugin);
+
+			/* Plugins without a load level are loaded last. */
+			if (plugin_load_level == -1)
+				plugin_load_level = 2;
+
+			if (plugin_load_level != load_level ||
+			    g_hash_table_lookup (ep_types, type) == NULL) {
+				g_variant_unref (entry);
+				continue;
+			}
 
-					if (ep && load_level == 1)
-						e_plugin_invoke (
-							ep, "load_plugin_type_register_function", NULL);
+			if (!system_plugin && !ep_check_enabled (id)) {
+				ep = ep_load_deferred (entry, filename);
+			} else {
+				xmlDocPtr doc;
+				xmlNodePtr root = NULL;
+
+				doc = g_hash_table_lookup (docs, filename);
+				if (doc == NULL) {
+					doc = e_xml_parse_file (filename);
+					if (doc != NULL)
+						g_hash_table_insert (
+							docs, g_strdup (filename), doc);
 				}
-			} else if (load_level == 2) {
-				ep = ep_load_plugin (root, pdoc);
+
+				if (doc != NULL)
+					root = ep_find_plugin_node (doc, id);
+
+				e_trace_span_begin (&span, "plugin", "load-plugin");
+
+				if (root != NULL)
+					ep = ep_load_plugin (root, filename);
+
+				if (ep && load_level == 1)
+					e_plugin_invoke (
+						ep, "load_plugin_type_register_function", NULL);
+
+				e_trace_span_end (&span, id);
 			}
 
 			if (ep) {
 				/* README: Maybe we can use load_levels to
 				 * achieve the same thing.  But it may be
 				 * confusing for a plugin writer. */
-				is_system_plugin =
-					e_plugin_xml_prop (root, "system_plugin");
-				if (g_strcmp0 (is_system_plugin, "true") == 0) {
+				if (system_plugin) {
 					e_plugin_enable (ep, TRUE);
 					ep->flags |= E_PLUGIN_FLAGS_SYSTEM_PLUGIN;
 				} else
 					ep->flags &= ~E_PLUGIN_FLAGS_SYSTEM_PLUGIN;
-				g_free (is_system_plugin);
-
-				ep = NULL;
 			}
+
+			g_variant_unref (entry);
 		}
-	}
 
-	xmlFreeDoc (pdoc->doc);
-	g_free (pdoc->filename);
-	g_free (pdoc);
+		g_variant_iter_free (entries);
+		g_free (filename);
+	}
 
-	return 0;
+	g_variant_unref (files);
 }
 
 static void
@@ -477,7 +956,10 @@ plugin_hook_load_subclass (GType type,
  * e_plugin_load_plugins:
  *
  * Scan the search path, looking for plugin definitions, and load them
- * into memory.
+ * into memory.  What is known about the plugin definitions is cached in
+ * a manifest in the user cache directory, which is rebuilt whenever the
+ * plugin directory changes.  Disabled plugins are loaded from the
+ * manifest alone and only constructed once they are enabled.
  *
  * Return value: Returns -1 if an error occurred.
  **/
@@ -485,15 +967,22 @@ gint
 e_plugin_load_plugins (void)
 {
 	GSettings *settings;
+	GVariant *manifest;
+	GHashTable *docs;
+	const gchar *path = EVOLUTION_PLUGINDIR;
+	ETraceSpan span;
 	gchar **strv;
 	gint i;
 
 	if (eph_types != NULL)
 		return 0;
 
+	e_trace_span_begin (&span, "plugin", "load-plugins");
+
 	ep_types = g_hash_table_new (g_str_hash, g_str_equal);
 	eph_types = g_hash_table_new (g_str_hash, g_str_equal);
 	ep_plugins = g_hash_table_new (g_str_hash, g_str_equal);
+	ep_deferred = g_hash_table_new (g_direct_hash, g_direct_equal);
 
 	/* We require that all GTypes for EPlugin and EPluginHook
 	 * subclasses be registered prior to loading any plugins.
@@ -512,31 +1001,28 @@ e_plugin_load_plugins (void)
 	g_strfreev (strv);
 	g_object_unref (settings);
 
-	for (i = 0; i < 3; i++) {
-		GDir *dir;
-		const gchar *d;
-		const gchar *path = EVOLUTION_PLUGINDIR;
-
-		pd (printf ("scanning plugin dir '%s'\n", path));
-
-		dir = g_dir_open (path, 0, NULL);
-		if (dir == NULL) {
-			/*g_warning("Could not find plugin path: %s", path);*/
-			continue;
-		}
+	docs = g_hash_table_new_full (
+		(GHashFunc) g_str_hash,
+		(GEqualFunc) g_str_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) xmlFreeDoc);
+
+	manifest = ep_manifest_load (path);
+	if (manifest == NULL) {
+		manifest = ep_manifest_build (path, docs);
+		if (manifest != NULL)
+			ep_manifest_save (manifest);
+	}
 
-		while ((d = g_dir_read_name (dir))) {
-			if (g_str_has_suffix  (d, ".eplug")) {
-				gchar *name;
+	if (manifest != NULL) {
+		for (i = 0; i < 3; i++)
+			ep_load_level (manifest, docs, i);
+		g_variant_unref (manifest);
+	}
 
-				name = g_build_filename (path, d, NULL);
-				ep_load (name, i);
-				g_free (name);
-			}
-		}
+	g_hash_table_destroy (docs);
 
-		g_dir_close (dir);
-	}
+	e_trace_span_end (&span, NULL);
 
 	return 0;
 }
@@ -645,6 +1131,10 @@ e_plugin_get_symbol (EPlugin *plugin,
 
 	g_return_val_if_fail (E_IS_PLUGIN (plugin), NULL);
 
+	/* Deferred plugins lack what their class needs to look up symbols. */
+	if (ep_construct_deferred (plugin, FALSE) == -1)
+		return NULL;
+
 	class = E_PLUGIN_GET_CLASS (plugin);
 	g_return_val_if_fail (class->get_symbol != NULL, NULL);
 
@@ -671,6 +1161,11 @@ e_plugin_enable (EPlugin *plugin,
 	if ((plugin->enabled == 0) == (state == 0))
 		return;
 
+	if (state && ep_construct_deferred (plugin, TRUE) == -1) {
+		g_warning ("Plugin '%s' failed to load", plugin->id);
+		return;
+	}
+
 	class = E_PLUGIN_GET_CLASS (plugin);
 	g_return_if_fail (class->enable != NULL);
 
@@ -695,6 +1190,9 @@ e_plugin_get_configure_widget (EPlugin *plugin)
 
 	g_return_val_if_fail (E_IS_PLUGIN (plugin), NULL);
 
+	if (ep_construct_deferred (plugin, FALSE) == -1)
+		return NULL;
+
 	class = E_PLUGIN_GET_CLASS (plugin);
 	if (class->get_configure_widget == NULL)
 		return NULL;
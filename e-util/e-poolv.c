@@ -22,17 +22,104 @@
 #include "e-poolv.h"
 
 #include <string.h>
-#include <camel/camel.h>
 
 struct _EPoolv {
 	guchar length;
 	gchar *s[1];
 };
 
-static GHashTable *poolv_pool;
-static CamelMemPool *poolv_mempool;
+/* Interned strings are reference counted, one reference per EPoolv
+ * slot pointing at them, and freed as soon as the last one goes away.
+ * The pool is split into lock-striped shards by string hash so that
+ * concurrent users rarely contend on the same lock. */
 
-G_LOCK_DEFINE_STATIC (poolv);
+#define POOLV_N_SHARDS 16
+
+typedef struct _EPoolvString EPoolvString;
+typedef struct _EPoolvShard EPoolvShard;
+
+struct _EPoolvString {
+	guint ref_count;	/* guarded by the shard lock */
+	gchar str[1];
+};
+
+struct _EPoolvShard {
+	GMutex lock;
+	GHashTable *strings;	/* str -> EPoolvString */
+	gsize n_bytes;
+	guint64 n_hits;
+	guint64 n_misses;
+};
+
+#define POOLV_STRING(s) \
+	((EPoolvString *) ((s) - G_STRUCT_OFFSET (EPoolvString, str)))
+
+/* Statically allocated GMutexes need no initialization. */
+static EPoolvShard poolv_shards[POOLV_N_SHARDS];
+
+static EPoolvShard *
+poolv_shard_for_string (const gchar *str)
+{
+	/* Use the high bits; GHashTable itself uses the low ones. */
+	return &poolv_shards[(g_str_hash (str) >> 16) % POOLV_N_SHARDS];
+}
+
+static gchar *
+poolv_string_intern (const gchar *str)
+{
+	EPoolvShard *shard;
+	EPoolvString *pstring;
+	gsize length;
+
+	shard = poolv_shard_for_string (str);
+
+	g_mutex_lock (&shard->lock);
+
+	if (shard->strings == NULL)
+		shard->strings = g_hash_table_new (g_str_hash, g_str_equal);
+
+	pstring = g_hash_table_lookup (shard->strings, str);
+
+	if (pstring != NULL) {
+		pstring->ref_count++;
+		shard->n_hits++;
+	} else {
+		length = strlen (str);
+		pstring = g_malloc (sizeof (EPoolvString) + length);
+		pstring->ref_count = 1;
+		memcpy (pstring->str, str, length + 1);
+
+		g_hash_table_insert (shard->strings, pstring->str, pstring);
+		shard->n_bytes += sizeof (EPoolvString) + length;
+		shard->n_misses++;
+	}
+
+	g_mutex_unlock (&shard->lock);
+
+	return pstring->str;
+}
+
+static void
+poolv_string_release (gchar *str)
+{
+	EPoolvShard *shard;
+	EPoolvString *pstring;
+
+	shard = poolv_shard_for_string (str);
+	pstring = POOLV_STRING (str);
+
+	g_mutex_lock (&shard->lock);
+
+	g_warn_if_fail (pstring->ref_count > 0);
+
+	if (--pstring->ref_count == 0) {
+		g_hash_table_remove (shard->strings, pstring->str);
+		shard->n_bytes -= sizeof (EPoolvString) + strlen (pstring->str);
+		g_free (pstring);
+	}
+
+	g_mutex_unlock (&shard->lock);
+}
 
 /**
  * e_poolv_new:
@@ -42,8 +129,9 @@ G_LOCK_DEFINE_STATIC (poolv);
  * pool.  An #EPoolv can be used to work with arrays of strings which
  * save memory by eliminating duplicated allocations of the same string.
  *
- * This is useful when you have a log of read-only strings that do not
- * go away and are duplicated a lot, such as email headers.
+ * This is useful when you have a log of read-only strings that are
+ * duplicated a lot, such as email headers.  Pooled strings are released
+ * once no #EPoolv references them anymore.
  *
  * Returns: a new #EPoolv
  **/
@@ -57,17 +145,6 @@ e_poolv_new (guint size)
 	poolv = g_malloc0 (sizeof (*poolv) + (size - 1) * sizeof (gchar *));
 	poolv->length = size;
 
-	G_LOCK (poolv);
-
-	if (!poolv_pool)
-		poolv_pool = g_hash_table_new (g_str_hash, g_str_equal);
-
-	if (!poolv_mempool)
-		poolv_mempool = camel_mempool_new (
-			32 * 1024, 512, CAMEL_MEMPOOL_ALIGN_BYTE);
-
-	G_UNLOCK (poolv);
-
 	return poolv;
 }
 
@@ -91,25 +168,23 @@ e_poolv_set (EPoolv *poolv,
              gchar *str,
              gint freeit)
 {
+	gchar *old_str;
+
 	g_return_val_if_fail (poolv != NULL, NULL);
 	g_return_val_if_fail (index >= 0 && index < poolv->length, NULL);
 
-	if (!str) {
-		poolv->s[index] = NULL;
-		return poolv;
-	}
-
-	G_LOCK (poolv);
+	old_str = poolv->s[index];
 
-	if ((poolv->s[index] = g_hash_table_lookup (poolv_pool, str)) != NULL) {
-	} else {
-		poolv->s[index] = camel_mempool_strdup (poolv_mempool, str);
-		g_hash_table_insert (poolv_pool, poolv->s[index], poolv->s[index]);
-	}
+	/* Intern the new string first, in case it's the same one. */
+	if (str != NULL)
+		poolv->s[index] = poolv_string_intern (str);
+	else
+		poolv->s[index] = NULL;
 
-	G_UNLOCK (poolv);
+	if (old_str != NULL)
+		poolv_string_release (old_str);
 
-	if (freeit)
+	if (str != NULL && freeit)
 		g_free (str);
 
 	return poolv;
@@ -122,8 +197,9 @@ e_poolv_set (EPoolv *poolv,
  *
  * Retrieve a string by index.  This could possibly just be a macro.
  *
- * Since the pool is never freed, this string does not need to be
- * duplicated, but should not be modified.
+ * The string is owned by the pool and should not be modified.  It stays
+ * valid until the @index slot of @poolv is set again or @poolv itself
+ * is destroyed.
  *
  * Returns: string at that index.
  **/
@@ -141,13 +217,77 @@ e_poolv_get (EPoolv *poolv,
  * e_poolv_destroy:
  * @poolv: pooled string vector to free
  *
- * Free a pooled string vector.  This doesn't free the strings from
- * the vector, however.
+ * Free a pooled string vector, releasing its references to the pooled
+ * strings.  Strings no longer referenced by any #EPoolv are freed.
  **/
 void
 e_poolv_destroy (EPoolv *poolv)
 {
+	gint ii;
+
 	g_return_if_fail (poolv != NULL);
 
+	for (ii = 0; ii < poolv->length; ii++) {
+		if (poolv->s[ii] != NULL)
+			poolv_string_release (poolv->s[ii]);
+	}
+
 	g_free (poolv);
 }
+
+/**
+ * e_poolv_get_stats:
+ * @out_n_strings: (out) (allow-none): return location for the number of
+ *                 pooled strings, or %NULL
+ * @out_n_bytes: (out) (allow-none): return location for the memory held
+ *               by pooled strings, in bytes, or %NULL
+ * @out_n_hits: (out) (allow-none): return location for the number of
+ *              e_poolv_set() calls which found their string pooled
+ *              already, or %NULL
+ * @out_n_misses: (out) (allow-none): return location for the number of
+ *                e_poolv_set() calls which had to add their string to
+ *                the pool, or %NULL
+ *
+ * Reports the current state of the shared string pool, summed over
+ * all of its shards.  Meant for diagnostics and sizing.
+ *
+ * Since: 3.12
+ **/
+void
+e_poolv_get_stats (guint *out_n_strings,
+                   gsize *out_n_bytes,
+                   guint64 *out_n_hits,
+                   guint64 *out_n_misses)
+{
+	guint n_strings = 0;
+	gsize n_bytes = 0;
+	guint64 n_hits = 0;
+	guint64 n_misses = 0;
+	gint ii;
+
+	for (ii = 0; ii < POOLV_N_SHARDS; ii++) {
+		EPoolvShard *shard = &poolv_shards[ii];
+
+		g_mutex_lock (&shard->lock);
+
+		if (shard->strings != NULL)
+			n_strings += g_hash_table_size (shard->strings);
+		n_bytes += shard->n_bytes;
+		n_hits += shard->n_hits;
+		n_misses += shard->n_misses;
+
+		g_mutex_unlock (&shard->lock);
+	}
+
+	if (out_n_strings != NULL)
+		*out_n_strings = n_strings;
+
+	if (out_n_bytes != NULL)
+		*out_n_bytes = n_bytes;
+
+	if (out_n_hits != NULL)
+		*out_n_hits = n_hits;
+
+	if (out_n_misses != NULL)
+		*out_n_misses = n_misses;
+}
@@ -38,6 +38,10 @@ EPoolv *	e_poolv_set			(EPoolv *poolv,
 const gchar *	e_poolv_get			(EPoolv *poolv,
 						 gint index);
 void		e_poolv_destroy			(EPoolv *poolv);
+void		e_poolv_get_stats		(guint *out_n_strings,
+						 gsize *out_n_bytes,
+						 guint64 *out_n_hits,
+						 guint64 *out_n_misses);
 
 G_END_DECLS
 
@@ -725,6 +725,134 @@ eti_row_height_real (ETableItem *eti,
 	return max_h;
 }
 
+static void
+height_tree_add (gint *tree,
+                 gint n_rows,
+                 gint row,
+                 gint delta)
+{
+	gint i;
+
+	for (i = row + 1; i <= n_rows; i += i & -i)
+		tree[i] += delta;
+}
+
+/* Sum of the first @n_rows entries. */
+static gint
+height_tree_sum (const gint *tree,
+                 gint n_rows)
+{
+	gint i, sum = 0;
+
+	for (i = n_rows; i > 0; i -= i & -i)
+		sum += tree[i];
+
+	return sum;
+}
+
+static void
+free_height_trees (ETableItem *eti)
+{
+	g_free (eti->height_sums);
+	eti->height_sums = NULL;
+	g_free (eti->height_known);
+	eti->height_known = NULL;
+}
+
+/* Rebuilds both trees from height_cache in linear time. */
+static void
+rebuild_height_trees (ETableItem *eti)
+{
+	gint i, j;
+
+	free_height_trees (eti);
+
+	if (!eti->height_cache)
+		return;
+
+	eti->height_sums = g_new0 (gint, eti->rows + 1);
+	eti->height_known = g_new0 (gint, eti->rows + 1);
+
+	for (i = 1; i <= eti->rows; i++) {
+		if (eti->height_cache[i - 1] != -1) {
+			eti->height_sums[i] += eti->height_cache[i - 1];
+			eti->height_known[i] += 1;
+		}
+
+		j = i + (i & -i);
+		if (j <= eti->rows) {
+			eti->height_sums[j] += eti->height_sums[i];
+			eti->height_known[j] += eti->height_known[i];
+		}
+	}
+}
+
+static void
+set_cached_height (ETableItem *eti,
+                   gint row,
+                   gint height)
+{
+	gint old_height = eti->height_cache[row];
+
+	eti->height_cache[row] = height;
+
+	if (old_height == -1) {
+		height_tree_add (eti->height_known, eti->rows, row, 1);
+		old_height = 0;
+	}
+
+	height_tree_add (eti->height_sums, eti->rows, row, height - old_height);
+}
+
+/* Whether the heights of rows @start_row to @end_row - 1 are cached. */
+static gboolean
+heights_known (ETableItem *eti,
+               gint start_row,
+               gint end_row)
+{
+	if (!eti->height_cache)
+		return FALSE;
+
+	return height_tree_sum (eti->height_known, end_row) -
+		height_tree_sum (eti->height_known, start_row) ==
+		end_row - start_row;
+}
+
+/*
+ * Returns the last row whose offset from the top of the first row
+ * is less than @offset, where every row also takes @height_extra
+ * pixels, and stores that row's offset in @row_offset.  Returns
+ * eti->rows if the rows end before @offset.  All row heights must
+ * be cached.
+ */
+static gint
+find_row_before_offset (ETableItem *eti,
+                        gint offset,
+                        gint height_extra,
+                        gint *row_offset)
+{
+	gint row = 0, sum = 0, bit = 1;
+
+	while (bit * 2 <= eti->rows)
+		bit *= 2;
+
+	for (; bit > 0; bit /= 2) {
+		gint next = row + bit;
+
+		/* height_sums[next] covers exactly @bit rows here. */
+		if (next <= eti->rows &&
+		    sum + eti->height_sums[next] + bit * height_extra < offset) {
+			row = next;
+			sum += eti->height_sums[next] + bit * height_extra;
+		}
+	}
+
+	if (row_offset)
+		*row_offset = sum;
+
+	return row;
+}
+
 static void
 confirm_height_cache (ETableItem *eti)
 {
@@ -736,6 +864,7 @@ confirm_height_cache (ETableItem *eti)
 	for (i = 0; i < eti->rows; i++) {
 		eti->height_cache[i] = -1;
 	}
+	rebuild_height_trees (eti);
 }
 
 static gboolean
@@ -771,6 +900,7 @@ free_height_cache (ETableItem *eti)
 		if (eti->height_cache)
 			g_free (eti->height_cache);
 		eti->height_cache = NULL;
+		free_height_trees (eti);
 		eti->height_cache_idle_count = 0;
 		eti->uniform_row_height_cache = -1;
 
@@ -809,7 +939,7 @@ eti_row_height (ETableItem *eti,
 			calculate_height_cache (eti);
 		}
 		if (eti->height_cache[row] == -1) {
-			eti->height_cache[row] = eti_row_height_real (eti, row);
+			set_cached_height (eti, row, eti_row_height_real (eti, row));
 			if (row > 0 &&
 			    eti->length_threshold != -1 &&
 			    eti->rows > eti->length_threshold &&
@@ -872,11 +1002,7 @@ eti_get_height (ETableItem *eti)
 			}
 		}
 
-		height = height_extra;
-		for (row = 0; row < rows; row++)
-			height += ETI_ROW_HEIGHT (eti, row) + height_extra;
-
-		return height;
+		return e_table_item_row_diff (eti, 0, rows) + height_extra;
 	}
 }
 
@@ -921,6 +1047,13 @@ e_table_item_row_diff (ETableItem *eti,
 		return ((end_row - start_row) * (ETI_ROW_HEIGHT (eti, -1) + height_extra));
 	} else {
 		gint row, total;
+
+		if (start_row < end_row && heights_known (eti, start_row, end_row))
+			return height_tree_sum (eti->height_sums, end_row) -
+				height_tree_sum (eti->height_sums, start_row) +
+				(end_row - start_row) * height_extra;
+
+		/* Computes and caches the missing heights on the way. */
 		total = 0;
 		for (row = start_row; row < end_row; row++)
 			total += ETI_ROW_HEIGHT (eti, row) + height_extra;
@@ -1253,6 +1386,21 @@ eti_table_model_changed (ETableModel *table_model,
 	eti_idle_maybe_show_cursor (eti);
 }
 
+static void
+eti_row_height_changed (ETableItem *eti,
+                        gint row,
+                        gint height)
+{
+	set_cached_height (eti, row, height);
+
+	eti_unfreeze (eti);
+
+	eti->needs_compute_height = 1;
+	e_canvas_item_request_reflow (GNOME_CANVAS_ITEM (eti));
+	eti->needs_redraw = 1;
+	gnome_canvas_item_request_update (GNOME_CANVAS_ITEM (eti));
+}
+
 static void
 eti_table_model_row_changed (ETableModel *table_model,
                              gint row,
@@ -1265,9 +1413,13 @@ eti_table_model_row_changed (ETableModel *table_model,
 		return;
 	}
 
-	if ((!eti->uniform_row_height) && eti->height_cache && eti->height_cache[row] != -1 && eti_row_height_real (eti, row) != eti->height_cache[row]) {
-		eti_table_model_changed (table_model, eti);
-		return;
+	if ((!eti->uniform_row_height) && eti->height_cache && eti->height_cache[row] != -1) {
+		gint height = eti_row_height_real (eti, row);
+
+		if (height != eti->height_cache[row]) {
+			eti_row_height_changed (eti, row, height);
+			return;
+		}
 	}
 
 	eti_unfreeze (eti);
@@ -1288,9 +1440,13 @@ eti_table_model_cell_changed (ETableModel *table_model,
 		return;
 	}
 
-	if ((!eti->uniform_row_height) && eti->height_cache && eti->height_cache[row] != -1 && eti_row_height_real (eti, row) != eti->height_cache[row]) {
-		eti_table_model_changed (table_model, eti);
-		return;
+	if ((!eti->uniform_row_height) && eti->height_cache && eti->height_cache[row] != -1) {
+		gint height = eti_row_height_real (eti, row);
+
+		if (height != eti->height_cache[row]) {
+			eti_row_height_changed (eti, row, height);
+			return;
+		}
 	}
 
 	eti_unfreeze (eti);
@@ -1318,6 +1474,7 @@ eti_table_model_rows_inserted (ETableModel *table_model,
 		memmove (eti->height_cache + row + count, eti->height_cache + row, (eti->rows - count - row) * sizeof (gint));
 		for (i = row; i < row + count; i++)
 			eti->height_cache[i] = -1;
+		rebuild_height_trees (eti);
 	}
 
 	eti_unfreeze (eti);
@@ -1349,6 +1506,9 @@ eti_table_model_rows_deleted (ETableModel *table_model,
 		memmove (eti->height_cache + row, eti->height_cache + row + count, (eti->rows - row) * sizeof (gint));
 	}
 
+	if (eti->height_cache)
+		rebuild_height_trees (eti);
+
 	eti_unfreeze (eti);
 
 	eti_idle_maybe_show_cursor (eti);
@@ -1595,6 +1755,7 @@ eti_dispose (GObject *object)
 	if (eti->height_cache)
 		g_free (eti->height_cache);
 	eti->height_cache = NULL;
+	free_height_trees (eti);
 
 	/* Chain up to parent's dispose() method. */
 	G_OBJECT_CLASS (e_table_item_parent_class)->dispose (object);
@@ -1875,6 +2036,7 @@ eti_unrealize (GnomeCanvasItem *item)
 	if (eti->height_cache)
 		g_free (eti->height_cache);
 	eti->height_cache = NULL;
+	free_height_trees (eti);
 	eti->height_cache_idle_count = 0;
 
 	eti_unrealize_cell_views (eti);
@@ -1982,6 +2144,23 @@ eti_draw (GnomeCanvasItem *item,
 			first_row = 0;
 		if (last_row > eti->rows)
 			last_row = eti->rows;
+	} else if (heights_known (eti, 0, rows)) {
+		gint top = floor (eti_base_y) + height_extra;
+		gint row_offset;
+
+		/* Rows ending at or below @y, up to rows starting above
+		 * @y + @height; see the loop below. */
+		if (y + height - top < 0)
+			return;
+
+		first_row = find_row_before_offset (eti, y - top, height_extra, &row_offset);
+		if (first_row >= rows)
+			return;
+		y_offset = top + row_offset - y;
+
+		last_row = find_row_before_offset (eti, y + height - top + 1, height_extra, NULL) + 1;
+		if (last_row > rows)
+			last_row = rows;
 	} else {
 		gint y1, y2;
 
@@ -2275,6 +2454,16 @@ find_cell (ETableItem *eti,
 		y1 = row * (ETI_ROW_HEIGHT (eti, -1) + height_extra) + height_extra;
 		if (row >= eti->rows)
 			return FALSE;
+	} else if (heights_known (eti, 0, rows)) {
+		gint row_offset;
+
+		if (y < height_extra)
+			return FALSE;
+
+		row = find_row_before_offset (eti, ceil (y - height_extra), height_extra, &row_offset);
+		if (row >= rows)
+			return FALSE;
+		y1 = row_offset + height_extra;
 	} else {
 		y1 = y2 = height_extra;
 		if (y < height_extra)
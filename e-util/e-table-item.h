@@ -149,6 +149,11 @@ struct _ETableItem {
 	gint height_cache_idle_id;
 	gint height_cache_idle_count;
 
+	/* Fenwick trees over height_cache (1-based), holding the
+	 * heights of computed rows and the number of computed rows. */
+	gint *height_sums;
+	gint *height_known;
+
 	/*
 	 * Lengh Threshold: above this, we stop computing correctly
 	 * the size
@@ -223,6 +223,27 @@ ets_proxy_model_rows_inserted (ETableSubset *etss,
 		return;
 	}
 
+	/* A ranged append is merged in one step rather than inserted
+	 * row by row; if a full sort is pending, it will do the job. */
+	if (count > 1 && row == etss->n_map) {
+		e_table_model_pre_change (etm);
+
+		etss->map_table = g_realloc (etss->map_table, (etss->n_map + count) * sizeof (gint));
+		for (i = 0; i < count; i++)
+			etss->map_table[etss->n_map + i] = row + i;
+
+		if (ets->sort_idle_id == 0)
+			e_table_sorting_utils_merge (
+				source_model, ets->sort_info, ets->full_header,
+				etss->map_table, etss->n_map, count);
+
+		etss->n_map += count;
+
+		d (g_print ("merged rows %d count %d", row, count));
+		e_table_model_changed (etm);
+		return;
+	}
+
 	if (row != etss->n_map) {
 		full_change = TRUE;
 		for (i = 0; i < etss->n_map; i++) {
@@ -188,6 +188,61 @@ e_table_sorting_utils_sort (ETableModel *source,
 	e_table_sorting_utils_free_cmp_cache (closure.cmp_cache);
 }
 
+/* Sorts the 'count' rows following the 'rows' already sorted rows in
+ * 'map_table', then merges both runs in place.  This is linear in the
+ * size of the table instead of inserting the new rows one by one. */
+void
+e_table_sorting_utils_merge (ETableModel *source,
+                             ETableSortInfo *sort_info,
+                             ETableHeader *full_header,
+                             gint *map_table,
+                             gint rows,
+                             gint count)
+{
+	gint *sorted;
+	gint i, j, k;
+	gpointer cmp_cache;
+
+	g_return_if_fail (E_IS_TABLE_MODEL (source));
+	g_return_if_fail (E_IS_TABLE_SORT_INFO (sort_info));
+	g_return_if_fail (E_IS_TABLE_HEADER (full_header));
+
+	if (count <= 0)
+		return;
+
+	e_table_sorting_utils_sort (
+		source, sort_info, full_header, map_table + rows, count);
+
+	if (rows <= 0)
+		return;
+
+	/* Nothing to merge if the runs are already in order. */
+	cmp_cache = e_table_sorting_utils_create_cmp_cache ();
+	if (etsu_compare (source, sort_info, full_header, map_table[rows - 1], map_table[rows], cmp_cache) < 0) {
+		e_table_sorting_utils_free_cmp_cache (cmp_cache);
+		return;
+	}
+
+	sorted = g_memdup (map_table, rows * sizeof (gint));
+
+	/* The output never overtakes the unread part of the new run. */
+	i = 0;
+	j = rows;
+	k = 0;
+	while (i < rows && j < rows + count) {
+		if (etsu_compare (source, sort_info, full_header, sorted[i], map_table[j], cmp_cache) <= 0)
+			map_table[k++] = sorted[i++];
+		else
+			map_table[k++] = map_table[j++];
+	}
+
+	while (i < rows)
+		map_table[k++] = sorted[i++];
+
+	g_free (sorted);
+	e_table_sorting_utils_free_cmp_cache (cmp_cache);
+}
+
 gboolean
 e_table_sorting_utils_affects_sort (ETableSortInfo *sort_info,
                                     ETableHeader *full_header,
@@ -43,6 +43,12 @@ void		e_table_sorting_utils_sort	(ETableModel *source,
 						 ETableHeader *full_header,
 						 gint *map_table,
 						 gint rows);
+void		e_table_sorting_utils_merge	(ETableModel *source,
+						 ETableSortInfo *sort_info,
+						 ETableHeader *full_header,
+						 gint *map_table,
+						 gint rows,
+						 gint count);
 gint		e_table_sorting_utils_insert	(ETableModel *source,
 						 ETableSortInfo *sort_info,
 						 ETableHeader *full_header,
@@ -0,0 +1,427 @@
+/*
+ * e-trace.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * SECTION: e-trace
+ * @short_description: lightweight tracing of time spent
+ * @include: e-util/e-util.h
+ *
+ * These functions record spans of time, instant events and counters,
+ * tagged with the thread they happened on.  Tracing is disabled unless
+ * the EVOLUTION_TRACE environment variable names a file, in which case
+ * all events are written to that file on exit, or by e_trace_flush(),
+ * in the Chrome trace event format understood by chrome://tracing and
+ * the Perfetto UI.  When disabled, each call costs about as much as
+ * checking a flag.
+ *
+ * |[
+ * ETraceSpan span;
+ *
+ * e_trace_span_begin (&span, "mail", "load-folder");
+ * ...
+ * e_trace_span_end (&span, folder_name);
+ * ]|
+ **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "e-trace.h"
+
+#include <stdlib.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+#define TRACE_ENV_VARIABLE "EVOLUTION_TRACE"
+
+/* NULL while tracing is disabled. */
+static gchar *trace_filename;
+static gint trace_pid;
+
+/* Guards trace_events. */
+static GMutex trace_lock;
+static GString *trace_events;
+
+static GPrivate trace_thread_id;
+static gint trace_n_threads;
+
+static void
+trace_atexit (void)
+{
+	e_trace_flush ();
+}
+
+static void
+trace_init (void)
+{
+	const gchar *filename;
+
+	filename = g_getenv (TRACE_ENV_VARIABLE);
+	if (filename == NULL || *filename == '\0')
+		return;
+
+	trace_filename = g_strdup (filename);
+	trace_events = g_string_sized_new (64 * 1024);
+
+#ifdef G_OS_UNIX
+	trace_pid = getpid ();
+#endif
+
+	atexit (trace_atexit);
+}
+
+static gint
+trace_get_thread_id (void)
+{
+	gint thread_id;
+
+	thread_id = GPOINTER_TO_INT (g_private_get (&trace_thread_id));
+
+	if (thread_id == 0) {
+		thread_id = g_atomic_int_add (&trace_n_threads, 1) + 1;
+		g_private_set (&trace_thread_id, GINT_TO_POINTER (thread_id));
+	}
+
+	return thread_id;
+}
+
+static void
+trace_append_json_string (GString *buffer,
+                          const gchar *string)
+{
+	const gchar *cp;
+
+	g_string_append_c (buffer, '"');
+
+	for (cp = string; *cp != '\0'; cp++) {
+		switch (*cp) {
+			case '"':
+				g_string_append (buffer, "\\\"");
+				break;
+			case '\\':
+				g_string_append (buffer, "\\\\");
+				break;
+			case '\n':
+				g_string_append (buffer, "\\n");
+				break;
+			case '\t':
+				g_string_append (buffer, "\\t");
+				break;
+			default:
+				if ((guchar) *cp < 0x20)
+					g_string_append_printf (
+						buffer, "\\u%04x", (guchar) *cp);
+				else
+					g_string_append_c (buffer, *cp);
+				break;
+		}
+	}
+
+	g_string_append_c (buffer, '"');
+}
+
+/* Appends one event, @fields being the JSON members
+ * specific to the event type, without a leading comma. */
+static void
+trace_add_event (gchar phase,
+                 const gchar *category,
+                 const gchar *name,
+                 gint64 timestamp,
+                 const gchar *fields)
+{
+	gint thread_id;
+
+	thread_id = trace_get_thread_id ();
+
+	g_mutex_lock (&trace_lock);
+
+	if (trace_events->len > 0)
+		g_string_append (trace_events, ",\n");
+
+	g_string_append_printf (
+		trace_events, "{\"ph\":\"%c\",\"cat\":", phase);
+	trace_append_json_string (trace_events, category);
+	g_string_append (trace_events, ",\"name\":");
+	trace_append_json_string (trace_events, name);
+	g_string_append_printf (
+		trace_events,
+		",\"ts\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":%d",
+		timestamp, trace_pid, thread_id);
+
+	if (fields != NULL) {
+		g_string_append_c (trace_events, ',');
+		g_string_append (trace_events, fields);
+	}
+
+	g_string_append_c (trace_events, '}');
+
+	g_mutex_unlock (&trace_lock);
+}
+
+/**
+ * e_trace_is_enabled:
+ *
+ * Returns whether tracing is enabled, that is, whether the
+ * EVOLUTION_TRACE environment variable was set on first use.
+ *
+ * Returns: %TRUE if tracing is enabled
+ **/
+gboolean
+e_trace_is_enabled (void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter (&initialized)) {
+		trace_init ();
+		g_once_init_leave (&initialized, 1);
+	}
+
+	return trace_filename != NULL;
+}
+
+/**
+ * e_trace_span_begin:
+ * @span: an #ETraceSpan
+ * @category: the category of the span
+ * @name: the name of the span
+ *
+ * Starts recording a span of time, which is finished by
+ * e_trace_span_end().  The @category and @name strings are not
+ * copied and must outlive the span; string literals are best.
+ **/
+void
+e_trace_span_begin (ETraceSpan *span,
+                    const gchar *category,
+                    const gchar *name)
+{
+	g_return_if_fail (span != NULL);
+
+	span->category = category;
+	span->name = name;
+	span->start_time = e_trace_is_enabled () ? g_get_monotonic_time () : 0;
+}
+
+/**
+ * e_trace_span_end:
+ * @span: an #ETraceSpan
+ * @detail: additional information about the span, or %NULL
+ *
+ * Finishes the span started by e_trace_span_begin() and records it.
+ * Further calls for the same @span do nothing, until it is begun again.
+ **/
+void
+e_trace_span_end (ETraceSpan *span,
+                  const gchar *detail)
+{
+	g_return_if_fail (span != NULL);
+
+	if (span->start_time == 0)
+		return;
+
+	e_trace_complete (
+		span->category, span->name, detail,
+		span->start_time, g_get_monotonic_time ());
+
+	span->start_time = 0;
+}
+
+/**
+ * e_trace_complete:
+ * @category: the category of the span
+ * @name: the name of the span
+ * @detail: additional information about the span, or %NULL
+ * @start_time: when the span began, as returned by g_get_monotonic_time()
+ * @end_time: when the span ended, as returned by g_get_monotonic_time()
+ *
+ * Records a span of time on the calling thread, whose boundaries were
+ * measured by the caller.  Spans which did not take place on a thread,
+ * such as the time a job spent waiting in a queue, should be recorded
+ * with e_trace_async() instead.
+ **/
+void
+e_trace_complete (const gchar *category,
+                  const gchar *name,
+                  const gchar *detail,
+                  gint64 start_time,
+                  gint64 end_time)
+{
+	GString *fields;
+
+	if (!e_trace_is_enabled ())
+		return;
+
+	g_return_if_fail (category != NULL);
+	g_return_if_fail (name != NULL);
+
+	fields = g_string_new (NULL);
+	g_string_append_printf (
+		fields, "\"dur\":%" G_GINT64_FORMAT,
+		MAX (end_time - start_time, 0));
+
+	if (detail != NULL) {
+		g_string_append (fields, ",\"args\":{\"detail\":");
+		trace_append_json_string (fields, detail);
+		g_string_append_c (fields, '}');
+	}
+
+	trace_add_event ('X', category, name, start_time, fields->str);
+
+	g_string_free (fields, TRUE);
+}
+
+/**
+ * e_trace_async:
+ * @category: the category of the span
+ * @name: the name of the span
+ * @detail: additional information about the span, or %NULL
+ * @id: identifies the span among those of the same @category and @name
+ * @start_time: when the span began, as returned by g_get_monotonic_time()
+ * @end_time: when the span ended, as returned by g_get_monotonic_time()
+ *
+ * Records a span of time which is not bound to the calling thread, such
+ * as the time a job spent waiting in a queue.  It is shown on a track of
+ * its own, so it may overlap the spans of any thread.
+ **/
+void
+e_trace_async (const gchar *category,
+               const gchar *name,
+               const gchar *detail,
+               guint64 id,
+               gint64 start_time,
+               gint64 end_time)
+{
+	GString *fields;
+	gsize id_length;
+
+	if (!e_trace_is_enabled ())
+		return;
+
+	g_return_if_fail (category != NULL);
+	g_return_if_fail (name != NULL);
+
+	fields = g_string_new (NULL);
+	g_string_append_printf (
+		fields, "\"id\":\"0x%" G_GINT64_MODIFIER "x\"", id);
+	id_length = fields->len;
+
+	if (detail != NULL) {
+		g_string_append (fields, ",\"args\":{\"detail\":");
+		trace_append_json_string (fields, detail);
+		g_string_append_c (fields, '}');
+	}
+
+	trace_add_event ('b', category, name, start_time, fields->str);
+
+	/* The end event only needs the id to be matched up. */
+	g_string_truncate (fields, id_length);
+
+	trace_add_event (
+		'e', category, name,
+		MAX (end_time, start_time), fields->str);
+
+	g_string_free (fields, TRUE);
+}
+
+/**
+ * e_trace_instant:
+ * @category: the category of the event
+ * @name: the name of the event
+ *
+ * Records that something happened at this point in time.
+ **/
+void
+e_trace_instant (const gchar *category,
+                 const gchar *name)
+{
+	if (!e_trace_is_enabled ())
+		return;
+
+	g_return_if_fail (category != NULL);
+	g_return_if_fail (name != NULL);
+
+	trace_add_event (
+		'i', category, name,
+		g_get_monotonic_time (), "\"s\":\"p\"");
+}
+
+/**
+ * e_trace_counter:
+ * @category: the category of the counter
+ * @name: the name of the counter
+ * @value: the current value of the counter
+ *
+ * Records the current value of a counter, such as a queue length.
+ **/
+void
+e_trace_counter (const gchar *category,
+                 const gchar *name,
+                 gint64 value)
+{
+	gchar *fields;
+
+	if (!e_trace_is_enabled ())
+		return;
+
+	g_return_if_fail (category != NULL);
+	g_return_if_fail (name != NULL);
+
+	fields = g_strdup_printf (
+		"\"args\":{\"value\":%" G_GINT64_FORMAT "}", value);
+	trace_add_event ('C', category, name, g_get_monotonic_time (), fields);
+	g_free (fields);
+}
+
+/**
+ * e_trace_flush:
+ *
+ * Writes all events recorded so far to the trace file.  This happens
+ * automatically on exit, so it is only needed to look at a trace while
+ * the process is still running.
+ **/
+void
+e_trace_flush (void)
+{
+	GString *contents;
+	GError *error = NULL;
+
+	if (!e_trace_is_enabled ())
+		return;
+
+	contents = g_string_new ("{\"traceEvents\":[\n");
+
+	g_mutex_lock (&trace_lock);
+	g_string_append_len (
+		contents, trace_events->str, trace_events->len);
+	g_mutex_unlock (&trace_lock);
+
+	g_string_append (contents, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	g_file_set_contents (
+		trace_filename, contents->str, contents->len, &error);
+
+	if (error != NULL) {
+		g_warning (
+			"%s: Failed to write '%s': %s",
+			G_STRFUNC, trace_filename, error->message);
+		g_error_free (error);
+	}
+
+	g_string_free (contents, TRUE);
+}
@@ -0,0 +1,72 @@
+/*
+ * e-trace.h
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if !defined (__E_UTIL_H_INSIDE__) && !defined (LIBEUTIL_COMPILATION)
+#error "Only <e-util/e-util.h> should be included directly."
+#endif
+
+#ifndef E_TRACE_H
+#define E_TRACE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _ETraceSpan ETraceSpan;
+
+/**
+ * ETraceSpan:
+ * @category: the category of the span
+ * @name: the name of the span
+ * @start_time: monotonic time the span began, or 0 if tracing is disabled
+ *
+ * A span of time recorded by e_trace_span_begin() and e_trace_span_end().
+ * It is usually allocated on the stack.
+ **/
+struct _ETraceSpan {
+	const gchar *category;
+	const gchar *name;
+	gint64 start_time;
+};
+
+gboolean	e_trace_is_enabled		(void);
+void		e_trace_span_begin		(ETraceSpan *span,
+						 const gchar *category,
+						 const gchar *name);
+void		e_trace_span_end		(ETraceSpan *span,
+						 const gchar *detail);
+void		e_trace_complete		(const gchar *category,
+						 const gchar *name,
+						 const gchar *detail,
+						 gint64 start_time,
+						 gint64 end_time);
+void		e_trace_async			(const gchar *category,
+						 const gchar *name,
+						 const gchar *detail,
+						 guint64 id,
+						 gint64 start_time,
+						 gint64 end_time);
+void		e_trace_instant			(const gchar *category,
+						 const gchar *name);
+void		e_trace_counter			(const gchar *category,
+						 const gchar *name,
+						 gint64 value);
+void		e_trace_flush			(void);
+
+G_END_DECLS
+
+#endif /* E_TRACE_H */
@@ -795,6 +795,58 @@ e_tree_model_generator_set_generate_func (ETreeModelGenerator *tree_model_genera
 	tree_model_generator->priv->generate_func_data = data;
 }
 
+static void
+refilter_group (ETreeModelGenerator *tree_model_generator,
+                GtkTreeIter *parent_iter,
+                GtkTreePath *path)
+{
+	GtkTreeIter iter;
+	gboolean    result;
+
+	if (parent_iter)
+		result = gtk_tree_model_iter_children (tree_model_generator->priv->child_model, &iter, parent_iter);
+	else
+		result = gtk_tree_model_get_iter_first (tree_model_generator->priv->child_model, &iter);
+
+	if (!result)
+		return;
+
+	gtk_tree_path_down (path);
+
+	do {
+		child_row_changed (tree_model_generator, path, &iter);
+
+		if (gtk_tree_model_iter_has_child (tree_model_generator->priv->child_model, &iter))
+			refilter_group (tree_model_generator, &iter, path);
+
+		gtk_tree_path_next (path);
+	} while (gtk_tree_model_iter_next (tree_model_generator->priv->child_model, &iter));
+
+	gtk_tree_path_up (path);
+}
+
+/**
+ * e_tree_model_generator_refilter:
+ * @tree_model_generator: an #ETreeModelGenerator
+ *
+ * Runs the generate function again for every child row, emitting the
+ * appropriate row-inserted, row-deleted and row-changed signals. Call
+ * this after changing state the generate function depends on.
+ *
+ * Since: 3.12
+ **/
+void
+e_tree_model_generator_refilter (ETreeModelGenerator *tree_model_generator)
+{
+	GtkTreePath *path;
+
+	g_return_if_fail (E_IS_TREE_MODEL_GENERATOR (tree_model_generator));
+
+	path = gtk_tree_path_new ();
+	refilter_group (tree_model_generator, NULL, path);
+	gtk_tree_path_free (path);
+}
+
 /**
  * e_tree_model_generator_set_modify_func:
  * @tree_model_generator: an #ETreeModelGenerator
@@ -82,6 +82,7 @@ void		e_tree_model_generator_set_modify_func
 						 ETreeModelGeneratorModifyFunc func,
 						 gpointer data,
 						 GDestroyNotify destroy);
+void		e_tree_model_generator_refilter	(ETreeModelGenerator *tree_model_generator);
 GtkTreePath *	e_tree_model_generator_convert_child_path_to_path
 						(ETreeModelGenerator *tree_model_generator,
 						 GtkTreePath *child_path);
@@ -38,7 +38,12 @@
 #define STYLESHEET_URI \
 	"evo-file://" EVOLUTION_PRIVDATADIR "/theme/webview.css"
 
+/* How long formatting of the remaining parts may
+ * block the main loop in one go, when progressive. */
+#define PROGRESSIVE_STEP_BUDGET_USEC (10 * 1000)
+
 typedef struct _AsyncContext AsyncContext;
+typedef struct _ProgressiveContext ProgressiveContext;
 
 struct _EMailFormatterPrivate {
 	EMailImageLoadingPolicy image_loading_policy;
@@ -60,6 +65,16 @@ struct _AsyncContext {
 	EMailFormatterMode mode;
 };
 
+struct _ProgressiveContext {
+	EMailFormatter *formatter;
+	EMailFormatterContext *context;
+	GOutputStream *stream;
+	GCancellable *cancellable;
+
+	GQueue queue;	/* EMailParts, ref'ed */
+	GList *link;	/* next part to format */
+};
+
 /* internal formatter extensions */
 GType e_mail_formatter_attachment_get_type (void);
 GType e_mail_formatter_attachment_bar_get_type (void);
@@ -369,109 +384,130 @@ e_mail_formatter_constructed (GObject *object)
 	e_extensible_load_extensions (E_EXTENSIBLE (object));
 }
 
-static void
-mail_formatter_run (EMailFormatter *formatter,
-                    EMailFormatterContext *context,
-                    GOutputStream *stream,
-                    GCancellable *cancellable)
+/* Formats the part at *plink and moves *plink to the next part
+ * to format.  Returns FALSE when there is nothing more to format. */
+static gboolean
+mail_formatter_format_link (EMailFormatter *formatter,
+                            EMailFormatterContext *context,
+                            GList **plink,
+                            GOutputStream *stream,
+                            GCancellable *cancellable)
 {
-	GQueue queue = G_QUEUE_INIT;
-	GList *head, *link;
-	gchar *hdr;
-	const gchar *string;
-
-	hdr = e_mail_formatter_get_html_header (formatter);
-	g_output_stream_write_all (
-		stream, hdr, strlen (hdr), NULL, cancellable, NULL);
-	g_free (hdr);
+	GList *link = *plink;
+	EMailPart *part = link->data;
+	const gchar *part_id;
+	gboolean ok;
 
-	e_mail_part_list_queue_parts (context->part_list, NULL, &queue);
+	part_id = e_mail_part_get_id (part);
 
-	head = g_queue_peek_head_link (&queue);
+	if (g_cancellable_is_cancelled (cancellable))
+		return FALSE;
 
-	for (link = head; link != NULL; link = g_list_next (link)) {
-		EMailPart *part = link->data;
-		const gchar *part_id;
-		gboolean ok;
+	if (part->is_hidden && !part->is_error) {
+		if (e_mail_part_id_has_suffix (part, ".rfc822")) {
+			link = e_mail_formatter_find_rfc822_end_iter (link);
+		}
 
-		part_id = e_mail_part_get_id (part);
+		if (link == NULL)
+			return FALSE;
 
-		if (g_cancellable_is_cancelled (cancellable))
-			break;
+		goto next;
+	}
 
-		if (part->is_hidden && !part->is_error) {
-			if (e_mail_part_id_has_suffix (part, ".rfc822")) {
-				link = e_mail_formatter_find_rfc822_end_iter (link);
-			}
+	/* Force formatting as source if needed */
+	if (context->mode != E_MAIL_FORMATTER_MODE_SOURCE) {
+		const gchar *mime_type;
 
-			if (link == NULL)
-				break;
+		mime_type = e_mail_part_get_mime_type (part);
+		if (mime_type == NULL)
+			goto next;
 
-			continue;
-		}
+		ok = e_mail_formatter_format_as (
+			formatter, context, part, stream,
+			mime_type, cancellable);
 
-		/* Force formatting as source if needed */
-		if (context->mode != E_MAIL_FORMATTER_MODE_SOURCE) {
-			const gchar *mime_type;
+		/* If the written part was message/rfc822 then
+		 * jump to the end of the message, because content
+		 * of the whole message has been formatted by
+		 * message_rfc822 formatter */
+		if (ok && e_mail_part_id_has_suffix (part, ".rfc822")) {
+			link = e_mail_formatter_find_rfc822_end_iter (link);
 
-			mime_type = e_mail_part_get_mime_type (part);
-			if (mime_type == NULL)
-				continue;
+			if (link == NULL)
+				return FALSE;
 
-			ok = e_mail_formatter_format_as (
-				formatter, context, part, stream,
-				mime_type, cancellable);
+			goto next;
+		}
 
-			/* If the written part was message/rfc822 then
-			 * jump to the end of the message, because content
-			 * of the whole message has been formatted by
-			 * message_rfc822 formatter */
-			if (ok && e_mail_part_id_has_suffix (part, ".rfc822")) {
-				link = e_mail_formatter_find_rfc822_end_iter (link);
+	} else {
+		ok = FALSE;
+	}
 
-				if (link == NULL)
+	if (!ok) {
+		/* We don't want to source these */
+		if (e_mail_part_id_has_suffix (part, ".headers") ||
+		    e_mail_part_id_has_suffix (part, "attachment-bar"))
+			goto next;
+
+		e_mail_formatter_format_as (
+			formatter, context, part, stream,
+			"application/vnd.evolution.source", cancellable);
+
+		/* .message is the entire message. There's nothing more
+		 * to be written. */
+		if (g_strcmp0 (part_id, ".message") == 0)
+			return FALSE;
+
+		/* If we just wrote source of a rfc822 message, then jump
+		 * behind the message (otherwise source of all parts
+		 * would be rendered twice) */
+		if (e_mail_part_id_has_suffix (part, ".rfc822")) {
+
+			do {
+				part = link->data;
+				if (e_mail_part_id_has_suffix (part, ".rfc822.end"))
 					break;
 
-				continue;
-			}
+				link = g_list_next (link);
+			} while (link != NULL);
 
-		} else {
-			ok = FALSE;
+			if (link == NULL)
+				return FALSE;
 		}
+	}
 
-		if (!ok) {
-			/* We don't want to source these */
-			if (e_mail_part_id_has_suffix (part, ".headers") ||
-			    e_mail_part_id_has_suffix (part, "attachment-bar"))
-				continue;
+next:
+	*plink = g_list_next (link);
 
-			e_mail_formatter_format_as (
-				formatter, context, part, stream,
-				"application/vnd.evolution.source", cancellable);
+	return (*plink != NULL);
+}
 
-			/* .message is the entire message. There's nothing more
-			 * to be written. */
-			if (g_strcmp0 (part_id, ".message") == 0)
-				break;
+static void
+mail_formatter_run (EMailFormatter *formatter,
+                    EMailFormatterContext *context,
+                    GOutputStream *stream,
+                    GCancellable *cancellable)
+{
+	GQueue queue = G_QUEUE_INIT;
+	GList *link;
+	gchar *hdr;
+	const gchar *string;
+	ETraceSpan span;
 
-			/* If we just wrote source of a rfc822 message, then jump
-			 * behind the message (otherwise source of all parts
-			 * would be rendered twice) */
-			if (e_mail_part_id_has_suffix (part, ".rfc822")) {
+	e_trace_span_begin (&span, "mail", "format-message");
 
-				do {
-					part = link->data;
-					if (e_mail_part_id_has_suffix (part, ".rfc822.end"))
-						break;
+	hdr = e_mail_formatter_get_html_header (formatter);
+	g_output_stream_write_all (
+		stream, hdr, strlen (hdr), NULL, cancellable, NULL);
+	g_free (hdr);
 
-					link = g_list_next (link);
-				} while (link != NULL);
+	e_mail_part_list_queue_parts (context->part_list, NULL, &queue);
 
-				if (link == NULL)
-					break;
-			}
-		}
-	}
+	link = g_queue_peek_head_link (&queue);
+
+	while (link != NULL && mail_formatter_format_link (
+		formatter, context, &link, stream, cancellable))
+		;
 
 	while (!g_queue_is_empty (&queue))
 		g_object_unref (g_queue_pop_head (&queue));
@@ -480,6 +516,9 @@ mail_formatter_run (EMailFormatter *formatter,
 	g_output_stream_write_all (
 		stream, string, strlen (string),
 		NULL, cancellable, NULL);
+
+	e_trace_span_end (
+		&span, e_mail_part_list_get_message_uid (context->part_list));
 }
 
 static void
@@ -538,6 +577,9 @@ mail_formatter_update_style (EMailFormatter *formatter,
 static void
 e_mail_formatter_base_init (EMailFormatterClass *class)
 {
+	/* Load the modules extending us before collecting extensions. */
+	e_util_prepare_extension_point (G_TYPE_FROM_CLASS (class));
+
 	/* Register internal extensions. */
 	g_type_ensure (e_mail_formatter_attachment_get_type ());
 	g_type_ensure (e_mail_formatter_attachment_bar_get_type ());
@@ -929,6 +971,219 @@ e_mail_formatter_format_finish (EMailFormatter *formatter,
 	return !g_simple_async_result_propagate_error (simple, error);
 }
 
+static gboolean
+mail_formatter_part_is_expensive (EMailPart *part)
+{
+	/* Attachments and nested messages may need to be decoded,
+	 * decrypted or highlighted, and are rarely what the user
+	 * wants to see first. */
+	return e_mail_part_get_is_attachment (part) ||
+		e_mail_part_id_has_suffix (part, ".rfc822") ||
+		e_mail_part_id_has_suffix (part, "attachment-bar");
+}
+
+static void
+progressive_context_free (ProgressiveContext *progressive)
+{
+	while (!g_queue_is_empty (&progressive->queue))
+		g_object_unref (g_queue_pop_head (&progressive->queue));
+
+	mail_formatter_free_context (progressive->context);
+
+	g_clear_object (&progressive->formatter);
+	g_clear_object (&progressive->stream);
+	g_clear_object (&progressive->cancellable);
+
+	g_slice_free (ProgressiveContext, progressive);
+}
+
+static gboolean
+mail_formatter_progressive_step (ProgressiveContext *progressive,
+                                 gboolean first_paint)
+{
+	gint64 deadline;
+
+	deadline = g_get_monotonic_time () + PROGRESSIVE_STEP_BUDGET_USEC;
+
+	while (progressive->link != NULL) {
+		if (first_paint) {
+			if (mail_formatter_part_is_expensive (
+				progressive->link->data))
+				break;
+		} else if (g_get_monotonic_time () >= deadline) {
+			break;
+		}
+
+		if (!mail_formatter_format_link (
+			progressive->formatter, progressive->context,
+			&progressive->link, progressive->stream,
+			progressive->cancellable))
+			progressive->link = NULL;
+	}
+
+	if (progressive->link == NULL) {
+		const gchar *string = "</body></html>";
+
+		g_output_stream_write_all (
+			progressive->stream, string, strlen (string),
+			NULL, progressive->cancellable, NULL);
+	}
+
+	/* Let the reader see what we have so far. */
+	g_output_stream_flush (
+		progressive->stream, progressive->cancellable, NULL);
+
+	return (progressive->link != NULL);
+}
+
+static gboolean
+mail_formatter_progressive_idle_cb (gpointer user_data)
+{
+	GSimpleAsyncResult *simple = user_data;
+	ProgressiveContext *progressive;
+
+	progressive = g_simple_async_result_get_op_res_gpointer (simple);
+
+	if (mail_formatter_progressive_step (progressive, FALSE))
+		return TRUE;
+
+	g_simple_async_result_complete (simple);
+
+	return FALSE;
+}
+
+/**
+ * e_mail_formatter_format_progressive:
+ * @formatter: an #EMailFormatter
+ * @part_list: an #EMailPartList
+ * @stream: a #GOutputStream
+ * @flags: #EMailFormatterHeaderFlags
+ * @mode: an #EMailFormatterMode
+ * @callback: a #GAsyncReadyCallback to call when formatting is done
+ * @cancellable: (allow-none) an optional #GCancellable
+ * @user_data: data to pass to @callback
+ *
+ * Like e_mail_formatter_format(), but formats the parts in the calling
+ * thread, which is expected to be the main thread.  The HTML header and
+ * the leading parts, up to the first attachment or nested message, are
+ * written before this function returns.  The remaining parts are written
+ * from idle callbacks, a few at a time.  @stream is flushed after each
+ * batch, so that a reader on its other end can render the message as it
+ * is being formatted.
+ *
+ * Formatters which override the #EMailFormatterClass.run method format
+ * the whole message at once.
+ *
+ * When done, @callback is called.  Call
+ * e_mail_formatter_format_progressive_finish() to get the result.
+ *
+ * Since: 3.12
+ **/
+void
+e_mail_formatter_format_progressive (EMailFormatter *formatter,
+                                     EMailPartList *part_list,
+                                     GOutputStream *stream,
+                                     EMailFormatterHeaderFlags flags,
+                                     EMailFormatterMode mode,
+                                     GAsyncReadyCallback callback,
+                                     GCancellable *cancellable,
+                                     gpointer user_data)
+{
+	GSimpleAsyncResult *simple;
+	ProgressiveContext *progressive;
+	EMailFormatterClass *class;
+	GSource *idle_source;
+	gchar *hdr;
+
+	g_return_if_fail (E_IS_MAIL_FORMATTER (formatter));
+	g_return_if_fail (E_IS_MAIL_PART_LIST (part_list));
+	g_return_if_fail (G_IS_OUTPUT_STREAM (stream));
+
+	class = E_MAIL_FORMATTER_GET_CLASS (formatter);
+	g_return_if_fail (class->run != NULL);
+
+	simple = g_simple_async_result_new (
+		G_OBJECT (formatter), callback, user_data,
+		e_mail_formatter_format_progressive);
+
+	g_simple_async_result_set_check_cancellable (simple, cancellable);
+
+	if (class->run != mail_formatter_run) {
+		e_mail_formatter_format_sync (
+			formatter, part_list, stream,
+			flags, mode, cancellable);
+		g_simple_async_result_complete_in_idle (simple);
+		g_object_unref (simple);
+		return;
+	}
+
+	progressive = g_slice_new0 (ProgressiveContext);
+	progressive->formatter = g_object_ref (formatter);
+	progressive->context = mail_formatter_create_context (
+		formatter, part_list, mode, flags);
+	progressive->stream = g_object_ref (stream);
+	if (cancellable != NULL)
+		progressive->cancellable = g_object_ref (cancellable);
+
+	g_simple_async_result_set_op_res_gpointer (
+		simple, progressive, (GDestroyNotify) progressive_context_free);
+
+	hdr = e_mail_formatter_get_html_header (formatter);
+	g_output_stream_write_all (
+		stream, hdr, strlen (hdr), NULL, cancellable, NULL);
+	g_free (hdr);
+
+	e_mail_part_list_queue_parts (part_list, NULL, &progressive->queue);
+	progressive->link = g_queue_peek_head_link (&progressive->queue);
+
+	if (!mail_formatter_progressive_step (progressive, TRUE)) {
+		g_simple_async_result_complete_in_idle (simple);
+		g_object_unref (simple);
+		return;
+	}
+
+	/* Below redraws, so the first parts get painted right away. */
+	idle_source = g_idle_source_new ();
+	g_source_set_priority (idle_source, G_PRIORITY_DEFAULT_IDLE);
+	g_source_set_callback (
+		idle_source,
+		mail_formatter_progressive_idle_cb,
+		simple, (GDestroyNotify) g_object_unref);
+	g_source_attach (
+		idle_source, g_main_context_get_thread_default ());
+	g_source_unref (idle_source);
+}
+
+/**
+ * e_mail_formatter_format_progressive_finish:
+ * @formatter: an #EMailFormatter
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes the operation started with e_mail_formatter_format_progressive().
+ *
+ * Returns: %TRUE on success, %FALSE on failure
+ *
+ * Since: 3.12
+ **/
+gboolean
+e_mail_formatter_format_progressive_finish (EMailFormatter *formatter,
+                                            GAsyncResult *result,
+                                            GError **error)
+{
+	GSimpleAsyncResult *simple;
+
+	g_return_val_if_fail (
+		g_simple_async_result_is_valid (
+		result, G_OBJECT (formatter),
+		e_mail_formatter_format_progressive), FALSE);
+
+	simple = G_SIMPLE_ASYNC_RESULT (result);
+
+	/* Assume success unless a GError is set. */
+	return !g_simple_async_result_propagate_error (simple, error);
+}
+
 /**
  * e_mail_formatter_format_as:
  * @formatter: an #EMailFormatter
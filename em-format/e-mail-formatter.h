@@ -112,6 +112,20 @@ gboolean	e_mail_formatter_format_finish	(EMailFormatter *formatter,
 						 GAsyncResult *result,
 						 GError **error);
 
+void		e_mail_formatter_format_progressive
+						(EMailFormatter *formatter,
+						 EMailPartList *part_list,
+						 GOutputStream *stream,
+						 EMailFormatterHeaderFlags flags,
+						 EMailFormatterMode mode,
+						 GAsyncReadyCallback callback,
+						 GCancellable *cancellable,
+						 gpointer user_data);
+gboolean	e_mail_formatter_format_progressive_finish
+						(EMailFormatter *formatter,
+						 GAsyncResult *result,
+						 GError **error);
+
 gboolean	e_mail_formatter_format_as	(EMailFormatter *formatter,
 						 EMailFormatterContext *context,
 						 EMailPart *part,
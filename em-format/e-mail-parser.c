@@ -91,6 +91,7 @@ mail_parser_run (EMailParser *parser,
 	GQueue mail_part_queue = G_QUEUE_INIT;
 	GList *iter;
 	GString *part_id;
+	ETraceSpan span;
 
 	message = e_mail_part_list_get_message (part_list);
 
@@ -107,6 +108,8 @@ mail_parser_run (EMailParser *parser,
 	 * extensions were not loaded. Something is terribly wrong! */
 	g_return_if_fail (parsers != NULL);
 
+	e_trace_span_begin (&span, "mail", "parse-message");
+
 	part_id = g_string_new (".message");
 
 	mail_part = e_mail_part_new (CAMEL_MIME_PART (message), ".message");
@@ -140,6 +143,9 @@ mail_parser_run (EMailParser *parser,
 	}
 
 	g_string_free (part_id, TRUE);
+
+	e_trace_span_end (
+		&span, e_mail_part_list_get_message_uid (part_list));
 }
 
 static void
@@ -204,6 +210,9 @@ e_mail_parser_finalize (GObject *object)
 static void
 e_mail_parser_base_init (EMailParserClass *class)
 {
+	/* Load the modules extending us before collecting extensions. */
+	e_util_prepare_extension_point (G_TYPE_FROM_CLASS (class));
+
 	/* Register internal extensions. */
 	g_type_ensure (e_mail_parser_application_mbox_get_type ());
 	g_type_ensure (e_mail_parser_attachment_bar_get_type ());
@@ -23,6 +23,26 @@
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), E_TYPE_MAIL_PART_LIST, EMailPartListPrivate))
 
+/* Approximate memory the cache of recently parsed
+ * messages may hold on to, see e_mail_part_list_cache_add(). */
+#define CACHE_MAX_SIZE (32 * 1024 * 1024)
+
+typedef struct _CacheEntry CacheEntry;
+typedef struct _CacheFolder CacheFolder;
+
+struct _CacheEntry {
+	gchar *mail_uri;
+	EMailPartList *part_list;
+	gsize size;
+};
+
+/* Watches a folder with cached part lists for messages going away. */
+struct _CacheFolder {
+	guint n_entries;
+	gulong changed_handler_id;
+	gulong deleted_handler_id;
+};
+
 struct _EMailPartListPrivate {
 	CamelFolder *folder;
 	CamelMimeMessage *message;
@@ -44,6 +64,13 @@ G_DEFINE_TYPE (EMailPartList, e_mail_part_list, G_TYPE_OBJECT)
 static CamelObjectBag *registry = NULL;
 G_LOCK_DEFINE_STATIC (registry);
 
+/* Most recently used entries at the head. */
+static GQueue cache_queue = G_QUEUE_INIT;
+static GHashTable *cache_index = NULL;	/* mail_uri -> GList link */
+static GHashTable *cache_folders = NULL;	/* CamelFolder -> CacheFolder */
+static gsize cache_size = 0;
+G_LOCK_DEFINE_STATIC (cache);
+
 static void
 mail_part_list_set_folder (EMailPartList *part_list,
                            CamelFolder *folder)
@@ -416,6 +443,259 @@ e_mail_part_list_is_empty (EMailPartList *part_list)
 	return is_empty;
 }
 
+static gsize
+mail_part_list_estimate_size (EMailPartList *part_list)
+{
+	CamelFolder *folder;
+	const gchar *message_uid;
+	gsize size = 0;
+	guint n_parts;
+
+	folder = part_list->priv->folder;
+	message_uid = part_list->priv->message_uid;
+
+	if (folder != NULL && message_uid != NULL) {
+		CamelMessageInfo *info;
+
+		info = camel_folder_get_message_info (folder, message_uid);
+		if (info != NULL) {
+			size = camel_message_info_size (info);
+			camel_message_info_unref (info);
+		}
+	}
+
+	g_mutex_lock (&part_list->priv->queue_lock);
+	n_parts = g_queue_get_length (&part_list->priv->queue);
+	g_mutex_unlock (&part_list->priv->queue_lock);
+
+	/* The raw message, its decoded parts and their bookkeeping. */
+	return 2 * size + 1024 * n_parts + 4096;
+}
+
+static void
+mail_part_list_cache_entry_free (CacheEntry *entry)
+{
+	g_free (entry->mail_uri);
+	g_object_unref (entry->part_list);
+
+	g_slice_free (CacheEntry, entry);
+}
+
+static void	mail_part_list_cache_folder_changed_cb
+						(CamelFolder *folder,
+						 CamelFolderChangeInfo *changes);
+static void	mail_part_list_cache_folder_deleted_cb
+						(CamelFolder *folder);
+
+/* Must be called with the cache lock held. */
+static void
+mail_part_list_cache_watch_folder (CamelFolder *folder)
+{
+	CacheFolder *cache_folder;
+
+	if (folder == NULL)
+		return;
+
+	if (cache_folders == NULL)
+		cache_folders = g_hash_table_new (NULL, NULL);
+
+	cache_folder = g_hash_table_lookup (cache_folders, folder);
+
+	if (cache_folder == NULL) {
+		cache_folder = g_slice_new0 (CacheFolder);
+		cache_folder->changed_handler_id = g_signal_connect (
+			folder, "changed",
+			G_CALLBACK (mail_part_list_cache_folder_changed_cb),
+			NULL);
+		cache_folder->deleted_handler_id = g_signal_connect (
+			folder, "deleted",
+			G_CALLBACK (mail_part_list_cache_folder_deleted_cb),
+			NULL);
+		g_hash_table_insert (cache_folders, folder, cache_folder);
+	}
+
+	cache_folder->n_entries++;
+}
+
+/* Must be called with the cache lock held. */
+static void
+mail_part_list_cache_unwatch_folder (CamelFolder *folder)
+{
+	CacheFolder *cache_folder;
+
+	if (folder == NULL || cache_folders == NULL)
+		return;
+
+	cache_folder = g_hash_table_lookup (cache_folders, folder);
+	g_return_if_fail (cache_folder != NULL);
+
+	if (--cache_folder->n_entries > 0)
+		return;
+
+	g_signal_handler_disconnect (
+		folder, cache_folder->changed_handler_id);
+	g_signal_handler_disconnect (
+		folder, cache_folder->deleted_handler_id);
+
+	g_hash_table_remove (cache_folders, folder);
+	g_slice_free (CacheFolder, cache_folder);
+}
+
+/* Takes the entry out of the cache and returns it, to be freed once
+ * the cache lock is released.  Must be called with the lock held. */
+static CacheEntry *
+mail_part_list_cache_steal_link (GList *link)
+{
+	CacheEntry *entry = link->data;
+
+	g_hash_table_remove (cache_index, entry->mail_uri);
+	g_queue_delete_link (&cache_queue, link);
+	cache_size -= entry->size;
+
+	mail_part_list_cache_unwatch_folder (
+		entry->part_list->priv->folder);
+
+	return entry;
+}
+
+/* Drops the cached part lists of @folder, either all of them or only
+ * those of the messages in @message_uids. */
+static void
+mail_part_list_cache_remove (CamelFolder *folder,
+                             GPtrArray *message_uids)
+{
+	GSList *evicted = NULL;
+	GList *link;
+
+	G_LOCK (cache);
+
+	link = g_queue_peek_head_link (&cache_queue);
+
+	while (link != NULL) {
+		CacheEntry *entry = link->data;
+		EMailPartListPrivate *priv = entry->part_list->priv;
+		GList *next = g_list_next (link);
+		gboolean remove;
+		guint ii;
+
+		remove = (priv->folder == folder);
+
+		if (remove && message_uids != NULL) {
+			remove = FALSE;
+
+			for (ii = 0; !remove && ii < message_uids->len; ii++)
+				remove = (g_strcmp0 (
+					priv->message_uid,
+					message_uids->pdata[ii]) == 0);
+		}
+
+		if (remove)
+			evicted = g_slist_prepend (
+				evicted,
+				mail_part_list_cache_steal_link (link));
+
+		link = next;
+	}
+
+	G_UNLOCK (cache);
+
+	g_slist_free_full (
+		evicted, (GDestroyNotify)
+		mail_part_list_cache_entry_free);
+}
+
+static void
+mail_part_list_cache_folder_changed_cb (CamelFolder *folder,
+                                        CamelFolderChangeInfo *changes)
+{
+	if (changes->uid_removed->len > 0)
+		mail_part_list_cache_remove (folder, changes->uid_removed);
+}
+
+static void
+mail_part_list_cache_folder_deleted_cb (CamelFolder *folder)
+{
+	mail_part_list_cache_remove (folder, NULL);
+}
+
+/**
+ * e_mail_part_list_cache_add:
+ * @mail_uri: the URI @part_list is registered under
+ * @part_list: an #EMailPartList
+ *
+ * Keeps a reference to @part_list in a cache of recently parsed messages,
+ * so that it stays in the registry returned by
+ * e_mail_part_list_get_registry() after its last user drops it.  Adding
+ * a @mail_uri which is already cached marks it as recently used.
+ *
+ * The cache holds on to a limited amount of memory, the least recently
+ * used part lists are released first.  Part lists of messages removed
+ * from their folder, or of a deleted folder, are released right away.
+ *
+ * Since: 3.12
+ **/
+void
+e_mail_part_list_cache_add (const gchar *mail_uri,
+                            EMailPartList *part_list)
+{
+	CacheEntry *entry;
+	GList *link;
+	GSList *evicted = NULL;
+	gsize size;
+
+	g_return_if_fail (mail_uri != NULL);
+	g_return_if_fail (E_IS_MAIL_PART_LIST (part_list));
+
+	/* This looks the message up in the folder summary,
+	 * which has a lock of its own, so do it beforehand. */
+	size = mail_part_list_estimate_size (part_list);
+
+	G_LOCK (cache);
+
+	if (cache_index == NULL)
+		cache_index = g_hash_table_new (g_str_hash, g_str_equal);
+
+	link = g_hash_table_lookup (cache_index, mail_uri);
+
+	if (link != NULL && ((CacheEntry *) link->data)->part_list == part_list) {
+		/* Just move it to the head. */
+		g_queue_unlink (&cache_queue, link);
+		g_queue_push_head_link (&cache_queue, link);
+		G_UNLOCK (cache);
+		return;
+	}
+
+	/* The message was parsed again, replace the entry. */
+	if (link != NULL)
+		evicted = g_slist_prepend (
+			evicted, mail_part_list_cache_steal_link (link));
+
+	entry = g_slice_new0 (CacheEntry);
+	entry->mail_uri = g_strdup (mail_uri);
+	entry->part_list = g_object_ref (part_list);
+	entry->size = size;
+
+	g_queue_push_head (&cache_queue, entry);
+	g_hash_table_insert (cache_index, entry->mail_uri, cache_queue.head);
+	cache_size += entry->size;
+
+	mail_part_list_cache_watch_folder (part_list->priv->folder);
+
+	/* Always keep the most recent entry, however large. */
+	while (cache_size > CACHE_MAX_SIZE && cache_queue.length > 1)
+		evicted = g_slist_prepend (
+			evicted, mail_part_list_cache_steal_link (
+			g_queue_peek_tail_link (&cache_queue)));
+
+	G_UNLOCK (cache);
+
+	/* Finalizing a part list takes the registry lock,
+	 * so release the evicted entries without holding ours. */
+	g_slist_free_full (
+		evicted, (GDestroyNotify)
+		mail_part_list_cache_entry_free);
+}
+
 /**
  * e_mail_part_list_get_registry:
  *
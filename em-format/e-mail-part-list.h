@@ -75,6 +75,8 @@ gboolean	e_mail_part_list_is_empty	(EMailPartList *part_list);
 
 CamelObjectBag *
 		e_mail_part_list_get_registry	(void);
+void		e_mail_part_list_cache_add	(const gchar *mail_uri,
+						 EMailPartList *part_list);
 
 G_END_DECLS
 
@@ -73,6 +73,11 @@ struct _MailFolderCachePrivate {
 
 	GQueue local_folder_uris;
 	GQueue remote_folder_uris;
+
+	/* Plain updates not yet emitted, by store UID and folder name.
+	 * Further updates for the same folder are merged into these. */
+	GHashTable *pending_updates;
+	GMutex pending_updates_lock;
 };
 
 enum {
@@ -155,6 +160,9 @@ struct _UpdateClosure {
 	gchar *msg_uid;
 	gchar *msg_sender;
 	gchar *msg_subject;
+
+	/* set while listed in pending_updates */
+	gchar *pending_key;
 };
 
 /* Forward Declarations */
@@ -472,10 +480,47 @@ update_closure_free (UpdateClosure *closure)
 	g_free (closure->msg_uid);
 	g_free (closure->msg_sender);
 	g_free (closure->msg_subject);
+	g_free (closure->pending_key);
 
 	g_slice_free (UpdateClosure, closure);
 }
 
+/* Folds a later plain update into a pending one for the same folder. */
+static void
+update_closure_merge (UpdateClosure *closure,
+                      UpdateClosure *later)
+{
+	closure->unread = later->unread;
+
+	if (later->new_messages == 0)
+		return;
+
+	if (closure->new_messages == 0) {
+		g_free (closure->msg_uid);
+		g_free (closure->msg_sender);
+		g_free (closure->msg_subject);
+
+		closure->msg_uid = later->msg_uid;
+		closure->msg_sender = later->msg_sender;
+		closure->msg_subject = later->msg_subject;
+
+		later->msg_uid = NULL;
+		later->msg_sender = NULL;
+		later->msg_subject = NULL;
+	} else {
+		/* More than one new message, no details then. */
+		g_free (closure->msg_uid);
+		g_free (closure->msg_sender);
+		g_free (closure->msg_subject);
+
+		closure->msg_uid = NULL;
+		closure->msg_sender = NULL;
+		closure->msg_subject = NULL;
+	}
+
+	closure->new_messages += later->new_messages;
+}
+
 static StoreInfo *
 mail_folder_cache_new_store_info (MailFolderCache *cache,
                                   CamelStore *store)
@@ -626,6 +671,14 @@ mail_folder_cache_update_idle_cb (gpointer user_data)
 
 	cache = g_weak_ref_get (&closure->cache);
 
+	/* Stop accepting merges before looking at the closure. */
+	if (cache != NULL && closure->pending_key != NULL) {
+		g_mutex_lock (&cache->priv->pending_updates_lock);
+		if (g_hash_table_lookup (cache->priv->pending_updates, closure->pending_key) == closure)
+			g_hash_table_remove (cache->priv->pending_updates, closure->pending_key);
+		g_mutex_unlock (&cache->priv->pending_updates_lock);
+	}
+
 	if (cache != NULL) {
 		if (closure->signal_id == signals[FOLDER_DELETED]) {
 			g_signal_emit (
@@ -718,13 +771,49 @@ mail_folder_cache_submit_update (UpdateClosure *closure)
 {
 	GMainContext *main_context;
 	MailFolderCache *cache;
+	UpdateClosure *pending;
 	GSource *idle_source;
+	gchar *key;
 
 	g_return_if_fail (closure != NULL);
 
 	cache = g_weak_ref_get (&closure->cache);
 	g_return_if_fail (cache != NULL);
 
+	key = g_strdup_printf (
+		"%s\n%s", camel_service_get_uid (
+		CAMEL_SERVICE (closure->store)), closure->full_name);
+
+	g_mutex_lock (&cache->priv->pending_updates_lock);
+
+	pending = g_hash_table_lookup (cache->priv->pending_updates, key);
+
+	if (closure->signal_id != 0) {
+		/* Keep later updates from being merged across this one. */
+		if (pending != NULL)
+			g_hash_table_remove (cache->priv->pending_updates, key);
+		pending = NULL;
+	} else if (pending != NULL) {
+		/* A burst of changes to the same folder results
+		 * in a single emission of the latest state. */
+		update_closure_merge (pending, closure);
+	} else {
+		closure->pending_key = g_strdup (key);
+		g_hash_table_insert (
+			cache->priv->pending_updates,
+			g_strdup (key), closure);
+	}
+
+	g_mutex_unlock (&cache->priv->pending_updates_lock);
+
+	g_free (key);
+
+	if (pending != NULL) {
+		update_closure_free (closure);
+		g_object_unref (cache);
+		return;
+	}
+
 	main_context = mail_folder_cache_ref_main_context (cache);
 
 	idle_source = g_idle_source_new ();
@@ -1301,6 +1390,9 @@ mail_folder_cache_finalize (GObject *object)
 	while (!g_queue_is_empty (&priv->remote_folder_uris))
 		g_free (g_queue_pop_head (&priv->remote_folder_uris));
 
+	g_hash_table_destroy (priv->pending_updates);
+	g_mutex_clear (&priv->pending_updates_lock);
+
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (mail_folder_cache_parent_class)->finalize (object);
 }
@@ -1630,6 +1722,14 @@ mail_folder_cache_init (MailFolderCache *cache)
 
 	g_queue_init (&cache->priv->local_folder_uris);
 	g_queue_init (&cache->priv->remote_folder_uris);
+
+	/* Values are owned by their idle callbacks. */
+	cache->priv->pending_updates = g_hash_table_new_full (
+		(GHashFunc) g_str_hash,
+		(GEqualFunc) g_str_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) NULL);
+	g_mutex_init (&cache->priv->pending_updates_lock);
 }
 
 MailFolderCache *
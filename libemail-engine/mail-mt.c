@@ -218,10 +218,12 @@ mail_msg_unref (gpointer msg)
 	}
 }
 
-void
-mail_msg_check_error (gpointer msg)
+/* If @reported_errors is given, an error already reported for the same
+ * kind of message with the same text is not alerted about again. */
+static void
+mail_msg_check_error_full (MailMsg *m,
+                           GHashTable *reported_errors)
 {
-	MailMsg *m = msg;
 
 #ifdef MALLOC_CHECK
 	checkmem (m);
@@ -250,6 +252,19 @@ mail_msg_check_error (gpointer msg)
 		CAMEL_FOLDER_ERROR_INVALID_UID))
 		return;
 
+	if (reported_errors != NULL) {
+		gchar *key;
+
+		key = g_strdup_printf ("%p\n%s", m->info, m->error->message);
+
+		if (g_hash_table_contains (reported_errors, key)) {
+			g_free (key);
+			return;
+		}
+
+		g_hash_table_add (reported_errors, key);
+	}
+
 	/* FIXME: Submit an error on the dbus */
 	if (alert_error) {
 		gchar *what;
@@ -262,6 +277,12 @@ mail_msg_check_error (gpointer msg)
 	}
 }
 
+void
+mail_msg_check_error (gpointer msg)
+{
+	mail_msg_check_error_full (msg, NULL);
+}
+
 void
 mail_msg_cancel (guint msgid)
 {
@@ -311,10 +332,18 @@ static GAsyncQueue *main_loop_queue = NULL;
 static GAsyncQueue *msg_reply_queue = NULL;
 static GThread *main_thread = NULL;
 
+/* Completions are dispatched for at most this long per main loop
+ * iteration.  Whatever is left is picked up by a lower priority idle
+ * callback, so GTK+ gets to redraw in between during a large burst. */
+#define MAIL_MSG_IDLE_BUDGET_USEC (8 * 1000)
+
 static gboolean
 mail_msg_idle_cb (void)
 {
 	MailMsg *msg;
+	GHashTable *reported_errors;
+	gint64 deadline;
+	gboolean pending;
 
 	g_return_val_if_fail (main_loop_queue != NULL, FALSE);
 	g_return_val_if_fail (msg_reply_queue != NULL, FALSE);
@@ -322,8 +351,12 @@ mail_msg_idle_cb (void)
 	G_LOCK (idle_source_id);
 	idle_source_id = 0;
 	G_UNLOCK (idle_source_id);
+
+	deadline = g_get_monotonic_time () + MAIL_MSG_IDLE_BUDGET_USEC;
+
 	/* check the main loop queue */
-	while ((msg = g_async_queue_try_pop (main_loop_queue)) != NULL) {
+	while (g_get_monotonic_time () < deadline &&
+	       (msg = g_async_queue_try_pop (main_loop_queue)) != NULL) {
 		GCancellable *cancellable;
 
 		cancellable = msg->cancellable;
@@ -340,13 +373,38 @@ mail_msg_idle_cb (void)
 		mail_msg_unref (msg);
 	}
 
+	/* A burst of failures of the same kind, say while filtering
+	 * lots of messages, gets alerted about once per batch. */
+	reported_errors = g_hash_table_new_full (
+		g_str_hash, g_str_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) NULL);
+
 	/* check the reply queue */
-	while ((msg = g_async_queue_try_pop (msg_reply_queue)) != NULL) {
+	while (g_get_monotonic_time () < deadline &&
+	       (msg = g_async_queue_try_pop (msg_reply_queue)) != NULL) {
 		if (msg->info->done != NULL)
 			msg->info->done (msg);
-		mail_msg_check_error (msg);
+		mail_msg_check_error_full (msg, reported_errors);
 		mail_msg_unref (msg);
 	}
+
+	g_hash_table_destroy (reported_errors);
+
+	pending =
+		g_async_queue_length (main_loop_queue) > 0 ||
+		g_async_queue_length (msg_reply_queue) > 0;
+
+	if (pending) {
+		G_LOCK (idle_source_id);
+		if (idle_source_id == 0)
+			/* Leave room for GTK+ redraws this time. */
+			idle_source_id = g_idle_add_full (
+				G_PRIORITY_DEFAULT_IDLE,
+				(GSourceFunc) mail_msg_idle_cb, NULL, NULL);
+		G_UNLOCK (idle_source_id);
+	}
+
 	return FALSE;
 }
 
@@ -386,19 +444,6 @@ mail_msg_proxy (MailMsg *msg)
 	G_UNLOCK (idle_source_id);
 }
 
-void
-mail_msg_init (void)
-{
-	g_mutex_init (&mail_msg_lock);
-	g_cond_init (&mail_msg_cond);
-
-	main_loop_queue = g_async_queue_new ();
-	msg_reply_queue = g_async_queue_new ();
-
-	mail_msg_active_table = g_hash_table_new (NULL, NULL);
-	main_thread = g_thread_self ();
-}
-
 static gint
 mail_msg_compare (const MailMsg *msg1,
                   const MailMsg *msg2)
@@ -412,19 +457,398 @@ mail_msg_compare (const MailMsg *msg1,
 	return (priority1 < priority2) ? 1 : -1;
 }
 
-static gpointer
-create_thread_pool (gpointer data)
+/* **************************************** */
+
+/* Messages run either on the shared unordered pool, or on an ordered
+ * lane.  Each lane runs its messages one at a time, highest priority
+ * first and in submission order otherwise, but distinct lanes run
+ * independently of each other.  There is one lane per CamelStore for
+ * mail_msg_store_ordered_push(), plus the two global fast and slow
+ * ordered lanes.  A runnable lane is handed to the lane pool, whose
+ * idle workers pick up whichever lane is next, one message at a time,
+ * so a busy lane never holds on to a worker another lane could use.
+ *
+ * A message pushed with mail_msg_stores_ordered_push() sits in two
+ * lanes at once.  The first lane to reach it stops there until the
+ * other lane reaches it too, and the message then runs on the latter.
+ * Nothing may overtake such a message, whatever its priority, which
+ * keeps them in the same order in every lane, so lanes waiting for
+ * each other cannot deadlock. */
+
+typedef struct _MailMsgJob MailMsgJob;
+typedef struct _MailMsgLane MailMsgLane;
+
+struct _MailMsgJob {
+	MailMsg *msg;
+	gint64 queued_time;
+
+	MailMsgLane *lanes[2];	/* lanes the job is queued in */
+	guint n_lanes;
+	guint n_reached;	/* lanes that have got to the job */
+};
+
+struct _MailMsgLane {
+	gchar *name;
+	GQueue queue;		/* MailMsgJob, ordered by priority */
+	gboolean scheduled;	/* queued on or running in lane_pool */
+	gboolean orphaned;	/* its store is gone, free when idle */
+
+	/* Statistics, all times in microseconds. */
+	guint n_completed;
+	gint64 total_wait_time;
+	gint64 max_wait_time;
+	gint64 total_exec_time;
+};
+
+/* Guards all lane queues, state and statistics. */
+static GMutex lanes_lock;
+static GHashTable *store_lanes;	/* CamelStore -> MailMsgLane */
+static MailMsgLane *fast_ordered_lane;
+static MailMsgLane *slow_ordered_lane;
+static MailMsgLane *unordered_lane;	/* statistics only */
+
+static GThreadPool *unordered_pool;
+static GThreadPool *lane_pool;
+
+static void	mail_msg_lane_run		(MailMsgLane *lane,
+						 gpointer user_data);
+static void	mail_msg_unordered_run		(MailMsgJob *job,
+						 gpointer user_data);
+
+static MailMsgLane *
+mail_msg_lane_new (const gchar *name)
+{
+	MailMsgLane *lane;
+
+	lane = g_slice_new0 (MailMsgLane);
+	lane->name = g_strdup (name);
+	g_queue_init (&lane->queue);
+
+	return lane;
+}
+
+static void
+mail_msg_lane_free (MailMsgLane *lane)
+{
+	g_free (lane->name);
+	g_slice_free (MailMsgLane, lane);
+}
+
+static gint
+mail_msg_job_compare (const MailMsgJob *job1,
+                      const MailMsgJob *job2,
+                      gpointer user_data)
+{
+	gint result;
+
+	result = mail_msg_compare (job1->msg, job2->msg);
+
+	/* Keep messages of equal priority in submission order. */
+	if (result == 0 && job1->msg->seq != job2->msg->seq)
+		result = (job1->msg->seq < job2->msg->seq) ? -1 : 1;
+
+	return result;
+}
+
+/* Sets up the lanes on first use, so messages pushed before
+ * mail_msg_init() has been called still find somewhere to run. */
+static void
+mail_msg_lanes_ensure (void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter (&initialized)) {
+		/* Lanes are tiny and there is one per account at most,
+		 * so they are kept around for the statistics' sake until
+		 * their store goes away. */
+		store_lanes = g_hash_table_new (NULL, NULL);
+		fast_ordered_lane = mail_msg_lane_new ("fast-ordered");
+		slow_ordered_lane = mail_msg_lane_new ("slow-ordered");
+		unordered_lane = mail_msg_lane_new ("unordered");
+
+		/* once created, run forever */
+		unordered_pool = g_thread_pool_new (
+			(GFunc) mail_msg_unordered_run, NULL, 10, FALSE, NULL);
+		g_thread_pool_set_sort_function (
+			unordered_pool,
+			(GCompareDataFunc) mail_msg_job_compare, NULL);
+
+		/* Each lane occupies at most one worker at a time, so the
+		 * number of workers is bounded by the number of lanes. */
+		lane_pool = g_thread_pool_new (
+			(GFunc) mail_msg_lane_run, NULL, -1, FALSE, NULL);
+
+		g_once_init_leave (&initialized, 1);
+	}
+}
+
+static MailMsgJob *
+mail_msg_job_new (MailMsg *msg)
+{
+	MailMsgJob *job;
+
+	job = g_slice_new0 (MailMsgJob);
+	job->msg = msg;
+	job->queued_time = g_get_monotonic_time ();
+
+	return job;
+}
+
+static void
+mail_msg_job_run (MailMsgJob *job,
+                  MailMsgLane *lane)
+{
+	gint64 started, finished;
+
+	started = g_get_monotonic_time ();
+
+	/* The wait is tracked per job, not on this worker thread. */
+	e_trace_async (
+		"mail-msg", "wait", lane->name, job->msg->seq,
+		job->queued_time, started);
+
+	/* The message may be gone once this returns. */
+	mail_msg_proxy (job->msg);
+
+	finished = g_get_monotonic_time ();
+
+	g_mutex_lock (&lanes_lock);
+
+	lane->n_completed++;
+	lane->total_wait_time += started - job->queued_time;
+	lane->max_wait_time = MAX (
+		lane->max_wait_time, started - job->queued_time);
+	lane->total_exec_time += finished - started;
+
+	g_mutex_unlock (&lanes_lock);
+
+	e_trace_complete (
+		"mail-msg", "exec", lane->name,
+		started, finished);
+
+	d (printf (
+		"Lane '%s' ran a message, waited %" G_GINT64_FORMAT
+		" us, ran %" G_GINT64_FORMAT " us\n", lane->name,
+		started - job->queued_time, finished - started));
+}
+
+static void
+mail_msg_unordered_run (MailMsgJob *job,
+                        gpointer user_data)
+{
+	mail_msg_job_run (job, unordered_lane);
+
+	g_slice_free (MailMsgJob, job);
+}
+
+/* Lets @lane go on once it is neither running nor waiting.
+ * Returns whether it has to be handed back to the lane pool.
+ * Must be called with lanes_lock held. */
+static gboolean
+mail_msg_lane_release_locked (MailMsgLane *lane)
+{
+	gboolean reschedule;
+
+	reschedule = !g_queue_is_empty (&lane->queue);
+	lane->scheduled = reschedule;
+
+	if (!reschedule && lane->orphaned)
+		mail_msg_lane_free (lane);
+
+	return reschedule;
+}
+
+static void
+mail_msg_lane_run (MailMsgLane *lane,
+                   gpointer user_data)
+{
+	MailMsgJob *job;
+	MailMsgLane *other_lane = NULL;
+	gboolean reschedule;
+	gboolean reschedule_other = FALSE;
+	guint ii;
+
+	g_mutex_lock (&lanes_lock);
+
+	job = g_queue_pop_head (&lane->queue);
+
+	/* The lane may be freed as soon as the lock is released, when
+	 * it is orphaned and another lane runs the job, so report the
+	 * queue depth right here. */
+	if (job != NULL)
+		e_trace_counter (
+			"mail-msg", lane->name,
+			g_queue_get_length (&lane->queue));
+
+	/* Hold the lane until every lane the job is in got to it.
+	 * The last one to arrive runs it and then releases the rest. */
+	if (job != NULL && ++job->n_reached < job->n_lanes) {
+		g_mutex_unlock (&lanes_lock);
+		return;
+	}
+
+	g_mutex_unlock (&lanes_lock);
+
+	if (job != NULL)
+		mail_msg_job_run (job, lane);
+
+	/* Stay scheduled while there is work left, but go to the back
+	 * of the lane pool so other lanes get their turn in between. */
+	g_mutex_lock (&lanes_lock);
+
+	for (ii = 0; job != NULL && ii < job->n_lanes; ii++) {
+		if (job->lanes[ii] != lane) {
+			other_lane = job->lanes[ii];
+			reschedule_other =
+				mail_msg_lane_release_locked (other_lane);
+		}
+	}
+
+	reschedule = mail_msg_lane_release_locked (lane);
+
+	g_mutex_unlock (&lanes_lock);
+
+	if (job != NULL)
+		g_slice_free (MailMsgJob, job);
+
+	if (reschedule_other)
+		g_thread_pool_push (lane_pool, other_lane, NULL);
+
+	if (reschedule)
+		g_thread_pool_push (lane_pool, lane, NULL);
+}
+
+/* Inserts @job by priority, but never ahead of a job queued in more
+ * than one lane.  Must be called with lanes_lock held. */
+static void
+mail_msg_lane_insert_locked (MailMsgLane *lane,
+                             MailMsgJob *job)
+{
+	GList *link, *sibling = NULL;
+
+	for (link = g_queue_peek_tail_link (&lane->queue);
+	     link != NULL; link = g_list_previous (link)) {
+		MailMsgJob *queued_job = link->data;
+
+		if (queued_job->n_lanes > 1)
+			break;
+
+		if (mail_msg_job_compare (queued_job, job, NULL) <= 0)
+			break;
+
+		sibling = link;
+	}
+
+	if (sibling != NULL)
+		g_queue_insert_before (&lane->queue, sibling, job);
+	else
+		g_queue_push_tail (&lane->queue, job);
+}
+
+static void
+mail_msg_lanes_push (MailMsgLane **lanes,
+                     guint n_lanes,
+                     MailMsg *msg)
+{
+	MailMsgJob *job;
+	gboolean schedule[2];
+	guint depth[2];
+	guint ii;
+
+	job = mail_msg_job_new (msg);
+	job->n_lanes = n_lanes;
+
+	g_mutex_lock (&lanes_lock);
+
+	for (ii = 0; ii < n_lanes; ii++) {
+		MailMsgLane *lane = lanes[ii];
+
+		job->lanes[ii] = lane;
+		mail_msg_lane_insert_locked (lane, job);
+
+		schedule[ii] = !lane->scheduled;
+		lane->scheduled = TRUE;
+
+		depth[ii] = g_queue_get_length (&lane->queue);
+	}
+
+	g_mutex_unlock (&lanes_lock);
+
+	for (ii = 0; ii < n_lanes; ii++) {
+		e_trace_counter ("mail-msg", lanes[ii]->name, depth[ii]);
+
+		if (schedule[ii])
+			g_thread_pool_push (lane_pool, lanes[ii], NULL);
+	}
+}
+
+static void
+mail_msg_lane_push (MailMsgLane *lane,
+                    MailMsg *msg)
+{
+	mail_msg_lanes_push (&lane, 1, msg);
+}
+
+static void
+mail_msg_store_lane_gone_cb (gpointer user_data,
+                             GObject *where_the_store_was)
+{
+	MailMsgLane *lane;
+
+	g_mutex_lock (&lanes_lock);
+
+	lane = g_hash_table_lookup (store_lanes, where_the_store_was);
+	g_hash_table_remove (store_lanes, where_the_store_was);
+
+	/* The address may be reused by a new store, which must
+	 * not inherit this lane, so it goes once it runs dry. */
+	if (lane != NULL) {
+		if (lane->scheduled)
+			lane->orphaned = TRUE;
+		else
+			mail_msg_lane_free (lane);
+	}
+
+	g_mutex_unlock (&lanes_lock);
+}
+
+/* Must be called with lanes_lock held. */
+static MailMsgLane *
+mail_msg_store_lane_get_locked (CamelStore *store)
+{
+	MailMsgLane *lane;
+	gchar *name;
+
+	lane = g_hash_table_lookup (store_lanes, store);
+	if (lane != NULL)
+		return lane;
+
+	name = g_strdup_printf (
+		"store:%s", camel_service_get_uid (
+		CAMEL_SERVICE (store)));
+	lane = mail_msg_lane_new (name);
+	g_hash_table_insert (store_lanes, store, lane);
+	g_free (name);
+
+	g_object_weak_ref (
+		G_OBJECT (store), mail_msg_store_lane_gone_cb, NULL);
+
+	return lane;
+}
+
+void
+mail_msg_init (void)
 {
-	GThreadPool *thread_pool;
-	gint max_threads = GPOINTER_TO_INT (data);
+	g_mutex_init (&mail_msg_lock);
+	g_cond_init (&mail_msg_cond);
+
+	main_loop_queue = g_async_queue_new ();
+	msg_reply_queue = g_async_queue_new ();
 
-	/* once created, run forever */
-	thread_pool = g_thread_pool_new (
-		(GFunc) mail_msg_proxy, NULL, max_threads, FALSE, NULL);
-	g_thread_pool_set_sort_function (
-		thread_pool, (GCompareDataFunc) mail_msg_compare, NULL);
+	mail_msg_active_table = g_hash_table_new (NULL, NULL);
+	main_thread = g_thread_self ();
 
-	return thread_pool;
+	mail_msg_lanes_ensure ();
 }
 
 void
@@ -446,31 +870,139 @@ mail_msg_main_loop_push (gpointer msg)
 void
 mail_msg_unordered_push (gpointer msg)
 {
-	static GOnce once = G_ONCE_INIT;
+	mail_msg_lanes_ensure ();
 
-	g_once (&once, (GThreadFunc) create_thread_pool, GINT_TO_POINTER (10));
-
-	g_thread_pool_push ((GThreadPool *) once.retval, msg, NULL);
+	g_thread_pool_push (unordered_pool, mail_msg_job_new (msg), NULL);
 }
 
 void
 mail_msg_fast_ordered_push (gpointer msg)
 {
-	static GOnce once = G_ONCE_INIT;
-
-	g_once (&once, (GThreadFunc) create_thread_pool, GINT_TO_POINTER (1));
+	mail_msg_lanes_ensure ();
 
-	g_thread_pool_push ((GThreadPool *) once.retval, msg, NULL);
+	mail_msg_lane_push (fast_ordered_lane, msg);
 }
 
 void
 mail_msg_slow_ordered_push (gpointer msg)
 {
-	static GOnce once = G_ONCE_INIT;
+	mail_msg_lanes_ensure ();
+
+	mail_msg_lane_push (slow_ordered_lane, msg);
+}
+
+/* Runs messages in order with respect to other messages pushed for the
+ * same @store, but independently of any other store.  Meant for slow
+ * operations like syncing, expunging or transferring, so that one slow
+ * account does not hold up all the others. */
+void
+mail_msg_store_ordered_push (gpointer msg,
+                             CamelStore *store)
+{
+	mail_msg_stores_ordered_push (msg, store, NULL);
+}
+
+/* Like mail_msg_store_ordered_push(), but keeps @msg in order with
+ * messages for either of two stores, such as the source and the
+ * destination of a transfer.  Either store may be %NULL. */
+void
+mail_msg_stores_ordered_push (gpointer msg,
+                              CamelStore *store,
+                              CamelStore *other_store)
+{
+	MailMsgLane *lanes[2];
+	guint n_lanes = 0;
+
+	g_return_if_fail (store == NULL || CAMEL_IS_STORE (store));
+	g_return_if_fail (other_store == NULL || CAMEL_IS_STORE (other_store));
+
+	mail_msg_lanes_ensure ();
+
+	if (store == NULL) {
+		store = other_store;
+		other_store = NULL;
+	}
+
+	if (other_store == store)
+		other_store = NULL;
+
+	if (store == NULL) {
+		mail_msg_slow_ordered_push (msg);
+		return;
+	}
+
+	g_mutex_lock (&lanes_lock);
+
+	lanes[n_lanes++] = mail_msg_store_lane_get_locked (store);
+	if (other_store != NULL)
+		lanes[n_lanes++] = mail_msg_store_lane_get_locked (other_store);
+
+	g_mutex_unlock (&lanes_lock);
+
+	mail_msg_lanes_push (lanes, n_lanes, msg);
+}
+
+static void
+mail_msg_lane_get_stats (MailMsgLane *lane,
+                         MailMsgLaneStats *stats)
+{
+	stats->name = g_strdup (lane->name);
+	stats->queue_depth = g_queue_get_length (&lane->queue);
+	stats->n_completed = lane->n_completed;
+	stats->total_wait_time = lane->total_wait_time;
+	stats->max_wait_time = lane->max_wait_time;
+	stats->total_exec_time = lane->total_exec_time;
+}
 
-	g_once (&once, (GThreadFunc) create_thread_pool, GINT_TO_POINTER (1));
+/* Calls @func with a snapshot of the statistics of each lane, including
+ * the unordered pool.  Times are in microseconds; the wait time is the
+ * time between pushing a message and starting to run it. */
+void
+mail_msg_foreach_lane_stats (MailMsgLaneStatsFunc func,
+                             gpointer user_data)
+{
+	GArray *array;
+	GHashTableIter iter;
+	MailMsgLaneStats stats;
+	gpointer value;
+	guint ii;
+
+	g_return_if_fail (func != NULL);
+
+	mail_msg_lanes_ensure ();
+
+	array = g_array_new (FALSE, FALSE, sizeof (MailMsgLaneStats));
+
+	g_mutex_lock (&lanes_lock);
+
+	mail_msg_lane_get_stats (unordered_lane, &stats);
+	stats.queue_depth = g_thread_pool_unprocessed (unordered_pool);
+	g_array_append_val (array, stats);
+
+	mail_msg_lane_get_stats (fast_ordered_lane, &stats);
+	g_array_append_val (array, stats);
+
+	mail_msg_lane_get_stats (slow_ordered_lane, &stats);
+	g_array_append_val (array, stats);
+
+	g_hash_table_iter_init (&iter, store_lanes);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		mail_msg_lane_get_stats (value, &stats);
+		g_array_append_val (array, stats);
+	}
+
+	g_mutex_unlock (&lanes_lock);
+
+	/* Store lanes may go away meanwhile, hence the copied names. */
+	for (ii = 0; ii < array->len; ii++) {
+		MailMsgLaneStats *item;
+
+		item = &g_array_index (array, MailMsgLaneStats, ii);
+		func (item, user_data);
+		g_free ((gchar *) item->name);
+	}
 
-	g_thread_pool_push ((GThreadPool *) once.retval, msg, NULL);
+	g_array_free (array, TRUE);
 }
 
 gboolean
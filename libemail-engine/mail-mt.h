@@ -32,6 +32,7 @@
 
 typedef struct _MailMsg MailMsg;
 typedef struct _MailMsgInfo MailMsgInfo;
+typedef struct _MailMsgLaneStats MailMsgLaneStats;
 
 typedef gchar *	(*MailMsgDescFunc)		(MailMsg *msg);
 typedef void	(*MailMsgExecFunc)		(MailMsg *msg,
@@ -51,6 +52,8 @@ typedef void    (*MailMsgAlertErrorFunc)	(GCancellable *cancellable,
 						 const gchar *message);
 typedef EAlertSink *
 		(*MailMsgGetAlertSinkFunc)	(void);
+typedef void	(*MailMsgLaneStatsFunc)		(const MailMsgLaneStats *stats,
+						 gpointer user_data);
 
 struct _MailMsg {
 	MailMsgInfo *info;
@@ -69,6 +72,16 @@ struct _MailMsgInfo {
 	MailMsgFreeFunc free;
 };
 
+/* Per-lane queue statistics, times in microseconds */
+struct _MailMsgLaneStats {
+	const gchar *name;
+	guint queue_depth;
+	guint n_completed;
+	gint64 total_wait_time;
+	gint64 max_wait_time;
+	gint64 total_exec_time;
+};
+
 /* Just till we move this out to EDS */
 EAlertSink *	mail_msg_get_alert_sink (void);
 
@@ -97,6 +110,11 @@ void mail_msg_main_loop_push (gpointer msg);
 void mail_msg_unordered_push (gpointer msg);
 void mail_msg_fast_ordered_push (gpointer msg);
 void mail_msg_slow_ordered_push (gpointer msg);
+void mail_msg_store_ordered_push (gpointer msg, CamelStore *store);
+void mail_msg_stores_ordered_push (gpointer msg, CamelStore *store, CamelStore *other_store);
+
+/* queue statistics */
+void mail_msg_foreach_lane_stats (MailMsgLaneStatsFunc func, gpointer user_data);
 
 /* Call a function in the GUI thread, wait for it to return, type is
  * the marshaller to use.  FIXME This thing is horrible, please put
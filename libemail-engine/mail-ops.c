@@ -1173,6 +1173,7 @@ mail_transfer_messages (EMailSession *session,
                         gpointer data)
 {
 	struct _transfer_msg *m;
+	CamelStore *dest_store = NULL;
 
 	g_return_if_fail (CAMEL_IS_FOLDER (source));
 	g_return_if_fail (uids != NULL);
@@ -1188,7 +1189,16 @@ mail_transfer_messages (EMailSession *session,
 	m->done = done;
 	m->data = data;
 
-	mail_msg_slow_ordered_push (m);
+	/* Keep the transfer in order with other operations on both
+	 * stores.  An unparsable URI fails later, in the exec func. */
+	e_mail_folder_uri_parse (
+		CAMEL_SESSION (session), dest_uri, &dest_store, NULL, NULL);
+
+	mail_msg_stores_ordered_push (
+		m, camel_folder_get_parent_store (source), dest_store);
+
+	if (dest_store != NULL)
+		g_object_unref (dest_store);
 }
 
 /* ** SYNC FOLDER ********************************************************* */
@@ -1308,7 +1318,7 @@ mail_sync_folder (CamelFolder *folder,
 	m->data = data;
 	m->done = done;
 
-	mail_msg_slow_ordered_push (m);
+	mail_msg_store_ordered_push (m, camel_folder_get_parent_store (folder));
 }
 
 /* ** SYNC STORE ********************************************************* */
@@ -1389,7 +1399,7 @@ mail_sync_store (CamelStore *store,
 	m->data = data;
 	m->done = done;
 
-	mail_msg_slow_ordered_push (m);
+	mail_msg_store_ordered_push (m, store);
 }
 
 /* ******************************************************************************** */
@@ -1465,7 +1475,7 @@ mail_empty_trash (CamelStore *store)
 	m = mail_msg_new (&empty_trash_info);
 	m->store = g_object_ref (store);
 
-	mail_msg_slow_ordered_push (m);
+	mail_msg_store_ordered_push (m, store);
 }
 
 /* ** Execute Shell Command ************************************************ */
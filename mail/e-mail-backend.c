@@ -329,6 +329,30 @@ mail_backend_delete_junk (CamelService *service,
 	g_object_unref (folder);
 }
 
+/* Helper for mail_backend_prepare_for_quit_cb() */
+static void
+mail_backend_dump_lane_stats_cb (const MailMsgLaneStats *stats,
+                                 gpointer user_data)
+{
+	gint64 average_wait_time = 0;
+	gint64 average_exec_time = 0;
+
+	if (stats->n_completed > 0) {
+		average_wait_time =
+			stats->total_wait_time / stats->n_completed;
+		average_exec_time =
+			stats->total_exec_time / stats->n_completed;
+	}
+
+	g_debug (
+		"Lane '%s': %u queued, %u completed, waited %"
+		G_GINT64_FORMAT " us on average and %" G_GINT64_FORMAT
+		" us at most, ran %" G_GINT64_FORMAT " us on average",
+		stats->name, stats->queue_depth, stats->n_completed,
+		average_wait_time, stats->max_wait_time,
+		average_exec_time);
+}
+
 /* Helper for mail_backend_prepare_for_quit_cb() */
 static gboolean
 mail_backend_poll_to_quit (gpointer user_data)
@@ -379,6 +403,9 @@ mail_backend_prepare_for_quit_cb (EShell *shell,
 
 	camel_application_is_exiting = TRUE;
 
+	/* Run with G_MESSAGES_DEBUG=evolution-mail to see these. */
+	mail_msg_foreach_lane_stats (mail_backend_dump_lane_stats_cb, NULL);
+
 	mail_vfolder_shutdown ();
 
 	list = camel_session_list_services (CAMEL_SESSION (session));
@@ -1414,6 +1414,9 @@ e_mail_display_class_init (EMailDisplayClass *class)
 
 	g_type_class_add_private (class, sizeof (EMailDisplayPrivate));
 
+	/* Load the modules extending us before anything looks for them. */
+	e_util_prepare_extension_point (G_TYPE_FROM_CLASS (class));
+
 	object_class = G_OBJECT_CLASS (class);
 	object_class->constructed = mail_display_constructed;
 	object_class->set_property = mail_display_set_property;
@@ -2343,24 +2343,23 @@ e_mail_reader_create_vfolder_from_selected (EMailReader *reader,
 	g_ptr_array_unref (uids);
 }
 
-static void
-mail_reader_parse_message_run (GSimpleAsyncResult *simple,
-                               GObject *object,
-                               GCancellable *cancellable)
+/* Returns the part list of the message, from the registry if some other
+ * thread parsed it already.  Either way it ends up in the cache of recently
+ * parsed messages, so going back to it does not parse it again. */
+static EMailPartList *
+mail_reader_parse_message_sync (EMailReader *reader,
+                                CamelFolder *folder,
+                                const gchar *message_uid,
+                                CamelMimeMessage *message,
+                                GCancellable *cancellable)
 {
-	EMailReader *reader = E_MAIL_READER (object);
 	CamelObjectBag *registry;
 	EMailPartList *part_list;
-	AsyncContext *async_context;
 	gchar *mail_uri;
 
-	async_context = g_simple_async_result_get_op_res_gpointer (simple);
-
 	registry = e_mail_part_list_get_registry ();
 
-	mail_uri = e_mail_part_build_uri (
-		async_context->folder,
-		async_context->message_uid, NULL, NULL);
+	mail_uri = e_mail_part_build_uri (folder, message_uid, NULL, NULL);
 
 	part_list = camel_object_bag_reserve (registry, mail_uri);
 	if (part_list == NULL) {
@@ -2374,11 +2373,7 @@ mail_reader_parse_message_run (GSimpleAsyncResult *simple,
 		parser = e_mail_parser_new (CAMEL_SESSION (mail_session));
 
 		part_list = e_mail_parser_parse_sync (
-			parser,
-			async_context->folder,
-			async_context->message_uid,
-			async_context->message,
-			cancellable);
+			parser, folder, message_uid, message, cancellable);
 
 		g_object_unref (parser);
 
@@ -2388,9 +2383,29 @@ mail_reader_parse_message_run (GSimpleAsyncResult *simple,
 			camel_object_bag_add (registry, mail_uri, part_list);
 	}
 
+	if (part_list != NULL)
+		e_mail_part_list_cache_add (mail_uri, part_list);
+
 	g_free (mail_uri);
 
-	async_context->part_list = part_list;
+	return part_list;
+}
+
+static void
+mail_reader_parse_message_run (GSimpleAsyncResult *simple,
+                               GObject *object,
+                               GCancellable *cancellable)
+{
+	AsyncContext *async_context;
+
+	async_context = g_simple_async_result_get_op_res_gpointer (simple);
+
+	async_context->part_list = mail_reader_parse_message_sync (
+		E_MAIL_READER (object),
+		async_context->folder,
+		async_context->message_uid,
+		async_context->message,
+		cancellable);
 }
 
 void
@@ -2458,3 +2473,150 @@ e_mail_reader_parse_message_finish (EMailReader *reader,
 
 	return async_context->part_list;
 }
+
+/* Whether showing the message involves decrypting or verifying
+ * something, which may prompt for a passphrase or go online. */
+static gboolean
+mail_reader_part_needs_crypto (CamelMimePart *part)
+{
+	CamelDataWrapper *content;
+	CamelContentType *content_type;
+
+	if (e_mail_part_is_secured (part))
+		return TRUE;
+
+	content = camel_medium_get_content (CAMEL_MEDIUM (part));
+	if (content == NULL)
+		return FALSE;
+
+	if (CAMEL_IS_MULTIPART (content)) {
+		CamelMultipart *multipart = CAMEL_MULTIPART (content);
+		guint ii, n_parts;
+
+		n_parts = camel_multipart_get_number (multipart);
+
+		for (ii = 0; ii < n_parts; ii++) {
+			if (mail_reader_part_needs_crypto (
+				camel_multipart_get_part (multipart, ii)))
+				return TRUE;
+		}
+
+		return FALSE;
+	}
+
+	/* An attached message. */
+	if (CAMEL_IS_MIME_PART (content))
+		return mail_reader_part_needs_crypto (
+			CAMEL_MIME_PART (content));
+
+	content_type = camel_mime_part_get_content_type (part);
+
+	/* Inline PGP, as EMailInlineFilter would find it. */
+	if (camel_content_type_is (content_type, "text", "*")) {
+		GByteArray *byte_array;
+		CamelStream *stream;
+		gboolean found;
+
+		byte_array = g_byte_array_new ();
+		stream = camel_stream_mem_new_with_byte_array (byte_array);
+
+		camel_data_wrapper_decode_to_stream_sync (
+			content, stream, NULL, NULL);
+
+		found = g_strstr_len (
+			(const gchar *) byte_array->data,
+			byte_array->len, "-----BEGIN PGP ") != NULL;
+
+		g_object_unref (stream);
+
+		return found;
+	}
+
+	return FALSE;
+}
+
+static void
+mail_reader_prefetch_message_run (GSimpleAsyncResult *simple,
+                                  GObject *object,
+                                  GCancellable *cancellable)
+{
+	AsyncContext *async_context;
+	CamelObjectBag *registry;
+	EMailPartList *part_list;
+	gchar *mail_uri;
+
+	async_context = g_simple_async_result_get_op_res_gpointer (simple);
+
+	registry = e_mail_part_list_get_registry ();
+
+	mail_uri = e_mail_part_build_uri (
+		async_context->folder,
+		async_context->message_uid, NULL, NULL);
+
+	/* Already parsed, just keep it around. */
+	part_list = camel_object_bag_peek (registry, mail_uri);
+	if (part_list != NULL) {
+		e_mail_part_list_cache_add (mail_uri, part_list);
+		g_object_unref (part_list);
+		g_free (mail_uri);
+		return;
+	}
+
+	g_free (mail_uri);
+
+	async_context->message = camel_folder_get_message_sync (
+		async_context->folder,
+		async_context->message_uid,
+		cancellable, NULL);
+
+	if (async_context->message == NULL)
+		return;
+
+	/* Nothing may prompt for a message the user has not opened.
+	 * Having the message at hand already saves the download. */
+	if (mail_reader_part_needs_crypto (
+		CAMEL_MIME_PART (async_context->message)))
+		return;
+
+	async_context->part_list = mail_reader_parse_message_sync (
+		E_MAIL_READER (object),
+		async_context->folder,
+		async_context->message_uid,
+		async_context->message,
+		cancellable);
+}
+
+/* Retrieves and parses the message in the background, at a low priority,
+ * so that it can be shown right away once it gets selected.  Encrypted or
+ * signed messages are only retrieved.  Errors are ignored, the message is
+ * simply parsed again when selected. */
+void
+e_mail_reader_prefetch_message (EMailReader *reader,
+                                CamelFolder *folder,
+                                const gchar *message_uid,
+                                GCancellable *cancellable)
+{
+	GSimpleAsyncResult *simple;
+	AsyncContext *async_context;
+
+	g_return_if_fail (E_IS_MAIL_READER (reader));
+	g_return_if_fail (CAMEL_IS_FOLDER (folder));
+	g_return_if_fail (message_uid != NULL);
+
+	async_context = g_slice_new0 (AsyncContext);
+	async_context->folder = g_object_ref (folder);
+	async_context->message_uid = g_strdup (message_uid);
+
+	simple = g_simple_async_result_new (
+		G_OBJECT (reader), NULL, NULL,
+		e_mail_reader_prefetch_message);
+
+	g_simple_async_result_set_op_res_gpointer (
+		simple, async_context, (GDestroyNotify) async_context_free);
+
+	g_simple_async_result_run_in_thread (
+		simple, mail_reader_prefetch_message_run,
+		G_PRIORITY_LOW, cancellable);
+
+	g_object_unref (simple);
+}
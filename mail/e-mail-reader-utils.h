@@ -92,6 +92,10 @@ void		e_mail_reader_parse_message	(EMailReader *reader,
 EMailPartList *	e_mail_reader_parse_message_finish
 						(EMailReader *reader,
 						 GAsyncResult *result);
+void		e_mail_reader_prefetch_message	(EMailReader *reader,
+						 CamelFolder *folder,
+						 const gchar *message_uid,
+						 GCancellable *cancellable);
 
 G_END_DECLS
 
@@ -81,6 +81,10 @@ struct _EMailReaderPrivate {
 	 * message is selected before the retrieval has completed. */
 	GCancellable *retrieving_message;
 
+	/* Cancels prefetching of the messages next to
+	 * the selected one when the selection changes. */
+	GCancellable *prefetching_messages;
+
 	/* These flags work together to prevent message selection
 	 * restoration after a folder switch from automatically
 	 * marking the message as read.  We only want that to
@@ -149,6 +153,12 @@ mail_reader_private_free (EMailReaderPrivate *priv)
 		priv->retrieving_message = 0;
 	}
 
+	if (priv->prefetching_messages != NULL) {
+		g_cancellable_cancel (priv->prefetching_messages);
+		g_object_unref (priv->prefetching_messages);
+		priv->prefetching_messages = NULL;
+	}
+
 	g_slice_free (EMailReaderPrivate, priv);
 }
 
@@ -3104,7 +3114,6 @@ mail_reader_set_display_formatter_for_message (EMailReader *reader,
 	mail_uri = e_mail_part_build_uri (folder, message_uid, NULL, NULL);
 	registry = e_mail_part_list_get_registry ();
 	parts = camel_object_bag_peek (registry, mail_uri);
-	g_free (mail_uri);
 
 	if (parts == NULL) {
 		e_mail_reader_parse_message (
@@ -3112,10 +3121,58 @@ mail_reader_set_display_formatter_for_message (EMailReader *reader,
 			priv->retrieving_message,
 			set_mail_display_part_list, NULL);
 	} else {
+		/* Mark it as recently used. */
+		e_mail_part_list_cache_add (mail_uri, parts);
+
 		e_mail_display_set_part_list (display, parts);
 		e_mail_display_load (display, NULL);
 		g_object_unref (parts);
 	}
+
+	g_free (mail_uri);
+}
+
+static void
+mail_reader_prefetch_adjacent_messages (EMailReader *reader,
+                                        CamelFolder *folder)
+{
+	EMailReaderPrivate *priv;
+	GtkWidget *message_list;
+	gchar *uid;
+
+	priv = E_MAIL_READER_GET_PRIVATE (reader);
+
+	if (priv->prefetching_messages != NULL) {
+		g_cancellable_cancel (priv->prefetching_messages);
+		g_object_unref (priv->prefetching_messages);
+		priv->prefetching_messages = NULL;
+	}
+
+	if (folder == NULL)
+		return;
+
+	priv->prefetching_messages = g_cancellable_new ();
+
+	message_list = e_mail_reader_get_message_list (reader);
+
+	/* So that stepping through the folder with
+	 * the keyboard finds each message parsed. */
+
+	uid = message_list_dup_adjacent_uid (
+		MESSAGE_LIST (message_list), MESSAGE_LIST_SELECT_NEXT);
+	if (uid != NULL) {
+		e_mail_reader_prefetch_message (
+			reader, folder, uid, priv->prefetching_messages);
+		g_free (uid);
+	}
+
+	uid = message_list_dup_adjacent_uid (
+		MESSAGE_LIST (message_list), MESSAGE_LIST_SELECT_PREVIOUS);
+	if (uid != NULL) {
+		e_mail_reader_prefetch_message (
+			reader, folder, uid, priv->prefetching_messages);
+		g_free (uid);
+	}
 }
 
 static void
@@ -3160,6 +3217,8 @@ mail_reader_message_loaded (EMailReader *reader,
 	mail_reader_set_display_formatter_for_message (
 		reader, display, message_uid, message, folder);
 
+	mail_reader_prefetch_adjacent_messages (reader, folder);
+
 	/* Reset the shell view icon. */
 	e_shell_event (shell, "mail-icon", (gpointer) "evolution-mail");
 
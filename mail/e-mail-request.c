@@ -20,6 +20,8 @@
 #include "e-mail-request.h"
 #include "em-utils.h"
 
+#include <string.h>
+
 #include <libsoup/soup.h>
 #include <libsoup/soup-requester.h>
 #include <libsoup/soup-request-http.h>
@@ -55,10 +57,317 @@ struct _EMailRequestPrivate {
 	gchar *ret_mime_type;
 };
 
+/* Carries progressively formatted HTML from the formatter, writing
+ * in the main thread, to WebKit, reading from a worker thread. */
+typedef struct _MailRequestPipe MailRequestPipe;
+
+struct _MailRequestPipe {
+	volatile gint ref_count;
+	GMutex lock;
+	GCond cond;
+	GByteArray *buffer;
+	gboolean writer_closed;
+	gboolean reader_closed;
+};
+
+typedef struct _MailRequestInputStream MailRequestInputStream;
+typedef struct _MailRequestOutputStream MailRequestOutputStream;
+typedef GInputStreamClass MailRequestInputStreamClass;
+typedef GOutputStreamClass MailRequestOutputStreamClass;
+
+struct _MailRequestInputStream {
+	GInputStream parent;
+	MailRequestPipe *pipe;
+};
+
+struct _MailRequestOutputStream {
+	GOutputStream parent;
+	MailRequestPipe *pipe;
+	GByteArray *pending;	/* written, not flushed yet */
+};
+
 static const gchar *data_schemes[] = { "mail", NULL };
 
+GType mail_request_input_stream_get_type (void);
+GType mail_request_output_stream_get_type (void);
+
 G_DEFINE_TYPE (EMailRequest, e_mail_request, SOUP_TYPE_REQUEST)
 
+G_DEFINE_TYPE (
+	MailRequestInputStream,
+	mail_request_input_stream,
+	G_TYPE_INPUT_STREAM)
+
+G_DEFINE_TYPE (
+	MailRequestOutputStream,
+	mail_request_output_stream,
+	G_TYPE_OUTPUT_STREAM)
+
+static MailRequestPipe *
+mail_request_pipe_new (void)
+{
+	MailRequestPipe *pipe;
+
+	pipe = g_slice_new0 (MailRequestPipe);
+	pipe->ref_count = 1;
+	g_mutex_init (&pipe->lock);
+	g_cond_init (&pipe->cond);
+	pipe->buffer = g_byte_array_new ();
+
+	return pipe;
+}
+
+static MailRequestPipe *
+mail_request_pipe_ref (MailRequestPipe *pipe)
+{
+	g_atomic_int_inc (&pipe->ref_count);
+
+	return pipe;
+}
+
+static void
+mail_request_pipe_unref (MailRequestPipe *pipe)
+{
+	if (g_atomic_int_dec_and_test (&pipe->ref_count)) {
+		g_mutex_clear (&pipe->lock);
+		g_cond_clear (&pipe->cond);
+		g_byte_array_free (pipe->buffer, TRUE);
+
+		g_slice_free (MailRequestPipe, pipe);
+	}
+}
+
+static gssize
+mail_request_input_stream_read (GInputStream *stream,
+                                gpointer buffer,
+                                gsize count,
+                                GCancellable *cancellable,
+                                GError **error)
+{
+	MailRequestPipe *pipe;
+	gsize n_bytes;
+
+	pipe = ((MailRequestInputStream *) stream)->pipe;
+
+	g_mutex_lock (&pipe->lock);
+
+	/* Block until there is something to read, the formatter
+	 * is done or the request is cancelled.  Zero bytes read
+	 * means end of stream. */
+	while (pipe->buffer->len == 0 && !pipe->writer_closed) {
+		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+			g_mutex_unlock (&pipe->lock);
+			return -1;
+		}
+
+		g_cond_wait_until (
+			&pipe->cond, &pipe->lock,
+			g_get_monotonic_time () +
+			100 * G_TIME_SPAN_MILLISECOND);
+	}
+
+	n_bytes = MIN (count, pipe->buffer->len);
+	memcpy (buffer, pipe->buffer->data, n_bytes);
+	g_byte_array_remove_range (pipe->buffer, 0, n_bytes);
+
+	g_mutex_unlock (&pipe->lock);
+
+	return n_bytes;
+}
+
+static gboolean
+mail_request_input_stream_close (GInputStream *stream,
+                                 GCancellable *cancellable,
+                                 GError **error)
+{
+	MailRequestPipe *pipe;
+
+	pipe = ((MailRequestInputStream *) stream)->pipe;
+
+	/* Nobody will read the rest. */
+	g_mutex_lock (&pipe->lock);
+	pipe->reader_closed = TRUE;
+	g_byte_array_set_size (pipe->buffer, 0);
+	g_mutex_unlock (&pipe->lock);
+
+	return TRUE;
+}
+
+static void
+mail_request_input_stream_finalize (GObject *object)
+{
+	mail_request_pipe_unref (((MailRequestInputStream *) object)->pipe);
+
+	/* Chain up to parent's finalize() method. */
+	G_OBJECT_CLASS (mail_request_input_stream_parent_class)->
+		finalize (object);
+}
+
+static void
+mail_request_input_stream_class_init (MailRequestInputStreamClass *class)
+{
+	GObjectClass *object_class;
+
+	object_class = G_OBJECT_CLASS (class);
+	object_class->finalize = mail_request_input_stream_finalize;
+
+	class->read_fn = mail_request_input_stream_read;
+	class->close_fn = mail_request_input_stream_close;
+}
+
+static void
+mail_request_input_stream_init (MailRequestInputStream *stream)
+{
+}
+
+static gssize
+mail_request_output_stream_write (GOutputStream *stream,
+                                  gconstpointer buffer,
+                                  gsize count,
+                                  GCancellable *cancellable,
+                                  GError **error)
+{
+	MailRequestOutputStream *output_stream;
+
+	output_stream = (MailRequestOutputStream *) stream;
+
+	/* Published on flush, in larger chunks. */
+	g_byte_array_append (output_stream->pending, buffer, count);
+
+	return count;
+}
+
+static gboolean
+mail_request_output_stream_flush (GOutputStream *stream,
+                                  GCancellable *cancellable,
+                                  GError **error)
+{
+	MailRequestOutputStream *output_stream;
+	MailRequestPipe *pipe;
+
+	output_stream = (MailRequestOutputStream *) stream;
+	pipe = output_stream->pipe;
+
+	if (output_stream->pending->len == 0)
+		return TRUE;
+
+	g_mutex_lock (&pipe->lock);
+	if (!pipe->reader_closed)
+		g_byte_array_append (
+			pipe->buffer,
+			output_stream->pending->data,
+			output_stream->pending->len);
+	g_cond_broadcast (&pipe->cond);
+	g_mutex_unlock (&pipe->lock);
+
+	g_byte_array_set_size (output_stream->pending, 0);
+
+	return TRUE;
+}
+
+static gboolean
+mail_request_output_stream_close (GOutputStream *stream,
+                                  GCancellable *cancellable,
+                                  GError **error)
+{
+	MailRequestPipe *pipe;
+
+	pipe = ((MailRequestOutputStream *) stream)->pipe;
+
+	mail_request_output_stream_flush (stream, NULL, NULL);
+
+	g_mutex_lock (&pipe->lock);
+	pipe->writer_closed = TRUE;
+	g_cond_broadcast (&pipe->cond);
+	g_mutex_unlock (&pipe->lock);
+
+	return TRUE;
+}
+
+static void
+mail_request_output_stream_finalize (GObject *object)
+{
+	MailRequestOutputStream *output_stream;
+
+	output_stream = (MailRequestOutputStream *) object;
+
+	mail_request_pipe_unref (output_stream->pipe);
+	g_byte_array_free (output_stream->pending, TRUE);
+
+	/* Chain up to parent's finalize() method. */
+	G_OBJECT_CLASS (mail_request_output_stream_parent_class)->
+		finalize (object);
+}
+
+static void
+mail_request_output_stream_class_init (MailRequestOutputStreamClass *class)
+{
+	GObjectClass *object_class;
+
+	object_class = G_OBJECT_CLASS (class);
+	object_class->finalize = mail_request_output_stream_finalize;
+
+	class->write_fn = mail_request_output_stream_write;
+	class->flush = mail_request_output_stream_flush;
+	class->close_fn = mail_request_output_stream_close;
+}
+
+static void
+mail_request_output_stream_init (MailRequestOutputStream *stream)
+{
+	stream->pending = g_byte_array_new ();
+}
+
+static void
+mail_request_format_progressive_done_cb (GObject *source_object,
+                                         GAsyncResult *result,
+                                         gpointer user_data)
+{
+	GOutputStream *output_stream = user_data;
+
+	e_mail_formatter_format_progressive_finish (
+		E_MAIL_FORMATTER (source_object), result, NULL);
+
+	/* Signals end of stream to the reader. */
+	g_output_stream_close (output_stream, NULL, NULL);
+	g_object_unref (output_stream);
+}
+
+/* Returns a stream WebKit can start rendering from right away,
+ * while the rest of the message is still being formatted. */
+static GInputStream *
+mail_request_format_progressive (EMailFormatter *formatter,
+                                 EMailPartList *part_list,
+                                 EMailFormatterHeaderFlags flags,
+                                 EMailFormatterMode mode,
+                                 GCancellable *cancellable)
+{
+	MailRequestInputStream *input_stream;
+	MailRequestOutputStream *output_stream;
+	MailRequestPipe *pipe;
+
+	pipe = mail_request_pipe_new ();
+
+	input_stream = g_object_new (
+		mail_request_input_stream_get_type (), NULL);
+	input_stream->pipe = mail_request_pipe_ref (pipe);
+
+	output_stream = g_object_new (
+		mail_request_output_stream_get_type (), NULL);
+	output_stream->pipe = mail_request_pipe_ref (pipe);
+
+	mail_request_pipe_unref (pipe);
+
+	/* The callback owns the output stream reference. */
+	e_mail_formatter_format_progressive (
+		formatter, part_list,
+		G_OUTPUT_STREAM (output_stream), flags, mode,
+		mail_request_format_progressive_done_cb,
+		cancellable, output_stream);
+
+	return G_INPUT_STREAM (input_stream);
+}
+
 static void
 handle_mail_request (GSimpleAsyncResult *simple,
                      GObject *object,
@@ -121,9 +430,28 @@ handle_mail_request (GSimpleAsyncResult *simple,
 	if (charset != NULL && *charset != '\0')
 		e_mail_formatter_set_charset (formatter, charset);
 
+	val = g_hash_table_lookup (request->priv->uri_query, "part_id");
+
+	/* Stream whole messages out as they get formatted,
+	 * except for printing, which needs the complete page. */
+	if (val == NULL && context.mode != E_MAIL_FORMATTER_MODE_PRINTING) {
+		input_stream = mail_request_format_progressive (
+			formatter, part_list, context.flags,
+			context.mode, cancellable);
+
+		g_simple_async_result_set_op_res_gpointer (
+			simple, input_stream,
+			(GDestroyNotify) g_object_unref);
+
+		g_clear_object (&context.part_list);
+		g_object_unref (part_list);
+		g_object_unref (formatter);
+
+		return;
+	}
+
 	output_stream = g_memory_output_stream_new_resizable ();
 
-	val = g_hash_table_lookup (request->priv->uri_query, "part_id");
 	if (val != NULL) {
 		EMailPart *part;
 		const gchar *mime_type;
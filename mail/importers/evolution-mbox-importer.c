@@ -306,6 +306,47 @@ mbox_importer_set_preview_funcs (MboxImporterCreatePreviewFunc create_func,
 	fill_preview_func = fill_func;
 }
 
+/* Don't list more than this many messages in the preview,
+ * so that huge mailboxes are not read through just for it. */
+#define PREVIEW_MAX_MESSAGES 500
+
+/* Parses the message whose From line starts at @offset in @filename. */
+static CamelMimeMessage *
+preview_load_message (const gchar *filename,
+                      goffset offset)
+{
+	CamelMimeParser *mp;
+	CamelMimeMessage *msg = NULL;
+	gint fd;
+
+	fd = g_open (filename, O_RDONLY | O_BINARY, 0);
+	if (fd == -1)
+		return NULL;
+
+	mp = camel_mime_parser_new ();
+	camel_mime_parser_scan_from (mp, TRUE);
+	if (camel_mime_parser_init_with_fd (mp, fd) == -1)
+		goto exit;
+
+	camel_mime_parser_seek (mp, offset, SEEK_SET);
+
+	if (camel_mime_parser_step (mp, NULL, NULL) == CAMEL_MIME_PARSER_STATE_FROM) {
+		msg = camel_mime_message_new ();
+		if (!camel_mime_part_construct_from_parser_sync (
+			(CamelMimePart *) msg, mp, NULL, NULL)) {
+			g_object_unref (msg);
+			msg = NULL;
+		}
+	}
+
+exit:
+	g_object_unref (mp);
+
+	/* 'fd' is freed together with 'mp' */
+	/* coverity[leaked_handle] */
+	return msg;
+}
+
 static void
 preview_selection_changed_cb (GtkTreeSelection *selection,
                               EWebViewPreview *preview)
@@ -319,9 +360,14 @@ preview_selection_changed_cb (GtkTreeSelection *selection,
 	g_return_if_fail (fill_preview_func != NULL);
 
 	if (gtk_tree_selection_get_selected (selection, &model, &iter) && model) {
-		CamelMimeMessage *msg = NULL;
+		CamelMimeMessage *msg;
+		gint64 offset = 0;
+
+		gtk_tree_model_get (model, &iter, 2, &offset, -1);
 
-		gtk_tree_model_get (model, &iter, 2, &msg, -1);
+		msg = preview_load_message (
+			g_object_get_data (G_OBJECT (preview), "mbox-filename"),
+			offset);
 
 		if (msg) {
 			found = TRUE;
@@ -349,6 +395,7 @@ mbox_get_preview (EImport *ei,
 	GtkListStore *store = NULL;
 	GtkTreeIter iter;
 	GtkWidget *preview_widget = NULL;
+	guint n_messages = 0;
 
 	if (!create_preview_func || !fill_preview_func)
 		return NULL;
@@ -368,47 +415,64 @@ mbox_get_preview (EImport *ei,
 		return NULL;
 	}
 
-	g_free (filename);
-
 	mp = camel_mime_parser_new ();
 	camel_mime_parser_scan_from (mp, TRUE);
 	if (camel_mime_parser_init_with_fd (mp, fd) == -1) {
 		goto cleanup;
 	}
 
-	while (camel_mime_parser_step (mp, NULL, NULL) == CAMEL_MIME_PARSER_STATE_FROM) {
-		CamelMimeMessage *msg;
-		gchar *from;
-
-		msg = camel_mime_message_new ();
-		if (!camel_mime_part_construct_from_parser_sync (
-			(CamelMimePart *) msg, mp, NULL, NULL)) {
-			g_object_unref (msg);
+	/* Only read the headers here; a message is parsed
+	 * in full when it is selected in the preview. */
+	while (n_messages < PREVIEW_MAX_MESSAGES &&
+	       camel_mime_parser_step (mp, NULL, NULL) == CAMEL_MIME_PARSER_STATE_FROM) {
+		CamelMimeParserState state;
+		CamelInternetAddress *addr;
+		const gchar *raw;
+		gint64 offset;
+		gchar *subject = NULL;
+		gchar *from = NULL;
+
+		offset = camel_mime_parser_tell_start_from (mp);
+
+		state = camel_mime_parser_step (mp, NULL, NULL);
+		if (state == CAMEL_MIME_PARSER_STATE_EOF)
 			break;
+
+		raw = camel_mime_parser_header (mp, "Subject", NULL);
+		if (raw)
+			subject = camel_header_decode_string (raw, NULL);
+
+		raw = camel_mime_parser_header (mp, "From", NULL);
+		if (raw) {
+			addr = camel_internet_address_new ();
+			if (camel_address_decode (CAMEL_ADDRESS (addr), raw) > 0)
+				from = camel_address_encode (CAMEL_ADDRESS (addr));
+			g_object_unref (addr);
 		}
 
+		/* Skip the body, up to the end of this message. */
+		while (state != CAMEL_MIME_PARSER_STATE_FROM_END &&
+		       state != CAMEL_MIME_PARSER_STATE_EOF)
+			state = camel_mime_parser_step (mp, NULL, NULL);
+
 		if (!store)
 			store = gtk_list_store_new (
 				3, G_TYPE_STRING, G_TYPE_STRING,
-				CAMEL_TYPE_MIME_MESSAGE);
-
-		from = NULL;
-		if (camel_mime_message_get_from (msg))
-			from = camel_address_encode (
-				CAMEL_ADDRESS (
-				camel_mime_message_get_from (msg)));
+				G_TYPE_INT64);
 
 		gtk_list_store_append (store, &iter);
 		gtk_list_store_set (
 			store, &iter,
-			0, camel_mime_message_get_subject (msg) ?
-			camel_mime_message_get_subject (msg) : "",
-			1, from ? from : "", 2, msg, -1);
+			0, subject ? subject : "",
+			1, from ? from : "", 2, offset, -1);
 
-		g_object_unref (msg);
+		g_free (subject);
 		g_free (from);
 
-		camel_mime_parser_step (mp, NULL, NULL);
+		n_messages++;
+
+		if (state == CAMEL_MIME_PARSER_STATE_EOF)
+			break;
 	}
 
 	if (store) {
@@ -418,6 +482,10 @@ mbox_get_preview (EImport *ei,
 		preview = e_web_view_preview_new ();
 		gtk_widget_show (preview);
 
+		g_object_set_data_full (
+			G_OBJECT (preview), "mbox-filename",
+			g_strdup (filename), (GDestroyNotify) g_free);
+
 		tree_view = e_web_view_preview_get_tree_view (
 			E_WEB_VIEW_PREVIEW (preview));
 		if (!tree_view) {
@@ -471,6 +539,7 @@ mbox_get_preview (EImport *ei,
 
  cleanup:
 	g_object_unref (mp);
+	g_free (filename);
 
 	/* 'fd' is freed together with 'mp' */
 	/* coverity[leaked_handle] */
@@ -95,16 +95,298 @@ decode_mozilla_status (const gchar *tmp)
 	return flags;
 }
 
+static CamelMessageInfo *
+import_mbox_message_info (CamelMimeMessage *msg)
+{
+	CamelMessageInfo *info;
+	const gchar *tmp;
+	guint32 flags = 0;
+
+	info = camel_message_info_new (NULL);
+
+	tmp = camel_medium_get_header ((CamelMedium *) msg, "X-Mozilla-Status");
+	if (tmp)
+		flags |= decode_mozilla_status (tmp);
+	tmp = camel_medium_get_header ((CamelMedium *) msg, "Status");
+	if (tmp)
+		flags |= decode_status (tmp);
+	tmp = camel_medium_get_header ((CamelMedium *) msg, "X-Status");
+	if (tmp)
+		flags |= decode_status (tmp);
+
+	camel_message_info_set_flags (info, flags, ~0);
+
+	return info;
+}
+
+/* Number of worker threads parsing messages, and how many
+ * messages each may parse ahead of the one being appended. */
+#define IMPORT_MBOX_MAX_THREADS 4
+#define IMPORT_MBOX_WINDOW_PER_THREAD 32
+
+typedef struct {
+	GMutex lock;
+	GCond cond;
+	GCancellable *cancellable;
+} ImportMboxPipeline;
+
+typedef struct {
+	const gchar *data;
+	gsize length;
+
+	CamelMimeMessage *message;
+	CamelMessageInfo *info;
+	gboolean done;
+} ImportMboxJob;
+
+/* Returns the offset of the first "From " line at or after @offset,
+ * or @length if there is none. */
+static gsize
+import_mbox_find_from (const gchar *data,
+                       gsize length,
+                       gsize offset)
+{
+	const gchar *p = data + offset;
+	const gchar *end = data + length;
+
+	while (p < end) {
+		if ((p == data || p[-1] == '\n') &&
+		    end - p >= 5 && strncmp (p, "From ", 5) == 0)
+			return p - data;
+
+		p = memchr (p, '\n', end - p);
+		if (p == NULL)
+			break;
+		p++;
+	}
+
+	return length;
+}
+
+static void
+import_mbox_parse_job (gpointer data,
+                       gpointer user_data)
+{
+	ImportMboxJob *job = data;
+	ImportMboxPipeline *pipeline = user_data;
+
+	if (!g_cancellable_is_cancelled (pipeline->cancellable)) {
+		CamelMimeParser *mp;
+		CamelStream *stream;
+
+		stream = camel_stream_mem_new_with_buffer (job->data, job->length);
+
+		mp = camel_mime_parser_new ();
+		camel_mime_parser_scan_from (mp, TRUE);
+		camel_mime_parser_init_with_stream (mp, stream, NULL);
+
+		if (camel_mime_parser_step (mp, NULL, NULL) == CAMEL_MIME_PARSER_STATE_FROM) {
+			CamelMimeMessage *msg;
+
+			msg = camel_mime_message_new ();
+			if (camel_mime_part_construct_from_parser_sync (
+				(CamelMimePart *) msg, mp, NULL, NULL)) {
+				job->message = msg;
+				job->info = import_mbox_message_info (msg);
+			} else {
+				g_object_unref (msg);
+			}
+		}
+
+		g_object_unref (mp);
+		g_object_unref (stream);
+	}
+
+	g_mutex_lock (&pipeline->lock);
+	job->done = TRUE;
+	g_cond_broadcast (&pipeline->cond);
+	g_mutex_unlock (&pipeline->lock);
+}
+
+static void
+import_mbox_job_free (ImportMboxJob *job)
+{
+	if (job->message)
+		g_object_unref (job->message);
+	if (job->info)
+		camel_message_info_unref (job->info);
+
+	g_slice_free (ImportMboxJob, job);
+}
+
+/* Splits the mapped mbox at From lines and builds the messages on a
+ * pool of worker threads, while this thread appends them to @folder
+ * in file order.  Returns FALSE if the file could not be mapped. */
+static gboolean
+import_mbox_pipelined (struct _import_mbox_msg *m,
+                       CamelFolder *folder,
+                       GCancellable *cancellable,
+                       GError **error)
+{
+	ImportMboxPipeline pipeline;
+	GMappedFile *mapped;
+	GThreadPool *pool;
+	GQueue pending = G_QUEUE_INIT;
+	const gchar *data;
+	gsize length, offset;
+	guint n_threads, window;
+	gboolean stop = FALSE;
+
+	mapped = g_mapped_file_new (m->path, FALSE, NULL);
+	if (mapped == NULL)
+		return FALSE;
+
+	data = g_mapped_file_get_contents (mapped);
+	length = g_mapped_file_get_length (mapped);
+	offset = length > 0 ? import_mbox_find_from (data, length, 0) : 0;
+
+	n_threads = CLAMP (g_get_num_processors (), 1, IMPORT_MBOX_MAX_THREADS);
+	window = n_threads * IMPORT_MBOX_WINDOW_PER_THREAD;
+
+	g_mutex_init (&pipeline.lock);
+	g_cond_init (&pipeline.cond);
+	pipeline.cancellable = cancellable;
+
+	pool = g_thread_pool_new (
+		import_mbox_parse_job, &pipeline, n_threads, FALSE, NULL);
+
+	while (offset < length || !g_queue_is_empty (&pending)) {
+		ImportMboxJob *job;
+
+		/* Keep the workers parsing ahead of the appends. */
+		while (offset < length && g_queue_get_length (&pending) < window) {
+			gsize next;
+
+			next = import_mbox_find_from (data, length, offset + 1);
+
+			job = g_slice_new0 (ImportMboxJob);
+			job->data = data + offset;
+			job->length = next - offset;
+
+			g_queue_push_tail (&pending, job);
+			g_thread_pool_push (pool, job, NULL);
+
+			offset = next;
+		}
+
+		job = g_queue_pop_head (&pending);
+
+		g_mutex_lock (&pipeline.lock);
+		while (!job->done)
+			g_cond_wait (&pipeline.cond, &pipeline.lock);
+		g_mutex_unlock (&pipeline.lock);
+
+		if (!stop && job->message != NULL) {
+			GError *local_error = NULL;
+
+			camel_folder_append_message_sync (
+				folder, job->message, job->info, NULL,
+				cancellable, &local_error);
+
+			if (local_error != NULL) {
+				g_propagate_error (error, local_error);
+				stop = TRUE;
+			}
+		}
+
+		if (!stop)
+			camel_operation_progress (
+				m->cancellable, (gint) (100.0 * ((gdouble)
+				(job->data + job->length - data) / (gdouble) length)));
+
+		import_mbox_job_free (job);
+
+		/* Stop queueing and appending, but still wait for the
+		 * jobs in flight, the workers use the pipeline. */
+		if (stop || g_cancellable_is_cancelled (cancellable)) {
+			stop = TRUE;
+			offset = length;
+		}
+	}
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	g_mutex_clear (&pipeline.lock);
+	g_cond_clear (&pipeline.cond);
+
+	g_mapped_file_unref (mapped);
+
+	return TRUE;
+}
+
+static void
+import_mbox_sequential (struct _import_mbox_msg *m,
+                        CamelFolder *folder,
+                        struct stat *st,
+                        GCancellable *cancellable,
+                        GError **error)
+{
+	CamelMimeParser *mp;
+	gint fd;
+
+	fd = g_open (m->path, O_RDONLY | O_BINARY, 0);
+	if (fd == -1) {
+		g_warning (
+			"cannot find source file to import '%s': %s",
+			m->path, g_strerror (errno));
+		return;
+	}
+
+	mp = camel_mime_parser_new ();
+	camel_mime_parser_scan_from (mp, TRUE);
+	if (camel_mime_parser_init_with_fd (mp, fd) == -1) {
+		/* will never happen - 0 is unconditionally returned */
+		goto exit;
+	}
+
+	while (camel_mime_parser_step (mp, NULL, NULL) ==
+			CAMEL_MIME_PARSER_STATE_FROM) {
+
+		CamelMimeMessage *msg;
+		CamelMessageInfo *info;
+		gint pc = 0;
+
+		if (st->st_size > 0)
+			pc = (gint) (100.0 * ((gdouble)
+				camel_mime_parser_tell (mp) /
+				(gdouble) st->st_size));
+		camel_operation_progress (m->cancellable, pc);
+
+		msg = camel_mime_message_new ();
+		if (!camel_mime_part_construct_from_parser_sync (
+			(CamelMimePart *) msg, mp, NULL, NULL)) {
+			/* set exception? */
+			g_object_unref (msg);
+			break;
+		}
+
+		info = import_mbox_message_info (msg);
+		camel_folder_append_message_sync (
+			folder, msg, info, NULL,
+			cancellable, error);
+		camel_message_info_unref (info);
+		g_object_unref (msg);
+
+		if (error && *error != NULL)
+			break;
+
+		camel_mime_parser_step (mp, NULL, NULL);
+	}
+
+exit:
+	g_object_unref (mp);
+
+	/* 'fd' is freed together with 'mp' */
+	/* coverity[leaked_handle] */
+}
+
 static void
 import_mbox_exec (struct _import_mbox_msg *m,
                   GCancellable *cancellable,
                   GError **error)
 {
 	CamelFolder *folder;
-	CamelMimeParser *mp = NULL;
 	struct stat st;
-	gint fd;
-	CamelMessageInfo *info;
 
 	if (g_stat (m->path, &st) == -1) {
 		g_warning (
@@ -125,84 +407,23 @@ import_mbox_exec (struct _import_mbox_msg *m,
 		return;
 
 	if (S_ISREG (st.st_mode)) {
-		fd = g_open (m->path, O_RDONLY | O_BINARY, 0);
-		if (fd == -1) {
-			g_warning (
-				"cannot find source file to import '%s': %s",
-				m->path, g_strerror (errno));
-			goto fail1;
-		}
-
-		mp = camel_mime_parser_new ();
-		camel_mime_parser_scan_from (mp, TRUE);
-		if (camel_mime_parser_init_with_fd (mp, fd) == -1) {
-			/* will never happen - 0 is unconditionally returned */
-			goto fail2;
-		}
-
 		camel_operation_push_message (
 			m->cancellable, _("Importing '%s'"),
 			camel_folder_get_display_name (folder));
 		camel_folder_freeze (folder);
-		while (camel_mime_parser_step (mp, NULL, NULL) ==
-				CAMEL_MIME_PARSER_STATE_FROM) {
-
-			CamelMimeMessage *msg;
-			const gchar *tmp;
-			gint pc = 0;
-			guint32 flags = 0;
 
-			if (st.st_size > 0)
-				pc = (gint) (100.0 * ((gdouble)
-					camel_mime_parser_tell (mp) /
-					(gdouble) st.st_size));
-			camel_operation_progress (m->cancellable, pc);
+		if (!import_mbox_pipelined (m, folder, cancellable, error))
+			import_mbox_sequential (m, folder, &st, cancellable, error);
 
-			msg = camel_mime_message_new ();
-			if (!camel_mime_part_construct_from_parser_sync (
-				(CamelMimePart *) msg, mp, NULL, NULL)) {
-				/* set exception? */
-				g_object_unref (msg);
-				break;
-			}
-
-			info = camel_message_info_new (NULL);
-
-			tmp = camel_medium_get_header ((CamelMedium *) msg, "X-Mozilla-Status");
-			if (tmp)
-				flags |= decode_mozilla_status (tmp);
-			tmp = camel_medium_get_header ((CamelMedium *) msg, "Status");
-			if (tmp)
-				flags |= decode_status (tmp);
-			tmp = camel_medium_get_header ((CamelMedium *) msg, "X-Status");
-			if (tmp)
-				flags |= decode_status (tmp);
-
-			camel_message_info_set_flags (info, flags, ~0);
-			camel_folder_append_message_sync (
-				folder, msg, info, NULL,
-				cancellable, error);
-			camel_message_info_unref (info);
-			g_object_unref (msg);
-
-			if (error && *error != NULL)
-				break;
-
-			camel_mime_parser_step (mp, NULL, NULL);
-		}
 		/* FIXME Not passing a GCancellable or GError here. */
 		camel_folder_synchronize_sync (folder, FALSE, NULL, NULL);
 		camel_folder_thaw (folder);
 		camel_operation_pop_message (m->cancellable);
-	fail2:
-		g_object_unref (mp);
 	}
-fail1:
+
 	/* FIXME Not passing a GCancellable or GError here. */
 	camel_folder_synchronize_sync (folder, FALSE, NULL, NULL);
 	g_object_unref (folder);
-	/* 'fd' is freed together with 'mp' */
-	/* coverity[leaked_handle] */
 }
 
 static void
@@ -64,6 +64,10 @@
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), MESSAGE_LIST_TYPE, MessageListPrivate))
 
+/* Folder changes bigger than this are applied with a full regen
+ * rather than one tree model notification per affected message. */
+#define ML_INCREMENTAL_MAX_CHANGES 250
+
 /* Common search expression segments. */
 #define EXCLUDE_DELETED_MESSAGES_EXPR	"(not (system-flag \"deleted\"))"
 #define EXCLUDE_JUNK_MESSAGES_EXPR	"(not (system-flag \"junk\"))"
@@ -111,6 +115,11 @@ struct _MessageListPrivate {
 	GNode *tree_model_root;
 	gint tree_model_frozen;
 
+	/* Message-ID lookup for threading incremental folder changes.
+	 * Built on demand and dropped whenever the tree is rebuilt. */
+	GHashTable *msgid_nodemap;	/* guint64 message-id -> GNode */
+	GHashTable *msgid_missing;	/* referenced but absent message-ids */
+
 	/* This aids in automatic message selection. */
 	time_t newest_read_date;
 	const gchar *newest_read_uid;
@@ -157,6 +166,9 @@ struct _RegenData {
 	gchar *select_uid;
 	gboolean select_all;
 	gboolean select_use_fallback;
+
+	/* From the request to the rebuilt tree. */
+	ETraceSpan trace_span;
 };
 
 enum {
@@ -274,6 +286,7 @@ static void	mail_regen_cancel		(MessageList *message_list);
 static void	clear_info			(gchar *key,
 						 GNode *node,
 						 MessageList *message_list);
+static void	ml_msgid_index_clear		(MessageList *message_list);
 
 enum {
 	MESSAGE_SELECTED,
@@ -462,6 +475,8 @@ regen_data_new (MessageList *message_list,
 
 	g_mutex_init (&regen_data->select_lock);
 
+	e_trace_span_begin (&regen_data->trace_span, "mail", "regen-list");
+
 	session = message_list_get_session (message_list);
 	e_mail_ui_session_add_activity (E_MAIL_UI_SESSION (session), activity);
 
@@ -666,6 +681,43 @@ message_list_tree_model_remove (MessageList *message_list,
 		e_tree_model_node_deleted (tree_model, node);
 }
 
+static void
+message_list_tree_model_move (MessageList *message_list,
+                              GNode *node,
+                              GNode *new_parent)
+{
+	ETreeModel *tree_model;
+	GNode *old_parent = node->parent;
+	gboolean tree_model_frozen;
+	gint old_position = 0;
+
+	g_return_if_fail (node != NULL);
+	g_return_if_fail (new_parent != NULL);
+
+	tree_model = E_TREE_MODEL (message_list);
+	tree_model_frozen = (message_list->priv->tree_model_frozen > 0);
+
+	if (!tree_model_frozen) {
+		e_tree_model_pre_change (tree_model);
+		old_position = g_node_child_position (old_parent, node);
+	}
+
+	/* The node and its subtree are kept, so only report a removal
+	 * and a re-insertion; there is nothing to be deleted here. */
+	extended_g_node_unlink (node);
+
+	if (!tree_model_frozen) {
+		e_tree_model_node_removed (
+			tree_model, old_parent, node, old_position);
+		e_tree_model_pre_change (tree_model);
+	}
+
+	extended_g_node_insert (new_parent, -1, node);
+
+	if (!tree_model_frozen)
+		e_tree_model_node_inserted (tree_model, new_parent, node);
+}
+
 static gint
 address_compare (gconstpointer address1,
                  gconstpointer address2,
@@ -988,6 +1040,33 @@ message_list_can_select (MessageList *message_list,
 	return ml_search_path (message_list, direction, flags, mask) != NULL;
 }
 
+/**
+ * message_list_dup_adjacent_uid:
+ * @message_list: a #MessageList
+ * @direction: %MESSAGE_LIST_SELECT_NEXT or %MESSAGE_LIST_SELECT_PREVIOUS
+ *
+ * Returns the UID of the message shown next to the cursor in the given
+ * direction, without changing the selection.  Free it with g_free().
+ *
+ * Return value: a newly allocated UID, or %NULL
+ **/
+gchar *
+message_list_dup_adjacent_uid (MessageList *message_list,
+                               MessageListSelectDirection direction)
+{
+	GNode *node;
+
+	g_return_val_if_fail (IS_MESSAGE_LIST (message_list), NULL);
+
+	node = ml_search_path (
+		message_list, direction & MESSAGE_LIST_SELECT_DIRECTION, 0, 0);
+	if (node == NULL)
+		return NULL;
+
+	return g_strdup (camel_message_info_uid (
+		get_message_info (message_list, node)));
+}
+
 /**
  * message_list_select_uid:
  * @message_list:
@@ -2682,6 +2761,8 @@ message_list_dispose (GObject *object)
 		message_list->uid_nodemap = NULL;
 	}
 
+	ml_msgid_index_clear (message_list);
+
 	g_clear_object (&priv->session);
 	g_clear_object (&priv->folder);
 	g_clear_object (&priv->invisible);
@@ -3496,6 +3577,8 @@ clear_tree (MessageList *message_list,
 	message_list->uid_nodemap = g_hash_table_new (g_str_hash, g_str_equal);
 	g_clear_object (&folder);
 
+	ml_msgid_index_clear (message_list);
+
 	message_list->priv->newest_read_date = 0;
 	message_list->priv->newest_read_uid = NULL;
 	message_list->priv->oldest_unread_date = 0;
@@ -3705,6 +3788,169 @@ find_next_selectable (MessageList *message_list)
 	return NULL;
 }
 
+static void
+ml_msgid_index_insert (MessageList *message_list,
+                       GNode *node)
+{
+	const CamelSummaryMessageID *message_id;
+	const guint64 *id;
+
+	message_id = camel_message_info_message_id (node->data);
+	if (message_id == NULL || message_id->id.id == 0)
+		return;
+
+	id = &message_id->id.id;
+
+	/* First one wins for duplicate Message-IDs, as in threading. */
+	if (!g_hash_table_contains (message_list->priv->msgid_nodemap, id))
+		g_hash_table_insert (
+			message_list->priv->msgid_nodemap,
+			g_memdup (id, sizeof (guint64)), node);
+
+	g_hash_table_remove (message_list->priv->msgid_missing, id);
+}
+
+static void
+ml_msgid_index_remove (MessageList *message_list,
+                       CamelMessageInfo *info,
+                       GNode *node)
+{
+	const CamelSummaryMessageID *message_id;
+	const guint64 *id;
+
+	message_id = camel_message_info_message_id (info);
+	if (message_id == NULL || message_id->id.id == 0)
+		return;
+
+	id = &message_id->id.id;
+
+	if (g_hash_table_lookup (message_list->priv->msgid_nodemap, id) != node)
+		return;
+
+	g_hash_table_remove (message_list->priv->msgid_nodemap, id);
+
+	/* Replies to the message may still be around and would have
+	 * to be re-adopted should the message ever come back. */
+	g_hash_table_add (
+		message_list->priv->msgid_missing,
+		g_memdup (id, sizeof (guint64)));
+}
+
+/* Records the Message-IDs @info refers to which are not in the tree,
+ * so a later arrival of any of them is recognised as a thread parent
+ * that would have to adopt existing messages. */
+static void
+ml_msgid_index_add_missing (MessageList *message_list,
+                            CamelMessageInfo *info)
+{
+	const CamelSummaryReferences *references;
+	gint ii;
+
+	references = camel_message_info_references (info);
+	if (references == NULL)
+		return;
+
+	for (ii = 0; ii < references->size; ii++) {
+		const guint64 *id = &references->references[ii].id.id;
+
+		if (*id == 0)
+			continue;
+
+		if (g_hash_table_contains (message_list->priv->msgid_nodemap, id))
+			continue;
+
+		if (g_hash_table_contains (message_list->priv->msgid_missing, id))
+			continue;
+
+		g_hash_table_add (
+			message_list->priv->msgid_missing,
+			g_memdup (id, sizeof (guint64)));
+	}
+}
+
+static void
+ml_msgid_index_ensure (MessageList *message_list)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	if (message_list->priv->msgid_nodemap != NULL)
+		return;
+
+	message_list->priv->msgid_nodemap = g_hash_table_new_full (
+		g_int64_hash, g_int64_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) NULL);
+	message_list->priv->msgid_missing = g_hash_table_new_full (
+		g_int64_hash, g_int64_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) NULL);
+
+	g_hash_table_iter_init (&iter, message_list->uid_nodemap);
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+		ml_msgid_index_insert (message_list, value);
+
+	/* Second pass, now that every present Message-ID is known. */
+	g_hash_table_iter_init (&iter, message_list->uid_nodemap);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		GNode *node = value;
+
+		ml_msgid_index_add_missing (message_list, node->data);
+	}
+}
+
+static void
+ml_msgid_index_clear (MessageList *message_list)
+{
+	if (message_list->priv->msgid_nodemap != NULL) {
+		g_hash_table_destroy (message_list->priv->msgid_nodemap);
+		message_list->priv->msgid_nodemap = NULL;
+	}
+
+	if (message_list->priv->msgid_missing != NULL) {
+		g_hash_table_destroy (message_list->priv->msgid_missing);
+		message_list->priv->msgid_missing = NULL;
+	}
+}
+
+/* Finds the closest ancestor of @info already shown in the tree.
+ * References are stored nearest parent first.  A reference to a
+ * message listed in @removed_ancestors, if given, resolves to the
+ * ancestor that message's replies were promoted to. */
+static GNode *
+ml_msgid_index_find_parent (MessageList *message_list,
+                            CamelMessageInfo *info,
+                            GHashTable *removed_ancestors)
+{
+	const CamelSummaryReferences *references;
+	gint ii;
+
+	references = camel_message_info_references (info);
+	if (references == NULL)
+		return NULL;
+
+	for (ii = 0; ii < references->size; ii++) {
+		GNode *node;
+
+		node = g_hash_table_lookup (
+			message_list->priv->msgid_nodemap,
+			&references->references[ii].id.id);
+		if (node != NULL)
+			return node;
+
+		if (removed_ancestors != NULL &&
+		    g_hash_table_lookup_extended (
+		    removed_ancestors, &references->references[ii].id.id,
+		    NULL, (gpointer *) &node)) {
+			if (node == message_list->priv->tree_model_root)
+				node = NULL;
+			return node;
+		}
+	}
+
+	return NULL;
+}
+
 static GNode *
 ml_uid_nodemap_insert (MessageList *message_list,
                        CamelMessageInfo *info,
@@ -3733,6 +3979,9 @@ ml_uid_nodemap_insert (MessageList *message_list,
 	camel_message_info_ref (info);
 	g_hash_table_insert (message_list->uid_nodemap, (gpointer) uid, node);
 
+	if (message_list->priv->msgid_nodemap != NULL)
+		ml_msgid_index_insert (message_list, node);
+
 	/* Track the latest seen and unseen messages shown, used in
 	 * fallback heuristics for automatic message selection. */
 	if (flags & CAMEL_MESSAGE_SEEN) {
@@ -3777,6 +4026,11 @@ ml_uid_nodemap_remove (MessageList *message_list,
 		message_list->priv->oldest_unread_uid = NULL;
 	}
 
+	if (message_list->priv->msgid_nodemap != NULL)
+		ml_msgid_index_remove (
+			message_list, info,
+			g_hash_table_lookup (message_list->uid_nodemap, uid));
+
 	g_hash_table_remove (message_list->uid_nodemap, uid);
 	camel_message_info_unref (info);
 
@@ -4195,13 +4449,454 @@ mail_folder_hide_by_flag (CamelFolder *folder,
 	return newchanges;
 }
 
+static void
+ml_apply_changed_uids (MessageList *message_list,
+                       GPtrArray *uid_changed)
+{
+	ETreeModel *tree_model;
+	guint ii;
+
+	tree_model = E_TREE_MODEL (message_list);
+
+	for (ii = 0; ii < uid_changed->len; ii++) {
+		GNode *node;
+
+		node = g_hash_table_lookup (
+			message_list->uid_nodemap,
+			uid_changed->pdata[ii]);
+		if (node) {
+			e_tree_model_pre_change (tree_model);
+			e_tree_model_node_data_changed (tree_model, node);
+
+			message_list_change_first_visible_parent (message_list, node);
+		}
+	}
+}
+
+/* Removes a single message from the tree.  Replies to it are promoted
+ * to its parent, the same way CamelFolderThread treats a thread whose
+ * intermediate message is missing. */
+static void
+ml_remove_node_promote_children (MessageList *message_list,
+                                 GNode *node)
+{
+	ETreeModel *tree_model;
+	GNode *parent = node->parent;
+	GNode *child;
+
+	tree_model = E_TREE_MODEL (message_list);
+
+	while ((child = g_node_first_child (node)) != NULL)
+		message_list_tree_model_move (message_list, child, parent);
+
+	remove_node_diff (message_list, node, 0);
+
+	/* The parent row may summarize its (now smaller) subtree. */
+	if (parent != message_list->priv->tree_model_root) {
+		e_tree_model_pre_change (tree_model);
+		e_tree_model_node_data_changed (tree_model, parent);
+
+		message_list_change_first_visible_parent (message_list, parent);
+	}
+}
+
+static gboolean
+ml_search_is_active (MessageList *message_list)
+{
+	return message_list->search != NULL &&
+		*message_list->search != '\0' &&
+		strcmp (message_list->search, " ") != 0;
+}
+
+/* Runs the current search on just @uids.  Returns the set of matching
+ * UIDs, or %NULL if the search failed. */
+static GHashTable *
+ml_search_uids (MessageList *message_list,
+                CamelFolder *folder,
+                GPtrArray *uids)
+{
+	GPtrArray *matches;
+	GHashTable *matched;
+	GError *local_error = NULL;
+	guint ii;
+
+	matches = camel_folder_search_by_uids (
+		folder, message_list->search, uids, NULL, &local_error);
+
+	if (local_error != NULL) {
+		g_warning ("%s: %s", G_STRFUNC, local_error->message);
+		g_error_free (local_error);
+		return NULL;
+	}
+
+	if (matches == NULL)
+		return NULL;
+
+	matched = g_hash_table_new_full (
+		g_str_hash, g_str_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) NULL);
+	for (ii = 0; ii < matches->len; ii++)
+		g_hash_table_add (matched, g_strdup (matches->pdata[ii]));
+
+	camel_folder_search_free (folder, matches);
+
+	return matched;
+}
+
+/* Maps the Message-ID of every node about to be removed to its nearest
+ * ancestor which stays in the tree, which is where its replies end up
+ * once ml_remove_node_promote_children() has run for all of them. */
+static GHashTable *
+ml_removed_ancestors_new (MessageList *message_list,
+                          GPtrArray *removed)
+{
+	GHashTable *removed_nodes;
+	GHashTable *ancestors;
+	GHashTableIter iter;
+	gpointer key;
+	guint ii;
+
+	removed_nodes = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (ii = 0; ii < removed->len; ii++) {
+		GNode *node;
+
+		node = g_hash_table_lookup (
+			message_list->uid_nodemap, removed->pdata[ii]);
+		if (node != NULL)
+			g_hash_table_add (removed_nodes, node);
+	}
+
+	ancestors = g_hash_table_new_full (
+		g_int64_hash, g_int64_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) NULL);
+
+	g_hash_table_iter_init (&iter, removed_nodes);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		const CamelSummaryMessageID *message_id;
+		GNode *node = key;
+		GNode *ancestor;
+
+		message_id = camel_message_info_message_id (node->data);
+		if (message_id == NULL || message_id->id.id == 0)
+			continue;
+
+		ancestor = node->parent;
+		while (g_hash_table_contains (removed_nodes, ancestor))
+			ancestor = ancestor->parent;
+
+		g_hash_table_insert (
+			ancestors,
+			g_memdup (&message_id->id.id, sizeof (guint64)),
+			ancestor);
+	}
+
+	g_hash_table_destroy (removed_nodes);
+
+	return ancestors;
+}
+
+/* Checks whether @added can be threaded into the existing tree one
+ * message at a time, without re-threading anything already shown. */
+static gboolean
+ml_can_thread_incrementally (MessageList *message_list,
+                             GPtrArray *added)
+{
+	GHashTable *added_ids;
+	gboolean thread_subject;
+	gboolean success = TRUE;
+	guint ii;
+
+	thread_subject = message_list_get_thread_subject (message_list);
+
+	ml_msgid_index_ensure (message_list);
+
+	/* message-id -> position in @added, plus one */
+	added_ids = g_hash_table_new (g_int64_hash, g_int64_equal);
+
+	for (ii = 0; ii < added->len; ii++) {
+		const CamelSummaryMessageID *message_id;
+
+		message_id = camel_message_info_message_id (added->pdata[ii]);
+		if (message_id != NULL && message_id->id.id != 0)
+			g_hash_table_insert (
+				added_ids, (gpointer) &message_id->id.id,
+				GUINT_TO_POINTER (ii + 1));
+	}
+
+	for (ii = 0; success && ii < added->len; ii++) {
+		CamelMessageInfo *info = added->pdata[ii];
+		const CamelSummaryMessageID *message_id;
+		const CamelSummaryReferences *references;
+		gboolean has_parent = FALSE;
+		gint jj;
+
+		/* The new message is the parent of messages already
+		 * shown, which would all have to be re-adopted. */
+		message_id = camel_message_info_message_id (info);
+		if (message_id != NULL && message_id->id.id != 0 &&
+		    g_hash_table_contains (
+		    message_list->priv->msgid_missing, &message_id->id.id)) {
+			success = FALSE;
+			break;
+		}
+
+		references = camel_message_info_references (info);
+		for (jj = 0; references != NULL && jj < references->size; jj++) {
+			const guint64 *id = &references->references[jj].id.id;
+			guint position;
+
+			if (g_hash_table_contains (
+			    message_list->priv->msgid_nodemap, id)) {
+				has_parent = TRUE;
+				continue;
+			}
+
+			/* A reply ordered before its own parent. */
+			position = GPOINTER_TO_UINT (
+				g_hash_table_lookup (added_ids, id));
+			if (position > ii) {
+				success = FALSE;
+				break;
+			} else if (position > 0) {
+				has_parent = TRUE;
+			}
+		}
+
+		/* Subject threading needs the whole folder at hand. */
+		if (thread_subject && !has_parent)
+			success = FALSE;
+	}
+
+	g_hash_table_destroy (added_ids);
+
+	return success;
+}
+
+/* Applies @changes straight to the existing tree.  Returns %FALSE,
+ * without having touched the tree, when a full regen is needed. */
+static gboolean
+message_list_apply_folder_changes (MessageList *message_list,
+                                   CamelFolder *folder,
+                                   CamelFolderChangeInfo *changes)
+{
+	RegenData *regen_data;
+	GPtrArray *added;
+	GPtrArray *removed;
+	GHashTable *removed_ancestors = NULL;
+	gboolean group_by_threads;
+	gboolean cursor_removed = FALSE;
+	gboolean success = FALSE;
+	guint32 hidden_flags = 0;
+	guint n_shown, n_removed = 0;
+	guint ii;
+
+	if (message_list->frozen > 0)
+		return FALSE;
+
+	/* A pending or running regen picks up these changes anyway. */
+	regen_data = message_list_ref_regen_data (message_list);
+	if (regen_data != NULL) {
+		regen_data_unref (regen_data);
+		return FALSE;
+	}
+
+	if (message_list->priv->tree_model_root == NULL)
+		return FALSE;
+
+	if (changes->uid_added->len +
+	    changes->uid_removed->len +
+	    changes->uid_changed->len > ML_INCREMENTAL_MAX_CHANGES)
+		return FALSE;
+
+	group_by_threads = message_list_get_group_by_threads (message_list);
+
+	if (message_list_get_hide_junk (message_list, folder))
+		hidden_flags |= CAMEL_MESSAGE_JUNK;
+	if (message_list_get_hide_deleted (message_list, folder))
+		hidden_flags |= CAMEL_MESSAGE_DELETED;
+
+	added = g_ptr_array_new_with_free_func (
+		(GDestroyNotify) camel_message_info_unref);
+	removed = g_ptr_array_new ();
+
+	for (ii = 0; ii < changes->uid_removed->len; ii++) {
+		const gchar *uid = changes->uid_removed->pdata[ii];
+
+		if (g_hash_table_contains (message_list->uid_nodemap, uid))
+			g_ptr_array_add (removed, (gpointer) uid);
+	}
+
+	for (ii = 0; ii < changes->uid_added->len; ii++) {
+		const gchar *uid = changes->uid_added->pdata[ii];
+		CamelMessageInfo *info;
+
+		if (g_hash_table_contains (message_list->uid_nodemap, uid))
+			continue;
+
+		info = camel_folder_get_message_info (folder, uid);
+		if (info == NULL)
+			continue;
+
+		if ((camel_message_info_flags (info) & hidden_flags) != 0) {
+			camel_message_info_unref (info);
+			continue;
+		}
+
+		g_ptr_array_add (added, info);
+	}
+
+	/* Changed messages may have stopped or started matching the
+	 * search, so run it on them as well as on the new messages. */
+	if (ml_search_is_active (message_list) &&
+	    (added->len > 0 || changes->uid_changed->len > 0)) {
+		GPtrArray *uids;
+		GHashTable *matched;
+
+		uids = g_ptr_array_sized_new (
+			added->len + changes->uid_changed->len);
+		for (ii = 0; ii < added->len; ii++)
+			g_ptr_array_add (
+				uids, (gpointer) camel_message_info_uid (
+				added->pdata[ii]));
+		for (ii = 0; ii < changes->uid_changed->len; ii++)
+			g_ptr_array_add (uids, changes->uid_changed->pdata[ii]);
+
+		matched = ml_search_uids (message_list, folder, uids);
+
+		g_ptr_array_free (uids, TRUE);
+
+		if (matched == NULL)
+			goto exit;
+
+		ii = 0;
+		while (ii < added->len) {
+			const gchar *uid;
+
+			uid = camel_message_info_uid (added->pdata[ii]);
+
+			if (g_hash_table_contains (matched, uid))
+				ii++;
+			else
+				g_ptr_array_remove_index (added, ii);
+		}
+
+		for (ii = 0; ii < changes->uid_changed->len; ii++) {
+			const gchar *uid = changes->uid_changed->pdata[ii];
+			CamelMessageInfo *info;
+
+			if (g_hash_table_contains (message_list->uid_nodemap, uid)) {
+				/* Keep the displayed message, as a regen
+				 * would in that case; see
+				 * message_list_regen_tweak_search_results(). */
+				if (!g_hash_table_contains (matched, uid) &&
+				    g_strcmp0 (message_list->cursor_uid, uid) != 0)
+					g_ptr_array_add (removed, (gpointer) uid);
+				continue;
+			}
+
+			if (!g_hash_table_contains (matched, uid))
+				continue;
+
+			info = camel_folder_get_message_info (folder, uid);
+			if (info == NULL)
+				continue;
+
+			if ((camel_message_info_flags (info) & hidden_flags) != 0) {
+				camel_message_info_unref (info);
+				continue;
+			}
+
+			g_ptr_array_add (added, info);
+		}
+
+		g_hash_table_destroy (matched);
+	}
+
+	n_removed = removed->len;
+
+	/* Let a regen update the "empty folder" info message. */
+	n_shown = g_hash_table_size (message_list->uid_nodemap);
+	if (n_shown == 0 || n_shown == n_removed)
+		goto exit;
+
+	if (group_by_threads && added->len > 0) {
+		if (!ml_can_thread_incrementally (message_list, added))
+			goto exit;
+
+		/* Replies to removed messages must follow their
+		 * siblings to the nearest ancestor still shown. */
+		if (removed->len > 0)
+			removed_ancestors = ml_removed_ancestors_new (
+				message_list, removed);
+	}
+
+	/* Nothing can fail from here on, so start touching the tree. */
+
+	for (ii = 0; ii < removed->len; ii++) {
+		const gchar *uid = removed->pdata[ii];
+		GNode *node;
+
+		node = g_hash_table_lookup (message_list->uid_nodemap, uid);
+		if (node == NULL)
+			continue;
+
+		if (g_strcmp0 (message_list->cursor_uid, uid) == 0)
+			cursor_removed = TRUE;
+
+		ml_remove_node_promote_children (message_list, node);
+	}
+
+	/* Parents are resolved only now that the removals are done. */
+	for (ii = 0; ii < added->len; ii++) {
+		CamelMessageInfo *info = added->pdata[ii];
+		GNode *parent = NULL;
+		GNode *node;
+
+		if (group_by_threads)
+			parent = ml_msgid_index_find_parent (
+				message_list, info, removed_ancestors);
+
+		node = ml_uid_nodemap_insert (message_list, info, parent, -1);
+
+		if (group_by_threads)
+			ml_msgid_index_add_missing (message_list, info);
+
+		if (parent != NULL)
+			message_list_change_first_visible_parent (
+				message_list, node);
+	}
+
+	ml_apply_changed_uids (message_list, changes->uid_changed);
+
+	if (cursor_removed) {
+		g_free (message_list->cursor_uid);
+		message_list->cursor_uid = NULL;
+		g_signal_emit (
+			message_list,
+			signals[MESSAGE_SELECTED], 0, NULL);
+	}
+
+	success = TRUE;
+
+exit:
+	if (removed_ancestors != NULL)
+		g_hash_table_destroy (removed_ancestors);
+
+	g_ptr_array_unref (removed);
+	g_ptr_array_unref (added);
+
+	return success;
+}
+
 static void
 message_list_folder_changed (CamelFolder *folder,
                              CamelFolderChangeInfo *changes,
                              MessageList *message_list)
 {
 	CamelFolderChangeInfo *altered_changes = NULL;
-	ETreeModel *tree_model;
 	gboolean need_list_regen = TRUE;
 	gboolean hide_junk;
 	gboolean hide_deleted;
@@ -4210,8 +4905,6 @@ message_list_folder_changed (CamelFolder *folder,
 	if (message_list->priv->destroyed)
 		return;
 
-	tree_model = E_TREE_MODEL (message_list);
-
 	hide_junk = message_list_get_hide_junk (message_list, folder);
 	hide_deleted = message_list_get_hide_deleted (message_list, folder);
 
@@ -4240,21 +4933,19 @@ message_list_folder_changed (CamelFolder *folder,
 			camel_folder_change_info_cat (altered_changes, changes);
 		}
 
-		if (altered_changes->uid_added->len == 0 && altered_changes->uid_removed->len == 0 && altered_changes->uid_changed->len < 100) {
-			for (i = 0; i < altered_changes->uid_changed->len; i++) {
-				GNode *node;
-
-				node = g_hash_table_lookup (
-					message_list->uid_nodemap,
-					altered_changes->uid_changed->pdata[i]);
-				if (node) {
-					e_tree_model_pre_change (tree_model);
-					e_tree_model_node_data_changed (tree_model, node);
+		/* With a search active, changed messages have to be
+		 * checked against it, which the full path takes care of. */
+		if (altered_changes->uid_added->len == 0 && altered_changes->uid_removed->len == 0 && altered_changes->uid_changed->len < 100 &&
+		    !ml_search_is_active (message_list)) {
+			ml_apply_changed_uids (
+				message_list, altered_changes->uid_changed);
 
-					message_list_change_first_visible_parent (message_list, node);
-				}
-			}
+			g_signal_emit (
+				message_list,
+				signals[MESSAGE_LIST_BUILT], 0);
 
+			need_list_regen = FALSE;
+		} else if (message_list_apply_folder_changes (message_list, folder, altered_changes)) {
 			g_signal_emit (
 				message_list,
 				signals[MESSAGE_LIST_BUILT], 0);
@@ -4806,29 +5497,348 @@ message_list_set_selected (MessageList *message_list,
 	g_ptr_array_free (paths, TRUE);
 }
 
-struct ml_sort_uids_data {
-	gchar *uid;
-	gint row;
+/* Sort keys for a set of messages, extracted once per sort column into
+ * flat arrays, so that comparisons never have to go back to the message
+ * infos, the folder summary or a hash table.  Items are identified by
+ * their index; ties are broken by that index, which lets the caller
+ * pre-order the items to get a stable fallback order for free. */
+
+/* Below this many items per thread, sorting in parallel doesn't pay. */
+#define ML_SORT_KEYS_MIN_CHUNK 16384
+
+typedef enum {
+	ML_SORT_KEY_INT,	/* gint64, zero sorts as "no value" */
+	ML_SORT_KEY_STRING,	/* owned strcmp()-able key, or NULL */
+	ML_SORT_KEY_VALUE	/* column value, uses the column compare */
+} MLSortKeyKind;
+
+typedef struct _MLSortKeyColumn MLSortKeyColumn;
+typedef struct _MLSortKeys MLSortKeys;
+typedef struct _MLSortKeysChunk MLSortKeysChunk;
+
+struct _MLSortKeyColumn {
+	MLSortKeyKind kind;
+	gboolean descending;
+	GCompareDataFunc compare;
+	gint64 *ints;
+	gchar **strings;
+	gpointer *values;
+};
+
+struct _MLSortKeys {
+	guint n_items;
+	guint n_columns;
+	MLSortKeyColumn *columns;
+};
+
+struct _MLSortKeysChunk {
+	MLSortKeys *sort_keys;
+	guint *order;
+	guint length;
 };
 
+static MLSortKeys *
+ml_sort_keys_new (guint n_items,
+                  guint n_columns)
+{
+	MLSortKeys *sort_keys;
+
+	sort_keys = g_slice_new0 (MLSortKeys);
+	sort_keys->n_items = n_items;
+	sort_keys->n_columns = n_columns;
+	sort_keys->columns = g_new0 (MLSortKeyColumn, n_columns);
+
+	return sort_keys;
+}
+
+static void
+ml_sort_keys_free (MLSortKeys *sort_keys)
+{
+	guint ii, jj;
+
+	for (ii = 0; ii < sort_keys->n_columns; ii++) {
+		MLSortKeyColumn *column = &sort_keys->columns[ii];
+
+		if (column->strings != NULL) {
+			for (jj = 0; jj < sort_keys->n_items; jj++)
+				g_free (column->strings[jj]);
+			g_free (column->strings);
+		}
+
+		g_free (column->ints);
+		g_free (column->values);
+	}
+
+	g_free (sort_keys->columns);
+	g_slice_free (MLSortKeys, sort_keys);
+}
+
+static void
+ml_sort_keys_init_column (MLSortKeys *sort_keys,
+                          guint column_index,
+                          MLSortKeyKind kind,
+                          gboolean descending,
+                          GCompareDataFunc compare)
+{
+	MLSortKeyColumn *column;
+
+	g_return_if_fail (column_index < sort_keys->n_columns);
+
+	column = &sort_keys->columns[column_index];
+	column->kind = kind;
+	column->descending = descending;
+	column->compare = compare;
+
+	switch (kind) {
+		case ML_SORT_KEY_INT:
+			column->ints = g_new0 (gint64, sort_keys->n_items);
+			break;
+		case ML_SORT_KEY_STRING:
+			column->strings = g_new0 (gchar *, sort_keys->n_items);
+			break;
+		case ML_SORT_KEY_VALUE:
+			column->values = g_new0 (gpointer, sort_keys->n_items);
+			break;
+	}
+}
+
+static gint
+ml_sort_keys_compare (MLSortKeys *sort_keys,
+                      guint item1,
+                      guint item2,
+                      gpointer cmp_cache)
+{
+	guint ii;
+
+	for (ii = 0; ii < sort_keys->n_columns; ii++) {
+		MLSortKeyColumn *column = &sort_keys->columns[ii];
+		gint res = 0;
+
+		/* Missing values sort first, as in the table sorter. */
+		switch (column->kind) {
+			case ML_SORT_KEY_INT: {
+				gint64 v1 = column->ints[item1];
+				gint64 v2 = column->ints[item2];
+
+				if (v1 == v2)
+					res = 0;
+				else if (v1 == 0 || v2 == 0)
+					res = (v1 == 0) ? -1 : 1;
+				else
+					res = (v1 < v2) ? -1 : 1;
+				break;
+			}
+			case ML_SORT_KEY_STRING: {
+				const gchar *v1 = column->strings[item1];
+				const gchar *v2 = column->strings[item2];
+
+				if (v1 != NULL && v2 != NULL)
+					res = strcmp (v1, v2);
+				else if (v1 != NULL || v2 != NULL)
+					res = (v1 == NULL) ? -1 : 1;
+				break;
+			}
+			case ML_SORT_KEY_VALUE: {
+				gpointer v1 = column->values[item1];
+				gpointer v2 = column->values[item2];
+
+				if (v1 != NULL && v2 != NULL)
+					res = column->compare (v1, v2, cmp_cache);
+				else if (v1 != NULL || v2 != NULL)
+					res = (v1 == NULL) ? -1 : 1;
+				break;
+			}
+		}
+
+		if (column->descending)
+			res = -res;
+
+		if (res != 0)
+			return res;
+	}
+
+	return (item1 < item2) ? -1 : (item1 > item2) ? 1 : 0;
+}
+
+typedef struct {
+	MLSortKeys *sort_keys;
+	gpointer cmp_cache;
+} MLSortKeysCompareData;
+
 static gint
-ml_sort_uids_cb (gconstpointer a,
-                 gconstpointer b)
+ml_sort_keys_compare_cb (gconstpointer a,
+                         gconstpointer b,
+                         gpointer user_data)
+{
+	MLSortKeysCompareData *data = user_data;
+
+	return ml_sort_keys_compare (
+		data->sort_keys,
+		*((const guint *) a),
+		*((const guint *) b),
+		data->cmp_cache);
+}
+
+static gpointer
+ml_sort_keys_sort_chunk_thread (gpointer user_data)
 {
-	struct ml_sort_uids_data * const *pdataA = a;
-	struct ml_sort_uids_data * const *pdataB = b;
+	MLSortKeysChunk *chunk = user_data;
+	MLSortKeysCompareData data;
+
+	/* The compare cache is not thread-safe, so one per thread. */
+	data.sort_keys = chunk->sort_keys;
+	data.cmp_cache = e_table_sorting_utils_create_cmp_cache ();
+
+	g_qsort_with_data (
+		chunk->order, chunk->length, sizeof (guint),
+		ml_sort_keys_compare_cb, &data);
 
-	return (* pdataA)->row - (* pdataB)->row;
+	e_table_sorting_utils_free_cmp_cache (data.cmp_cache);
+
+	return NULL;
+}
+
+/* Returns a newly allocated array of item indexes in sorted order,
+ * or %NULL if @cancellable got cancelled meanwhile. */
+static guint *
+ml_sort_keys_sort (MLSortKeys *sort_keys,
+                   GCancellable *cancellable)
+{
+	MLSortKeysChunk *chunks;
+	guint *order, *merged;
+	guint *bounds;
+	guint n_items = sort_keys->n_items;
+	guint n_chunks, chunk_size;
+	guint ii;
+
+	order = g_new (guint, MAX (n_items, 1));
+	for (ii = 0; ii < n_items; ii++)
+		order[ii] = ii;
+
+	n_chunks = MIN (
+		(guint) g_get_num_processors (),
+		n_items / ML_SORT_KEYS_MIN_CHUNK);
+	n_chunks = MAX (n_chunks, 1);
+	chunk_size = (n_items + n_chunks - 1) / n_chunks;
+
+	chunks = g_new0 (MLSortKeysChunk, n_chunks);
+	bounds = g_new (guint, n_chunks + 1);
+
+	for (ii = 0; ii < n_chunks; ii++) {
+		bounds[ii] = MIN (ii * chunk_size, n_items);
+		chunks[ii].sort_keys = sort_keys;
+		chunks[ii].order = order + bounds[ii];
+		chunks[ii].length = MIN (chunk_size, n_items - bounds[ii]);
+	}
+	bounds[n_chunks] = n_items;
+
+	if (n_chunks == 1) {
+		ml_sort_keys_sort_chunk_thread (&chunks[0]);
+	} else {
+		GThread **threads;
+
+		threads = g_new (GThread *, n_chunks);
+
+		/* The calling thread takes the first chunk itself. */
+		for (ii = 1; ii < n_chunks; ii++)
+			threads[ii] = g_thread_new (
+				"ml-sort-keys",
+				ml_sort_keys_sort_chunk_thread,
+				&chunks[ii]);
+
+		ml_sort_keys_sort_chunk_thread (&chunks[0]);
+
+		for (ii = 1; ii < n_chunks; ii++)
+			g_thread_join (threads[ii]);
+
+		g_free (threads);
+	}
+
+	g_free (chunks);
+
+	/* Merge neighbouring runs pairwise until one run is left. */
+	if (n_chunks > 1 && !g_cancellable_is_cancelled (cancellable)) {
+		gpointer cmp_cache;
+		guint n_runs = n_chunks;
+
+		cmp_cache = e_table_sorting_utils_create_cmp_cache ();
+		merged = g_new (guint, n_items);
+
+		while (n_runs > 1) {
+			guint *tmp;
+			guint n_merged = 0;
+
+			for (ii = 0; ii < n_runs; ii += 2) {
+				guint start = bounds[ii];
+				guint middle = bounds[MIN (ii + 1, n_runs)];
+				guint end = bounds[MIN (ii + 2, n_runs)];
+				guint aa = start, bb = middle, out = start;
+
+				while (aa < middle && bb < end) {
+					if (ml_sort_keys_compare (
+						sort_keys, order[aa],
+						order[bb], cmp_cache) <= 0)
+						merged[out++] = order[aa++];
+					else
+						merged[out++] = order[bb++];
+				}
+
+				while (aa < middle)
+					merged[out++] = order[aa++];
+				while (bb < end)
+					merged[out++] = order[bb++];
+
+				bounds[n_merged++] = start;
+			}
+
+			bounds[n_merged] = n_items;
+			n_runs = n_merged;
+
+			tmp = order;
+			order = merged;
+			merged = tmp;
+		}
+
+		g_free (merged);
+		e_table_sorting_utils_free_cmp_cache (cmp_cache);
+	}
+
+	g_free (bounds);
+
+	if (g_cancellable_is_cancelled (cancellable)) {
+		g_free (order);
+		return NULL;
+	}
+
+	return order;
+}
+
+/* Reorders @array in place to follow @order. */
+static void
+ml_sort_keys_apply (GPtrArray *array,
+                    const guint *order)
+{
+	gpointer *sorted;
+	guint ii;
+
+	sorted = g_new (gpointer, MAX (array->len, 1));
+
+	for (ii = 0; ii < array->len; ii++)
+		sorted[ii] = array->pdata[order[ii]];
+
+	memcpy (array->pdata, sorted, array->len * sizeof (gpointer));
+
+	g_free (sorted);
 }
 
 void
 message_list_sort_uids (MessageList *message_list,
                         GPtrArray *uids)
 {
-	struct ml_sort_uids_data *data;
-	GPtrArray *array;
+	MLSortKeys *sort_keys;
 	GNode *node;
 	ETreeTableAdapter *adapter;
+	guint *order;
 	gint ii;
 
 	g_return_if_fail (message_list != NULL);
@@ -4840,30 +5850,30 @@ message_list_sort_uids (MessageList *message_list,
 
 	adapter = e_tree_get_table_adapter (E_TREE (message_list));
 
-	array = g_ptr_array_new_full (uids->len, g_free);
+	sort_keys = ml_sort_keys_new (uids->len, 1);
+	ml_sort_keys_init_column (
+		sort_keys, 0, ML_SORT_KEY_INT, FALSE, NULL);
 
+	/* Rows are offset by one, since zero means "no value". */
 	for (ii = 0; ii < uids->len; ii++) {
-		data = g_new0 (struct ml_sort_uids_data, 1);
-		data->uid = g_ptr_array_index (uids, ii);
+		gint row;
 
-		node = g_hash_table_lookup (message_list->uid_nodemap, data->uid);
+		node = g_hash_table_lookup (
+			message_list->uid_nodemap,
+			g_ptr_array_index (uids, ii));
 		if (node != NULL)
-			data->row = e_tree_table_adapter_row_of_node (adapter, node);
+			row = e_tree_table_adapter_row_of_node (adapter, node);
 		else
-			data->row = ii;
+			row = ii;
 
-		g_ptr_array_add (array, data);
+		sort_keys->columns[0].ints[ii] = (gint64) row + 1;
 	}
 
-	g_ptr_array_sort (array, ml_sort_uids_cb);
+	order = ml_sort_keys_sort (sort_keys, NULL);
+	ml_sort_keys_apply (uids, order);
 
-	for (ii = 0; ii < uids->len; ii++) {
-		data = g_ptr_array_index (array, ii);
-
-		uids->pdata[ii] = data->uid;
-	}
-
-	g_ptr_array_free (array, TRUE);
+	g_free (order);
+	ml_sort_keys_free (sort_keys);
 }
 
 struct ml_count_data {
@@ -4984,106 +5994,52 @@ message_list_set_search (MessageList *message_list,
 	}
 }
 
-struct sort_column_data {
-	ETableCol *col;
-	GtkSortType sort_type;
-};
-
-struct sort_message_info_data {
-	CamelMessageInfo *mi;
-	GPtrArray *values; /* read values so far, in order of sort_array_data::sort_columns */
-};
-
-struct sort_array_data {
-	MessageList *message_list;
-	CamelFolder *folder;
-	GPtrArray *sort_columns; /* struct sort_column_data in order of sorting */
-	GHashTable *message_infos; /* uid -> struct sort_message_info_data */
-	gpointer cmp_cache;
-	GCancellable *cancellable;
-};
-
-static gint
-cmp_array_uids (gconstpointer a,
-                gconstpointer b,
-                gpointer user_data)
+/* Picks the cheapest key representation that still orders values
+ * exactly like the column's own compare function would. */
+static MLSortKeyKind
+ml_sort_key_kind_for_column (MessageList *message_list,
+                             ETableCol *col)
 {
-	const gchar *uid1 = *(const gchar **) a;
-	const gchar *uid2 = *(const gchar **) b;
-	struct sort_array_data *sort_data = user_data;
-	gint i, res = 0;
-	struct sort_message_info_data *md1, *md2;
+	ETableExtras *extras = message_list->extras;
 
-	g_return_val_if_fail (sort_data != NULL, 0);
+	if (col->compare == e_table_extras_get_compare (extras, "integer"))
+		return ML_SORT_KEY_INT;
 
-	md1 = g_hash_table_lookup (sort_data->message_infos, uid1);
-	md2 = g_hash_table_lookup (sort_data->message_infos, uid2);
+	if (col->compare == e_table_extras_get_compare (extras, "string") ||
+	    col->compare == e_table_extras_get_compare (extras, "collate") ||
+	    col->compare == e_table_extras_get_compare (extras, "stringcase") ||
+	    col->compare == e_table_extras_get_compare (extras, "address_compare"))
+		return ML_SORT_KEY_STRING;
 
-	g_return_val_if_fail (md1 != NULL, 0);
-	g_return_val_if_fail (md1->mi != NULL, 0);
-	g_return_val_if_fail (md2 != NULL, 0);
-	g_return_val_if_fail (md2->mi != NULL, 0);
-
-	if (g_cancellable_is_cancelled (sort_data->cancellable))
-		return 0;
-
-	for (i = 0;
-	     res == 0
-	     && i < sort_data->sort_columns->len
-	     && !g_cancellable_is_cancelled (sort_data->cancellable);
-	     i++) {
-		gpointer v1, v2;
-		struct sort_column_data *scol = g_ptr_array_index (sort_data->sort_columns, i);
+	return ML_SORT_KEY_VALUE;
+}
 
-		if (md1->values->len <= i) {
-			v1 = ml_tree_value_at_ex (
-				NULL, NULL,
-				scol->col->spec->compare_col,
-				md1->mi, sort_data->message_list);
-			g_ptr_array_add (md1->values, v1);
-		} else {
-			v1 = g_ptr_array_index (md1->values, i);
-		}
+static gchar *
+ml_sort_key_string_for_column (MessageList *message_list,
+                               ETableCol *col,
+                               const gchar *value)
+{
+	ETableExtras *extras = message_list->extras;
+	gchar *casefolded, *key;
 
-		if (md2->values->len <= i) {
-			v2 = ml_tree_value_at_ex (
-				NULL, NULL,
-				scol->col->spec->compare_col,
-				md2->mi, sort_data->message_list);
-			g_ptr_array_add (md2->values, v2);
-		} else {
-			v2 = g_ptr_array_index (md2->values, i);
-		}
+	if (value == NULL)
+		return NULL;
 
-		if (v1 != NULL && v2 != NULL) {
-			res = (*scol->col->compare) (v1, v2, sort_data->cmp_cache);
-		} else if (v1 != NULL || v2 != NULL) {
-			res = v1 == NULL ? -1 : 1;
-		}
+	if (col->compare == e_table_extras_get_compare (extras, "collate"))
+		return g_utf8_collate_key (value, -1);
 
-		if (scol->sort_type == GTK_SORT_DESCENDING)
-			res = res * (-1);
+	if (col->compare == e_table_extras_get_compare (extras, "stringcase")) {
+		casefolded = g_utf8_casefold (value, -1);
+		key = g_utf8_collate_key (casefolded, -1);
+		g_free (casefolded);
+		return key;
 	}
 
-	if (res == 0)
-		res = camel_folder_cmp_uids (sort_data->folder, uid1, uid2);
-
-	return res;
-}
-
-static void
-free_message_info_data (gpointer uid,
-                        struct sort_message_info_data *data,
-                        struct sort_array_data *sort_data)
-{
-	if (data->values) {
-		/* values in this array are not newly allocated, even ml_tree_value_at_ex
-		 * returns gpointer, not a gconstpointer */
-		g_ptr_array_free (data->values, TRUE);
-	}
+	/* Same order as g_ascii_strcasecmp() in address_compare(). */
+	if (col->compare == e_table_extras_get_compare (extras, "address_compare"))
+		return g_ascii_strdown (value, -1);
 
-	camel_message_info_unref (data->mi);
-	g_free (data);
+	return g_strdup (value);
 }
 
 static void
@@ -5095,8 +6051,11 @@ ml_sort_uids_by_tree (MessageList *message_list,
 	ETableSortInfo *sort_info;
 	ETableHeader *full_header;
 	CamelFolder *folder;
-	struct sort_array_data sort_data;
-	guint i, len;
+	MLSortKeys *sort_keys;
+	ETableCol **cols;
+	GPtrArray *value_infos = NULL;
+	guint *order;
+	guint i, j, len;
 
 	if (g_cancellable_is_cancelled (cancellable))
 		return;
@@ -5112,51 +6071,58 @@ ml_sort_uids_by_tree (MessageList *message_list,
 	sort_info = e_tree_table_adapter_get_sort_info (adapter);
 	full_header = e_tree_table_adapter_get_header (adapter);
 
+	/* The folder's own order is also the tie breaker below. */
+	camel_folder_sort_uids (folder, uids);
+
 	if (!sort_info || uids->len == 0 || !full_header || e_table_sort_info_sorting_get_count (sort_info) == 0) {
-		camel_folder_sort_uids (folder, uids);
 		g_object_unref (folder);
 		return;
 	}
 
 	len = e_table_sort_info_sorting_get_count (sort_info);
 
-	sort_data.message_list = message_list;
-	sort_data.folder = folder;
-	sort_data.sort_columns = g_ptr_array_sized_new (len);
-	sort_data.message_infos = g_hash_table_new (g_str_hash, g_str_equal);
-	sort_data.cmp_cache = e_table_sorting_utils_create_cmp_cache ();
-	sort_data.cancellable = cancellable;
+	sort_keys = ml_sort_keys_new (uids->len, len);
+	cols = g_new0 (ETableCol *, len);
 
-	for (i = 0;
-	     i < len
-	     && !g_cancellable_is_cancelled (cancellable);
-	     i++) {
+	for (i = 0; i < len; i++) {
 		ETableColumnSpecification *spec;
-		struct sort_column_data *data;
-
-		data = g_new0 (struct sort_column_data, 1);
+		GtkSortType sort_type;
+		ETableCol *col;
 
 		spec = e_table_sort_info_sorting_get_nth (
-			sort_info, i, &data->sort_type);
+			sort_info, i, &sort_type);
 
-		data->col = e_table_header_get_column_by_spec (full_header, spec);
-		if (data->col == NULL) {
+		col = e_table_header_get_column_by_spec (full_header, spec);
+		if (col == NULL) {
 			gint last = e_table_header_count (full_header) - 1;
-			data->col = e_table_header_get_column (full_header, last);
+			col = e_table_header_get_column (full_header, last);
 		}
 
-		g_ptr_array_add (sort_data.sort_columns, data);
+		cols[i] = col;
+
+		ml_sort_keys_init_column (
+			sort_keys, i,
+			ml_sort_key_kind_for_column (message_list, col),
+			sort_type == GTK_SORT_DESCENDING,
+			col->compare);
+
+		/* Column values point into the message infos, so
+		 * those have to stay alive until the sort is done. */
+		if (sort_keys->columns[i].kind == ML_SORT_KEY_VALUE &&
+		    value_infos == NULL)
+			value_infos = g_ptr_array_new_with_free_func (
+				(GDestroyNotify) camel_message_info_unref);
 	}
 
 	camel_folder_summary_prepare_fetch_all (folder->summary, NULL);
 
+	/* Extract every sort key exactly once, up front. */
 	for (i = 0;
 	     i < uids->len
 	     && !g_cancellable_is_cancelled (cancellable);
 	     i++) {
 		gchar *uid;
 		CamelMessageInfo *mi;
-		struct sort_message_info_data *md;
 
 		uid = g_ptr_array_index (uids, i);
 		mi = camel_folder_get_message_info (folder, uid);
@@ -5168,34 +6134,54 @@ ml_sort_uids_by_tree (MessageList *message_list,
 			continue;
 		}
 
-		md = g_new0 (struct sort_message_info_data, 1);
-		md->mi = mi;
-		md->values = g_ptr_array_sized_new (len);
+		for (j = 0; j < len; j++) {
+			MLSortKeyColumn *column = &sort_keys->columns[j];
+			gpointer value;
 
-		g_hash_table_insert (sort_data.message_infos, uid, md);
-	}
+			/* XXX Values are not newly allocated for the common
+			 *     sort columns, even though ml_tree_value_at_ex()
+			 *     returns a gpointer rather than a gconstpointer. */
+			value = ml_tree_value_at_ex (
+				NULL, NULL,
+				cols[j]->spec->compare_col,
+				mi, message_list);
 
-	if (!g_cancellable_is_cancelled (cancellable))
-		g_qsort_with_data (
-			uids->pdata,
-			uids->len,
-			sizeof (gpointer),
-			cmp_array_uids,
-			&sort_data);
+			switch (column->kind) {
+				case ML_SORT_KEY_INT:
+					column->ints[i] = GPOINTER_TO_INT (value);
+					break;
+				case ML_SORT_KEY_STRING:
+					column->strings[i] =
+						ml_sort_key_string_for_column (
+						message_list, cols[j], value);
+					break;
+				case ML_SORT_KEY_VALUE:
+					column->values[i] = value;
+					break;
+			}
+		}
+
+		if (value_infos != NULL)
+			g_ptr_array_add (value_infos, mi);
+		else
+			camel_message_info_unref (mi);
+	}
 
 	camel_folder_summary_unlock (folder->summary);
 
-	/* FIXME Teach the hash table to destroy its own data. */
-	g_hash_table_foreach (
-		sort_data.message_infos,
-		(GHFunc) free_message_info_data,
-		&sort_data);
-	g_hash_table_destroy (sort_data.message_infos);
+	order = NULL;
+	if (!g_cancellable_is_cancelled (cancellable))
+		order = ml_sort_keys_sort (sort_keys, cancellable);
+
+	if (order != NULL)
+		ml_sort_keys_apply (uids, order);
 
-	g_ptr_array_foreach (sort_data.sort_columns, (GFunc) g_free, NULL);
-	g_ptr_array_free (sort_data.sort_columns, TRUE);
+	g_free (order);
+	g_free (cols);
+	ml_sort_keys_free (sort_keys);
 
-	e_table_sorting_utils_free_cmp_cache (sort_data.cmp_cache);
+	if (value_infos != NULL)
+		g_ptr_array_unref (value_infos);
 
 	g_object_unref (folder);
 }
@@ -5276,6 +6262,7 @@ message_list_regen_thread (GSimpleAsyncResult *simple,
 	GString *expr;
 	gboolean hide_deleted;
 	gboolean hide_junk;
+	ETraceSpan span;
 	GError *local_error = NULL;
 
 	message_list = MESSAGE_LIST (source_object);
@@ -5284,6 +6271,8 @@ message_list_regen_thread (GSimpleAsyncResult *simple,
 	if (g_cancellable_is_cancelled (cancellable))
 		return;
 
+	e_trace_span_begin (&span, "mail", "regen-list-search");
+
 	/* Just for convenience. */
 	folder = g_object_ref (regen_data->folder);
 
@@ -5415,6 +6404,8 @@ exit:
 	else if (uids != NULL)
 		camel_folder_free_uids (folder, uids);
 
+	e_trace_span_end (&span, camel_folder_get_full_name (folder));
+
 	g_object_unref (folder);
 }
 
@@ -5450,6 +6441,7 @@ message_list_regen_done_cb (GObject *source_object,
 
 	if (g_simple_async_result_propagate_error (simple, &local_error) &&
 	    e_activity_handle_cancellation (activity, local_error)) {
+		e_trace_span_end (&regen_data->trace_span, "cancelled");
 		g_error_free (local_error);
 		return;
 
@@ -5676,6 +6668,10 @@ message_list_regen_done_cb (GObject *source_object,
 		signals[MESSAGE_LIST_BUILT], 0);
 
 	message_list->priv->any_row_changed = FALSE;
+
+	e_trace_span_end (
+		&regen_data->trace_span,
+		camel_folder_get_full_name (regen_data->folder));
 }
 
 static gboolean
@@ -20,8 +20,14 @@
 #endif
 
 #include <config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
 #include <glib/gi18n-lib.h>
 
 #include <camel/camel.h>
@@ -40,12 +46,46 @@
 #define BOGOFILTER_EXIT_STATUS_UNSURE		2
 #define BOGOFILTER_EXIT_STATUS_ERROR		3
 
+/* Number of messages a learning process registers
+ * before it is restarted to commit the wordlist. */
+#define BOGOFILTER_LEARN_BATCH_SIZE		100
+
+/* Seconds to wait for a verdict on a single message, for a process
+ * to finish once its input is closed, and for it to go away once it
+ * has been told to.  A process exceeding these is considered hung. */
+#define BOGOFILTER_REPLY_TIMEOUT		30
+#define BOGOFILTER_STOP_TIMEOUT			60
+#define BOGOFILTER_TERMINATE_TIMEOUT		5
+
 typedef struct _EBogofilter EBogofilter;
 typedef struct _EBogofilterClass EBogofilterClass;
+typedef struct _BogofilterProcess BogofilterProcess;
+
+/* A long-lived bogofilter running in streaming bulk mode (-b).
+ * It reads message file names from its stdin, one per line. */
+struct _BogofilterProcess {
+	GMutex lock;
+	const gchar *mode;	/* NULL when classifying */
+	GPid pid;
+	gboolean running;
+	gboolean unicode;
+	CamelStream *input_stream;	/* bogofilter's stdin */
+	gint output_fd;			/* bogofilter's stdout */
+	GString *output_buffer;		/* read, but not a full line */
+	GPtrArray *pending_files;	/* passed, not yet processed */
+};
 
 struct _EBogofilter {
 	EMailJunkFilter parent;
 	gboolean convert_to_unicode;
+
+	GMutex directory_lock;
+	gchar *directory;
+	gint n_files;
+
+	BogofilterProcess classifier;
+	BogofilterProcess spam_learner;
+	BogofilterProcess ham_learner;
 };
 
 struct _EBogofilterClass {
@@ -73,66 +113,53 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (
 		CAMEL_TYPE_JUNK_FILTER,
 		e_bogofilter_interface_init))
 
-#ifdef G_OS_UNIX
 static void
-bogofilter_cancelled_cb (GCancellable *cancellable,
-                         GPid *pid)
+bogofilter_process_init (BogofilterProcess *process,
+                         const gchar *mode)
 {
-	/* XXX On UNIX-like systems we can safely assume a GPid is the
-	 *     process ID and use it to terminate the process via signal. */
-	kill (*pid, SIGTERM);
+	g_mutex_init (&process->lock);
+	process->mode = mode;
+	process->output_fd = -1;
+	process->output_buffer = g_string_new (NULL);
+	process->pending_files = g_ptr_array_new ();
 }
-#endif
 
-static void
-bogofilter_exited_cb (GPid *pid,
-                      gint status,
-                      gpointer user_data)
-{
-	struct {
-		GMainLoop *loop;
-		gint exit_code;
-	} *source_data = user_data;
-
-	if (WIFEXITED (status))
-		source_data->exit_code = WEXITSTATUS (status);
-	else
-		source_data->exit_code = BOGOFILTER_EXIT_STATUS_ERROR;
-
-	g_main_loop_quit (source_data->loop);
-}
-
-static gint
-bogofilter_command (const gchar **argv,
-                    CamelMimeMessage *message,
-                    GCancellable *cancellable,
-                    GError **error)
+static gboolean
+bogofilter_process_start (BogofilterProcess *process,
+                          gboolean unicode,
+                          GError **error)
 {
-	CamelStream *stream;
-	GMainContext *context;
-	GSource *source;
-	GPid child_pid;
-	gssize bytes_written;
 	gint standard_input;
-	gulong handler_id = 0;
+	gint standard_output;
 	gboolean success;
+	gint ii = 0;
 
-	struct {
-		GMainLoop *loop;
-		gint exit_code;
-	} source_data;
+	const gchar *argv[6];
 
-	/* Spawn Bogofilter with an open stdin pipe. */
+	argv[ii++] = BOGOFILTER_COMMAND;
+	argv[ii++] = "-b";
+	if (process->mode != NULL)
+		argv[ii++] = process->mode;
+	else
+		argv[ii++] = "-T";
+	if (unicode)
+		argv[ii++] = "--unicode=yes";
+	argv[ii] = NULL;
+
+	g_assert (ii < G_N_ELEMENTS (argv));
+
+	/* End of its stdout tells us when it is done with all the
+	 * names it was given; the exit status is collected then. */
 	success = g_spawn_async_with_pipes (
 		NULL,
 		(gchar **) argv,
 		NULL,
 		G_SPAWN_DO_NOT_REAP_CHILD |
-		G_SPAWN_STDOUT_TO_DEV_NULL,
+		G_SPAWN_STDERR_TO_DEV_NULL,
 		NULL, NULL,
-		&child_pid,
+		&process->pid,
 		&standard_input,
-		NULL,
+		&standard_output,
 		NULL,
 		error);
 
@@ -145,31 +172,132 @@ bogofilter_command (const gchar **argv,
 			command_line);
 		g_free (command_line);
 
-		return BOGOFILTER_EXIT_STATUS_ERROR;
+		return FALSE;
 	}
 
-	/* Stream the CamelMimeMessage to Bogofilter. */
-	stream = camel_stream_fs_new_with_fd (standard_input);
-	bytes_written = camel_data_wrapper_write_to_stream_sync (
-		CAMEL_DATA_WRAPPER (message), stream, cancellable, error);
-	success = (bytes_written >= 0) &&
-		(camel_stream_close (stream, cancellable, error) == 0);
-	g_object_unref (stream);
+	process->input_stream = camel_stream_fs_new_with_fd (standard_input);
+	process->output_fd = standard_output;
+	g_string_truncate (process->output_buffer, 0);
 
-	if (!success) {
-		g_spawn_close_pid (child_pid);
-		g_prefix_error (
-			error, _("Failed to stream mail "
-			"message content to Bogofilter: "));
-		return BOGOFILTER_EXIT_STATUS_ERROR;
+	process->running = TRUE;
+	process->unicode = unicode;
+
+	return TRUE;
+}
+
+/* Reads one line of the process' output, waiting at most @timeout
+ * seconds for it.  Returns %NULL at the end of the output, and with
+ * @error set if the process did not reply in time or on cancellation. */
+static gchar *
+bogofilter_process_read_line (BogofilterProcess *process,
+                              gint timeout,
+                              GCancellable *cancellable,
+                              GError **error)
+{
+	GString *buffer = process->output_buffer;
+	GPollFD poll_fds[2];
+	gint n_poll_fds = 1;
+	gint64 deadline;
+	gchar *line = NULL;
+
+	deadline = g_get_monotonic_time () + timeout * G_USEC_PER_SEC;
+
+	poll_fds[0].fd = process->output_fd;
+	poll_fds[0].events = G_IO_IN | G_IO_HUP | G_IO_ERR;
+
+	if (g_cancellable_make_pollfd (cancellable, &poll_fds[1]))
+		n_poll_fds++;
+
+	while (TRUE) {
+		gchar chunk[4096];
+		const gchar *newline;
+		gssize n_read;
+		gint64 remaining;
+
+		newline = memchr (buffer->str, '\n', buffer->len);
+		if (newline != NULL) {
+			line = g_strndup (buffer->str, newline - buffer->str);
+			g_string_erase (buffer, 0, newline - buffer->str + 1);
+			break;
+		}
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, error))
+			break;
+
+		remaining = deadline - g_get_monotonic_time ();
+		if (remaining <= 0) {
+			g_set_error_literal (
+				error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+				_("Bogofilter did not reply in time"));
+			break;
+		}
+
+		poll_fds[0].revents = 0;
+		if (g_poll (poll_fds, n_poll_fds, remaining / 1000 + 1) < 0 &&
+		    errno != EINTR) {
+			g_set_error_literal (
+				error, G_IO_ERROR,
+				g_io_error_from_errno (errno),
+				g_strerror (errno));
+			break;
+		}
+
+		if (poll_fds[0].revents == 0)
+			continue;
+
+		n_read = read (process->output_fd, chunk, sizeof (chunk));
+
+		if (n_read < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+
+		/* End of output, or the pipe broke. */
+		if (n_read <= 0)
+			break;
+
+		g_string_append_len (buffer, chunk, n_read);
 	}
 
-	/* Wait for the Bogofilter process to terminate
-	 * using GLib's main loop for better portability. */
+	if (n_poll_fds > 1)
+		g_cancellable_release_fd (cancellable);
+
+	return line;
+}
+
+static void
+bogofilter_exited_cb (GPid child_pid,
+                      gint status,
+                      gpointer user_data)
+{
+	struct {
+		GMainLoop *loop;
+		gint exit_code;
+	} *source_data = user_data;
+
+	if (WIFEXITED (status))
+		source_data->exit_code = WEXITSTATUS (status);
+	else
+		source_data->exit_code = BOGOFILTER_EXIT_STATUS_ERROR;
+
+	g_main_loop_quit (source_data->loop);
+}
+
+/* Waits for the process to terminate and returns its exit status. */
+static gint
+bogofilter_process_wait (BogofilterProcess *process)
+{
+	GMainContext *context;
+	GSource *source;
+
+	struct {
+		GMainLoop *loop;
+		gint exit_code;
+	} source_data;
+
+	/* Use GLib's main loop for better portability. */
 
 	context = g_main_context_new ();
 
-	source = g_child_watch_source_new (child_pid);
+	source = g_child_watch_source_new (process->pid);
 	g_source_set_callback (
 		source, (GSourceFunc)
 		bogofilter_exited_cb,
@@ -180,38 +308,368 @@ bogofilter_command (const gchar **argv,
 	source_data.loop = g_main_loop_new (context, TRUE);
 	source_data.exit_code = 0;
 
+	g_main_loop_run (source_data.loop);
+
+	g_main_loop_unref (source_data.loop);
+	g_main_context_unref (context);
+
+	return source_data.exit_code;
+}
+
+/* Closes the process' stdin and waits for it to finish, or terminates
+ * it right away.  Either way, files passed to it are removed.  Should
+ * the process hang, it is killed instead of being waited for forever.
+ * Returns %FALSE with @error set if the process, when not terminated,
+ * exited with an error, in which case the files passed to a learning
+ * process were not registered. */
+static gboolean
+bogofilter_process_stop (BogofilterProcess *process,
+                         gboolean terminate,
+                         GError **error)
+{
+	GError *local_error = NULL;
+	gboolean killed = terminate;
+	gchar *line;
+	gint exit_code;
+	gint timeout;
+	guint ii;
+
+	if (!process->running)
+		return TRUE;
+
 #ifdef G_OS_UNIX
-	if (G_IS_CANCELLABLE (cancellable))
-		handler_id = g_cancellable_connect (
-			cancellable,
-			G_CALLBACK (bogofilter_cancelled_cb),
-			&child_pid, (GDestroyNotify) NULL);
+	if (terminate)
+		kill (process->pid, SIGTERM);
 #endif
 
-	g_main_loop_run (source_data.loop);
+	camel_stream_close (process->input_stream, NULL, NULL);
 
-	if (handler_id > 0)
-		g_cancellable_disconnect (cancellable, handler_id);
+	timeout = terminate ?
+		BOGOFILTER_TERMINATE_TIMEOUT :
+		BOGOFILTER_STOP_TIMEOUT;
 
-	g_main_loop_unref (source_data.loop);
-	source_data.loop = NULL;
+	while ((line = bogofilter_process_read_line (
+		process, timeout, NULL, &local_error)) != NULL)
+		g_free (line);
 
-	g_main_context_unref (context);
+	if (local_error != NULL) {
+		g_warning (
+			"Stopping Bogofilter: %s",
+			local_error->message);
+#ifdef G_OS_UNIX
+		kill (process->pid, SIGKILL);
+#endif
+		g_error_free (local_error);
+		killed = TRUE;
+	}
+
+	g_object_unref (process->input_stream);
+	process->input_stream = NULL;
 
-	/* Clean up. */
+	close (process->output_fd);
+	process->output_fd = -1;
+	g_string_truncate (process->output_buffer, 0);
 
-	g_spawn_close_pid (child_pid);
+	exit_code = bogofilter_process_wait (process);
+
+	g_spawn_close_pid (process->pid);
+	process->running = FALSE;
+
+	for (ii = 0; ii < process->pending_files->len; ii++) {
+		gchar *filename = process->pending_files->pdata[ii];
+
+		g_unlink (filename);
+		g_free (filename);
+	}
 
-	if (g_cancellable_set_error_if_cancelled (cancellable, error))
-		source_data.exit_code = BOGOFILTER_EXIT_STATUS_ERROR;
+	g_ptr_array_set_size (process->pending_files, 0);
 
-	else if (source_data.exit_code == BOGOFILTER_EXIT_STATUS_ERROR)
+	if (!killed && exit_code == BOGOFILTER_EXIT_STATUS_ERROR) {
 		g_set_error_literal (
 			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
 			_("Bogofilter either crashed or "
 			"failed to process a mail message"));
+		return FALSE;
+	}
 
-	return source_data.exit_code;
+	return TRUE;
+}
+
+/* Stops the process, warning if it exited with an error. */
+static void
+bogofilter_process_stop_with_warning (BogofilterProcess *process)
+{
+	GError *local_error = NULL;
+
+	if (!bogofilter_process_stop (process, FALSE, &local_error)) {
+		g_warning (
+			"Stopping Bogofilter: %s",
+			local_error->message);
+		g_error_free (local_error);
+	}
+}
+
+static void
+bogofilter_process_clear (BogofilterProcess *process)
+{
+	bogofilter_process_stop_with_warning (process);
+
+	g_ptr_array_free (process->pending_files, TRUE);
+	g_string_free (process->output_buffer, TRUE);
+	g_mutex_clear (&process->lock);
+}
+
+/* Hands one file name to a running process, starting the process
+ * first if needed.  A process which went away, or which runs with
+ * outdated options, is replaced by a fresh one. */
+static gboolean
+bogofilter_process_submit (BogofilterProcess *process,
+                           const gchar *filename,
+                           gboolean unicode,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	gchar *line;
+	gboolean success = FALSE;
+	gint attempt;
+
+	if (process->running && process->unicode != unicode)
+		bogofilter_process_stop_with_warning (process);
+
+	line = g_strconcat (filename, "\n", NULL);
+
+	for (attempt = 0; attempt < 2 && !success; attempt++) {
+		GError *local_error = NULL;
+
+		if (!process->running &&
+		    !bogofilter_process_start (process, unicode, error))
+			break;
+
+		success =
+			(camel_stream_write_string (
+				process->input_stream, line,
+				cancellable, &local_error) >= 0) &&
+			(camel_stream_flush (
+				process->input_stream,
+				cancellable, &local_error) == 0);
+
+		if (success)
+			break;
+
+		bogofilter_process_stop (process, TRUE, NULL);
+
+		if (attempt > 0 || g_cancellable_is_cancelled (cancellable)) {
+			g_propagate_prefixed_error (
+				error, local_error, _("Failed to stream mail "
+				"message content to Bogofilter: "));
+			break;
+		}
+
+		g_clear_error (&local_error);
+	}
+
+	g_free (line);
+
+	return success;
+}
+
+/* Writes the message to a file of its own, for bulk mode. */
+static gchar *
+bogofilter_write_message (EBogofilter *extension,
+                          CamelMimeMessage *message,
+                          GCancellable *cancellable,
+                          GError **error)
+{
+	CamelStream *stream;
+	gchar *filename;
+	gboolean success;
+
+	g_mutex_lock (&extension->directory_lock);
+
+	if (extension->directory == NULL)
+		extension->directory = g_dir_make_tmp (
+			"evolution-bogofilter-XXXXXX", error);
+
+	if (extension->directory == NULL) {
+		g_mutex_unlock (&extension->directory_lock);
+		return NULL;
+	}
+
+	filename = g_strdup_printf (
+		"%s" G_DIR_SEPARATOR_S "%d",
+		extension->directory, extension->n_files++);
+
+	g_mutex_unlock (&extension->directory_lock);
+
+	stream = camel_stream_fs_new_with_name (
+		filename, O_WRONLY | O_CREAT | O_TRUNC, 0600, error);
+
+	success = (stream != NULL);
+
+	if (success) {
+		success = (camel_data_wrapper_write_to_stream_sync (
+			CAMEL_DATA_WRAPPER (message),
+			stream, cancellable, error) >= 0) &&
+			(camel_stream_close (stream, cancellable, error) == 0);
+		g_object_unref (stream);
+	}
+
+	if (!success) {
+		g_prefix_error (
+			error, _("Failed to stream mail "
+			"message content to Bogofilter: "));
+		g_unlink (filename);
+		g_free (filename);
+		filename = NULL;
+	}
+
+	return filename;
+}
+
+static gint
+bogofilter_classify_bulk (EBogofilter *extension,
+                          CamelMimeMessage *message,
+                          GCancellable *cancellable,
+                          GError **error)
+{
+	BogofilterProcess *process = &extension->classifier;
+	gchar *filename;
+	gchar *reply = NULL;
+	const gchar *cp;
+	gint exit_code = BOGOFILTER_EXIT_STATUS_ERROR;
+	gint attempt;
+
+	filename = bogofilter_write_message (
+		extension, message, cancellable, error);
+	if (filename == NULL)
+		return BOGOFILTER_EXIT_STATUS_ERROR;
+
+	g_mutex_lock (&process->lock);
+
+	for (attempt = 0; attempt < 2 && reply == NULL; attempt++) {
+		if (!bogofilter_process_submit (
+			process, filename,
+			extension->convert_to_unicode,
+			cancellable, error))
+			break;
+
+		reply = bogofilter_process_read_line (
+			process, BOGOFILTER_REPLY_TIMEOUT,
+			cancellable, NULL);
+
+		/* The process died or hung and we gave up waiting for
+		 * it, either way its replies are out of step now.  The
+		 * next attempt starts a fresh process. */
+		if (reply == NULL)
+			bogofilter_process_stop (process, TRUE, NULL);
+
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+	}
+
+	g_mutex_unlock (&process->lock);
+
+	g_unlink (filename);
+	g_free (filename);
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+		g_free (reply);
+		return BOGOFILTER_EXIT_STATUS_ERROR;
+	}
+
+	if (reply == NULL) {
+		if (error == NULL || *error == NULL)
+			g_set_error_literal (
+				error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
+				_("Bogofilter either crashed or "
+				"failed to process a mail message"));
+		return BOGOFILTER_EXIT_STATUS_ERROR;
+	}
+
+	/* The terse reply reads "<file name> <S|H|U> <spamicity>". */
+	cp = strrchr (reply, ' ');
+	if (cp != NULL && cp - reply >= 2 && cp[-2] == ' ') {
+		switch (cp[-1]) {
+			case 'S':
+				exit_code = BOGOFILTER_EXIT_STATUS_SPAM;
+				break;
+			case 'H':
+				exit_code = BOGOFILTER_EXIT_STATUS_HAM;
+				break;
+			case 'U':
+				exit_code = BOGOFILTER_EXIT_STATUS_UNSURE;
+				break;
+		}
+	}
+
+	if (exit_code == BOGOFILTER_EXIT_STATUS_ERROR)
+		g_set_error (
+			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
+			_("Unexpected reply from Bogofilter: %s"), reply);
+
+	g_free (reply);
+
+	return exit_code;
+}
+
+static gboolean
+bogofilter_learn_bulk (EBogofilter *extension,
+                       CamelMimeMessage *message,
+                       gboolean is_junk,
+                       GCancellable *cancellable,
+                       GError **error)
+{
+	BogofilterProcess *process;
+	gchar *filename;
+	gboolean success;
+
+	process = is_junk ?
+		&extension->spam_learner :
+		&extension->ham_learner;
+
+	filename = bogofilter_write_message (
+		extension, message, cancellable, error);
+	if (filename == NULL)
+		return FALSE;
+
+	g_mutex_lock (&process->lock);
+
+	success = bogofilter_process_submit (
+		process, filename,
+		extension->convert_to_unicode,
+		cancellable, error);
+
+	if (success) {
+		/* Removed once the process is done with it. */
+		g_ptr_array_add (process->pending_files, filename);
+		filename = NULL;
+
+		if (process->pending_files->len >= BOGOFILTER_LEARN_BATCH_SIZE)
+			success = bogofilter_process_stop (
+				process, FALSE, error);
+	}
+
+	g_mutex_unlock (&process->lock);
+
+	if (filename != NULL) {
+		g_unlink (filename);
+		g_free (filename);
+	}
+
+	return success;
+}
+
+static gboolean
+bogofilter_flush_process (BogofilterProcess *process,
+                          GError **error)
+{
+	gboolean success;
+
+	g_mutex_lock (&process->lock);
+	success = bogofilter_process_stop (process, FALSE, error);
+	g_mutex_unlock (&process->lock);
+
+	return success;
 }
 
 static void
@@ -220,6 +678,7 @@ bogofilter_init_wordlist (EBogofilter *extension)
 	CamelStream *stream;
 	CamelMimeParser *parser;
 	CamelMimeMessage *message;
+	GError *local_error = NULL;
 
 	/* Initialize the Bogofilter database with a welcome message. */
 
@@ -238,6 +697,15 @@ bogofilter_init_wordlist (EBogofilter *extension)
 	camel_junk_filter_learn_not_junk (
 		CAMEL_JUNK_FILTER (extension), message, NULL, NULL);
 
+	/* Make sure the wordlist is written before going on. */
+	if (!bogofilter_flush_process (
+		&extension->ham_learner, &local_error)) {
+		g_warning (
+			"Initializing Bogofilter: %s",
+			local_error->message);
+		g_error_free (local_error);
+	}
+
 	g_object_unref (message);
 	g_object_unref (parser);
 }
@@ -338,17 +806,9 @@ bogofilter_classify (CamelJunkFilter *junk_filter,
 	CamelJunkStatus status;
 	gint exit_code;
 
-	const gchar *argv[] = {
-		BOGOFILTER_COMMAND,
-		NULL,  /* leave room for unicode option */
-		NULL
-	};
-
-	if (bogofilter_get_convert_to_unicode (extension))
-		argv[1] = "--unicode=yes";
-
 retry:
-	exit_code = bogofilter_command (argv, message, cancellable, error);
+	exit_code = bogofilter_classify_bulk (
+		extension, message, cancellable, error);
 
 	switch (exit_code) {
 		case BOGOFILTER_EXIT_STATUS_SPAM:
@@ -365,8 +825,10 @@ retry:
 
 		case BOGOFILTER_EXIT_STATUS_ERROR:
 			status = CAMEL_JUNK_STATUS_ERROR;
-			if (!wordlist_initialized) {
+			if (!wordlist_initialized &&
+			    !g_cancellable_is_cancelled (cancellable)) {
 				wordlist_initialized = TRUE;
+				g_clear_error (error);
 				bogofilter_init_wordlist (extension);
 				goto retry;
 			}
@@ -395,32 +857,18 @@ bogofilter_learn_junk (CamelJunkFilter *junk_filter,
                        GError **error)
 {
 	EBogofilter *extension = E_BOGOFILTER (junk_filter);
-	gint exit_code;
-
-	const gchar *argv[] = {
-		BOGOFILTER_COMMAND,
-		"--register-spam",
-		NULL,  /* leave room for unicode option */
-		NULL
-	};
-
-	if (bogofilter_get_convert_to_unicode (extension))
-		argv[2] = "--unicode=yes";
-
-	exit_code = bogofilter_command (argv, message, cancellable, error);
+	gboolean success;
 
-	if (exit_code != 0)
-		g_warning (
-			"Bogofilter: Unexpected exit code (%d) "
-			"while registering spam", exit_code);
+	success = bogofilter_learn_bulk (
+		extension, message, TRUE, cancellable, error);
 
 	/* Check that the return value and GError agree. */
-	if (exit_code != BOGOFILTER_EXIT_STATUS_ERROR)
+	if (success)
 		g_warn_if_fail (error == NULL || *error == NULL);
 	else
 		g_warn_if_fail (error == NULL || *error != NULL);
 
-	return (exit_code != BOGOFILTER_EXIT_STATUS_ERROR);
+	return success;
 }
 
 static gboolean
@@ -430,32 +878,67 @@ bogofilter_learn_not_junk (CamelJunkFilter *junk_filter,
                            GError **error)
 {
 	EBogofilter *extension = E_BOGOFILTER (junk_filter);
-	gint exit_code;
-
-	const gchar *argv[] = {
-		BOGOFILTER_COMMAND,
-		"--register-ham",
-		NULL,  /* leave room for unicode option */
-		NULL
-	};
-
-	if (bogofilter_get_convert_to_unicode (extension))
-		argv[2] = "--unicode=yes";
-
-	exit_code = bogofilter_command (argv, message, cancellable, error);
+	gboolean success;
 
-	if (exit_code != 0)
-		g_warning (
-			"Bogofilter: Unexpected exit code (%d) "
-			"while registering ham", exit_code);
+	success = bogofilter_learn_bulk (
+		extension, message, FALSE, cancellable, error);
 
 	/* Check that the return value and GError agree. */
-	if (exit_code != BOGOFILTER_EXIT_STATUS_ERROR)
+	if (success)
 		g_warn_if_fail (error == NULL || *error == NULL);
 	else
 		g_warn_if_fail (error == NULL || *error != NULL);
 
-	return (exit_code != BOGOFILTER_EXIT_STATUS_ERROR);
+	return success;
+}
+
+static gboolean
+bogofilter_synchronize (CamelJunkFilter *junk_filter,
+                        GCancellable *cancellable,
+                        GError **error)
+{
+	EBogofilter *extension = E_BOGOFILTER (junk_filter);
+	GError *local_error = NULL;
+	gboolean success;
+
+	/* Let the learning processes finish and commit the wordlist,
+	 * and restart the classifier so that it picks up the changes.
+	 * All of them are stopped, the first failure is reported. */
+	success = bogofilter_flush_process (
+		&extension->spam_learner, &local_error);
+	if (!bogofilter_flush_process (
+		&extension->ham_learner,
+		success ? &local_error : NULL))
+		success = FALSE;
+	if (!bogofilter_flush_process (
+		&extension->classifier,
+		success ? &local_error : NULL))
+		success = FALSE;
+
+	if (local_error != NULL)
+		g_propagate_error (error, local_error);
+
+	return success;
+}
+
+static void
+bogofilter_finalize (GObject *object)
+{
+	EBogofilter *extension = E_BOGOFILTER (object);
+
+	bogofilter_process_clear (&extension->classifier);
+	bogofilter_process_clear (&extension->spam_learner);
+	bogofilter_process_clear (&extension->ham_learner);
+
+	if (extension->directory != NULL) {
+		g_rmdir (extension->directory);
+		g_free (extension->directory);
+	}
+
+	g_mutex_clear (&extension->directory_lock);
+
+	/* Chain up to parent's finalize() method. */
+	G_OBJECT_CLASS (e_bogofilter_parent_class)->finalize (object);
 }
 
 static void
@@ -467,6 +950,7 @@ e_bogofilter_class_init (EBogofilterClass *class)
 	object_class = G_OBJECT_CLASS (class);
 	object_class->set_property = bogofilter_set_property;
 	object_class->get_property = bogofilter_get_property;
+	object_class->finalize = bogofilter_finalize;
 
 	junk_filter_class = E_MAIL_JUNK_FILTER_CLASS (class);
 	junk_filter_class->filter_name = "Bogofilter";
@@ -495,6 +979,7 @@ e_bogofilter_interface_init (CamelJunkFilterInterface *iface)
 	iface->classify = bogofilter_classify;
 	iface->learn_junk = bogofilter_learn_junk;
 	iface->learn_not_junk = bogofilter_learn_not_junk;
+	iface->synchronize = bogofilter_synchronize;
 }
 
 static void
@@ -502,6 +987,12 @@ e_bogofilter_init (EBogofilter *extension)
 {
 	GSettings *settings;
 
+	g_mutex_init (&extension->directory_lock);
+
+	bogofilter_process_init (&extension->classifier, NULL);
+	bogofilter_process_init (&extension->spam_learner, "--register-spam");
+	bogofilter_process_init (&extension->ham_learner, "--register-ham");
+
 	settings = g_settings_new ("org.gnome.evolution.bogofilter");
 	g_settings_bind (
 		settings, "utf8-for-spam-filter",
@@ -0,0 +1,157 @@
+/*
+ * e-spamc.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "e-spamc.h"
+
+#include <string.h>
+#include <glib/gi18n-lib.h>
+
+/* Checks @content with the spamd listening at @address, using the
+ * spamc protocol.  Sets @out_connected to whether the daemon could
+ * be reached at all, so the caller can tell a missing daemon from
+ * a failed check and fall back to running spamassassin itself. */
+gboolean
+e_spamc_check (GSocketClient *socket_client,
+               GSocketConnectable *address,
+               const guint8 *content,
+               gsize content_length,
+               gboolean *out_connected,
+               gboolean *out_is_spam,
+               GCancellable *cancellable,
+               GError **error)
+{
+	GSocketConnection *connection;
+	GDataInputStream *input_stream;
+	GOutputStream *output_stream;
+	GError *local_error = NULL;
+	gboolean have_verdict = FALSE;
+	gboolean success;
+	gchar *request;
+	gchar *line;
+	gint code = -1;
+
+	g_return_val_if_fail (G_IS_SOCKET_CLIENT (socket_client), FALSE);
+	g_return_val_if_fail (G_IS_SOCKET_CONNECTABLE (address), FALSE);
+	g_return_val_if_fail (out_connected != NULL, FALSE);
+	g_return_val_if_fail (out_is_spam != NULL, FALSE);
+
+	*out_connected = FALSE;
+	*out_is_spam = FALSE;
+
+	connection = g_socket_client_connect (
+		socket_client, address, cancellable, error);
+
+	if (connection == NULL)
+		return FALSE;
+
+	*out_connected = TRUE;
+
+	request = g_strdup_printf (
+		"CHECK SPAMC/1.5\r\n"
+		"Content-length: %" G_GSIZE_FORMAT "\r\n"
+		"User: %s\r\n"
+		"\r\n",
+		content_length, g_get_user_name ());
+
+	output_stream = g_io_stream_get_output_stream (
+		G_IO_STREAM (connection));
+
+	success =
+		g_output_stream_write_all (
+			output_stream, request, strlen (request),
+			NULL, cancellable, &local_error) &&
+		g_output_stream_write_all (
+			output_stream, content, content_length,
+			NULL, cancellable, &local_error) &&
+		g_output_stream_flush (
+			output_stream, cancellable, &local_error);
+
+	g_free (request);
+
+	if (!success) {
+		g_prefix_error (
+			&local_error, _("Failed to stream mail "
+			"message content to SpamAssassin: "));
+		goto exit;
+	}
+
+	input_stream = g_data_input_stream_new (
+		g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+	g_data_input_stream_set_newline_type (
+		input_stream, G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+
+	/* Status line, e.g. "SPAMD/1.1 0 EX_OK". */
+	line = g_data_input_stream_read_line (
+		input_stream, NULL, cancellable, &local_error);
+	if (line != NULL) {
+		if (g_str_has_prefix (line, "SPAMD/")) {
+			const gchar *cp = strchr (line, ' ');
+
+			if (cp != NULL)
+				code = (gint) g_ascii_strtoll (cp + 1, NULL, 10);
+		}
+		g_free (line);
+	}
+
+	/* Headers, e.g. "Spam: True ; 15.0 / 5.0", up to a blank line. */
+	while (code == 0 && local_error == NULL) {
+		line = g_data_input_stream_read_line (
+			input_stream, NULL, cancellable, &local_error);
+		if (line == NULL || *line == '\0') {
+			g_free (line);
+			break;
+		}
+
+		if (g_ascii_strncasecmp (line, "Spam:", 5) == 0) {
+			const gchar *value = line + 5;
+
+			while (g_ascii_isspace (*value))
+				value++;
+
+			*out_is_spam =
+				g_ascii_strncasecmp (value, "True", 4) == 0 ||
+				g_ascii_strncasecmp (value, "Yes", 3) == 0;
+			have_verdict = TRUE;
+		}
+
+		g_free (line);
+	}
+
+	g_object_unref (input_stream);
+
+	if (local_error == NULL && !have_verdict)
+		g_set_error_literal (
+			&local_error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			_("SpamAssassin either crashed or "
+			"failed to process a mail message"));
+
+exit:
+	/* spamd closes the connection after each reply. */
+	g_io_stream_close (G_IO_STREAM (connection), NULL, NULL);
+	g_object_unref (connection);
+
+	if (local_error != NULL) {
+		g_propagate_error (error, local_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,36 @@
+/*
+ * e-spamc.h
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef E_SPAMC_H
+#define E_SPAMC_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+gboolean	e_spamc_check			(GSocketClient *socket_client,
+						 GSocketConnectable *address,
+						 const guint8 *content,
+						 gsize content_length,
+						 gboolean *out_connected,
+						 gboolean *out_is_spam,
+						 GCancellable *cancellable,
+						 GError **error);
+
+G_END_DECLS
+
+#endif /* E_SPAMC_H */
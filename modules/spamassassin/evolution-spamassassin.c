@@ -17,16 +17,23 @@
 
 #include <config.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <glib/gstdio.h>
 #include <glib/gi18n-lib.h>
 
+#ifdef G_OS_UNIX
+#include <gio/gunixsocketaddress.h>
+#endif
+
 #include <camel/camel.h>
 
 #include <shell/e-shell.h>
 #include <libemail-engine/libemail-engine.h>
 
+#include "e-spamc.h"
+
 /* Standard GObject macros */
 #define E_TYPE_SPAM_ASSASSIN \
 	(e_spam_assassin_get_type ())
@@ -37,13 +44,38 @@
 #define SPAM_ASSASSIN_EXIT_STATUS_SUCCESS	0
 #define SPAM_ASSASSIN_EXIT_STATUS_ERROR		-1
 
+/* Number of messages to collect before training sa-learn on them,
+ * unless the junk filter gets synchronized before that. */
+#define SPAM_ASSASSIN_LEARN_BATCH_SIZE		100
+
+#define SPAMD_DEFAULT_PORT			783
+
 typedef struct _ESpamAssassin ESpamAssassin;
 typedef struct _ESpamAssassinClass ESpamAssassinClass;
 
+typedef struct _LearnQueue LearnQueue;
+
+/* Messages waiting to be handed to a single sa-learn run.
+ * Each message is written to its own file in "directory". */
+struct _LearnQueue {
+	gchar *directory;
+	guint n_messages;
+};
+
 struct _ESpamAssassin {
 	EMailJunkFilter parent;
 
 	gboolean local_only;
+	gboolean use_daemon;
+	gchar *socket_path;
+	gint daemon_port;
+
+	GMutex lock;
+	GSocketClient *socket_client;
+	GSocketConnectable *daemon_address;
+
+	LearnQueue learn_spam;
+	LearnQueue learn_ham;
 };
 
 struct _ESpamAssassinClass {
@@ -52,7 +84,10 @@ struct _ESpamAssassinClass {
 
 enum {
 	PROP_0,
-	PROP_LOCAL_ONLY
+	PROP_DAEMON_PORT,
+	PROP_LOCAL_ONLY,
+	PROP_SOCKET_PATH,
+	PROP_USE_DAEMON
 };
 
 /* Module Entry Points */
@@ -307,6 +342,112 @@ spam_assassin_set_local_only (ESpamAssassin *extension,
 	g_object_notify (G_OBJECT (extension), "local-only");
 }
 
+static gboolean
+spam_assassin_get_use_daemon (ESpamAssassin *extension)
+{
+	return extension->use_daemon;
+}
+
+static void
+spam_assassin_set_use_daemon (ESpamAssassin *extension,
+                              gboolean use_daemon)
+{
+	if (extension->use_daemon == use_daemon)
+		return;
+
+	extension->use_daemon = use_daemon;
+
+	g_object_notify (G_OBJECT (extension), "use-daemon");
+}
+
+static const gchar *
+spam_assassin_get_socket_path (ESpamAssassin *extension)
+{
+	return extension->socket_path;
+}
+
+static void
+spam_assassin_set_socket_path (ESpamAssassin *extension,
+                               const gchar *socket_path)
+{
+	if (g_strcmp0 (extension->socket_path, socket_path) == 0)
+		return;
+
+	g_mutex_lock (&extension->lock);
+
+	g_free (extension->socket_path);
+	extension->socket_path = g_strdup (socket_path);
+
+	if (extension->daemon_address != NULL) {
+		g_object_unref (extension->daemon_address);
+		extension->daemon_address = NULL;
+	}
+
+	g_mutex_unlock (&extension->lock);
+
+	g_object_notify (G_OBJECT (extension), "socket-path");
+}
+
+static gint
+spam_assassin_get_daemon_port (ESpamAssassin *extension)
+{
+	return extension->daemon_port;
+}
+
+static void
+spam_assassin_set_daemon_port (ESpamAssassin *extension,
+                               gint daemon_port)
+{
+	if (extension->daemon_port == daemon_port)
+		return;
+
+	g_mutex_lock (&extension->lock);
+
+	extension->daemon_port = daemon_port;
+
+	if (extension->daemon_address != NULL) {
+		g_object_unref (extension->daemon_address);
+		extension->daemon_address = NULL;
+	}
+
+	g_mutex_unlock (&extension->lock);
+
+	g_object_notify (G_OBJECT (extension), "daemon-port");
+}
+
+static GSocketConnectable *
+spam_assassin_ref_daemon_address (ESpamAssassin *extension)
+{
+	GSocketConnectable *address;
+
+	g_mutex_lock (&extension->lock);
+
+	/* Resolve the address once and reuse it for every request. */
+	if (extension->daemon_address == NULL) {
+#ifdef G_OS_UNIX
+		if (extension->socket_path != NULL &&
+		    *extension->socket_path != '\0') {
+			GSocketAddress *socket_address;
+
+			socket_address = g_unix_socket_address_new (
+				extension->socket_path);
+			extension->daemon_address =
+				G_SOCKET_CONNECTABLE (socket_address);
+		}
+#endif
+		if (extension->daemon_address == NULL)
+			extension->daemon_address = g_network_address_new (
+				"127.0.0.1", extension->daemon_port > 0 ?
+				extension->daemon_port : SPAMD_DEFAULT_PORT);
+	}
+
+	address = g_object_ref (extension->daemon_address);
+
+	g_mutex_unlock (&extension->lock);
+
+	return address;
+}
+
 static void
 spam_assassin_set_property (GObject *object,
                             guint property_id,
@@ -314,11 +455,29 @@ spam_assassin_set_property (GObject *object,
                             GParamSpec *pspec)
 {
 	switch (property_id) {
+		case PROP_DAEMON_PORT:
+			spam_assassin_set_daemon_port (
+				E_SPAM_ASSASSIN (object),
+				g_value_get_int (value));
+			return;
+
 		case PROP_LOCAL_ONLY:
 			spam_assassin_set_local_only (
 				E_SPAM_ASSASSIN (object),
 				g_value_get_boolean (value));
 			return;
+
+		case PROP_SOCKET_PATH:
+			spam_assassin_set_socket_path (
+				E_SPAM_ASSASSIN (object),
+				g_value_get_string (value));
+			return;
+
+		case PROP_USE_DAEMON:
+			spam_assassin_set_use_daemon (
+				E_SPAM_ASSASSIN (object),
+				g_value_get_boolean (value));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -331,16 +490,357 @@ spam_assassin_get_property (GObject *object,
                             GParamSpec *pspec)
 {
 	switch (property_id) {
+		case PROP_DAEMON_PORT:
+			g_value_set_int (
+				value, spam_assassin_get_daemon_port (
+				E_SPAM_ASSASSIN (object)));
+			return;
+
 		case PROP_LOCAL_ONLY:
 			g_value_set_boolean (
 				value, spam_assassin_get_local_only (
 				E_SPAM_ASSASSIN (object)));
 			return;
+
+		case PROP_SOCKET_PATH:
+			g_value_set_string (
+				value, spam_assassin_get_socket_path (
+				E_SPAM_ASSASSIN (object)));
+			return;
+
+		case PROP_USE_DAEMON:
+			g_value_set_boolean (
+				value, spam_assassin_get_use_daemon (
+				E_SPAM_ASSASSIN (object)));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
 }
 
+static void	spam_assassin_learn_queue_discard
+						(LearnQueue *queue);
+static gboolean	spam_assassin_flush_learn_queue	(ESpamAssassin *extension,
+						 gboolean is_junk,
+						 GCancellable *cancellable,
+						 GError **error);
+static gboolean	spam_assassin_synchronize	(CamelJunkFilter *junk_filter,
+						 GCancellable *cancellable,
+						 GError **error);
+
+static void
+spam_assassin_flush_thread (GSimpleAsyncResult *simple,
+                            GObject *object,
+                            GCancellable *cancellable)
+{
+	GError *local_error = NULL;
+
+	if (!spam_assassin_synchronize (
+		CAMEL_JUNK_FILTER (object), cancellable, &local_error))
+		g_simple_async_result_take_error (simple, local_error);
+}
+
+static void
+spam_assassin_flush_done_cb (GObject *source_object,
+                             GAsyncResult *result,
+                             gpointer user_data)
+{
+	EActivity *activity = E_ACTIVITY (user_data);
+	GError *local_error = NULL;
+
+	/* There is no window left to show an alert in. */
+	if (g_simple_async_result_propagate_error (
+		G_SIMPLE_ASYNC_RESULT (result), &local_error)) {
+		g_warning (
+			"Failed to train SpamAssassin "
+			"on pending messages: %s",
+			local_error->message);
+		g_error_free (local_error);
+	}
+
+	/* Lets the shell go on quitting. */
+	g_object_unref (activity);
+}
+
+static void
+spam_assassin_prepare_for_quit_cb (EShell *shell,
+                                   EActivity *activity,
+                                   ESpamAssassin *extension)
+{
+	GSimpleAsyncResult *simple;
+	gboolean pending;
+
+	g_mutex_lock (&extension->lock);
+	pending =
+		extension->learn_spam.directory != NULL ||
+		extension->learn_ham.directory != NULL;
+	g_mutex_unlock (&extension->lock);
+
+	if (!pending)
+		return;
+
+	/* Train on whatever is still queued before quitting.  The shell
+	 * waits until the activity is released; sa-learn runs in a
+	 * thread so the main loop keeps going meanwhile. */
+	simple = g_simple_async_result_new (
+		G_OBJECT (extension), spam_assassin_flush_done_cb,
+		g_object_ref (activity), spam_assassin_prepare_for_quit_cb);
+
+	g_simple_async_result_run_in_thread (
+		simple, spam_assassin_flush_thread,
+		G_PRIORITY_DEFAULT, NULL);
+
+	g_object_unref (simple);
+}
+
+static void
+spam_assassin_finalize (GObject *object)
+{
+	ESpamAssassin *extension = E_SPAM_ASSASSIN (object);
+
+	/* Normally empty, the queues are trained on when the junk
+	 * filter is synchronized and before the shell quits. */
+	spam_assassin_learn_queue_discard (&extension->learn_spam);
+	spam_assassin_learn_queue_discard (&extension->learn_ham);
+
+	g_free (extension->socket_path);
+
+	g_object_unref (extension->socket_client);
+
+	if (extension->daemon_address != NULL)
+		g_object_unref (extension->daemon_address);
+
+	g_mutex_clear (&extension->lock);
+
+	/* Chain up to parent's finalize() method. */
+	G_OBJECT_CLASS (e_spam_assassin_parent_class)->finalize (object);
+}
+
+static void
+spam_assassin_constructed (GObject *object)
+{
+	EShell *shell;
+
+	/* Chain up to parent's constructed() method. */
+	G_OBJECT_CLASS (e_spam_assassin_parent_class)->constructed (object);
+
+	shell = e_shell_get_default ();
+
+	if (shell != NULL)
+		g_signal_connect_object (
+			shell, "prepare-for-quit",
+			G_CALLBACK (spam_assassin_prepare_for_quit_cb),
+			object, 0);
+}
+
+static void
+spam_assassin_learn_queue_discard (LearnQueue *queue)
+{
+	GDir *dir;
+	const gchar *name;
+
+	if (queue->directory == NULL)
+		return;
+
+	dir = g_dir_open (queue->directory, 0, NULL);
+	if (dir != NULL) {
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			gchar *filename;
+
+			filename = g_build_filename (
+				queue->directory, name, NULL);
+			g_unlink (filename);
+			g_free (filename);
+		}
+
+		g_dir_close (dir);
+	}
+
+	g_rmdir (queue->directory);
+
+	g_free (queue->directory);
+	queue->directory = NULL;
+	queue->n_messages = 0;
+}
+
+/* Writes the message into the pending training set, which
+ * sa-learn processes in one run once the set grows large
+ * enough or the junk filter is synchronized. */
+static gboolean
+spam_assassin_queue_learn (ESpamAssassin *extension,
+                           CamelMimeMessage *message,
+                           gboolean is_junk,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	LearnQueue *queue;
+	CamelStream *stream;
+	gchar *filename;
+	gboolean success;
+	gboolean flush;
+
+	queue = is_junk ? &extension->learn_spam : &extension->learn_ham;
+
+	g_mutex_lock (&extension->lock);
+
+	if (queue->directory == NULL) {
+		queue->directory = g_dir_make_tmp (
+			"evolution-sa-learn-XXXXXX", error);
+		if (queue->directory == NULL) {
+			g_mutex_unlock (&extension->lock);
+			return FALSE;
+		}
+	}
+
+	filename = g_strdup_printf (
+		"%s" G_DIR_SEPARATOR_S "%u",
+		queue->directory, queue->n_messages);
+
+	stream = camel_stream_fs_new_with_name (
+		filename, O_WRONLY | O_CREAT | O_TRUNC, 0600, error);
+
+	success = (stream != NULL);
+
+	if (success) {
+		success = (camel_data_wrapper_write_to_stream_sync (
+			CAMEL_DATA_WRAPPER (message),
+			stream, cancellable, error) >= 0) &&
+			(camel_stream_close (stream, cancellable, error) == 0);
+		g_object_unref (stream);
+	}
+
+	if (success)
+		queue->n_messages++;
+	else
+		g_unlink (filename);
+
+	flush = (queue->n_messages >= SPAM_ASSASSIN_LEARN_BATCH_SIZE);
+
+	g_mutex_unlock (&extension->lock);
+
+	g_free (filename);
+
+	if (success && flush)
+		success = spam_assassin_flush_learn_queue (
+			extension, is_junk, cancellable, error);
+
+	return success;
+}
+
+static gboolean
+spam_assassin_flush_learn_queue (ESpamAssassin *extension,
+                                 gboolean is_junk,
+                                 GCancellable *cancellable,
+                                 GError **error)
+{
+	LearnQueue *queue;
+	LearnQueue pending;
+	const gchar *argv[6];
+	gint exit_code;
+	gint ii = 0;
+
+	queue = is_junk ? &extension->learn_spam : &extension->learn_ham;
+
+	/* Take the pending set, so that new messages
+	 * can be queued while sa-learn is running. */
+	g_mutex_lock (&extension->lock);
+	pending = *queue;
+	queue->directory = NULL;
+	queue->n_messages = 0;
+	g_mutex_unlock (&extension->lock);
+
+	if (pending.directory == NULL)
+		return TRUE;
+
+	if (pending.n_messages == 0) {
+		spam_assassin_learn_queue_discard (&pending);
+		return TRUE;
+	}
+
+	argv[ii++] = SA_LEARN_COMMAND;
+	argv[ii++] = is_junk ? "--spam" : "--ham";
+	argv[ii++] = "--no-sync";
+	if (extension->local_only)
+		argv[ii++] = "--local";
+	argv[ii++] = pending.directory;
+	argv[ii] = NULL;
+
+	g_assert (ii < G_N_ELEMENTS (argv));
+
+	exit_code = spam_assassin_command (
+		argv, NULL, NULL, cancellable, error);
+
+	spam_assassin_learn_queue_discard (&pending);
+
+	/* Check that the return value and GError agree. */
+	if (exit_code == SPAM_ASSASSIN_EXIT_STATUS_SUCCESS)
+		g_warn_if_fail (error == NULL || *error == NULL);
+	else
+		g_warn_if_fail (error == NULL || *error != NULL);
+
+	return (exit_code == SPAM_ASSASSIN_EXIT_STATUS_SUCCESS);
+}
+
+/* Checks the message with a running spamd, using the spamc protocol.
+ * Returns CAMEL_JUNK_STATUS_ERROR with "connected" unset when the
+ * daemon cannot be reached, so the caller can fall back to running
+ * the spamassassin program itself. */
+static CamelJunkStatus
+spam_assassin_classify_with_daemon (ESpamAssassin *extension,
+                                    CamelMimeMessage *message,
+                                    gboolean *connected,
+                                    GCancellable *cancellable,
+                                    GError **error)
+{
+	GSocketConnectable *address;
+	CamelStream *stream;
+	GByteArray *content;
+	GError *local_error = NULL;
+	gboolean is_spam = FALSE;
+	gboolean success;
+
+	*connected = FALSE;
+
+	/* spamd needs the message length up front. */
+	stream = camel_stream_mem_new ();
+	success = (camel_data_wrapper_write_to_stream_sync (
+		CAMEL_DATA_WRAPPER (message),
+		stream, cancellable, error) >= 0);
+
+	if (!success) {
+		g_object_unref (stream);
+		g_prefix_error (
+			error, _("Failed to stream mail "
+			"message content to SpamAssassin: "));
+		return CAMEL_JUNK_STATUS_ERROR;
+	}
+
+	content = camel_stream_mem_get_byte_array (CAMEL_STREAM_MEM (stream));
+	address = spam_assassin_ref_daemon_address (extension);
+
+	success = e_spamc_check (
+		extension->socket_client, address,
+		content->data, content->len,
+		connected, &is_spam, cancellable, &local_error);
+
+	g_object_unref (address);
+	g_object_unref (stream);
+
+	if (!success) {
+		/* Not being able to connect is not an error,
+		 * the caller falls back to spawning spamassassin. */
+		if (*connected)
+			g_propagate_error (error, local_error);
+		else
+			g_clear_error (&local_error);
+		return CAMEL_JUNK_STATUS_ERROR;
+	}
+
+	return is_spam ?
+		CAMEL_JUNK_STATUS_MESSAGE_IS_JUNK :
+		CAMEL_JUNK_STATUS_MESSAGE_IS_NOT_JUNK;
+}
+
 static GtkWidget *
 spam_assassin_new_config_widget (EMailJunkFilter *junk_filter)
 {
@@ -390,6 +890,29 @@ spam_assassin_new_config_widget (EMailJunkFilter *junk_filter)
 	gtk_widget_show (widget);
 	g_free (markup);
 
+	widget = gtk_check_button_new_with_mnemonic (
+		_("Use the SpamAssassin _daemon (spamd)"));
+	gtk_widget_set_margin_left (widget, 12);
+	gtk_box_pack_start (GTK_BOX (container), widget, FALSE, FALSE, 0);
+	gtk_widget_show (widget);
+
+	g_object_bind_property (
+		junk_filter, "use-daemon",
+		widget, "active",
+		G_BINDING_BIDIRECTIONAL |
+		G_BINDING_SYNC_CREATE);
+
+	markup = g_markup_printf_escaped (
+		"<small>%s</small>",
+		_("Checks messages much faster, but spamd must be running."));
+	widget = gtk_label_new (markup);
+	gtk_widget_set_margin_left (widget, 36);
+	gtk_misc_set_alignment (GTK_MISC (widget), 0.0, 0.5);
+	gtk_label_set_use_markup (GTK_LABEL (widget), TRUE);
+	gtk_box_pack_start (GTK_BOX (container), widget, FALSE, FALSE, 0);
+	gtk_widget_show (widget);
+	g_free (markup);
+
 	return box;
 }
 
@@ -408,6 +931,17 @@ spam_assassin_classify (CamelJunkFilter *junk_filter,
 	if (g_cancellable_set_error_if_cancelled (cancellable, error))
 		return FALSE;
 
+	if (extension->use_daemon) {
+		gboolean connected;
+
+		status = spam_assassin_classify_with_daemon (
+			extension, message, &connected, cancellable, error);
+
+		/* Spawn SpamAssassin if the daemon is not running. */
+		if (connected)
+			goto exit;
+	}
+
 	argv[ii++] = SPAMASSASSIN_COMMAND;
 	argv[ii++] = "--exit-code";
 	if (extension->local_only)
@@ -431,6 +965,7 @@ spam_assassin_classify (CamelJunkFilter *junk_filter,
 	else
 		status = CAMEL_JUNK_STATUS_MESSAGE_IS_JUNK;
 
+exit:
 	/* Check that the return value and GError agree. */
 	if (status != CAMEL_JUNK_STATUS_ERROR)
 		g_warn_if_fail (error == NULL || *error == NULL);
@@ -440,6 +975,10 @@ spam_assassin_classify (CamelJunkFilter *junk_filter,
 	return status;
 }
 
+/* Learning only queues the message, so a success here means it was
+ * queued.  Training itself fails in spam_assassin_synchronize(), which
+ * Camel runs after every training pass, or in the learn call filling a
+ * batch up, and the error is reported by whichever of those ran it. */
 static gboolean
 spam_assassin_learn_junk (CamelJunkFilter *junk_filter,
                           CamelMimeMessage *message,
@@ -447,32 +986,12 @@ spam_assassin_learn_junk (CamelJunkFilter *junk_filter,
                           GError **error)
 {
 	ESpamAssassin *extension = E_SPAM_ASSASSIN (junk_filter);
-	const gchar *argv[5];
-	gint exit_code;
-	gint ii = 0;
 
 	if (g_cancellable_set_error_if_cancelled (cancellable, error))
 		return FALSE;
 
-	argv[ii++] = SA_LEARN_COMMAND;
-	argv[ii++] = "--spam";
-	argv[ii++] = "--no-sync";
-	if (extension->local_only)
-		argv[ii++] = "--local";
-	argv[ii] = NULL;
-
-	g_assert (ii < G_N_ELEMENTS (argv));
-
-	exit_code = spam_assassin_command (
-		argv, message, NULL, cancellable, error);
-
-	/* Check that the return value and GError agree. */
-	if (exit_code == SPAM_ASSASSIN_EXIT_STATUS_SUCCESS)
-		g_warn_if_fail (error == NULL || *error == NULL);
-	else
-		g_warn_if_fail (error == NULL || *error != NULL);
-
-	return (exit_code == SPAM_ASSASSIN_EXIT_STATUS_SUCCESS);
+	return spam_assassin_queue_learn (
+		extension, message, TRUE, cancellable, error);
 }
 
 static gboolean
@@ -482,32 +1001,12 @@ spam_assassin_learn_not_junk (CamelJunkFilter *junk_filter,
                               GError **error)
 {
 	ESpamAssassin *extension = E_SPAM_ASSASSIN (junk_filter);
-	const gchar *argv[5];
-	gint exit_code;
-	gint ii = 0;
 
 	if (g_cancellable_set_error_if_cancelled (cancellable, error))
 		return FALSE;
 
-	argv[ii++] = SA_LEARN_COMMAND;
-	argv[ii++] = "--ham";
-	argv[ii++] = "--no-sync";
-	if (extension->local_only)
-		argv[ii++] = "--local";
-	argv[ii] = NULL;
-
-	g_assert (ii < G_N_ELEMENTS (argv));
-
-	exit_code = spam_assassin_command (
-		argv, message, NULL, cancellable, error);
-
-	/* Check that the return value and GError agree. */
-	if (exit_code == SPAM_ASSASSIN_EXIT_STATUS_SUCCESS)
-		g_warn_if_fail (error == NULL || *error == NULL);
-	else
-		g_warn_if_fail (error == NULL || *error != NULL);
-
-	return (exit_code == SPAM_ASSASSIN_EXIT_STATUS_SUCCESS);
+	return spam_assassin_queue_learn (
+		extension, message, FALSE, cancellable, error);
 }
 
 static gboolean
@@ -523,6 +1022,15 @@ spam_assassin_synchronize (CamelJunkFilter *junk_filter,
 	if (g_cancellable_set_error_if_cancelled (cancellable, error))
 		return FALSE;
 
+	/* Train on the collected messages before syncing. */
+	if (!spam_assassin_flush_learn_queue (
+		extension, TRUE, cancellable, error))
+		return FALSE;
+
+	if (!spam_assassin_flush_learn_queue (
+		extension, FALSE, cancellable, error))
+		return FALSE;
+
 	argv[ii++] = SA_LEARN_COMMAND;
 	argv[ii++] = "--sync";
 	if (extension->local_only)
@@ -552,6 +1060,8 @@ e_spam_assassin_class_init (ESpamAssassinClass *class)
 	object_class = G_OBJECT_CLASS (class);
 	object_class->set_property = spam_assassin_set_property;
 	object_class->get_property = spam_assassin_get_property;
+	object_class->finalize = spam_assassin_finalize;
+	object_class->constructed = spam_assassin_constructed;
 
 	junk_filter_class = E_MAIL_JUNK_FILTER_CLASS (class);
 	junk_filter_class->filter_name = "SpamAssassin";
@@ -567,6 +1077,37 @@ e_spam_assassin_class_init (ESpamAssassinClass *class)
 			"Do not use tests requiring DNS lookups",
 			TRUE,
 			G_PARAM_READWRITE));
+
+	g_object_class_install_property (
+		object_class,
+		PROP_USE_DAEMON,
+		g_param_spec_boolean (
+			"use-daemon",
+			"Use Daemon",
+			"Check messages with a running spamd",
+			FALSE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property (
+		object_class,
+		PROP_SOCKET_PATH,
+		g_param_spec_string (
+			"socket-path",
+			"Socket Path",
+			"UNIX domain socket of the spamd to use",
+			NULL,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property (
+		object_class,
+		PROP_DAEMON_PORT,
+		g_param_spec_int (
+			"daemon-port",
+			"Daemon Port",
+			"Local TCP port of the spamd to use",
+			1, G_MAXUINT16,
+			SPAMD_DEFAULT_PORT,
+			G_PARAM_READWRITE));
 }
 
 static void
@@ -588,6 +1129,10 @@ e_spam_assassin_init (ESpamAssassin *extension)
 {
 	GSettings *settings;
 
+	g_mutex_init (&extension->lock);
+	extension->daemon_port = SPAMD_DEFAULT_PORT;
+	extension->socket_client = g_socket_client_new ();
+
 	settings = g_settings_new ("org.gnome.evolution.spamassassin");
 
 	g_settings_bind (
@@ -595,6 +1140,21 @@ e_spam_assassin_init (ESpamAssassin *extension)
 		extension, "local-only",
 		G_SETTINGS_BIND_DEFAULT);
 
+	g_settings_bind (
+		settings, "use-daemon",
+		extension, "use-daemon",
+		G_SETTINGS_BIND_DEFAULT);
+
+	g_settings_bind (
+		settings, "socket-path",
+		extension, "socket-path",
+		G_SETTINGS_BIND_DEFAULT);
+
+	g_settings_bind (
+		settings, "daemon-port",
+		extension, "daemon-port",
+		G_SETTINGS_BIND_DEFAULT);
+
 	g_object_unref (settings);
 }
 
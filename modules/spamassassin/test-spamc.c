@@ -0,0 +1,289 @@
+/*
+ * test-spamc.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * test-spamc - checks e_spamc_check() against a stand-in spamd, which
+ * calls a message spam if it contains SPAM_MARKER.  Exits with a non-zero
+ * status if any check fails.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "e-spamc.h"
+
+#define SPAM_MARKER "BUY-CHEAP-STUFF"
+
+#define HAM_MESSAGE \
+	"From: alice@example.com\r\n" \
+	"Subject: Lunch\r\n" \
+	"\r\n" \
+	"Noon at the usual place?\r\n"
+
+#define SPAM_MESSAGE \
+	"From: bob@example.com\r\n" \
+	"Subject: Offer\r\n" \
+	"\r\n" \
+	SPAM_MARKER " today only\r\n"
+
+typedef enum {
+	DAEMON_REPLY,		/* answers like spamd does */
+	DAEMON_HANG_UP		/* reads the request, then hangs up */
+} DaemonMode;
+
+typedef struct _Daemon Daemon;
+
+struct _Daemon {
+	GSocketListener *listener;
+	guint16 port;
+	DaemonMode mode;
+	guint n_clients;
+	GThread *thread;
+};
+
+static gint n_failures;
+
+static void
+check (gboolean condition,
+       const gchar *what)
+{
+	g_print ("%s: %s\n", condition ? "PASS" : "FAIL", what);
+
+	if (!condition)
+		n_failures++;
+}
+
+static void
+daemon_serve_client (Daemon *daemon,
+                     GSocketConnection *connection)
+{
+	GDataInputStream *input_stream;
+	GOutputStream *output_stream;
+	gsize content_length = 0;
+	gchar *content = NULL;
+	gchar *line;
+
+	input_stream = g_data_input_stream_new (
+		g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+	g_data_input_stream_set_newline_type (
+		input_stream, G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+
+	/* Request line and headers, up to a blank line. */
+	while ((line = g_data_input_stream_read_line (
+		input_stream, NULL, NULL, NULL)) != NULL) {
+		gboolean done = (*line == '\0');
+
+		if (g_ascii_strncasecmp (line, "Content-length:", 15) == 0)
+			content_length = g_ascii_strtoull (line + 15, NULL, 10);
+
+		g_free (line);
+
+		if (done)
+			break;
+	}
+
+	content = g_malloc0 (content_length + 1);
+	g_input_stream_read_all (
+		G_INPUT_STREAM (input_stream),
+		content, content_length, NULL, NULL, NULL);
+
+	if (daemon->mode == DAEMON_REPLY) {
+		const gchar *reply;
+
+		if (strstr (content, SPAM_MARKER) != NULL)
+			reply = "SPAMD/1.1 0 EX_OK\r\n"
+				"Spam: True ; 15.0 / 5.0\r\n\r\n";
+		else
+			reply = "SPAMD/1.1 0 EX_OK\r\n"
+				"Spam: False ; 0.5 / 5.0\r\n\r\n";
+
+		output_stream = g_io_stream_get_output_stream (
+			G_IO_STREAM (connection));
+		g_output_stream_write_all (
+			output_stream, reply, strlen (reply),
+			NULL, NULL, NULL);
+	}
+
+	g_io_stream_close (G_IO_STREAM (connection), NULL, NULL);
+
+	g_object_unref (input_stream);
+	g_free (content);
+}
+
+static gpointer
+daemon_thread (gpointer user_data)
+{
+	Daemon *daemon = user_data;
+	guint ii;
+
+	for (ii = 0; ii < daemon->n_clients; ii++) {
+		GSocketConnection *connection;
+
+		connection = g_socket_listener_accept (
+			daemon->listener, NULL, NULL, NULL);
+		if (connection == NULL)
+			break;
+
+		daemon_serve_client (daemon, connection);
+		g_object_unref (connection);
+	}
+
+	return NULL;
+}
+
+static Daemon *
+daemon_start (DaemonMode mode,
+              guint n_clients)
+{
+	Daemon *daemon;
+	GError *local_error = NULL;
+
+	daemon = g_slice_new0 (Daemon);
+	daemon->mode = mode;
+	daemon->n_clients = n_clients;
+	daemon->listener = g_socket_listener_new ();
+	daemon->port = g_socket_listener_add_any_inet_port (
+		daemon->listener, NULL, &local_error);
+
+	if (local_error != NULL)
+		g_error ("Cannot listen: %s", local_error->message);
+
+	if (n_clients > 0)
+		daemon->thread = g_thread_new (
+			"stand-in-spamd", daemon_thread, daemon);
+
+	return daemon;
+}
+
+static void
+daemon_stop (Daemon *daemon)
+{
+	if (daemon->thread != NULL)
+		g_thread_join (daemon->thread);
+
+	g_socket_listener_close (daemon->listener);
+	g_object_unref (daemon->listener);
+
+	g_slice_free (Daemon, daemon);
+}
+
+static gboolean
+check_message (guint16 port,
+               const gchar *message,
+               gboolean *out_connected,
+               gboolean *out_is_spam,
+               GError **error)
+{
+	GSocketClient *client;
+	GSocketConnectable *address;
+	gboolean success;
+
+	client = g_socket_client_new ();
+	address = g_network_address_new ("127.0.0.1", port);
+
+	success = e_spamc_check (
+		client, address,
+		(const guint8 *) message, strlen (message),
+		out_connected, out_is_spam, NULL, error);
+
+	g_object_unref (address);
+	g_object_unref (client);
+
+	return success;
+}
+
+static void
+test_verdicts (void)
+{
+	Daemon *daemon;
+	GError *local_error = NULL;
+	gboolean connected, is_spam;
+	gboolean success;
+
+	daemon = daemon_start (DAEMON_REPLY, 2);
+
+	success = check_message (
+		daemon->port, HAM_MESSAGE,
+		&connected, &is_spam, &local_error);
+	check (success && local_error == NULL, "ham is checked");
+	check (connected && !is_spam, "ham is not spam");
+	g_clear_error (&local_error);
+
+	success = check_message (
+		daemon->port, SPAM_MESSAGE,
+		&connected, &is_spam, &local_error);
+	check (success && local_error == NULL, "spam is checked");
+	check (connected && is_spam, "spam is spam");
+	g_clear_error (&local_error);
+
+	daemon_stop (daemon);
+}
+
+static void
+test_hang_up (void)
+{
+	Daemon *daemon;
+	GError *local_error = NULL;
+	gboolean connected, is_spam;
+	gboolean success;
+
+	daemon = daemon_start (DAEMON_HANG_UP, 1);
+
+	success = check_message (
+		daemon->port, HAM_MESSAGE,
+		&connected, &is_spam, &local_error);
+	check (!success && local_error != NULL, "no reply is an error");
+	check (connected, "no reply still counts as connected");
+	g_clear_error (&local_error);
+
+	daemon_stop (daemon);
+}
+
+static void
+test_no_daemon (void)
+{
+	Daemon *daemon;
+	GError *local_error = NULL;
+	gboolean connected, is_spam;
+	gboolean success;
+	guint16 port;
+
+	/* Grab a free port, then stop listening on it. */
+	daemon = daemon_start (DAEMON_REPLY, 0);
+	port = daemon->port;
+	daemon_stop (daemon);
+
+	success = check_message (
+		port, HAM_MESSAGE, &connected, &is_spam, &local_error);
+	check (!success && !connected, "a missing daemon is not connected");
+	g_clear_error (&local_error);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	test_verdicts ();
+	test_hang_up ();
+	test_no_daemon ();
+
+	return (n_failures > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1122,6 +1122,7 @@ EShellView *
 e_shell_window_get_shell_view (EShellWindow *shell_window,
                                const gchar *view_name)
 {
+	EShell *shell;
 	EShellView *shell_view;
 	EShellWindowClass *class;
 
@@ -1135,6 +1136,11 @@ e_shell_window_get_shell_view (EShellWindow *shell_window,
 	class = E_SHELL_WINDOW_GET_CLASS (shell_window);
 	g_return_val_if_fail (class->create_shell_view != NULL, NULL);
 
+	/* Modules serving the view must be loaded before it exists. */
+	shell = e_shell_window_get_shell (shell_window);
+	if (shell != NULL)
+		e_shell_load_deferred_modules (shell, view_name);
+
 	shell_view = class->create_shell_view (shell_window, view_name);
 
 	g_signal_emit (
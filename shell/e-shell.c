@@ -31,6 +31,7 @@
 #include "e-shell.h"
 
 #include <errno.h>
+#include <string.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 #include <libebackend/libebackend.h>
@@ -46,6 +47,31 @@
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), E_TYPE_SHELL, EShellPrivate))
 
+/* Modules may ship a key file next to the shared object, named after
+ * it with a ".module" suffix, which declares the shell views they
+ * serve and the extensible types they extend:
+ *
+ *   [Evolution Module]
+ *   Views=mail;
+ *   ExtensionPoints=EMailParser;EMailFormatter;
+ *
+ * Such modules are not loaded at startup, but before the first of
+ * their views is created, before the class of one of the types they
+ * extend is initialized or in the background once the main loop is
+ * idle, whichever comes first.  Modules providing shell backends,
+ * plugin hooks or extensions of objects which exist from startup on
+ * must not declare any views. */
+#define MODULE_INFO_GROUP "Evolution Module"
+#define MODULE_INFO_SUFFIX ".module"
+
+typedef struct _ModuleInfo ModuleInfo;
+
+struct _ModuleInfo {
+	gchar *filename;
+	gchar **views;
+	gchar **extension_points;
+};
+
 struct _EShellPrivate {
 	GQueue alerts;
 	ESourceRegistry *registry;
@@ -63,6 +89,12 @@ struct _EShellPrivate {
 	gchar *geometry;
 	gchar *module_directory;
 
+	/* Classes may look for their extensions from any thread, so the
+	 * queue is locked until the modules taken from it are loaded. */
+	GRecMutex deferred_modules_lock;
+	GQueue deferred_modules;             /* ModuleInfo */
+	guint deferred_modules_idle_id;
+
 	guint inhibit_cookie;
 
 	gulong backend_died_handler_id;
@@ -114,6 +146,215 @@ G_DEFINE_TYPE_WITH_CODE (
 	G_IMPLEMENT_INTERFACE (
 		E_TYPE_EXTENSIBLE, NULL))
 
+static void
+module_info_free (ModuleInfo *info)
+{
+	g_free (info->filename);
+	g_strfreev (info->views);
+	g_strfreev (info->extension_points);
+
+	g_slice_free (ModuleInfo, info);
+}
+
+/* Returns %NULL if the module at @filename declares no views. */
+static ModuleInfo *
+module_info_new (const gchar *filename)
+{
+	ModuleInfo *info;
+	GKeyFile *key_file;
+	gchar *basename;
+	gchar *key_filename;
+	gchar **views;
+
+	basename = g_strndup (
+		filename, strlen (filename) - strlen ("." G_MODULE_SUFFIX));
+	key_filename = g_strconcat (basename, MODULE_INFO_SUFFIX, NULL);
+	key_file = g_key_file_new ();
+	g_free (basename);
+
+	if (!g_key_file_load_from_file (key_file, key_filename, 0, NULL)) {
+		g_key_file_free (key_file);
+		g_free (key_filename);
+		return NULL;
+	}
+
+	views = g_key_file_get_string_list (
+		key_file, MODULE_INFO_GROUP, "Views", NULL, NULL);
+
+	if (views == NULL || *views == NULL) {
+		g_strfreev (views);
+		g_key_file_free (key_file);
+		g_free (key_filename);
+		return NULL;
+	}
+
+	info = g_slice_new0 (ModuleInfo);
+	info->filename = g_strdup (filename);
+	info->views = views;
+	info->extension_points = g_key_file_get_string_list (
+		key_file, MODULE_INFO_GROUP, "ExtensionPoints", NULL, NULL);
+
+	g_key_file_free (key_file);
+	g_free (key_filename);
+
+	return info;
+}
+
+static gboolean
+module_info_serves_view (ModuleInfo *info,
+                         const gchar *view_name)
+{
+	gint ii;
+
+	for (ii = 0; info->views[ii] != NULL; ii++) {
+		if (g_strcmp0 (info->views[ii], view_name) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Whether one of the types the module extends is in use already,
+ * in which case deferring the module would lose its extensions. */
+static gboolean
+module_info_extension_points_in_use (ModuleInfo *info)
+{
+	gint ii;
+
+	if (info->extension_points == NULL)
+		return FALSE;
+
+	for (ii = 0; info->extension_points[ii] != NULL; ii++) {
+		GType type;
+
+		type = g_type_from_name (info->extension_points[ii]);
+		if (type != G_TYPE_INVALID && g_type_class_peek (type) != NULL)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean
+module_info_extends_type (ModuleInfo *info,
+                          GType extensible_type)
+{
+	gint ii;
+
+	if (info->extension_points == NULL)
+		return FALSE;
+
+	for (ii = 0; info->extension_points[ii] != NULL; ii++) {
+		GType type;
+
+		type = g_type_from_name (info->extension_points[ii]);
+		if (type != G_TYPE_INVALID && g_type_is_a (extensible_type, type))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+shell_load_module (const gchar *filename)
+{
+	EModule *module;
+	ETraceSpan span;
+
+	e_trace_span_begin (&span, "shell", "load-module");
+
+	module = e_module_load_file (filename);
+	if (module != NULL)
+		g_type_module_unuse (G_TYPE_MODULE (module));
+
+	e_trace_span_end (&span, filename);
+}
+
+/* Loads the deferred modules serving @view_name if given, else those
+ * extending @extensible_type if given, else all of them.  Loading one
+ * may initialize classes and get us here again, so the matching ones
+ * are taken off the queue first.  The lock is held until they are
+ * loaded, so that a thread finding its modules taken by another one
+ * waits for them. */
+static void
+shell_load_deferred_modules (EShell *shell,
+                             const gchar *view_name,
+                             GType extensible_type)
+{
+	GQueue matching = G_QUEUE_INIT;
+	ModuleInfo *info;
+	GList *link;
+
+	g_rec_mutex_lock (&shell->priv->deferred_modules_lock);
+
+	link = g_queue_peek_head_link (&shell->priv->deferred_modules);
+
+	while (link != NULL) {
+		GList *next = g_list_next (link);
+		gboolean match;
+
+		info = link->data;
+
+		if (view_name != NULL)
+			match = module_info_serves_view (info, view_name);
+		else if (extensible_type != G_TYPE_INVALID)
+			match = module_info_extends_type (info, extensible_type);
+		else
+			match = TRUE;
+
+		if (match) {
+			g_queue_delete_link (
+				&shell->priv->deferred_modules, link);
+			g_queue_push_tail (&matching, info);
+		}
+
+		link = next;
+	}
+
+	while ((info = g_queue_pop_head (&matching)) != NULL) {
+		shell_load_module (info->filename);
+		module_info_free (info);
+	}
+
+	g_rec_mutex_unlock (&shell->priv->deferred_modules_lock);
+}
+
+static void
+shell_prepare_extension_point_cb (GType extensible_type,
+                                  gpointer user_data)
+{
+	EShell *shell = E_SHELL (user_data);
+
+	shell_load_deferred_modules (shell, NULL, extensible_type);
+}
+
+static gboolean
+shell_load_deferred_modules_idle_cb (gpointer user_data)
+{
+	EShell *shell = E_SHELL (user_data);
+	ModuleInfo *info;
+	gboolean done;
+
+	g_rec_mutex_lock (&shell->priv->deferred_modules_lock);
+
+	/* One module per iteration, to keep the UI responsive. */
+	info = g_queue_pop_head (&shell->priv->deferred_modules);
+
+	if (info != NULL) {
+		shell_load_module (info->filename);
+		module_info_free (info);
+	}
+
+	done = g_queue_is_empty (&shell->priv->deferred_modules);
+
+	g_rec_mutex_unlock (&shell->priv->deferred_modules_lock);
+
+	if (done)
+		shell->priv->deferred_modules_idle_id = 0;
+
+	return !done;
+}
+
 static void
 shell_alert_response_cb (EShell *shell,
                          gint response_id,
@@ -151,6 +392,20 @@ shell_window_delete_event_cb (GtkWindow *window,
 	return TRUE;
 }
 
+/* Marks when a new window is first drawn, not merely shown. */
+static gboolean
+shell_window_drawn_cb (GtkWidget *shell_window,
+                       cairo_t *cr,
+                       gpointer user_data)
+{
+	g_signal_handlers_disconnect_by_func (
+		shell_window, shell_window_drawn_cb, user_data);
+
+	e_trace_instant ("shell", "shell-window-shown");
+
+	return FALSE;
+}
+
 static void
 shell_action_new_window_cb (GSimpleAction *action,
                             GVariant *parameter,
@@ -681,6 +936,14 @@ shell_dispose (GObject *object)
 		priv->backend_died_handler_id = 0;
 	}
 
+	if (priv->deferred_modules_idle_id > 0) {
+		g_source_remove (priv->deferred_modules_idle_id);
+		priv->deferred_modules_idle_id = 0;
+	}
+
+	if (priv->modules_loaded)
+		e_util_set_extension_point_func (NULL, NULL);
+
 	g_clear_object (&priv->registry);
 	g_clear_object (&priv->client_cache);
 	g_clear_object (&priv->preferences_window);
@@ -711,6 +974,10 @@ shell_finalize (GObject *object)
 	g_free (priv->geometry);
 	g_free (priv->module_directory);
 
+	while (!g_queue_is_empty (&priv->deferred_modules))
+		module_info_free (g_queue_pop_head (&priv->deferred_modules));
+	g_rec_mutex_clear (&priv->deferred_modules_lock);
+
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_shell_parent_class)->finalize (object);
 }
@@ -1150,6 +1417,7 @@ e_shell_init (EShell *shell)
 	backends_by_scheme = g_hash_table_new (g_str_hash, g_str_equal);
 
 	g_queue_init (&shell->priv->alerts);
+	g_rec_mutex_init (&shell->priv->deferred_modules_lock);
 
 	shell->priv->preferences_window = e_preferences_window_new (shell);
 	shell->priv->backends_by_name = backends_by_name;
@@ -1195,27 +1463,77 @@ e_shell_get_default (void)
  * Loads all installed modules and performs some internal bookkeeping.
  * This function should be called after creating the #EShell instance
  * but before initiating migration or starting the main loop.
+ *
+ * Modules which declare the shell views they serve are not loaded here.
+ * They are loaded by e_shell_load_deferred_modules() before one of their
+ * views is created, before the class of a type they extend is initialized
+ * (see e_util_prepare_extension_point()), and in the background once the
+ * main loop is idle.
  **/
 void
 e_shell_load_modules (EShell *shell)
 {
 	EClientCache *client_cache;
 	const gchar *module_directory;
+	const gchar *name;
 	GList *list;
+	GDir *dir;
+	ETraceSpan span;
 
 	g_return_if_fail (E_IS_SHELL (shell));
 
 	if (shell->priv->modules_loaded)
 		return;
 
+	e_trace_span_begin (&span, "shell", "load-modules");
+
 	/* Load all shared library modules. */
 
 	module_directory = e_shell_get_module_directory (shell);
 	g_return_if_fail (module_directory != NULL);
 
-	list = e_module_load_all_in_directory (module_directory);
-	g_list_foreach (list, (GFunc) g_type_module_unuse, NULL);
-	g_list_free (list);
+	/* Modules loaded while scanning may already need deferred ones. */
+	e_util_set_extension_point_func (
+		shell_prepare_extension_point_cb, shell);
+
+	dir = g_dir_open (module_directory, 0, NULL);
+
+	while (dir != NULL && (name = g_dir_read_name (dir)) != NULL) {
+		ModuleInfo *info;
+		gchar *filename;
+
+		if (!g_str_has_suffix (name, "." G_MODULE_SUFFIX))
+			continue;
+
+		filename = g_build_filename (module_directory, name, NULL);
+		info = module_info_new (filename);
+
+		if (info == NULL) {
+			shell_load_module (filename);
+		} else if (module_info_extension_points_in_use (info)) {
+			shell_load_module (filename);
+			module_info_free (info);
+		} else {
+			g_rec_mutex_lock (&shell->priv->deferred_modules_lock);
+			g_queue_push_tail (&shell->priv->deferred_modules, info);
+			g_rec_mutex_unlock (&shell->priv->deferred_modules_lock);
+		}
+
+		g_free (filename);
+	}
+
+	if (dir != NULL)
+		g_dir_close (dir);
+
+	/* Load the remaining deferred modules once the main loop runs,
+	 * which may be without any shell window, e.g. for a mailto URI. */
+	g_rec_mutex_lock (&shell->priv->deferred_modules_lock);
+	if (!g_queue_is_empty (&shell->priv->deferred_modules))
+		shell->priv->deferred_modules_idle_id = g_idle_add_full (
+			G_PRIORITY_LOW,
+			shell_load_deferred_modules_idle_cb,
+			shell, (GDestroyNotify) NULL);
+	g_rec_mutex_unlock (&shell->priv->deferred_modules_lock);
 
 	/* Process shell backends. */
 
@@ -1232,6 +1550,26 @@ e_shell_load_modules (EShell *shell)
 	e_extensible_load_extensions (E_EXTENSIBLE (client_cache));
 
 	shell->priv->modules_loaded = TRUE;
+
+	e_trace_span_end (&span, NULL);
+}
+
+/**
+ * e_shell_load_deferred_modules:
+ * @shell: an #EShell
+ * @view_name: name of a shell view, or %NULL
+ *
+ * Loads the modules e_shell_load_modules() has deferred which serve the
+ * shell view named @view_name, or all of them if @view_name is %NULL.
+ * This is called before each shell view is created.
+ **/
+void
+e_shell_load_deferred_modules (EShell *shell,
+                               const gchar *view_name)
+{
+	g_return_if_fail (E_IS_SHELL (shell));
+
+	shell_load_deferred_modules (shell, view_name, G_TYPE_INVALID);
 }
 
 /**
@@ -1416,6 +1754,10 @@ e_shell_create_shell_window (EShell *shell,
 	g_free (shell->priv->geometry);
 	shell->priv->geometry = NULL;
 
+	g_signal_connect_after (
+		shell_window, "draw",
+		G_CALLBACK (shell_window_drawn_cb), NULL);
+
 	gtk_widget_show (shell_window);
 
 	return shell_window;
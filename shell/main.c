@@ -106,6 +106,9 @@ static gchar *geometry = NULL;
 static gchar *requested_view = NULL;
 static gchar **remaining_args;
 
+/* From entering main() to drawing the first window. */
+static ETraceSpan startup_span;
+
 /* Forward declarations */
 void e_convert_local_mail (EShell *shell);
 void e_migrate_base_dirs (EShell *shell);
@@ -229,12 +232,26 @@ show_development_warning (void)
 
 #endif /* DEVELOPMENT */
 
+static gboolean
+startup_window_drawn_cb (GtkWidget *shell_window,
+                         cairo_t *cr,
+                         gpointer user_data)
+{
+	g_signal_handlers_disconnect_by_func (
+		shell_window, startup_window_drawn_cb, user_data);
+
+	e_trace_span_end (&startup_span, NULL);
+
+	return FALSE;
+}
+
 /* This is for doing stuff that requires the GTK+ loop to be running already.  */
 
 static gboolean
 idle_cb (const gchar * const *uris)
 {
 	EShell *shell;
+	GtkWidget *shell_window = NULL;
 
 	shell = e_shell_get_default ();
 
@@ -244,9 +261,18 @@ idle_cb (const gchar * const *uris)
 		if (e_shell_handle_uris (shell, uris, import_uris) == 0)
 			gtk_main_quit ();
 	} else {
-		e_shell_create_shell_window (shell, requested_view);
+		shell_window = e_shell_create_shell_window (
+			shell, requested_view);
 	}
 
+	/* The window is drawn once we are back in the main loop. */
+	if (shell_window != NULL)
+		g_signal_connect_after (
+			shell_window, "draw",
+			G_CALLBACK (startup_window_drawn_cb), NULL);
+	else
+		e_trace_span_end (&startup_span, NULL);
+
 	/* If another Evolution process is running, we're done. */
 	if (g_application_get_is_remote (G_APPLICATION (shell)))
 		gtk_main_quit ();
@@ -471,6 +497,8 @@ main (gint argc,
 	}
 #endif
 
+	e_trace_span_begin (&startup_span, "shell", "startup");
+
 	/* Make ElectricFence work.  */
 	free (malloc (10));
 